@@ -0,0 +1,970 @@
+#include <stdlib.h>
+
+#include "compiler.h"
+#include "../util_array.h"
+#include "../runtime/symbol.h"
+#include "../runtime/lisp_string.h"
+#include "../trace/trace.h"
+
+
+struct CompilerFunction;
+
+
+/**
+ * A local variable: a parameter, or a variable or function declared in a
+ * function's body.
+ */
+typedef struct {
+    LispValue name;
+    // The function whose frame holds the variable.
+    struct CompilerFunction *owner;
+    bool parameter;
+    // The position of the variable among its owner's parameters, or among
+    // the other variables declared in its owner.
+    u32 index;
+    // The function the variable is defined as, if it is declared by a
+    // `define`.
+    struct CompilerFunction *function;
+} CompilerBinding;
+
+
+/**
+ * What is known about a function, the top level of the program included,
+ * before it is compiled.
+ */
+typedef struct CompilerFunction {
+    AstNode *node;
+    // The function the function is defined in, or `NULL` for the top level.
+    struct CompilerFunction *parent;
+    // The symbol the function is defined as, or `nil`.
+    LispValue name;
+    // The variable naming the function within its own body, if any.
+    CompilerBinding *self;
+    u32 parameter_count;
+    // The number of variables declared in the function's body.
+    u32 declared_count;
+    // Whether the function is used as a value, and so needs a closure.
+    bool escapes;
+
+    // The variables of enclosing functions that the function uses, and
+    // which it captures if it escapes or is passed as arguments if not.
+    CompilerBinding **free;
+    u32 free_count;
+    u32 free_capacity;
+
+    // The functions that are called without a closure from the function.
+    struct CompilerFunction **calls;
+    u32 call_count;
+    u32 call_capacity;
+
+    // The escaping functions whose closures the function makes.
+    struct CompilerFunction **creates;
+    u32 create_count;
+    u32 create_capacity;
+
+    // The forms of a chunk of the program, if the function is one.
+    u32 first_form;
+    u32 form_count;
+
+    LispFunction *compiled;
+} CompilerFunction;
+
+
+/**
+ * A use of a variable by a function.
+ */
+typedef struct {
+    CompilerFunction *function;
+    CompilerBinding *binding;
+    // Whether the variable is only called, with the right arguments.
+    bool call;
+} CompilerReference;
+
+
+/**
+ * What the compiler found out about the syntax located at a token: the
+ * variable declared there or referred to there, and the function defined
+ * there. Each declaration, reference and function is located at its own
+ * token, so these are indexed by token.
+ */
+typedef struct {
+    CompilerBinding *binding;
+    CompilerFunction *function;
+} CompilerNote;
+
+
+typedef struct {
+    TokenList *tokens;
+    CompilerNote *notes;
+    LispError *error;
+    u32 depth;
+
+    // The variables in scope, innermost last.
+    CompilerBinding **scope;
+    u32 scope_count;
+    u32 scope_capacity;
+
+    // Every function, in the order they are found.
+    CompilerFunction **functions;
+    u32 function_count;
+    u32 function_capacity;
+
+    CompilerBinding **bindings;
+    u32 binding_count;
+    u32 binding_capacity;
+
+    CompilerReference *references;
+    u32 reference_count;
+    u32 reference_capacity;
+} Compiler;
+
+
+/**
+ * A function being compiled to bytecode.
+ */
+typedef struct {
+    Compiler *compiler;
+    CompilerFunction *function;
+
+    u8 *code;
+    u32 code_length;
+    u32 code_capacity;
+
+    LispValue *constants;
+    u32 constant_count;
+    u32 constant_capacity;
+    // A hash table of the constants, each slot 0 if it is empty or the
+    // index of a constant plus one.
+    u32 *constant_slots;
+    u32 constant_slot_count;
+
+    // The number of inline caches of globals.
+    u32 cache_count;
+
+    // The number of values on the stack above the locals, and the most
+    // there have been.
+    u32 height;
+    u32 max_height;
+} Emitter;
+
+
+/**
+ * Fail with an error located at `token`, unless compilation has failed
+ * already.
+ */
+static void compiler_fail(Compiler *compiler, LispToken *token, char *message) {
+    if (compiler->error == NULL) {
+        compiler->error = lisp_parser_error(message, line_table_position(&compiler->tokens->lines, token->offset));
+    }
+}
+
+
+inline static CompilerNote *compiler_note(Compiler *compiler, LispToken *token) {
+    return &compiler->notes[token - compiler->tokens->tokens];
+}
+
+
+static LispValue compiler_symbol(Compiler *compiler, LispToken *token) {
+    return symbol_intern(token_lexeme(compiler->tokens, token), token->length);
+}
+
+
+static CompilerFunction *compiler_add_function(Compiler *compiler, CompilerFunction *parent, AstNode *node, LispValue name) {
+    CompilerFunction *function = (CompilerFunction *) calloc(1, sizeof(CompilerFunction));
+    function->parent = parent;
+    function->node = node;
+    function->name = name;
+
+    compiler->functions = array_reserve(compiler->functions, &compiler->function_capacity,
+        compiler->function_count, 1, sizeof(CompilerFunction *));
+    compiler->functions[compiler->function_count++] = function;
+    return function;
+}
+
+
+/**
+ * Declare a variable named by `token` in `owner`, in scope until the scope
+ * it is declared in ends.
+ */
+static CompilerBinding *compiler_declare(Compiler *compiler, CompilerFunction *owner, LispToken *token, bool parameter) {
+    CompilerBinding *binding = (CompilerBinding *) calloc(1, sizeof(CompilerBinding));
+    binding->name = compiler_symbol(compiler, token);
+    binding->owner = owner;
+    binding->parameter = parameter;
+    binding->index = parameter ? owner->parameter_count++ : owner->declared_count++;
+    compiler_note(compiler, token)->binding = binding;
+
+    compiler->bindings = array_reserve(compiler->bindings, &compiler->binding_capacity,
+        compiler->binding_count, 1, sizeof(CompilerBinding *));
+    compiler->bindings[compiler->binding_count++] = binding;
+
+    compiler->scope = array_reserve(compiler->scope, &compiler->scope_capacity,
+        compiler->scope_count, 1, sizeof(CompilerBinding *));
+    compiler->scope[compiler->scope_count++] = binding;
+    return binding;
+}
+
+
+/**
+ * Find the innermost variable in scope named `name`.
+ *
+ * @return The variable, or `NULL` for a global.
+ */
+static CompilerBinding *compiler_lookup(Compiler *compiler, LispValue name) {
+    for (u32 i = compiler->scope_count; i > 0; --i) {
+        if (compiler->scope[i - 1]->name == name) {
+            return compiler->scope[i - 1];
+        }
+    }
+    return NULL;
+}
+
+
+static void compiler_add_reference(Compiler *compiler, CompilerFunction *function, CompilerBinding *binding, bool call) {
+    compiler->references = array_reserve(compiler->references, &compiler->reference_capacity,
+        compiler->reference_count, 1, sizeof(CompilerReference));
+    compiler->references[compiler->reference_count++] = (CompilerReference) {
+        .function = function,
+        .binding = binding,
+        .call = call
+    };
+}
+
+
+/**
+ * Add `function` to a list of functions, if it is not in it already.
+ */
+static void compiler_add_function_to(CompilerFunction ***list, u32 *count, u32 *capacity, CompilerFunction *function) {
+    for (u32 i = 0; i < *count; ++i) {
+        if ((*list)[i] == function) {
+            return;
+        }
+    }
+    *list = array_reserve(*list, capacity, *count, 1, sizeof(CompilerFunction *));
+    (*list)[(*count)++] = function;
+}
+
+
+/**
+ * Add `binding` to the free variables of `function`, unless it is one of
+ * the function's own variables or its name.
+ *
+ * @return Whether `binding` was added.
+ */
+static bool compiler_add_free(CompilerFunction *function, CompilerBinding *binding) {
+    if (binding->owner == function || binding == function->self) {
+        return false;
+    }
+    for (u32 i = 0; i < function->free_count; ++i) {
+        if (function->free[i] == binding) {
+            return false;
+        }
+    }
+    function->free = array_reserve(function->free, &function->free_capacity,
+        function->free_count, 1, sizeof(CompilerBinding *));
+    function->free[function->free_count++] = binding;
+    return true;
+}
+
+
+static void compiler_resolve(Compiler *compiler, CompilerFunction *function, AstNode *node, bool used);
+
+
+/**
+ * Resolve `node` in a scope of its own, so that what it declares is not
+ * visible after it.
+ */
+static void compiler_resolve_scoped(Compiler *compiler, CompilerFunction *function, AstNode *node, bool used) {
+    u32 scope_count = compiler->scope_count;
+    compiler_resolve(compiler, function, node, used);
+    compiler->scope_count = scope_count;
+}
+
+
+/**
+ * Resolve the parameters and body of `node`, a function definition or
+ * lambda expression, as the function `function`.
+ */
+static void compiler_resolve_function(Compiler *compiler, CompilerFunction *function, AstNode *node) {
+    u32 scope_count = compiler->scope_count;
+    u32 parameter_count = node->child_count - 1;
+    for (u32 i = 0; i < parameter_count; ++i) {
+        compiler_declare(compiler, function, node->children[i]->token, true);
+    }
+    compiler_resolve(compiler, function, node->children[parameter_count], true);
+    compiler->scope_count = scope_count;
+}
+
+
+/**
+ * Resolve a call. A call of a local function by name, or of a lambda
+ * expression, with the number of arguments it takes does not make the
+ * function escape.
+ */
+static void compiler_resolve_call(Compiler *compiler, CompilerFunction *function, AstNode *node) {
+    AstNode *callee = node->children[0];
+    u32 argument_count = node->child_count - 1;
+
+    if (callee->type == AST_IDENTIFIER) {
+        CompilerBinding *binding = compiler_lookup(compiler, compiler_symbol(compiler, callee->token));
+        compiler_note(compiler, callee->token)->binding = binding;
+        if (binding != NULL) {
+            bool call = binding->function != NULL && binding->function->parameter_count == argument_count;
+            compiler_add_reference(compiler, function, binding, call);
+        }
+    } else if (callee->type == AST_LAMBDA_EXPRESSION && callee->child_count - 1 == argument_count) {
+        CompilerFunction *lambda = compiler_add_function(compiler, function, callee, LISP_NIL);
+        compiler_note(compiler, callee->token)->function = lambda;
+        compiler_resolve_function(compiler, lambda, callee);
+        compiler_add_function_to(&function->calls, &function->call_count, &function->call_capacity, lambda);
+    } else {
+        compiler_resolve_scoped(compiler, function, callee, true);
+    }
+
+    for (u32 i = 1; i < node->child_count; ++i) {
+        compiler_resolve_scoped(compiler, function, node->children[i], true);
+    }
+}
+
+
+/**
+ * Resolve the variables of `node`, found in `function`, and note which
+ * functions escape. `used` is whether the value of `node` is used.
+ */
+static void compiler_resolve(Compiler *compiler, CompilerFunction *function, AstNode *node, bool used) {
+    if (compiler->error != NULL) {
+        return;
+    }
+    if (++compiler->depth > COMPILER_MAX_DEPTH) {
+        compiler_fail(compiler, node->token, "The expression is nested too deeply.");
+        return;
+    }
+
+    switch (node->type) {
+        case AST_IDENTIFIER: {
+            CompilerBinding *binding = compiler_lookup(compiler, compiler_symbol(compiler, node->token));
+            compiler_note(compiler, node->token)->binding = binding;
+            if (binding != NULL) {
+                compiler_add_reference(compiler, function, binding, false);
+            }
+            break;
+        }
+        case AST_FUNCTION_CALL: {
+            compiler_resolve_call(compiler, function, node);
+            break;
+        }
+        case AST_IF_STATEMENT: {
+            compiler_resolve_scoped(compiler, function, node->children[0], true);
+            compiler_resolve_scoped(compiler, function, node->children[1], used);
+            compiler_resolve_scoped(compiler, function, node->children[2], used);
+            break;
+        }
+        case AST_LAMBDA_EXPRESSION: {
+            CompilerFunction *lambda = compiler_add_function(compiler, function, node, LISP_NIL);
+            compiler_note(compiler, node->token)->function = lambda;
+            lambda->escapes = true;
+            compiler_resolve_function(compiler, lambda, node);
+            break;
+        }
+        case AST_FUNCTION_DEFINITION: {
+            CompilerFunction *defined = compiler_add_function(compiler, function, node, compiler_symbol(compiler, node->token));
+            compiler_note(compiler, node->token)->function = defined;
+            defined->escapes = used;
+            defined->self = compiler_declare(compiler, function, node->token, false);
+            defined->self->function = defined;
+            compiler_resolve_function(compiler, defined, node);
+            break;
+        }
+        case AST_VARIABLE_DECLARATION: {
+            if (node->child_count > 0) {
+                compiler_resolve_scoped(compiler, function, node->children[0], true);
+            }
+            compiler_declare(compiler, function, node->token, false);
+            break;
+        }
+        case AST_GROUPING: {
+            for (u32 i = 0; i < node->child_count; ++i) {
+                compiler_resolve(compiler, function, node->children[i], used && i + 1 == node->child_count);
+            }
+            break;
+        }
+        default: break;
+    }
+
+    compiler->depth--;
+}
+
+
+/**
+ * Resolve the forms of `program`, in chunks called by the top level
+ * `top_level`. Their definitions and declarations are globals.
+ */
+static void compiler_resolve_program(Compiler *compiler, CompilerFunction *top_level, AstNode *program) {
+    CompilerFunction *function = NULL;
+    for (u32 i = 0; i < program->child_count; ++i) {
+        if (i % COMPILER_CHUNK_FORMS == 0) {
+            function = compiler_add_function(compiler, top_level, program, LISP_NIL);
+            function->first_form = i;
+            compiler_add_function_to(&top_level->calls, &top_level->call_count, &top_level->call_capacity, function);
+        }
+        function->form_count++;
+
+        AstNode *form = program->children[i];
+        switch (form->type) {
+            case AST_FUNCTION_DEFINITION: {
+                CompilerFunction *defined = compiler_add_function(compiler, function, form, compiler_symbol(compiler, form->token));
+                compiler_note(compiler, form->token)->function = defined;
+                defined->escapes = true;
+                compiler_resolve_function(compiler, defined, form);
+                break;
+            }
+            case AST_VARIABLE_DECLARATION: {
+                if (form->child_count > 0) {
+                    compiler_resolve_scoped(compiler, function, form->children[0], true);
+                }
+                break;
+            }
+            default: {
+                compiler_resolve_scoped(compiler, function, form, true);
+                break;
+            }
+        }
+    }
+}
+
+
+/**
+ * Decide which functions escape, and find the free variables of every
+ * function: those it uses directly, those of the functions it calls
+ * without a closure, which it has to pass on, and those of the closures
+ * it makes, which it has to capture.
+ */
+static void compiler_analyze(Compiler *compiler) {
+    for (u32 i = 0; i < compiler->reference_count; ++i) {
+        CompilerReference *reference = &compiler->references[i];
+        if (!reference->call && reference->binding->function != NULL) {
+            reference->binding->function->escapes = true;
+        }
+    }
+
+    for (u32 i = 0; i < compiler->reference_count; ++i) {
+        CompilerReference *reference = &compiler->references[i];
+        CompilerFunction *callee = reference->binding->function;
+        if (reference->call && !callee->escapes) {
+            compiler_add_function_to(&reference->function->calls, &reference->function->call_count,
+                &reference->function->call_capacity, callee);
+        } else {
+            compiler_add_free(reference->function, reference->binding);
+        }
+    }
+
+    for (u32 i = 0; i < compiler->function_count; ++i) {
+        CompilerFunction *function = compiler->functions[i];
+        if (function->parent != NULL && function->escapes) {
+            CompilerFunction *parent = function->parent;
+            compiler_add_function_to(&parent->creates, &parent->create_count, &parent->create_capacity, function);
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (u32 i = 0; i < compiler->function_count; ++i) {
+            CompilerFunction *function = compiler->functions[i];
+            for (u32 j = 0; j < function->call_count; ++j) {
+                CompilerFunction *callee = function->calls[j];
+                for (u32 k = 0; k < callee->free_count; ++k) {
+                    changed |= compiler_add_free(function, callee->free[k]);
+                }
+            }
+            for (u32 j = 0; j < function->create_count; ++j) {
+                CompilerFunction *created = function->creates[j];
+                for (u32 k = 0; k < created->free_count; ++k) {
+                    changed |= compiler_add_free(function, created->free[k]);
+                }
+            }
+        }
+    }
+}
+
+
+static void emitter_byte(Emitter *emitter, u8 byte) {
+    emitter->code = array_reserve(emitter->code, &emitter->code_capacity, emitter->code_length, 1, sizeof(u8));
+    emitter->code[emitter->code_length++] = byte;
+}
+
+
+static void emitter_u16(Emitter *emitter, u16 operand) {
+    emitter_byte(emitter, (u8) operand);
+    emitter_byte(emitter, (u8) (operand >> 8));
+}
+
+
+static void emitter_u32(Emitter *emitter, u32 operand) {
+    emitter_u16(emitter, (u16) operand);
+    emitter_u16(emitter, (u16) (operand >> 16));
+}
+
+
+/**
+ * Emit `op`, which changes the number of values on the stack by `effect`.
+ */
+static void emitter_op(Emitter *emitter, OpCode op, i32 effect) {
+    emitter_byte(emitter, (u8) op);
+    emitter->height += effect;
+    if (emitter->height > emitter->max_height) {
+        emitter->max_height = emitter->height;
+    }
+}
+
+
+/**
+ * Emit `op`, with a 16-bit operand, which the compiler fails on if it
+ * is out of range.
+ */
+static void emitter_op_u16(Emitter *emitter, OpCode op, i32 effect, u32 operand, LispToken *token) {
+    if (operand > UINT16_MAX) {
+        compiler_fail(emitter->compiler, token, "The function is too large.");
+    }
+    emitter_op(emitter, op, effect);
+    emitter_u16(emitter, (u16) operand);
+}
+
+
+/**
+ * Emit a jump to be patched with `emitter_patch` once its target is known.
+ *
+ * @return Where the target is in the code.
+ */
+static u32 emitter_jump(Emitter *emitter, OpCode op, i32 effect) {
+    emitter_op(emitter, op, effect);
+    u32 target = emitter->code_length;
+    emitter_u32(emitter, 0);
+    return target;
+}
+
+
+/**
+ * Point the jump whose target is at `target` to the next instruction.
+ */
+static void emitter_patch(Emitter *emitter, u32 target) {
+    u32 offset = emitter->code_length;
+    for (u32 i = 0; i < 4; ++i) {
+        emitter->code[target + i] = (u8) (offset >> (8 * i));
+    }
+}
+
+
+/**
+ * Get the slot of the constants' hash table to look for `value` in first.
+ * Constants are told apart by identity, so the value itself is hashed.
+ */
+inline static u32 emitter_constant_slot(Emitter *emitter, LispValue value) {
+    // Fibonacci hashing: the top bits of the product are well mixed.
+    return (u32) ((value * 0x9e3779b97f4a7c15ull) >> 32) & (emitter->constant_slot_count - 1);
+}
+
+
+static void emitter_grow_constants(Emitter *emitter) {
+    free(emitter->constant_slots);
+    emitter->constant_slot_count = emitter->constant_slot_count == 0 ? 0x20 : emitter->constant_slot_count * 2;
+    emitter->constant_slots = (u32 *) calloc(emitter->constant_slot_count, sizeof(u32));
+    for (u32 i = 0; i < emitter->constant_count; ++i) {
+        u32 slot = emitter_constant_slot(emitter, emitter->constants[i]);
+        while (emitter->constant_slots[slot] != 0) {
+            slot = (slot + 1) & (emitter->constant_slot_count - 1);
+        }
+        emitter->constant_slots[slot] = i + 1;
+    }
+}
+
+
+/**
+ * Get the index of `value` among the function's constants, adding it if
+ * it is not there.
+ */
+static u32 emitter_constant(Emitter *emitter, LispValue value) {
+    if (2 * (emitter->constant_count + 1) > emitter->constant_slot_count) {
+        emitter_grow_constants(emitter);
+    }
+
+    u32 slot = emitter_constant_slot(emitter, value);
+    while (emitter->constant_slots[slot] != 0) {
+        if (emitter->constants[emitter->constant_slots[slot] - 1] == value) {
+            return emitter->constant_slots[slot] - 1;
+        }
+        slot = (slot + 1) & (emitter->constant_slot_count - 1);
+    }
+
+    emitter->constants = array_reserve(emitter->constants, &emitter->constant_capacity,
+        emitter->constant_count, 1, sizeof(LispValue));
+    emitter->constants[emitter->constant_count] = value;
+    emitter->constant_slots[slot] = ++emitter->constant_count;
+    return emitter->constant_count - 1;
+}
+
+
+/**
+ * Get the slot of `binding` in the frame of its owner. The parameters come
+ * first, then the free variables if they are passed as arguments, then the
+ * variables declared in the body.
+ */
+static u32 compiler_slot(CompilerBinding *binding) {
+    CompilerFunction *owner = binding->owner;
+    if (binding->parameter) {
+        return binding->index;
+    }
+    return owner->parameter_count + (owner->escapes ? 0 : owner->free_count) + binding->index;
+}
+
+
+/**
+ * Emit `op`, which uses the global `name` through an inline cache of its
+ * own.
+ */
+static void emitter_global(Emitter *emitter, OpCode op, i32 effect, LispValue name, LispToken *token) {
+    emitter_op_u16(emitter, op, effect, emitter_constant(emitter, name), token);
+    if (emitter->cache_count == UINT16_MAX) {
+        compiler_fail(emitter->compiler, token, "The function is too large.");
+    }
+    emitter_u16(emitter, (u16) emitter->cache_count++);
+}
+
+
+/**
+ * Push the value of the variable `binding`, or of the global `name` if
+ * `binding` is `NULL`.
+ */
+static void emitter_load(Emitter *emitter, CompilerBinding *binding, LispValue name, LispToken *token) {
+    CompilerFunction *function = emitter->function;
+
+    if (binding == NULL) {
+        emitter_global(emitter, OP_GLOBAL, 1, name, token);
+    } else if (binding == function->self) {
+        emitter_op(emitter, OP_SELF, 1);
+    } else if (binding->owner == function) {
+        emitter_op_u16(emitter, OP_LOCAL, 1, compiler_slot(binding), token);
+    } else {
+        u32 index = 0;
+        while (function->free[index] != binding) {
+            index++;
+        }
+        if (function->escapes) {
+            emitter_op_u16(emitter, OP_CAPTURED, 1, index, token);
+        } else {
+            emitter_op_u16(emitter, OP_LOCAL, 1, function->parameter_count + index, token);
+        }
+    }
+}
+
+
+static LispFunction *compiler_emit_function(Compiler *compiler, CompilerFunction *function);
+
+static void compiler_emit(Emitter *emitter, AstNode *node);
+
+
+/**
+ * Push a closure of `function`, capturing its free variables.
+ */
+static void emitter_closure(Emitter *emitter, CompilerFunction *function, LispToken *token) {
+    LispFunction *compiled = compiler_emit_function(emitter->compiler, function);
+    for (u32 i = 0; i < function->free_count; ++i) {
+        emitter_load(emitter, function->free[i], function->free[i]->name, token);
+    }
+    emitter_op_u16(emitter, OP_CLOSURE, 1 - (i32) function->free_count,
+        emitter_constant(emitter, value_from_object(compiled)), token);
+    emitter_u16(emitter, (u16) function->free_count);
+}
+
+
+/**
+ * Get the instruction that applies the operator `token` names to two
+ * values.
+ *
+ * @return Whether `token` names an operator with an instruction.
+ */
+static bool compiler_operator(LispToken *token, OpCode *op) {
+    switch (token->type) {
+        case TOKEN_PLUS: *op = OP_ADD; return true;
+        case TOKEN_MINUS: *op = OP_SUBTRACT; return true;
+        case TOKEN_ASTERISK: *op = OP_MULTIPLY; return true;
+        case TOKEN_SLASH: *op = OP_DIVIDE; return true;
+        case TOKEN_EQUALS: *op = OP_EQUAL; return true;
+        default: return false;
+    }
+}
+
+
+/**
+ * Emit a call of `node`. A function that does not escape is called
+ * directly, with its free variables after the arguments, and an operator
+ * applied to two values with its own instruction.
+ */
+static void emitter_call(Emitter *emitter, AstNode *node) {
+    Compiler *compiler = emitter->compiler;
+    AstNode *callee = node->children[0];
+    u32 argument_count = node->child_count - 1;
+
+    CompilerNote *note = compiler_note(compiler, callee->token);
+    OpCode op;
+    if (callee->type == AST_IDENTIFIER && note->binding == NULL && argument_count == 2
+            && compiler_operator(callee->token, &op)) {
+        compiler_emit(emitter, node->children[1]);
+        compiler_emit(emitter, node->children[2]);
+        emitter_global(emitter, op, -1, compiler_symbol(compiler, callee->token), node->token);
+        return;
+    }
+
+    CompilerFunction *known = NULL;
+    if (callee->type == AST_IDENTIFIER && note->binding != NULL
+            && note->binding->function != NULL && !note->binding->function->escapes) {
+        known = note->binding->function;
+    } else if (callee->type == AST_LAMBDA_EXPRESSION && !note->function->escapes) {
+        known = note->function;
+    }
+
+    if (known == NULL) {
+        compiler_emit(emitter, callee);
+    }
+    for (u32 i = 1; i < node->child_count; ++i) {
+        compiler_emit(emitter, node->children[i]);
+    }
+    if (known == NULL) {
+        emitter_op_u16(emitter, OP_CALL, -(i32) argument_count, argument_count, node->token);
+        return;
+    }
+
+    LispFunction *compiled = compiler_emit_function(compiler, known);
+    for (u32 i = 0; i < known->free_count; ++i) {
+        emitter_load(emitter, known->free[i], known->free[i]->name, callee->token);
+    }
+    u32 count = argument_count + known->free_count;
+    emitter_op_u16(emitter, OP_CALL_KNOWN, 1 - (i32) count,
+        emitter_constant(emitter, value_from_object(compiled)), node->token);
+    emitter_u16(emitter, (u16) count);
+}
+
+
+/**
+ * Set the variable declared at `token` to the value on top of the stack,
+ * or define the global it names if it is not a local variable.
+ */
+static void emitter_store(Emitter *emitter, LispToken *token) {
+    Compiler *compiler = emitter->compiler;
+    CompilerBinding *binding = compiler_note(compiler, token)->binding;
+    if (binding == NULL) {
+        emitter_op_u16(emitter, OP_DEFINE_GLOBAL, 0,
+            emitter_constant(emitter, compiler_symbol(compiler, token)), token);
+    } else {
+        emitter_op_u16(emitter, OP_SET_LOCAL, 0, compiler_slot(binding), token);
+    }
+}
+
+
+static void emitter_literal(Emitter *emitter, AstNode *node) {
+    switch (node->token->type) {
+        case TOKEN_TRUE: emitter_op(emitter, OP_TRUE, 1); break;
+        case TOKEN_FALSE: emitter_op(emitter, OP_FALSE, 1); break;
+        case TOKEN_NIL: emitter_op(emitter, OP_NIL, 1); break;
+        case TOKEN_STRING: {
+            LispValue string = string_from_literal(token_lexeme(emitter->compiler->tokens, node->token), node->token->length);
+            emitter_op_u16(emitter, OP_CONSTANT, 1, emitter_constant(emitter, string), node->token);
+            break;
+        }
+        default: {
+            emitter_op_u16(emitter, OP_CONSTANT, 1, emitter_constant(emitter, node->value), node->token);
+            break;
+        }
+    }
+}
+
+
+/**
+ * Emit the code that pushes the value of `node`. Functions called directly
+ * are compiled where they are first called, so the nesting is limited here
+ * as well as while resolving.
+ */
+static void compiler_emit(Emitter *emitter, AstNode *node) {
+    Compiler *compiler = emitter->compiler;
+    if (compiler->error != NULL) {
+        return;
+    }
+    if (++compiler->depth > COMPILER_MAX_DEPTH) {
+        compiler_fail(compiler, node->token, "The expression is nested too deeply.");
+        return;
+    }
+
+    switch (node->type) {
+        case AST_LITERAL: {
+            emitter_literal(emitter, node);
+            break;
+        }
+        case AST_IDENTIFIER: {
+            emitter_load(emitter, compiler_note(compiler, node->token)->binding,
+                compiler_symbol(compiler, node->token), node->token);
+            break;
+        }
+        case AST_FUNCTION_CALL: {
+            emitter_call(emitter, node);
+            break;
+        }
+        case AST_IF_STATEMENT: {
+            compiler_emit(emitter, node->children[0]);
+            u32 alternative = emitter_jump(emitter, OP_JUMP_IF_FALSE, -1);
+            compiler_emit(emitter, node->children[1]);
+            u32 end = emitter_jump(emitter, OP_JUMP, -1);
+            emitter_patch(emitter, alternative);
+            compiler_emit(emitter, node->children[2]);
+            emitter_patch(emitter, end);
+            break;
+        }
+        case AST_LAMBDA_EXPRESSION: {
+            emitter_closure(emitter, compiler_note(compiler, node->token)->function, node->token);
+            break;
+        }
+        case AST_FUNCTION_DEFINITION: {
+            CompilerFunction *defined = compiler_note(compiler, node->token)->function;
+            if (defined->escapes) {
+                emitter_closure(emitter, defined, node->token);
+                emitter_store(emitter, node->token);
+            } else {
+                // The function is only ever called directly, so it is
+                // compiled where it is called, and has no value.
+                emitter_op(emitter, OP_NIL, 1);
+            }
+            break;
+        }
+        case AST_VARIABLE_DECLARATION: {
+            if (node->child_count > 0) {
+                compiler_emit(emitter, node->children[0]);
+            } else {
+                emitter_op(emitter, OP_NIL, 1);
+            }
+            emitter_store(emitter, node->token);
+            break;
+        }
+        case AST_GROUPING: {
+            if (node->child_count == 0) {
+                emitter_op(emitter, OP_NIL, 1);
+            }
+            for (u32 i = 0; i < node->child_count; ++i) {
+                if (i > 0) {
+                    emitter_op(emitter, OP_POP, -1);
+                }
+                compiler_emit(emitter, node->children[i]);
+            }
+            break;
+        }
+        default: {
+            // Imports are loaded before the program runs.
+            emitter_op(emitter, OP_NIL, 1);
+            break;
+        }
+    }
+
+    compiler->depth--;
+}
+
+
+/**
+ * Compile `function`, if it has not been compiled already.
+ */
+static LispFunction *compiler_emit_function(Compiler *compiler, CompilerFunction *function) {
+    if (function->compiled != NULL) {
+        return function->compiled;
+    }
+
+    LispFunction *compiled = value_allocate_object(LISP_OBJECT_FUNCTION, sizeof(LispFunction));
+    compiled->name = function->name;
+    compiled->parameter_count = function->parameter_count + (function->escapes ? 0 : function->free_count);
+    compiled->local_count = compiled->parameter_count + function->declared_count;
+    // Set before the body is compiled, for the calls the function makes to
+    // itself.
+    function->compiled = compiled;
+
+    Emitter emitter = { .compiler = compiler, .function = function };
+    AstNode *node = function->node;
+    if (node->type == AST_PROGRAM && function->parent == NULL) {
+        // The top level only calls the chunks of the program, in order.
+        if (function->call_count == 0) {
+            emitter_op(&emitter, OP_NIL, 1);
+        }
+        for (u32 i = 0; i < function->call_count; ++i) {
+            if (i > 0) {
+                emitter_op(&emitter, OP_POP, -1);
+            }
+            LispFunction *chunk = compiler_emit_function(compiler, function->calls[i]);
+            emitter_op_u16(&emitter, OP_CALL_KNOWN, 1, emitter_constant(&emitter, value_from_object(chunk)), node->token);
+            emitter_u16(&emitter, 0);
+        }
+    } else if (node->type == AST_PROGRAM) {
+        for (u32 i = function->first_form; i < function->first_form + function->form_count; ++i) {
+            if (i > function->first_form) {
+                emitter_op(&emitter, OP_POP, -1);
+            }
+            compiler_emit(&emitter, node->children[i]);
+        }
+    } else {
+        compiler_emit(&emitter, node->children[node->child_count - 1]);
+    }
+    emitter_op(&emitter, OP_RETURN, -1);
+
+    if (compiled->local_count > UINT16_MAX) {
+        compiler_fail(compiler, node->token, "The function has too many variables.");
+    }
+    compiled->stack_size = emitter.max_height;
+    compiled->code = emitter.code;
+    compiled->code_length = emitter.code_length;
+    compiled->constants = emitter.constants;
+    compiled->constant_count = emitter.constant_count;
+    free(emitter.constant_slots);
+    compiled->caches = (GlobalCache *) calloc(emitter.cache_count, sizeof(GlobalCache));
+    compiled->cache_count = emitter.cache_count;
+    return compiled;
+}
+
+
+static void compiler_free(Compiler *compiler) {
+    for (u32 i = 0; i < compiler->function_count; ++i) {
+        CompilerFunction *function = compiler->functions[i];
+        free(function->free);
+        free(function->calls);
+        free(function->creates);
+        free(function);
+    }
+    for (u32 i = 0; i < compiler->binding_count; ++i) {
+        free(compiler->bindings[i]);
+    }
+    free(compiler->functions);
+    free(compiler->bindings);
+    free(compiler->scope);
+    free(compiler->references);
+    free(compiler->notes);
+}
+
+
+// @see compiler.h
+extern CompileResult compiler_compile(TokenList *tokens, AstNode *program) {
+    CompileResult result = { .failed = false, .error = NULL };
+    trace_begin(TRACE_COMPILER);
+
+    Compiler compiler = {
+        .tokens = tokens,
+        .notes = (CompilerNote *) calloc(tokens->count + 1, sizeof(CompilerNote))
+    };
+
+    CompilerFunction *top_level = compiler_add_function(&compiler, NULL, program, LISP_NIL);
+    compiler_resolve_program(&compiler, top_level, program);
+    if (compiler.error == NULL) {
+        compiler_analyze(&compiler);
+        result.function = compiler_emit_function(&compiler, top_level);
+    }
+
+    if (compiler.error != NULL) {
+        result.failed = true;
+        result.error = compiler.error;
+    }
+    compiler_free(&compiler);
+    trace_end(TRACE_COMPILER);
+    return result;
+}
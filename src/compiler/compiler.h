@@ -0,0 +1,54 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+#include <stdbool.h>
+
+#include "../util_types.h"
+#include "../lisp/error.h"
+#include "../lexer/token.h"
+#include "../parser/ast.h"
+#include "../vm/bytecode.h"
+
+// The deepest expressions are allowed to nest.
+#define COMPILER_MAX_DEPTH 0x1000
+
+// The most forms of a program compiled into one function.
+#define COMPILER_CHUNK_FORMS 0x400
+
+
+typedef struct {
+    bool failed;
+    union {
+        LispFunction *function;
+        LispError *error;
+    };
+} CompileResult;
+
+
+/**
+ * Compile `program`, parsed from `tokens`, to a function of no arguments
+ * that evaluates its forms in order and returns the value of the last.
+ *
+ * The forms of a program define globals, while declarations anywhere
+ * else are local to the rest of the group they are in, and a function's
+ * name is visible in its own body. Local variables are never assigned
+ * once they are declared, so closures capture their values rather than
+ * the variables: each closure is flat, holding just the values it uses.
+ *
+ * Escape analysis finds the local functions that are only ever called
+ * by name, with the right number of arguments. Those are never made into
+ * closures: the values they would capture are passed as extra arguments
+ * instead, so calling them allocates nothing, and their frames live on
+ * the machine's stack like any other.
+ *
+ * The forms of a program are compiled in chunks of up to
+ * `COMPILER_CHUNK_FORMS`, each a function that the program calls in
+ * turn, so that no function of a large program has more constants than
+ * its operands can index.
+ *
+ * String literals are not copied, so the source code of `tokens` must
+ * outlive the compiled function.
+ */
+extern CompileResult compiler_compile(TokenList *tokens, AstNode *program);
+
+
+#endif
@@ -0,0 +1,355 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "dump.h"
+
+// The longest a single formatted number can be.
+#define DUMP_NUMBER_MAX 24
+
+
+// @see dump.h
+extern void dump_buffer_init(DumpBuffer *buffer, FILE *stream) {
+    buffer->stream = stream;
+    buffer->data = (char *) malloc(DUMP_BUFFER_SIZE);
+    buffer->length = 0;
+}
+
+
+// @see dump.h
+extern void dump_buffer_flush(DumpBuffer *buffer) {
+    if (buffer->length > 0) {
+        fwrite(buffer->data, 1, buffer->length, buffer->stream);
+        buffer->length = 0;
+    }
+    fflush(buffer->stream);
+}
+
+
+// @see dump.h
+extern void dump_buffer_free(DumpBuffer *buffer) {
+    dump_buffer_flush(buffer);
+    free(buffer->data);
+}
+
+
+/**
+ * Make room for `length` more bytes, flushing the buffer if they do not fit.
+ */
+inline static char *dump_reserve(DumpBuffer *buffer, size_t length) {
+    if (buffer->length + length > DUMP_BUFFER_SIZE) {
+        dump_buffer_flush(buffer);
+    }
+    return &buffer->data[buffer->length];
+}
+
+
+// @see dump.h
+extern void dump_write_bytes(DumpBuffer *buffer, const char *bytes, size_t length) {
+    // Anything larger than the buffer goes straight to the stream.
+    if (length > DUMP_BUFFER_SIZE) {
+        dump_buffer_flush(buffer);
+        fwrite(bytes, 1, length, buffer->stream);
+        return;
+    }
+
+    memcpy(dump_reserve(buffer, length), bytes, length);
+    buffer->length += length;
+}
+
+
+inline static void dump_write_char(DumpBuffer *buffer, char c) {
+    *dump_reserve(buffer, 1) = c;
+    buffer->length++;
+}
+
+
+inline static void dump_write_string(DumpBuffer *buffer, const char *string) {
+    dump_write_bytes(buffer, string, strlen(string));
+}
+
+
+/**
+ * Write `number` in decimal.
+ */
+static void dump_write_decimal(DumpBuffer *buffer, u64 number) {
+    char digits[DUMP_NUMBER_MAX];
+    char *end = &digits[DUMP_NUMBER_MAX];
+    char *start = end;
+
+    do {
+        *--start = (char) ('0' + number % 10);
+        number /= 10;
+    } while (number != 0);
+
+    dump_write_bytes(buffer, start, (size_t) (end - start));
+}
+
+
+// @see dump.h
+extern void dump_write_varint(DumpBuffer *buffer, u64 number) {
+    char *bytes = dump_reserve(buffer, 10);
+    size_t length = 0;
+
+    while (number >= 0x80) {
+        bytes[length++] = (char) ((number & 0x7f) | 0x80);
+        number >>= 7;
+    }
+    bytes[length++] = (char) number;
+
+    buffer->length += length;
+}
+
+
+/**
+ * Write the line and column of `offset`. Tokens are dumped in the order
+ * of their offsets, so rather than searching the line table for each of
+ * them, `line` remembers the line of the previous one and only moves
+ * forward.
+ */
+static void dump_write_position(DumpBuffer *buffer, const LineTable *lines, u32 *line, u32 offset) {
+    while (*line + 1 < lines->count && lines->line_starts[*line + 1] <= offset) {
+        (*line)++;
+    }
+
+    dump_write_decimal(buffer, *line + 1);
+    dump_write_char(buffer, ':');
+    dump_write_decimal(buffer, offset - lines->line_starts[*line] + 1);
+}
+
+
+static void dump_tokens_text(DumpBuffer *buffer, TokenList *tokens) {
+    u32 line = 0;
+
+    for (u32 i = 0; i < tokens->count; ++i) {
+        LispToken *token = &tokens->tokens[i];
+
+        dump_write_string(buffer, "LispToken => ");
+        dump_write_string(buffer, token_type_to_string(token->type));
+        dump_write_string(buffer, " '");
+        dump_write_bytes(buffer, token_lexeme(tokens, token), token->length);
+        dump_write_string(buffer, "' @ ");
+        dump_write_string(buffer, tokens->file_name);
+        dump_write_char(buffer, ':');
+        dump_write_position(buffer, &tokens->lines, &line, token->offset);
+        dump_write_char(buffer, '\n');
+    }
+}
+
+
+static void dump_tokens_binary(DumpBuffer *buffer, TokenList *tokens) {
+    dump_write_bytes(buffer, DUMP_TOKENS_MAGIC, sizeof(DUMP_TOKENS_MAGIC) - 1);
+    dump_write_varint(buffer, DUMP_FORMAT_VERSION);
+    dump_write_varint(buffer, tokens->count);
+
+    u32 previous_end = 0;
+    for (u32 i = 0; i < tokens->count; ++i) {
+        LispToken *token = &tokens->tokens[i];
+        dump_write_varint(buffer, token->type);
+        dump_write_varint(buffer, token->offset - previous_end);
+        dump_write_varint(buffer, token->length);
+        previous_end = token->offset + token->length;
+    }
+}
+
+
+// @see dump.h
+extern bool dump_read_varint(const u8 **cursor, const u8 *end, u64 *number) {
+    *number = 0;
+
+    for (u32 shift = 0; *cursor < end && shift < 64; shift += 7) {
+        u8 byte = *(*cursor)++;
+        *number |= (u64) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+// @see dump.h
+extern TokenList *dump_read_tokens(const u8 **cursor, const u8 *end, char *source, size_t source_length) {
+    size_t magic_length = sizeof(DUMP_TOKENS_MAGIC) - 1;
+    if ((size_t) (end - *cursor) < magic_length || memcmp(*cursor, DUMP_TOKENS_MAGIC, magic_length) != 0) {
+        return NULL;
+    }
+    *cursor += magic_length;
+
+    u64 version, count;
+    if (!dump_read_varint(cursor, end, &version) || version != DUMP_FORMAT_VERSION
+            || !dump_read_varint(cursor, end, &count) || count > (u64) (end - *cursor)
+            || source_length > UINT32_MAX) {
+        return NULL;
+    }
+
+    TokenList *tokens = token_list_create(source);
+    line_table_scan(&tokens->lines, source, 0, (u32) source_length);
+
+    u64 previous_end = 0;
+    for (u64 i = 0; i < count; ++i) {
+        u64 type, gap, length;
+        if (!dump_read_varint(cursor, end, &type) || type > TOKEN_EOF
+                || !dump_read_varint(cursor, end, &gap) || !dump_read_varint(cursor, end, &length)
+                || gap > source_length - previous_end || length > source_length - previous_end - gap) {
+            token_list_free(tokens);
+            return NULL;
+        }
+
+        u64 offset = previous_end + gap;
+        token_list_push(tokens, (LispTokenType) type, (u32) offset, (u32) length);
+        previous_end = offset + length;
+    }
+
+    return tokens;
+}
+
+
+// @see dump.h
+extern void dump_tokens(DumpBuffer *buffer, TokenList *tokens, DumpFormat format) {
+    switch (format) {
+        case DUMP_TEXT: dump_tokens_text(buffer, tokens); break;
+        case DUMP_BINARY: dump_tokens_binary(buffer, tokens); break;
+    }
+}
+
+
+static const char *ast_node_type_to_string(AstNodeType type) {
+    switch (type) {
+        case AST_PROGRAM: return "Program";
+        case AST_FUNCTION_DEFINITION: return "FunctionDefinition";
+        case AST_PARAMETER: return "Parameter";
+        case AST_FUNCTION_CALL: return "FunctionCall";
+        case AST_IF_STATEMENT: return "IfStatement";
+        case AST_LAMBDA_EXPRESSION: return "LambdaExpression";
+        case AST_VARIABLE_DECLARATION: return "VariableDeclaration";
+        case AST_GROUPING: return "Grouping";
+        case AST_IMPORT: return "Import";
+        case AST_LITERAL: return "Literal";
+        case AST_IDENTIFIER: return "Identifier";
+        case AST_NO_ARGUMENTS: return "NoArguments";
+        default: return "<UNDEFINED>";
+    }
+}
+
+
+/**
+ * Write ` 'lexeme' @ line:column` for `token`.
+ */
+static void dump_write_token_reference(DumpBuffer *buffer, TokenList *tokens, LispToken *token) {
+    SourcePosition position = token_position(tokens, token);
+
+    dump_write_string(buffer, " '");
+    dump_write_bytes(buffer, token_lexeme(tokens, token), token->length);
+    dump_write_string(buffer, "' @ ");
+    dump_write_decimal(buffer, position.line);
+    dump_write_char(buffer, ':');
+    dump_write_decimal(buffer, position.column);
+}
+
+
+/**
+ * A node still to be dumped, and how deeply it is nested.
+ */
+typedef struct {
+    AstNode *node;
+    u32 depth;
+} DumpPending;
+
+
+/**
+ * Push the children of `node`, last first, so that they are popped in order.
+ */
+static DumpPending *dump_push_children(DumpPending *pending, u32 *count, u32 *capacity, AstNode *node, u32 depth) {
+    if (*count + node->child_count > *capacity) {
+        while (*count + node->child_count > *capacity) {
+            *capacity *= 2;
+        }
+        pending = (DumpPending *) realloc(pending, *capacity * sizeof(DumpPending));
+    }
+    for (u32 i = node->child_count; i > 0; --i) {
+        pending[(*count)++] = (DumpPending) { .node = node->children[i - 1], .depth = depth };
+    }
+    return pending;
+}
+
+
+/**
+ * Walk the tree in preorder without recursing, so that trees of any
+ * depth can be dumped. The root of a program is not dumped itself.
+ */
+static void dump_ast_text(DumpBuffer *buffer, TokenList *tokens, AstNode *ast) {
+    u32 capacity = 16;
+    u32 count = 0;
+    DumpPending *pending = (DumpPending *) malloc(capacity * sizeof(DumpPending));
+
+    if (ast->type == AST_PROGRAM) {
+        pending = dump_push_children(pending, &count, &capacity, ast, 0);
+    } else {
+        pending[count++] = (DumpPending) { .node = ast, .depth = 0 };
+    }
+
+    while (count > 0) {
+        DumpPending next = pending[--count];
+
+        for (u32 i = 0; i < next.depth; ++i) {
+            dump_write_string(buffer, "  ");
+        }
+        dump_write_string(buffer, ast_node_type_to_string(next.node->type));
+        if (next.node->token != NULL) {
+            dump_write_token_reference(buffer, tokens, next.node->token);
+        }
+        dump_write_char(buffer, '\n');
+
+        pending = dump_push_children(pending, &count, &capacity, next.node, next.depth + 1);
+    }
+
+    free(pending);
+}
+
+
+/**
+ * Write the index of `token` within `tokens`.
+ */
+inline static void dump_write_token_index(DumpBuffer *buffer, TokenList *tokens, LispToken *token) {
+    dump_write_varint(buffer, token != NULL ? (u64) (token - tokens->tokens) : tokens->count);
+}
+
+
+static void dump_ast_binary(DumpBuffer *buffer, TokenList *tokens, AstNode *ast) {
+    u32 capacity = 16;
+    u32 count = 0;
+    DumpPending *pending = (DumpPending *) malloc(capacity * sizeof(DumpPending));
+    pending[count++] = (DumpPending) { .node = ast, .depth = 0 };
+
+    while (count > 0) {
+        AstNode *node = pending[--count].node;
+        dump_write_varint(buffer, node->type);
+        dump_write_token_index(buffer, tokens, node->token);
+        dump_write_varint(buffer, node->child_count);
+        pending = dump_push_children(pending, &count, &capacity, node, 0);
+    }
+
+    free(pending);
+}
+
+
+// @see dump.h
+extern void dump_ast(DumpBuffer *buffer, TokenList *tokens, AstNode *ast, DumpFormat format) {
+    switch (format) {
+        case DUMP_TEXT: {
+            if (ast != NULL) {
+                dump_ast_text(buffer, tokens, ast);
+            }
+            break;
+        }
+        case DUMP_BINARY: {
+            dump_write_bytes(buffer, DUMP_AST_MAGIC, sizeof(DUMP_AST_MAGIC) - 1);
+            dump_write_varint(buffer, DUMP_FORMAT_VERSION);
+            if (ast != NULL) {
+                dump_ast_binary(buffer, tokens, ast);
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef DUMP_H
+#define DUMP_H
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "../util_types.h"
+#include "../lexer/token.h"
+#include "../parser/ast.h"
+
+// The size of the output buffer; it is written out whenever it fills up.
+#define DUMP_BUFFER_SIZE 0x100000
+
+#define DUMP_TOKENS_MAGIC "LTOK"
+#define DUMP_AST_MAGIC "LAST"
+#define DUMP_FORMAT_VERSION 3
+
+
+typedef enum {
+    DUMP_TEXT,
+    DUMP_BINARY
+} DumpFormat;
+
+
+/**
+ * A large output buffer that dumps are formatted into directly, without
+ * any allocation per token or node.
+ */
+typedef struct {
+    FILE *stream;
+    char *data;
+    size_t length;
+} DumpBuffer;
+
+
+extern void dump_buffer_init(DumpBuffer *buffer, FILE *stream);
+
+/**
+ * Write everything buffered so far to the stream.
+ */
+extern void dump_buffer_flush(DumpBuffer *buffer);
+
+/**
+ * Flush and release `buffer`.
+ */
+extern void dump_buffer_free(DumpBuffer *buffer);
+
+extern void dump_write_bytes(DumpBuffer *buffer, const char *bytes, size_t length);
+
+/**
+ * Write `number` as an unsigned LEB128 varint: seven bits per byte,
+ * least significant first, with the high bit set on all but the last.
+ */
+extern void dump_write_varint(DumpBuffer *buffer, u64 number);
+
+/**
+ * Dump a token stream.
+ *
+ * The text format is one `LispToken => TYPE 'lexeme' @ file:line:column`
+ * line per token.
+ *
+ * The binary format is the magic `LTOK`, then as varints: the format
+ * version, the number of tokens, and for each token its type, the gap
+ * between the end of the previous token and its offset, and its length.
+ */
+extern void dump_tokens(DumpBuffer *buffer, TokenList *tokens, DumpFormat format);
+
+/**
+ * Decode a varint written by `dump_write_varint`, advancing `*cursor`
+ * past it.
+ *
+ * @return Whether a complete varint was read before `end`.
+ */
+extern bool dump_read_varint(const u8 **cursor, const u8 *end, u64 *number);
+
+/**
+ * Rebuild a token stream from its binary dump, for instance from a file
+ * mapped into memory. `source` is the source code the tokens were
+ * scanned from.
+ *
+ * @param cursor The start of the dump, advanced past it.
+ * @return The tokens, or `NULL` if the dump is malformed or does not fit
+ * `source`.
+ */
+extern TokenList *dump_read_tokens(const u8 **cursor, const u8 *end, char *source, size_t source_length);
+
+/**
+ * Dump a syntax tree built from `tokens`.
+ *
+ * The text format is one indented line per node, with the forms of a
+ * program at the outermost level.
+ *
+ * The binary format is the magic `LAST`, the format version as a varint
+ * and then the nodes in preorder. Each node is its `AstNodeType`, the
+ * index of its token and its number of children, all as varints. A
+ * missing token is written as the number of tokens.
+ */
+extern void dump_ast(DumpBuffer *buffer, TokenList *tokens, AstNode *ast, DumpFormat format);
+
+
+#endif
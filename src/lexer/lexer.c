@@ -7,48 +7,24 @@
 #include "lexer.h"
 #include "../util_types.h"
 #include "../lisp/error.h"
+#include "../trace/trace.h"
 
 #define KEYWORD_TABLE_SIZE 256
 
 
 /**
- * A struct keeping track of everything related to the lexer.
- * It exists so that two lines of the lexer being run from the 
- * REPL do not share the same state. Notice however, that keywords are
- * stored statically, separate from the lexer.
+ * A keyword and its token type. Keywords are hashed into the table with
+ * linear probing, and a lookup compares the text of the candidate so
+ * that identifiers sharing a slot with a keyword are not mistaken for it.
  */
 typedef struct {
-    // A pointer to the source code.
-    char *source;
-    // The length of the source code.
-    size_t source_length;
-    // The index of the start of the current token in the source code.
-    u64 token_start;
-    // The current position of the lexer in the source code.
-    u64 position;
-    // The current line number.
-    u64 line;
-    // The head of the linked-list of tokens.
-    TokenList *tokens_begin;
-    // The tail of the linked-list of tokens.
-    TokenList *tokens_end;
-} Lexer;
+    const char *key;
+    size_t length;
+    LispTokenType type;
+} KeywordEntry;
 
 
-/**
- * A basic error for lexer functions. `ScanningError` is
- * basically the implementation of something like: `Error<Void>`.
- */
-typedef struct ScanningError {
-    // Tracks whether or not an error has occurred.
-    bool failed;
-    // If `failed` is `true` then `error` contains the value of the error,
-    // otherwise `error` is `NULL`.
-    LispError *error;
-} ScanResult;
-
-
-static LispTokenType keyword_table[KEYWORD_TABLE_SIZE];
+static KeywordEntry keyword_table[KEYWORD_TABLE_SIZE];
 
 static bool keywords_initialized = false;
 
@@ -57,13 +33,12 @@ static bool keywords_initialized = false;
  * Compute the hash value of a string, to be used 
  * to compute the indices in which to store keywords.
  * 
- * @return The hash value of `key`.
+ * @return The hash value of the `length` bytes at `key`.
  */
-static u64 hash_keyword_string(char *key) {
+static u64 hash_keyword_string(const char *key, size_t length) {
     u64 hash = 5381;
-    char *iterator = key;
-    while (*iterator != '\0') {
-        hash = ((hash << 5) + hash) + *iterator++;
+    for (size_t i = 0; i < length; ++i) {
+        hash = ((hash << 5) + hash) + key[i];
     }
     return hash;
 }
@@ -76,31 +51,37 @@ static u64 hash_keyword_string(char *key) {
  */
 static LispTokenType get_keyword_token_type(char *key_begin, char *key_end) {
     size_t lexeme_length = (size_t) (key_end - key_begin);
-    char *key = (char *) calloc(lexeme_length + 1, sizeof(char));
-    strncpy(key, key_begin, lexeme_length);
-    u64 hash = hash_keyword_string(key);
-    free(key);
-    
-    u64 index = hash % KEYWORD_TABLE_SIZE;
-    LispTokenType keyword_type = keyword_table[index];
-
-    return keyword_type;
+    u64 index = hash_keyword_string(key_begin, lexeme_length) % KEYWORD_TABLE_SIZE;
+
+    for (; keyword_table[index].key != NULL; index = (index + 1) % KEYWORD_TABLE_SIZE) {
+        KeywordEntry *entry = &keyword_table[index];
+        if (entry->length == lexeme_length && memcmp(entry->key, key_begin, lexeme_length) == 0) {
+            return entry->type;
+        }
+    }
+
+    return TOKEN_INVALID;
 }
 
 
 /**
  * Add a new keyword to the keyword table.
  */
-static void create_keyword(LispTokenType type, char *key) {
-    u64 hash = hash_keyword_string(key);
-    u64 index = hash % KEYWORD_TABLE_SIZE;
-    keyword_table[index] = type;
+static void create_keyword(LispTokenType type, const char *key) {
+    size_t length = strlen(key);
+    u64 index = hash_keyword_string(key, length) % KEYWORD_TABLE_SIZE;
+    while (keyword_table[index].key != NULL) {
+        index = (index + 1) % KEYWORD_TABLE_SIZE;
+    }
+    keyword_table[index].key = key;
+    keyword_table[index].length = length;
+    keyword_table[index].type = type;
 }
 
 
 /**
  * Check if the lexer has reached the end of the
- * source code.
+ * source code available so far.
  */
 static bool lexer_has_next(Lexer *lexer) {
     return lexer->position < lexer->source_length;
@@ -108,31 +89,30 @@ static bool lexer_has_next(Lexer *lexer) {
 
 
 /**
- * Create a new token on the heap and add it to the end of the
- * linked-list of tokens.
+ * Called when a token has been scanned up to the end of the available
+ * source code. If more source may still be appended, the token could
+ * continue past this point, so the lexer rewinds to the start of the token
+ * and suspends until it is resumed with more input.
+ *
+ * @return Whether the lexer has been suspended.
  */
-static void lexer_add_token(Lexer *lexer, LispTokenType type) {
-    LispToken *token = (LispToken *) calloc(1, sizeof(LispToken));
-
-    token->type = type;
-    token->line = lexer->line;
-    token->column = lexer->position;
-    token->file_name = "stdin",
-    token->begin = &lexer->source[lexer->token_start];
-    token->end = &lexer->source[lexer->position];
-    
-    TokenList *node = (TokenList *) calloc(1, sizeof(TokenList));
-    node->next = NULL;
-    node->token = token;
-
-    if (lexer->tokens_begin == NULL) {
-        lexer->tokens_begin = node;
-        lexer->tokens_end = lexer->tokens_begin;
-        return;
+static bool lexer_suspend_at_end(Lexer *lexer) {
+    if (lexer_has_next(lexer) || lexer->end_of_input) {
+        return false;
     }
+    lexer->position = lexer->token_start;
+    lexer->suspended = true;
+    return true;
+}
 
-    lexer->tokens_end->next = node;
-    lexer->tokens_end = node;
+
+/**
+ * Add a token spanning from the start of the current token to the
+ * current position.
+ */
+static void lexer_add_token(Lexer *lexer, LispTokenType type) {
+    token_list_push(lexer->tokens, type, (u32) lexer->token_start,
+        (u32) (lexer->position - lexer->token_start));
 }
 
 
@@ -168,11 +148,18 @@ static ScanResult lexer_scan_number(Lexer *lexer) {
         lexer_advance(lexer);
     }
 
+    if (lexer_suspend_at_end(lexer)) {
+        return result;
+    }
+
     if (lexer_peek(lexer) == '.') {
         lexer_advance(lexer);
         while (lexer_has_next(lexer) && isdigit(lexer_peek(lexer))) {
             lexer_advance(lexer);
         }
+        if (lexer_suspend_at_end(lexer)) {
+            return result;
+        }
         lexer_add_token(lexer, TOKEN_FLOAT);
         return result;
     }
@@ -194,6 +181,10 @@ static ScanResult lexer_scan_identifier(Lexer *lexer) {
         lexer_advance(lexer);
     }
 
+    if (lexer_suspend_at_end(lexer)) {
+        return result;
+    }
+
     LispTokenType keyword = get_keyword_token_type(
         &lexer->source[lexer->token_start], 
         &lexer->source[lexer->position]);
@@ -211,23 +202,33 @@ static ScanResult lexer_scan_identifier(Lexer *lexer) {
 
 /**
  * Scan a string token. Returns a lexer error in the event that
- * the string is not terminated with a terminating quote.
+ * the string is not terminated with a terminating quote. The character
+ * after a backslash never terminates the string; the escapes themselves
+ * are only processed when the string is first used.
  */
 static ScanResult lexer_scan_string(Lexer *lexer) {
     ScanResult result = { .failed = false, .error = NULL };
 
     // Scan until either reaching the end of the source code or
-    // finding a terminating quote.
+    // finding a terminating quote. A backslash that ends the available
+    // source code is scanned again along with the rest of the string.
     while (lexer_has_next(lexer) && lexer_peek(lexer) != '\"') {
-        lexer_advance(lexer);
+        if (lexer_advance(lexer) == '\\' && lexer_has_next(lexer)) {
+            lexer_advance(lexer);
+        }
     }
 
     // If the end of the source code is reached and a terminating
-    // quote has not been encountered, an error will be returned.
+    // quote has not been encountered, an error will be returned, unless
+    // the rest of the string may still be appended.
+    if (lexer_suspend_at_end(lexer)) {
+        return result;
+    }
+
     if (!lexer_has_next(lexer)) {
         result.failed = true;
-        result.error = lisp_lexer_error(
-            "Unterminated string.", lexer->line, lexer->position);
+        result.error = lisp_lexer_error("Unterminated string.",
+            line_table_position(&lexer->tokens->lines, (u32) lexer->token_start));
 
         return result;
     }
@@ -250,11 +251,7 @@ static void lexer_skip_comment(Lexer *lexer) {
         lexer_advance(lexer);
     }
 
-    // If the end of the line is not the end of the file
-    // then skip the newline character.
-    if (lexer_has_next(lexer)) {
-        lexer_advance(lexer);
-    }
+    lexer_suspend_at_end(lexer);
 }
 
 
@@ -269,11 +266,7 @@ static ScanResult lexer_scan_next(Lexer *lexer) {
     ScanResult result = { .failed = false, .error = NULL };
 
     switch (ch) {
-        case '\n': {
-            lexer->line++;
-            break;
-        }
-
+        case '\n':
         case ' ':
         case '\t':
         case '\r': {
@@ -300,12 +293,19 @@ static ScanResult lexer_scan_next(Lexer *lexer) {
             break;
         }
 
+        case '=': {
+            lexer_add_token(lexer, TOKEN_EQUALS);
+            break;
+        }
+
         case '(': {
+            lexer->depth++;
             lexer_add_token(lexer, TOKEN_LPAREN);
             break;
         }
 
         case ')': {
+            lexer->depth--;
             lexer_add_token(lexer, TOKEN_RPAREN);
             break;
         }
@@ -334,8 +334,7 @@ static ScanResult lexer_scan_next(Lexer *lexer) {
             result.failed = true;
             result.error = lisp_lexer_error(
                 "Unrecognized token.", 
-                lexer->line, 
-                lexer->position
+                line_table_position(&lexer->tokens->lines, (u32) lexer->token_start)
             );
             break;
         }
@@ -346,10 +345,6 @@ static ScanResult lexer_scan_next(Lexer *lexer) {
 
 
 static void initialize_keywords(void) {
-    // Mark all empty spaces in the keyword table as invalid.
-    for (u64 i = 0; i < KEYWORD_TABLE_SIZE; ++i) {
-        keyword_table[i] = TOKEN_INVALID;
-    }
     create_keyword(TOKEN_DEFINE, "define");
     create_keyword(TOKEN_VAR, "var");
     create_keyword(TOKEN_LAMBDA, "lambda");
@@ -358,43 +353,109 @@ static void initialize_keywords(void) {
     create_keyword(TOKEN_TRUE, "true");
     create_keyword(TOKEN_GROUP, "group");
     create_keyword(TOKEN_IF, "if");
+    create_keyword(TOKEN_IMPORT, "import");
 }
 
 
 // @see lexer.h
-extern TokenListResult lexer_tokenize(char *source, size_t source_length) {
-    TokenListResult result;
-
+extern void lexer_initialize_keywords(void) {
     if (!keywords_initialized) {
         initialize_keywords();
         keywords_initialized = true;
     }
-    
-    Lexer lexer = {
-        .source = source,
-        .source_length = source_length,
-        .token_start = 0,
-        .position = 0,
-        .line = 0,
-        .tokens_begin = NULL,
-        .tokens_end = NULL
-    };
-
-    while (lexer_has_next(&lexer)) {
-        ScanResult error = lexer_scan_next(&lexer);
-        lexer.token_start = lexer.position;
-
-        if (error.failed) {
-            result.failed = true;
-            result.error = error.error;
+}
+
+
+// @see lexer.h
+extern void lexer_init(Lexer *lexer, char *source) {
+    lexer_initialize_keywords();
+
+    lexer->source = source;
+    lexer->source_length = 0;
+    lexer->token_start = 0;
+    lexer->position = 0;
+    lexer->depth = 0;
+    lexer->end_of_input = false;
+    lexer->suspended = false;
+    lexer->tokens = token_list_create(source);
+}
+
+
+// @see lexer.h
+extern ScanResult lexer_resume(Lexer *lexer, char *source, size_t source_length) {
+    ScanResult result = { .failed = false, .error = NULL };
+
+    // Token offsets are 32-bit.
+    if (source_length > UINT32_MAX) {
+        result.failed = true;
+        result.error = lisp_internal_error("Source code too large.", LISP_OUT_OF_MEMORY);
+        return result;
+    }
+
+    line_table_scan(&lexer->tokens->lines, source, (u32) lexer->source_length, (u32) source_length);
+
+    lexer->source = source;
+    lexer->tokens->source = source;
+    lexer->source_length = source_length;
+    lexer->suspended = false;
+
+    while (lexer_has_next(lexer) && !lexer->suspended) {
+        result = lexer_scan_next(lexer);
+        lexer->token_start = lexer->position;
+
+        if (result.failed) {
             return result;
         }
     }
 
-    lexer_add_token(&lexer, TOKEN_EOF);
+    return result;
+}
+
+
+// @see lexer.h
+extern TokenListResult lexer_finish(Lexer *lexer) {
+    TokenListResult result;
+
+    lexer->end_of_input = true;
+
+    ScanResult scan_result = lexer_resume(lexer, lexer->source, lexer->source_length);
+    if (scan_result.failed) {
+        result.failed = true;
+        result.error = scan_result.error;
+        return result;
+    }
+
+    lexer_add_token(lexer, TOKEN_EOF);
 
     result.failed = false;
-    result.tokens = lexer.tokens_begin;
+    result.tokens = lexer->tokens;
 
     return result;
-}
\ No newline at end of file
+}
+
+
+// @see lexer.h
+extern TokenListResult lexer_tokenize(char *source, size_t source_length) {
+    TokenListResult result;
+    Lexer lexer;
+
+    trace_begin(TRACE_LEXER);
+    lexer_init(&lexer, source);
+
+    ScanResult scan_result = lexer_resume(&lexer, source, source_length);
+    if (scan_result.failed) {
+        token_list_free(lexer.tokens);
+        result.failed = true;
+        result.error = scan_result.error;
+        trace_end(TRACE_LEXER);
+        return result;
+    }
+
+    result = lexer_finish(&lexer);
+    if (result.failed) {
+        token_list_free(lexer.tokens);
+    }
+
+    trace_end(TRACE_LEXER);
+    return result;
+}
@@ -3,6 +3,7 @@
 #include <stdbool.h>
 
 #include "token.h"
+#include "../util_types.h"
 #include "../lisp/error.h"
 
 
@@ -15,6 +16,61 @@ typedef struct {
 } TokenListResult;
 
 
+/**
+ * A struct keeping track of everything related to the lexer.
+ * It exists so that two lines of the lexer being run from the 
+ * REPL do not share the same state. Notice however, that keywords are
+ * stored statically, separate from the lexer.
+ *
+ * A lexer can be resumed: source code may be appended to the end of
+ * `source` between calls to `lexer_resume`, and only the new text is
+ * scanned. A token that runs into the end of the available source is
+ * left unscanned until more input arrives or `lexer_finish` is called.
+ * Tokens record offsets rather than pointers, so the source may also be
+ * moved, e.g. when its buffer grows.
+ */
+typedef struct {
+    // A pointer to the source code.
+    char *source;
+    // The length of the source code available so far.
+    size_t source_length;
+    // The index of the start of the current token in the source code.
+    u64 token_start;
+    // The current position of the lexer in the source code.
+    u64 position;
+    // The number of '(' scanned minus the number of ')' scanned.
+    i64 depth;
+    // Whether all of the source code has been appended.
+    bool end_of_input;
+    // Whether scanning stopped at the start of an incomplete token.
+    bool suspended;
+    // The tokens scanned so far, and the line table of the source.
+    TokenList *tokens;
+} Lexer;
+
+
+/**
+ * A basic error for lexer functions. `ScanningError` is
+ * basically the implementation of something like: `Error<Void>`.
+ */
+typedef struct ScanningError {
+    // Tracks whether or not an error has occurred.
+    bool failed;
+    // If `failed` is `true` then `error` contains the value of the error,
+    // otherwise `error` is `NULL`.
+    LispError *error;
+} ScanResult;
+
+
+/**
+ * Check whether the tokens scanned so far form complete, balanced
+ * expressions, i.e. whether a REPL can stop reading more lines.
+ */
+inline static bool lexer_is_balanced(Lexer *lexer) {
+    return lexer->tokens->count > 0 && !lexer->suspended && lexer->depth <= 0;
+}
+
+
 /**
  * Scan `source` and create a list of tokens based on the content.
  * @return a `TokenListResult` tracking whether or not the tokenization has
@@ -23,5 +79,31 @@ typedef struct {
  */
 extern TokenListResult lexer_tokenize(char *source, size_t source_length);
 
+/**
+ * Prepare `lexer` to incrementally scan `source`, which is initially empty.
+ */
+extern void lexer_init(Lexer *lexer, char *source);
+
+/**
+ * Fill the keyword table. `lexer_init` does this on first use; code that
+ * lexes from several threads calls it up front, before starting them.
+ */
+extern void lexer_initialize_keywords(void);
+
+/**
+ * Scan the source code appended since the last call, up to `source_length`.
+ * `source` holds the whole source code so far, and may have moved since
+ * the last call.
+ * @return A `ScanResult` containing the error if the new text is invalid.
+ */
+extern ScanResult lexer_resume(Lexer *lexer, char *source, size_t source_length);
+
+/**
+ * Scan any incomplete trailing token, now that no more source code will
+ * be appended, and terminate the token list with an EOF token. The
+ * caller takes ownership of the token list.
+ */
+extern TokenListResult lexer_finish(Lexer *lexer);
+
 
 #endif
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "line_table.h"
+
+
+static void line_table_push(LineTable *table, u32 line_start) {
+    if (table->count == table->capacity) {
+        table->capacity *= 2;
+        table->line_starts = (u32 *) realloc(table->line_starts, table->capacity * sizeof(u32));
+    }
+    table->line_starts[table->count++] = line_start;
+}
+
+
+// @see line_table.h
+extern void line_table_init(LineTable *table) {
+    table->capacity = 0x40;
+    table->line_starts = (u32 *) malloc(table->capacity * sizeof(u32));
+    table->line_starts[0] = 0;
+    table->count = 1;
+}
+
+
+// @see line_table.h
+extern void line_table_scan(LineTable *table, const char *source, u32 begin, u32 end) {
+    u32 position = begin;
+
+#if defined(__SSE2__)
+    // Compare 16 bytes at a time against '\n' and walk the set bits of
+    // the resulting mask, so that long lines cost one compare per block.
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; position + 16 <= end; position += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *) &source[position]);
+        u32 mask = (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        while (mask != 0) {
+            line_table_push(table, position + (u32) __builtin_ctz(mask) + 1);
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; position < end; ++position) {
+        if (source[position] == '\n') {
+            line_table_push(table, position + 1);
+        }
+    }
+}
+
+
+// @see line_table.h
+extern SourcePosition line_table_position(const LineTable *table, u32 offset) {
+    // Find the last line starting at or before `offset`.
+    u32 low = 0;
+    u32 high = table->count;
+    while (high - low > 1) {
+        u32 middle = low + (high - low) / 2;
+        if (table->line_starts[middle] <= offset) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    SourcePosition position = {
+        .offset = offset,
+        .line = low + 1,
+        .column = offset - table->line_starts[low] + 1
+    };
+
+    return position;
+}
+
+
+// @see line_table.h
+extern void line_table_free(LineTable *table) {
+    free(table->line_starts);
+}
@@ -0,0 +1,40 @@
+#ifndef LINE_TABLE_H
+#define LINE_TABLE_H
+
+#include "../util_types.h"
+#include "../lisp/error.h"
+
+
+/**
+ * The offsets at which each line of a source starts. Tokens only record
+ * offsets; line and column numbers are looked up here, by binary search,
+ * when something actually needs to show them.
+ */
+typedef struct {
+    u32 *line_starts;
+    u32 count;
+    u32 capacity;
+} LineTable;
+
+
+/**
+ * Create a table for an empty source, which has a single line.
+ */
+extern void line_table_init(LineTable *table);
+
+/**
+ * Record the lines starting in `source` between the offsets `begin`
+ * (inclusive) and `end` (exclusive). Consecutive calls must cover
+ * consecutive ranges, so that a growing source is scanned only once.
+ */
+extern void line_table_scan(LineTable *table, const char *source, u32 begin, u32 end);
+
+/**
+ * Resolve `offset` to a 1-based line and column.
+ */
+extern SourcePosition line_table_position(const LineTable *table, u32 offset);
+
+extern void line_table_free(LineTable *table);
+
+
+#endif
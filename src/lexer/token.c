@@ -3,32 +3,35 @@
 
 #include "token.h"
 
-extern char *token_to_string(LispToken *token) {
-    if (token == NULL) {
-        return NULL;
-    }
+extern TokenList *token_list_create(char *source) {
+    TokenList *tokens = (TokenList *) calloc(1, sizeof(TokenList));
+    tokens->source = source;
+    tokens->file_name = "stdin";
+    tokens->capacity = 0x40;
+    tokens->tokens = (LispToken *) malloc(tokens->capacity * sizeof(LispToken));
+    line_table_init(&tokens->lines);
+    return tokens;
+}
 
-    // Compute the length of the string to allocate.
-    i32 lexeme_length = (i32) (token->end - token->begin);
-    i32 string_length = snprintf(NULL, 0, 
-        "LispToken => %s '%.*s' @ %s:%u%u", 
-        token_type_to_string(token->type), lexeme_length,
-        token->begin, token->file_name, 
-        token->line, token->column);
 
-    // Allocate a string buffer to store the token data.
-    char *token_string = (char *) calloc(string_length, sizeof(char));
-    if (token_string == NULL) {
-        return NULL;
+extern void token_list_push(TokenList *tokens, LispTokenType type, u32 offset, u32 length) {
+    if (tokens->count == tokens->capacity) {
+        tokens->capacity *= 2;
+        tokens->tokens = (LispToken *) realloc(tokens->tokens, tokens->capacity * sizeof(LispToken));
     }
 
-    // Load the token data into the buffer.
-    snprintf(token_string, string_length, 
-        "LispToken => %s '%.*s' @ %s:%u%u", 
-        token_type_to_string(token->type), lexeme_length, 
-        token->begin, token->file_name, 
-        token->line, token->column);
+    LispToken *token = &tokens->tokens[tokens->count++];
+    token->type = type;
+    token->offset = offset;
+    token->length = length;
+}
+
 
-    // Return the buffer;
-    return token_string;
-}
\ No newline at end of file
+extern void token_list_free(TokenList *tokens) {
+    if (tokens == NULL) {
+        return;
+    }
+    line_table_free(&tokens->lines);
+    free(tokens->tokens);
+    free(tokens);
+}
@@ -3,19 +3,20 @@
 #include <stdbool.h>
 #include "../util_types.h"
 #include "../lisp/error.h"
+#include "line_table.h"
 
 typedef enum {
     TOKEN_INVALID,
     
     // Operator tokens
-    TOKEN_PLUS, TOKEN_MINUS, TOKEN_ASTERISK, TOKEN_SLASH,
+    TOKEN_PLUS, TOKEN_MINUS, TOKEN_ASTERISK, TOKEN_SLASH, TOKEN_EQUALS,
 
     // Parentheses
     TOKEN_LPAREN, TOKEN_RPAREN,
 
     // Keyword tokens
     TOKEN_DEFINE, TOKEN_VAR, TOKEN_LAMBDA, TOKEN_GROUP,
-    TOKEN_IF,
+    TOKEN_IF, TOKEN_IMPORT,
 
     // Literal tokens
     TOKEN_INTEGER, TOKEN_FLOAT, TOKEN_STRING,
@@ -26,19 +27,34 @@ typedef enum {
 } LispTokenType;
 
 
+/**
+ * A token only records where its lexeme is in the source code. The text
+ * and the position of a token are looked up through the `TokenList` it
+ * belongs to.
+ */
 typedef struct {
     LispTokenType type;
-    char *file_name;
-    u32 line;
-    u16 column;
-    char *begin;
-    char *end;
+    // The offset of the first character of the lexeme.
+    u32 offset;
+    // The length of the lexeme in bytes.
+    u32 length;
 } LispToken;
 
 
+/**
+ * The tokens scanned from a source, stored contiguously, along with the
+ * source's line table.
+ */
 typedef struct TokenList {
-    LispToken *token;
-    struct TokenList *next;
+    // The source code the tokens were scanned from. It is not owned by
+    // the list and must outlive it.
+    char *source;
+    // The name of the file the source code was read from.
+    char *file_name;
+    LispToken *tokens;
+    u32 count;
+    u32 capacity;
+    LineTable lines;
 } TokenList;
 
 
@@ -62,7 +78,8 @@ inline static bool token_is_operator(LispToken *token) {
         case TOKEN_PLUS:
         case TOKEN_MINUS:
         case TOKEN_ASTERISK:
-        case TOKEN_SLASH: {
+        case TOKEN_SLASH:
+        case TOKEN_EQUALS: {
             return true;
         }
         default: return false;
@@ -84,6 +101,7 @@ inline static const char *token_type_to_string(LispTokenType type) {
         case TOKEN_MINUS: return "MINUS";
         case TOKEN_ASTERISK: return "ASTERISK";
         case TOKEN_SLASH: return "SLASH";
+        case TOKEN_EQUALS: return "EQUALS";
         case TOKEN_LPAREN: return "LPAREN";
         case TOKEN_RPAREN: return "RPAREN";
         case TOKEN_DEFINE: return "DEFINE";
@@ -98,17 +116,42 @@ inline static const char *token_type_to_string(LispTokenType type) {
         case TOKEN_EOF: return "EOF";
         case TOKEN_IDENTIFIER: return "IDENTIFIER";
         case TOKEN_GROUP: return "GROUP";
+        case TOKEN_IF: return "IF";
+        case TOKEN_IMPORT: return "IMPORT";
         case TOKEN_INVALID: return "<INVALID>";
         default: return "<UNDEFINED>";
     }
 }
 
 /**
- * Get the string representation of a token.
- * 
- * @param token The token of which to get the string representation.
- * @return A pointer to a string representing the data in `token`.
+ * Get a pointer to the first character of the lexeme of `token`.
+ */
+inline static char *token_lexeme(TokenList *tokens, LispToken *token) {
+    return &tokens->source[token->offset];
+}
+
+
+/**
+ * Get the line and column at which `token` starts.
+ */
+inline static SourcePosition token_position(TokenList *tokens, LispToken *token) {
+    return line_table_position(&tokens->lines, token->offset);
+}
+
+
+/**
+ * Create an empty token list for `source`.
+ */
+extern TokenList *token_list_create(char *source);
+
+/**
+ * Append a token to `tokens`.
+ */
+extern void token_list_push(TokenList *tokens, LispTokenType type, u32 offset, u32 length);
+
+/**
+ * Free the tokens and line table in `tokens` along with the list itself.
  */
-extern char *token_to_string(LispToken *token);
+extern void token_list_free(TokenList *tokens);
 
 #endif
\ No newline at end of file
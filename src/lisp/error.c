@@ -1,29 +1,85 @@
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include "error.h"
+#include "../trace/trace.h"
 
 static LispError *lisp_create_error(char *message, LispErrorType error_type) {
-    LispError *error = (LispError *) calloc(1, sizeof(LispError *));
+    LispError *error = (LispError *) calloc(1, sizeof(LispError));
     error->type = error_type;
     error->message = message;
     return error;
 }
 
 
-extern LispError *lisp_lexer_error(char *message, u32 line, u16 column) {
-    LispError *error = lisp_create_error(message, LISP_LEXER_ERROR);
-    error->lexer_error.line = line;
-    error->lexer_error.column = column;
+/**
+ * Record `error` in the trace, at `position` if it has one.
+ */
+static LispError *lisp_trace_error(LispError *error, const SourcePosition *position) {
+    trace_record(TRACE_ERROR, position != NULL ? position->line : 0, (u8) error->type,
+        position != NULL ? (u16) position->column : 0);
     return error;
 }
 
 
-extern LispError *lisp_parser_error(char *message, u32 line, u16 column) {
-    return lisp_lexer_error(message, line, column);
+extern LispError *lisp_lexer_error(char *message, SourcePosition position) {
+    LispError *error = lisp_create_error(message, LISP_LEXER_ERROR);
+    error->lexer_error.position = position;
+    return lisp_trace_error(error, &position);
+}
+
+
+extern LispError *lisp_parser_error(char *message, SourcePosition position) {
+    LispError *error = lisp_create_error(message, LISP_PARSER_ERROR);
+    error->parser_error.position = position;
+    return lisp_trace_error(error, &position);
 }
 
 
 extern LispError *lisp_internal_error(char *message, InternalErrorType type) {
     LispError *error = lisp_create_error(message, LISP_INTERNAL_ERROR);
     error->internalError.type = type;
+    return lisp_trace_error(error, NULL);
+}
+
+
+extern LispError *lisp_runtime_error(char *message) {
+    return lisp_trace_error(lisp_create_error(message, LISP_RUNTIME_ERROR), NULL);
+}
+
+
+extern LispError *lisp_runtime_error_format(const char *format, ...) {
+    va_list arguments;
+    va_start(arguments, format);
+    int length = vsnprintf(NULL, 0, format, arguments);
+    va_end(arguments);
+
+    char *message = (char *) malloc((size_t) length + 1);
+    va_start(arguments, format);
+    vsnprintf(message, (size_t) length + 1, format, arguments);
+    va_end(arguments);
+
+    LispError *error = lisp_runtime_error(message);
+    error->owns_message = true;
     return error;
 }
+
+
+extern LispError *lisp_resource_error(char *message, ResourceLimit limit, u64 used, u64 allowed) {
+    LispError *error = lisp_create_error(message, LISP_RESOURCE_ERROR);
+    error->resource_error.limit = limit;
+    error->resource_error.used = used;
+    error->resource_error.allowed = allowed;
+    return lisp_trace_error(error, NULL);
+}
+
+
+extern void lisp_error_free(LispError *error) {
+    if (error == NULL) {
+        return;
+    }
+    if (error->owns_message) {
+        free(error->message);
+    }
+    free(error);
+}
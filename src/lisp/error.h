@@ -7,7 +7,9 @@
 typedef enum {
     LISP_LEXER_ERROR,
     LISP_PARSER_ERROR,
-    LISP_INTERNAL_ERROR
+    LISP_INTERNAL_ERROR,
+    LISP_RUNTIME_ERROR,
+    LISP_RESOURCE_ERROR
 } LispErrorType;
 
 
@@ -17,9 +19,20 @@ typedef enum {
 } InternalErrorType;
 
 
+/**
+ * A location in the source code. `line` and `column` are 1-based; they
+ * are resolved from `offset` through the line table only when an error
+ * is reported.
+ */
 typedef struct {
+    u32 offset;
     u32 line;
-    u16 column;
+    u32 column;
+} SourcePosition;
+
+
+typedef struct {
+    SourcePosition position;
 } LispLexerError;
 
 
@@ -32,13 +45,38 @@ typedef struct {
 } LispInternalError;
 
 
+/**
+ * The limits on what an evaluation may use.
+ */
+typedef enum {
+    LISP_INSTRUCTION_LIMIT,
+    LISP_HEAP_LIMIT,
+    LISP_STACK_LIMIT,
+    LISP_TIME_LIMIT
+} ResourceLimit;
+
+
+/**
+ * An evaluation exceeded one of its limits, having used `used` of the
+ * `allowed` instructions, bytes, frames or milliseconds.
+ */
+typedef struct {
+    ResourceLimit limit;
+    u64 used;
+    u64 allowed;
+} LispResourceError;
+
+
 typedef struct {
     LispErrorType type;
     char *message;
+    // Whether `message` was allocated for the error, and is freed with it.
+    bool owns_message;
     union {
         LispLexerError lexer_error;
         LispParserError parser_error;
         LispInternalError internalError;
+        LispResourceError resource_error;
     };
 } LispError;
 
@@ -52,11 +90,26 @@ typedef struct {
 } StringResult;
 
 
-extern LispError *lisp_lexer_error(char *message, u32 line, u16 column);
+extern LispError *lisp_lexer_error(char *message, SourcePosition position);
 
-extern LispError *lisp_parser_error(char *message, u32 line, u16 column);
+extern LispError *lisp_parser_error(char *message, SourcePosition position);
 
 extern LispError *lisp_internal_error(char *message, InternalErrorType type);
 
+extern LispError *lisp_runtime_error(char *message);
+
+/**
+ * Create a runtime error whose message is formatted like `printf`, for
+ * messages that name what went wrong.
+ */
+extern LispError *lisp_runtime_error_format(const char *format, ...);
+
+extern LispError *lisp_resource_error(char *message, ResourceLimit limit, u64 used, u64 allowed);
+
+/**
+ * Free `error`, and its message if it owns it.
+ */
+extern void lisp_error_free(LispError *error);
+
 
 #endif
\ No newline at end of file
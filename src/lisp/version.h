@@ -0,0 +1,8 @@
+#ifndef VERSION_H
+#define VERSION_H
+
+// The version of the implementation. Compiled modules are cached per
+// version, so this must change whenever their format or meaning does.
+#define LISP_VERSION "0.1.0"
+
+#endif
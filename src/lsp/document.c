@@ -0,0 +1,552 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "document.h"
+#include "../lexer/lexer.h"
+
+
+/**
+ * Find the first index in the sorted `offsets` whose value is greater
+ * than `offset`.
+ */
+static size_t upper_bound(const size_t *offsets, size_t count, size_t offset) {
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (offsets[middle] <= offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+
+/**
+ * Skip whitespace and comments between top-level forms.
+ */
+static size_t document_skip_blank(const char *text, size_t length, size_t position) {
+    while (position < length) {
+        char ch = text[position];
+        if (ch == ';') {
+            while (position < length && text[position] != '\n') {
+                position++;
+            }
+        } else if (isspace((unsigned char) ch)) {
+            position++;
+        } else {
+            break;
+        }
+    }
+    return position;
+}
+
+
+/**
+ * Find the end of the top-level form starting at `start`. This only
+ * matches parentheses, skipping strings and comments the way the lexer
+ * does; the form is lexed properly once its extent is known. A stray
+ * token outside of any parentheses is a form of its own, so that it
+ * gets a diagnostic.
+ */
+static size_t document_scan_form(const char *text, size_t length, size_t start) {
+    size_t position = start;
+    i64 depth = 0;
+
+    if (text[position] != '(' && text[position] != '"') {
+        if (text[position] == ')') {
+            return position + 1;
+        }
+        while (position < length && !isspace((unsigned char) text[position])
+                && strchr("()\";", text[position]) == NULL) {
+            position++;
+        }
+        return position;
+    }
+
+    while (position < length) {
+        char ch = text[position++];
+        switch (ch) {
+            case '"': {
+                while (position < length && text[position] != '"') {
+                    if (text[position++] == '\\' && position < length) {
+                        position++;
+                    }
+                }
+                if (position < length) {
+                    position++;
+                }
+                break;
+            }
+            case ';': {
+                while (position < length && text[position] != '\n') {
+                    position++;
+                }
+                break;
+            }
+            case '(': {
+                depth++;
+                break;
+            }
+            case ')': {
+                depth--;
+                break;
+            }
+            default: break;
+        }
+        if (depth <= 0) {
+            return position;
+        }
+    }
+
+    return length;
+}
+
+
+/**
+ * Record every `(define Name ...)` in the tokens of `form`, linking
+ * nested definitions to their enclosing one.
+ */
+static void document_form_collect_symbols(DocumentForm *form) {
+    u32 capacity = 0;
+    i64 depth = 0;
+
+    // The open definitions, and the depth of the '(' that opened each.
+    i32 open_symbols[64];
+    i64 open_depths[64];
+    u32 open_count = 0;
+
+    TokenList *tokens = form->tokens;
+    for (u32 i = 0; i < tokens->count; ++i) {
+        LispToken *token = &tokens->tokens[i];
+
+        if (token->type == TOKEN_RPAREN) {
+            if (open_count > 0 && open_depths[open_count - 1] == depth) {
+                FormSymbol *symbol = &form->symbols[open_symbols[--open_count]];
+                symbol->end = token->offset + token->length;
+            }
+            depth--;
+            continue;
+        }
+
+        if (token->type != TOKEN_LPAREN) {
+            continue;
+        }
+        depth++;
+
+        if (i + 2 >= tokens->count || tokens->tokens[i + 1].type != TOKEN_DEFINE
+                || tokens->tokens[i + 2].type != TOKEN_IDENTIFIER) {
+            continue;
+        }
+
+        if (form->symbol_count == capacity) {
+            capacity = capacity == 0 ? 4 : capacity * 2;
+            form->symbols = realloc(form->symbols, capacity * sizeof(FormSymbol));
+        }
+
+        LispToken *name = &tokens->tokens[i + 2];
+        FormSymbol *symbol = &form->symbols[form->symbol_count];
+        symbol->name = (char *) calloc(name->length + 1, sizeof(char));
+        memcpy(symbol->name, token_lexeme(tokens, name), name->length);
+        symbol->name_start = name->offset;
+        symbol->name_end = name->offset + name->length;
+        symbol->start = token->offset;
+        symbol->end = form->end - form->start;
+        symbol->parent = open_count > 0 ? open_symbols[open_count - 1] : -1;
+
+        if (open_count < sizeof(open_depths) / sizeof(open_depths[0])) {
+            open_symbols[open_count] = (i32) form->symbol_count;
+            open_depths[open_count] = depth;
+            open_count++;
+        }
+        form->symbol_count++;
+    }
+}
+
+
+/**
+ * Lex, parse and index the text between `start` and `end` as a form.
+ */
+static void document_form_parse(DocumentForm *form, const char *text, size_t start, size_t end) {
+    memset(form, 0, sizeof(DocumentForm));
+    form->start = start;
+    form->end = end;
+    form->source = (char *) malloc(end - start + 1);
+    memcpy(form->source, &text[start], end - start);
+    form->source[end - start] = '\0';
+
+    TokenListResult lexer_result = lexer_tokenize(form->source, end - start);
+    if (lexer_result.failed) {
+        form->error = lexer_result.error;
+        return;
+    }
+    form->tokens = lexer_result.tokens;
+
+    AstResult parser_result = parser_build_ast(form->tokens);
+    if (parser_result.failed) {
+        form->error = parser_result.error;
+    } else {
+        form->ast = parser_result.ast;
+    }
+
+    document_form_collect_symbols(form);
+}
+
+
+static void document_form_free(DocumentForm *form) {
+    for (u32 i = 0; i < form->symbol_count; ++i) {
+        free(form->symbols[i].name);
+    }
+    free(form->symbols);
+    ast_free(form->ast);
+    token_list_free(form->tokens);
+    lisp_error_free(form->error);
+    free(form->source);
+}
+
+
+static void document_push_form(DocumentForm **forms, size_t *count, size_t *capacity, DocumentForm *form) {
+    if (*count == *capacity) {
+        *capacity = *capacity == 0 ? 16 : *capacity * 2;
+        *forms = realloc(*forms, *capacity * sizeof(DocumentForm));
+    }
+    (*forms)[(*count)++] = *form;
+}
+
+
+/**
+ * Replace the text between `start` and `end` and keep the line start
+ * table in sync, touching only the lines after the edit.
+ */
+static void document_splice(Document *document, size_t start, size_t end, const char *text, size_t length) {
+    size_t new_length = document->length - (end - start) + length;
+    if (new_length + 1 > document->capacity) {
+        while (new_length + 1 > document->capacity) {
+            document->capacity *= 2;
+        }
+        document->text = realloc(document->text, document->capacity);
+    }
+    memmove(&document->text[start + length], &document->text[end], document->length - end);
+    memcpy(&document->text[start], text, length);
+    document->length = new_length;
+    document->text[new_length] = '\0';
+
+    size_t inserted = 0;
+    for (size_t i = 0; i < length; ++i) {
+        inserted += text[i] == '\n';
+    }
+
+    // Lines starting in (start, end] began after a replaced newline.
+    size_t first = upper_bound(document->line_starts, document->line_count, start);
+    size_t last = upper_bound(document->line_starts, document->line_count, end);
+    size_t line_count = document->line_count - (last - first) + inserted;
+
+    if (line_count > document->line_capacity) {
+        while (line_count > document->line_capacity) {
+            document->line_capacity *= 2;
+        }
+        document->line_starts = realloc(document->line_starts, document->line_capacity * sizeof(size_t));
+    }
+
+    memmove(&document->line_starts[first + inserted], &document->line_starts[last],
+        (document->line_count - last) * sizeof(size_t));
+    for (size_t i = first + inserted; i < line_count; ++i) {
+        document->line_starts[i] = document->line_starts[i] - end + start + length;
+    }
+
+    size_t line = first;
+    for (size_t i = 0; i < length; ++i) {
+        if (text[i] == '\n') {
+            document->line_starts[line++] = start + i + 1;
+        }
+    }
+
+    document->line_count = line_count;
+}
+
+
+// @see document.h
+extern void document_init(Document *document, const char *text, size_t length) {
+    document->capacity = 0x1000;
+    document->length = 0;
+    document->text = (char *) malloc(document->capacity);
+    document->text[0] = '\0';
+    document->line_capacity = 0x100;
+    document->line_count = 1;
+    document->line_starts = (size_t *) malloc(document->line_capacity * sizeof(size_t));
+    document->line_starts[0] = 0;
+    document->forms = NULL;
+    document->form_count = 0;
+    document->form_capacity = 0;
+
+    document_edit(document, 0, 0, text, length);
+}
+
+
+// @see document.h
+extern void document_edit(Document *document, size_t start, size_t end, const char *text, size_t length) {
+    if (end > document->length) {
+        end = document->length;
+    }
+    if (start > end) {
+        start = end;
+    }
+
+    DocumentForm *forms = document->forms;
+    size_t form_count = document->form_count;
+    i64 delta = (i64) length - (i64) (end - start);
+
+    // The forms ending before the edit are untouched. A form ending
+    // exactly at the edit is rescanned too, since text appended to an
+    // unterminated form belongs to it.
+    size_t first = 0;
+    while (first < form_count && forms[first].end < start) {
+        first++;
+    }
+
+    // The forms overlapping the edit are dropped.
+    size_t reusable = first;
+    while (reusable < form_count && forms[reusable].start < end) {
+        document_form_free(&forms[reusable]);
+        reusable++;
+    }
+
+    document_splice(document, start, end, text, length);
+
+    DocumentForm *fresh = NULL;
+    size_t fresh_count = 0;
+    size_t fresh_capacity = 0;
+
+    size_t position = first > 0 ? forms[first - 1].end : 0;
+    while (1) {
+        position = document_skip_blank(document->text, document->length, position);
+
+        // Forms swallowed by the new text are dropped, and scanning
+        // stops as soon as it is back in step with an old form.
+        while (reusable < form_count && (i64) forms[reusable].start + delta < (i64) position) {
+            document_form_free(&forms[reusable]);
+            reusable++;
+        }
+        if (reusable < form_count && (i64) forms[reusable].start + delta == (i64) position) {
+            break;
+        }
+        if (position >= document->length) {
+            break;
+        }
+
+        DocumentForm form;
+        size_t form_end = document_scan_form(document->text, document->length, position);
+        document_form_parse(&form, document->text, position, form_end);
+        document_push_form(&fresh, &fresh_count, &fresh_capacity, &form);
+        position = form_end;
+    }
+
+    // Stitch the untouched prefix, the new forms and the reused suffix together.
+    size_t suffix_count = form_count - reusable;
+    size_t count = first + fresh_count + suffix_count;
+    if (count > document->form_capacity) {
+        document->form_capacity = count * 2;
+        forms = realloc(forms, document->form_capacity * sizeof(DocumentForm));
+    }
+    memmove(&forms[first + fresh_count], &forms[reusable], suffix_count * sizeof(DocumentForm));
+    for (size_t i = first + fresh_count; i < count; ++i) {
+        forms[i].start = (size_t) ((i64) forms[i].start + delta);
+        forms[i].end = (size_t) ((i64) forms[i].end + delta);
+    }
+    if (fresh_count > 0) {
+        memcpy(&forms[first], fresh, fresh_count * sizeof(DocumentForm));
+    }
+    free(fresh);
+
+    document->forms = forms;
+    document->form_count = count;
+}
+
+
+// @see document.h
+extern void document_free(Document *document) {
+    for (size_t i = 0; i < document->form_count; ++i) {
+        document_form_free(&document->forms[i]);
+    }
+    free(document->forms);
+    free(document->line_starts);
+    free(document->text);
+}
+
+
+/**
+ * Get the number of bytes and of UTF-16 code units of the character
+ * whose UTF-8 encoding starts with `lead`. Bytes that cannot start a
+ * character count as a character of their own.
+ */
+inline static void document_utf8_character(u8 lead, size_t *bytes, size_t *units) {
+    *units = 1;
+    if (lead >= 0xF0 && lead < 0xF8) {
+        *bytes = 4;
+        *units = 2;
+    } else if (lead >= 0xE0 && lead < 0xF0) {
+        *bytes = 3;
+    } else if (lead >= 0xC0 && lead < 0xE0) {
+        *bytes = 2;
+    } else {
+        *bytes = 1;
+    }
+}
+
+
+// @see document.h
+extern size_t document_offset_at(Document *document, size_t line, size_t column, DocumentEncoding encoding) {
+    if (line >= document->line_count) {
+        return document->length;
+    }
+
+    size_t line_start = document->line_starts[line];
+    size_t line_end = line + 1 < document->line_count
+        ? document->line_starts[line + 1] - 1
+        : document->length;
+
+    if (encoding == DOCUMENT_UTF8) {
+        return line_start + column < line_end ? line_start + column : line_end;
+    }
+
+    size_t offset = line_start;
+    while (offset < line_end) {
+        size_t bytes, units;
+        document_utf8_character((u8) document->text[offset], &bytes, &units);
+        if (units > column) {
+            break;
+        }
+        column -= units;
+        offset += bytes;
+    }
+    return offset < line_end ? offset : line_end;
+}
+
+
+// @see document.h
+extern void document_position_of(Document *document, size_t offset, DocumentEncoding encoding,
+        size_t *line, size_t *column) {
+    size_t index = upper_bound(document->line_starts, document->line_count, offset) - 1;
+    *line = index;
+    if (encoding == DOCUMENT_UTF8) {
+        *column = offset - document->line_starts[index];
+        return;
+    }
+
+    *column = 0;
+    for (size_t i = document->line_starts[index]; i < offset;) {
+        size_t bytes, units;
+        document_utf8_character((u8) document->text[i], &bytes, &units);
+        *column += units;
+        i += bytes;
+    }
+}
+
+
+// @see document.h
+extern size_t document_form_error_offset(DocumentForm *form) {
+    size_t offset = form->error->lexer_error.position.offset;
+    size_t length = form->end - form->start;
+    return form->start + (offset < length ? offset : length);
+}
+
+
+/**
+ * Find the form containing `offset`, or the form ending at it.
+ *
+ * @return The index of the form, or -1.
+ */
+static i64 document_form_at(Document *document, size_t offset) {
+    size_t low = 0;
+    size_t high = document->form_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (document->forms[middle].end < offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low < document->form_count && document->forms[low].start <= offset) {
+        return (i64) low;
+    }
+    return -1;
+}
+
+
+static bool symbol_contains(FormSymbol *symbol, size_t offset) {
+    return symbol->start <= offset && offset < symbol->end;
+}
+
+
+// @see document.h
+extern bool document_find_definition(Document *document, size_t offset, size_t *name_start, size_t *name_end) {
+    i64 index = document_form_at(document, offset);
+    if (index < 0) {
+        return false;
+    }
+
+    DocumentForm *form = &document->forms[index];
+    size_t relative = offset - form->start;
+
+    if (form->tokens == NULL) {
+        return false;
+    }
+
+    LispToken *identifier = NULL;
+    for (u32 i = 0; i < form->tokens->count; ++i) {
+        LispToken *token = &form->tokens->tokens[i];
+        if (token->type == TOKEN_IDENTIFIER && token->offset <= relative
+                && relative <= token->offset + token->length) {
+            identifier = token;
+            break;
+        }
+    }
+    if (identifier == NULL) {
+        return false;
+    }
+
+    char *lexeme = token_lexeme(form->tokens, identifier);
+    size_t length = identifier->length;
+
+    // Among the definitions whose enclosing scope contains the use, prefer
+    // the innermost scope. Those scopes all nest, so the innermost one is
+    // the one that starts last.
+    FormSymbol *best = NULL;
+    for (u32 i = 0; i < form->symbol_count; ++i) {
+        FormSymbol *symbol = &form->symbols[i];
+        if (strlen(symbol->name) != length || memcmp(symbol->name, lexeme, length) != 0) {
+            continue;
+        }
+        if (symbol->parent >= 0 && !symbol_contains(&form->symbols[symbol->parent], relative)) {
+            continue;
+        }
+        if (best == NULL || (symbol->parent >= 0 && (best->parent < 0
+                || form->symbols[symbol->parent].start > form->symbols[best->parent].start))) {
+            best = symbol;
+        }
+    }
+    if (best != NULL) {
+        *name_start = form->start + best->name_start;
+        *name_end = form->start + best->name_end;
+        return true;
+    }
+
+    for (size_t i = 0; i < document->form_count; ++i) {
+        DocumentForm *other = &document->forms[i];
+        for (u32 j = 0; j < other->symbol_count; ++j) {
+            FormSymbol *symbol = &other->symbols[j];
+            if (symbol->parent < 0 && strlen(symbol->name) == length
+                    && memcmp(symbol->name, lexeme, length) == 0) {
+                *name_start = other->start + symbol->name_start;
+                *name_end = other->start + symbol->name_end;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,118 @@
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../util_types.h"
+#include "../lexer/token.h"
+#include "../parser/parser.h"
+
+
+/**
+ * What the columns of positions count: bytes, or UTF-16 code units as
+ * the LSP does unless the client and server agree otherwise.
+ */
+typedef enum {
+    DOCUMENT_UTF8,
+    DOCUMENT_UTF16
+} DocumentEncoding;
+
+
+/**
+ * A `define` found in a top-level form. Offsets are relative to the
+ * start of the form, so they stay valid when the form is moved.
+ */
+typedef struct {
+    char *name;
+    size_t name_start;
+    size_t name_end;
+    // The extent of the whole `(define ...)` expression.
+    size_t start;
+    size_t end;
+    // The index of the enclosing `define` in the same form, or -1.
+    i32 parent;
+} FormSymbol;
+
+
+/**
+ * A top-level form of a document, together with everything derived
+ * from it. A form owns a copy of its source text, which its tokens point
+ * into, so edits elsewhere in the document only change `start` and `end`
+ * and the tokens, tree and symbols can be reused as they are.
+ */
+typedef struct {
+    // The extent of the form in the document.
+    size_t start;
+    size_t end;
+    char *source;
+    TokenList *tokens;
+    AstNode *ast;
+    // The lexer or parser error of the form, if any.
+    LispError *error;
+    FormSymbol *symbols;
+    u32 symbol_count;
+} DocumentForm;
+
+
+/**
+ * An open text document, kept as its text, the offsets at which its
+ * lines start, and its top-level forms in order.
+ */
+typedef struct {
+    char *text;
+    size_t length;
+    size_t capacity;
+    size_t *line_starts;
+    size_t line_count;
+    size_t line_capacity;
+    DocumentForm *forms;
+    size_t form_count;
+    size_t form_capacity;
+} Document;
+
+
+/**
+ * Create a document holding `text` and parse all of it.
+ */
+extern void document_init(Document *document, const char *text, size_t length);
+
+/**
+ * Replace the text between the offsets `start` and `end` with `text`.
+ * Only the top-level forms touched by the edit are lexed and parsed
+ * again; the forms that follow are reused as soon as scanning the new
+ * text arrives back at one of their (shifted) boundaries.
+ */
+extern void document_edit(Document *document, size_t start, size_t end, const char *text, size_t length);
+
+extern void document_free(Document *document);
+
+/**
+ * Convert a zero-based line and column in `encoding` to an offset,
+ * clamping positions past the end of a line or of the document. A column
+ * in the middle of a character is moved to its start.
+ */
+extern size_t document_offset_at(Document *document, size_t line, size_t column, DocumentEncoding encoding);
+
+/**
+ * Convert an offset to a zero-based line and column in `encoding`.
+ */
+extern void document_position_of(Document *document, size_t offset, DocumentEncoding encoding,
+    size_t *line, size_t *column);
+
+/**
+ * Get the offset in the document at which the error of `form` occurred.
+ */
+extern size_t document_form_error_offset(DocumentForm *form);
+
+/**
+ * Find the `define` of the identifier at `offset`, preferring the
+ * innermost enclosing definition, then top-level definitions anywhere in
+ * the document.
+ *
+ * @return Whether a definition was found, in which case the extent of its
+ * name is stored in `name_start` and `name_end`.
+ */
+extern bool document_find_definition(Document *document, size_t offset, size_t *name_start, size_t *name_end);
+
+
+#endif
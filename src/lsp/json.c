@@ -0,0 +1,539 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "json.h"
+
+// Documents nested deeper than this are rejected rather than risking
+// the C stack on hostile input.
+#define JSON_MAX_DEPTH 256
+
+
+typedef struct {
+    const char *text;
+    size_t length;
+    size_t position;
+} JsonParser;
+
+
+static JsonValue *json_parse_value(JsonParser *parser, u32 depth);
+
+
+static JsonValue *json_allocate(JsonType type) {
+    JsonValue *value = (JsonValue *) calloc(1, sizeof(JsonValue));
+    value->type = type;
+    return value;
+}
+
+
+static void json_skip_whitespace(JsonParser *parser) {
+    while (parser->position < parser->length) {
+        char ch = parser->text[parser->position];
+        if (ch != ' ' && ch != '\t' && ch != '\n' && ch != '\r') {
+            return;
+        }
+        parser->position++;
+    }
+}
+
+
+static bool json_match(JsonParser *parser, const char *literal) {
+    size_t length = strlen(literal);
+    if (parser->length - parser->position < length
+            || memcmp(&parser->text[parser->position], literal, length) != 0) {
+        return false;
+    }
+    parser->position += length;
+    return true;
+}
+
+
+static i32 json_hex_digit(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+
+static bool json_parse_hex4(JsonParser *parser, u32 *out) {
+    if (parser->length - parser->position < 4) {
+        return false;
+    }
+    u32 code = 0;
+    for (u32 i = 0; i < 4; ++i) {
+        i32 digit = json_hex_digit(parser->text[parser->position++]);
+        if (digit < 0) {
+            return false;
+        }
+        code = (code << 4) | (u32) digit;
+    }
+    *out = code;
+    return true;
+}
+
+
+static size_t json_encode_utf8(char *out, u32 code) {
+    if (code < 0x80) {
+        out[0] = (char) code;
+        return 1;
+    }
+    if (code < 0x800) {
+        out[0] = (char) (0xC0 | (code >> 6));
+        out[1] = (char) (0x80 | (code & 0x3F));
+        return 2;
+    }
+    if (code < 0x10000) {
+        out[0] = (char) (0xE0 | (code >> 12));
+        out[1] = (char) (0x80 | ((code >> 6) & 0x3F));
+        out[2] = (char) (0x80 | (code & 0x3F));
+        return 3;
+    }
+    out[0] = (char) (0xF0 | (code >> 18));
+    out[1] = (char) (0x80 | ((code >> 12) & 0x3F));
+    out[2] = (char) (0x80 | ((code >> 6) & 0x3F));
+    out[3] = (char) (0x80 | (code & 0x3F));
+    return 4;
+}
+
+
+/**
+ * Parse a string starting at its opening quote. Escapes never expand,
+ * so the unescaped string fits in the length of the raw text.
+ */
+static char *json_parse_string_chars(JsonParser *parser, size_t *out_length) {
+    parser->position++;
+
+    const char *start = &parser->text[parser->position];
+    const char *quote = memchr(start, '"', parser->length - parser->position);
+    if (quote == NULL) {
+        return NULL;
+    }
+
+    char *chars = (char *) malloc(parser->length - parser->position + 1);
+    size_t length = 0;
+
+    while (parser->position < parser->length) {
+        char ch = parser->text[parser->position++];
+
+        if (ch == '"') {
+            chars[length] = '\0';
+            *out_length = length;
+            return chars;
+        }
+
+        if (ch != '\\') {
+            chars[length++] = ch;
+            continue;
+        }
+
+        if (parser->position == parser->length) {
+            break;
+        }
+
+        char escape = parser->text[parser->position++];
+        switch (escape) {
+            case '"': chars[length++] = '"'; break;
+            case '\\': chars[length++] = '\\'; break;
+            case '/': chars[length++] = '/'; break;
+            case 'b': chars[length++] = '\b'; break;
+            case 'f': chars[length++] = '\f'; break;
+            case 'n': chars[length++] = '\n'; break;
+            case 'r': chars[length++] = '\r'; break;
+            case 't': chars[length++] = '\t'; break;
+            case 'u': {
+                u32 code;
+                if (!json_parse_hex4(parser, &code)) {
+                    free(chars);
+                    return NULL;
+                }
+                // Combine a UTF-16 surrogate pair into one code point.
+                if (code >= 0xD800 && code < 0xDC00 && json_match(parser, "\\u")) {
+                    u32 low;
+                    if (!json_parse_hex4(parser, &low)) {
+                        free(chars);
+                        return NULL;
+                    }
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                length += json_encode_utf8(&chars[length], code);
+                break;
+            }
+            default: {
+                free(chars);
+                return NULL;
+            }
+        }
+    }
+
+    free(chars);
+    return NULL;
+}
+
+
+static JsonValue *json_parse_array(JsonParser *parser, u32 depth) {
+    JsonValue *array = json_allocate(JSON_ARRAY);
+    size_t capacity = 0;
+
+    parser->position++;
+    json_skip_whitespace(parser);
+    if (json_match(parser, "]")) {
+        return array;
+    }
+
+    while (1) {
+        JsonValue *item = json_parse_value(parser, depth + 1);
+        if (item == NULL) {
+            json_free(array);
+            return NULL;
+        }
+
+        if (array->array.count == capacity) {
+            capacity = capacity == 0 ? 4 : capacity * 2;
+            array->array.items = realloc(array->array.items, capacity * sizeof(JsonValue *));
+        }
+        array->array.items[array->array.count++] = item;
+
+        json_skip_whitespace(parser);
+        if (json_match(parser, ",")) {
+            continue;
+        }
+        if (json_match(parser, "]")) {
+            return array;
+        }
+
+        json_free(array);
+        return NULL;
+    }
+}
+
+
+static JsonValue *json_parse_object(JsonParser *parser, u32 depth) {
+    JsonValue *object = json_allocate(JSON_OBJECT);
+    size_t capacity = 0;
+
+    parser->position++;
+    json_skip_whitespace(parser);
+    if (json_match(parser, "}")) {
+        return object;
+    }
+
+    while (1) {
+        json_skip_whitespace(parser);
+        if (parser->position == parser->length || parser->text[parser->position] != '"') {
+            json_free(object);
+            return NULL;
+        }
+
+        size_t key_length;
+        char *key = json_parse_string_chars(parser, &key_length);
+        if (key == NULL) {
+            json_free(object);
+            return NULL;
+        }
+
+        json_skip_whitespace(parser);
+        JsonValue *value = json_match(parser, ":") ? json_parse_value(parser, depth + 1) : NULL;
+        if (value == NULL) {
+            free(key);
+            json_free(object);
+            return NULL;
+        }
+
+        if (object->object.count == capacity) {
+            capacity = capacity == 0 ? 4 : capacity * 2;
+            object->object.keys = realloc(object->object.keys, capacity * sizeof(char *));
+            object->object.values = realloc(object->object.values, capacity * sizeof(JsonValue *));
+        }
+        object->object.keys[object->object.count] = key;
+        object->object.values[object->object.count] = value;
+        object->object.count++;
+
+        json_skip_whitespace(parser);
+        if (json_match(parser, ",")) {
+            continue;
+        }
+        if (json_match(parser, "}")) {
+            return object;
+        }
+
+        json_free(object);
+        return NULL;
+    }
+}
+
+
+static JsonValue *json_parse_number(JsonParser *parser) {
+    const char *start = &parser->text[parser->position];
+    size_t length = 0;
+    while (parser->position + length < parser->length
+            && strchr("+-0123456789.eE", start[length]) != NULL) {
+        length++;
+    }
+    if (length == 0) {
+        return NULL;
+    }
+
+    char *text = (char *) calloc(length + 1, sizeof(char));
+    memcpy(text, start, length);
+    char *end;
+    double number = strtod(text, &end);
+    bool valid = end == text + length;
+    free(text);
+
+    if (!valid) {
+        return NULL;
+    }
+
+    parser->position += length;
+    JsonValue *value = json_allocate(JSON_NUMBER);
+    value->number = number;
+    return value;
+}
+
+
+static JsonValue *json_parse_value(JsonParser *parser, u32 depth) {
+    if (depth > JSON_MAX_DEPTH) {
+        return NULL;
+    }
+
+    json_skip_whitespace(parser);
+    if (parser->position == parser->length) {
+        return NULL;
+    }
+
+    switch (parser->text[parser->position]) {
+        case '{': return json_parse_object(parser, depth);
+        case '[': return json_parse_array(parser, depth);
+        case '"': {
+            size_t length;
+            char *chars = json_parse_string_chars(parser, &length);
+            if (chars == NULL) {
+                return NULL;
+            }
+            JsonValue *value = json_allocate(JSON_STRING);
+            value->string.chars = chars;
+            value->string.length = length;
+            return value;
+        }
+        default: break;
+    }
+
+    if (json_match(parser, "null")) {
+        return json_allocate(JSON_NULL);
+    }
+    if (json_match(parser, "true")) {
+        JsonValue *value = json_allocate(JSON_BOOL);
+        value->boolean = true;
+        return value;
+    }
+    if (json_match(parser, "false")) {
+        return json_allocate(JSON_BOOL);
+    }
+
+    return json_parse_number(parser);
+}
+
+
+// @see json.h
+extern JsonValue *json_parse(const char *text, size_t length) {
+    JsonParser parser = { .text = text, .length = length, .position = 0 };
+
+    JsonValue *value = json_parse_value(&parser, 0);
+    json_skip_whitespace(&parser);
+
+    if (value != NULL && parser.position != length) {
+        json_free(value);
+        return NULL;
+    }
+
+    return value;
+}
+
+
+// @see json.h
+extern void json_free(JsonValue *value) {
+    if (value == NULL) {
+        return;
+    }
+
+    switch (value->type) {
+        case JSON_STRING: {
+            free(value->string.chars);
+            break;
+        }
+        case JSON_ARRAY: {
+            for (size_t i = 0; i < value->array.count; ++i) {
+                json_free(value->array.items[i]);
+            }
+            free(value->array.items);
+            break;
+        }
+        case JSON_OBJECT: {
+            for (size_t i = 0; i < value->object.count; ++i) {
+                free(value->object.keys[i]);
+                json_free(value->object.values[i]);
+            }
+            free(value->object.keys);
+            free(value->object.values);
+            break;
+        }
+        default: break;
+    }
+
+    free(value);
+}
+
+
+// @see json.h
+extern JsonValue *json_get(JsonValue *object, const char *key) {
+    if (object == NULL || object->type != JSON_OBJECT) {
+        return NULL;
+    }
+    for (size_t i = 0; i < object->object.count; ++i) {
+        if (strcmp(object->object.keys[i], key) == 0) {
+            return object->object.values[i];
+        }
+    }
+    return NULL;
+}
+
+
+// @see json.h
+extern JsonValue *json_get_string(JsonValue *object, const char *key) {
+    JsonValue *value = json_get(object, key);
+    return value != NULL && value->type == JSON_STRING ? value : NULL;
+}
+
+
+// @see json.h
+extern i64 json_get_integer(JsonValue *object, const char *key, i64 fallback) {
+    JsonValue *value = json_get(object, key);
+    return value != NULL && value->type == JSON_NUMBER ? (i64) value->number : fallback;
+}
+
+
+// @see json.h
+extern void json_writer_init(JsonWriter *writer) {
+    writer->capacity = 0x1000;
+    writer->length = 0;
+    writer->data = (char *) malloc(writer->capacity);
+}
+
+
+// @see json.h
+extern void json_writer_free(JsonWriter *writer) {
+    free(writer->data);
+}
+
+
+static void json_writer_reserve(JsonWriter *writer, size_t length) {
+    if (writer->length + length <= writer->capacity) {
+        return;
+    }
+    while (writer->length + length > writer->capacity) {
+        writer->capacity *= 2;
+    }
+    writer->data = (char *) realloc(writer->data, writer->capacity);
+}
+
+
+static void json_write_bytes(JsonWriter *writer, const char *bytes, size_t length) {
+    json_writer_reserve(writer, length);
+    memcpy(&writer->data[writer->length], bytes, length);
+    writer->length += length;
+}
+
+
+// @see json.h
+extern void json_write_raw(JsonWriter *writer, const char *text) {
+    json_write_bytes(writer, text, strlen(text));
+}
+
+
+// @see json.h
+extern void json_write_string(JsonWriter *writer, const char *text, size_t length) {
+    // Worst case every byte becomes a six byte \u escape.
+    json_writer_reserve(writer, length * 6 + 2);
+
+    char *out = &writer->data[writer->length];
+    *out++ = '"';
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char ch = (unsigned char) text[i];
+        switch (ch) {
+            case '"': *out++ = '\\'; *out++ = '"'; break;
+            case '\\': *out++ = '\\'; *out++ = '\\'; break;
+            case '\n': *out++ = '\\'; *out++ = 'n'; break;
+            case '\r': *out++ = '\\'; *out++ = 'r'; break;
+            case '\t': *out++ = '\\'; *out++ = 't'; break;
+            default: {
+                if (ch < 0x20) {
+                    out += sprintf(out, "\\u%04x", ch);
+                } else {
+                    *out++ = (char) ch;
+                }
+                break;
+            }
+        }
+    }
+    *out++ = '"';
+
+    writer->length = (size_t) (out - writer->data);
+}
+
+
+// @see json.h
+extern void json_write_integer(JsonWriter *writer, i64 number) {
+    char digits[24];
+    i32 length = snprintf(digits, sizeof(digits), "%" PRId64, number);
+    json_write_bytes(writer, digits, (size_t) length);
+}
+
+
+// @see json.h
+extern void json_write_value(JsonWriter *writer, JsonValue *value) {
+    if (value == NULL) {
+        json_write_raw(writer, "null");
+        return;
+    }
+
+    switch (value->type) {
+        case JSON_NULL: json_write_raw(writer, "null"); break;
+        case JSON_BOOL: json_write_raw(writer, value->boolean ? "true" : "false"); break;
+        case JSON_NUMBER: {
+            char digits[32];
+            i32 length = snprintf(digits, sizeof(digits), "%.17g", value->number);
+            json_write_bytes(writer, digits, (size_t) length);
+            break;
+        }
+        case JSON_STRING: {
+            json_write_string(writer, value->string.chars, value->string.length);
+            break;
+        }
+        case JSON_ARRAY: {
+            json_write_raw(writer, "[");
+            for (size_t i = 0; i < value->array.count; ++i) {
+                if (i > 0) {
+                    json_write_raw(writer, ",");
+                }
+                json_write_value(writer, value->array.items[i]);
+            }
+            json_write_raw(writer, "]");
+            break;
+        }
+        case JSON_OBJECT: {
+            json_write_raw(writer, "{");
+            for (size_t i = 0; i < value->object.count; ++i) {
+                if (i > 0) {
+                    json_write_raw(writer, ",");
+                }
+                json_write_string(writer, value->object.keys[i], strlen(value->object.keys[i]));
+                json_write_raw(writer, ":");
+                json_write_value(writer, value->object.values[i]);
+            }
+            json_write_raw(writer, "}");
+            break;
+        }
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef JSON_H
+#define JSON_H
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../util_types.h"
+
+
+typedef enum {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+} JsonType;
+
+
+/**
+ * A parsed JSON value. Strings are unescaped and NUL-terminated, but
+ * also carry their length since they may contain NUL characters.
+ */
+typedef struct JsonValue {
+    JsonType type;
+    union {
+        bool boolean;
+        double number;
+        struct {
+            char *chars;
+            size_t length;
+        } string;
+        struct {
+            struct JsonValue **items;
+            size_t count;
+        } array;
+        struct {
+            char **keys;
+            struct JsonValue **values;
+            size_t count;
+        } object;
+    };
+} JsonValue;
+
+
+/**
+ * A growable buffer that JSON text is written into.
+ */
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} JsonWriter;
+
+
+/**
+ * Parse the JSON document in `text`.
+ *
+ * @return The parsed value, or `NULL` if `text` is not valid JSON.
+ */
+extern JsonValue *json_parse(const char *text, size_t length);
+
+/**
+ * Free `value` and everything it contains.
+ */
+extern void json_free(JsonValue *value);
+
+/**
+ * Look up `key` in `object`.
+ *
+ * @return The member's value, or `NULL` if `object` is not an object
+ * or has no such member.
+ */
+extern JsonValue *json_get(JsonValue *object, const char *key);
+
+/**
+ * Look up a string member of `object`.
+ *
+ * @return The string, or `NULL` if it is missing or not a string.
+ */
+extern JsonValue *json_get_string(JsonValue *object, const char *key);
+
+/**
+ * Look up a numeric member of `object`, or return `fallback`.
+ */
+extern i64 json_get_integer(JsonValue *object, const char *key, i64 fallback);
+
+
+extern void json_writer_init(JsonWriter *writer);
+
+extern void json_writer_free(JsonWriter *writer);
+
+/**
+ * Append `text` verbatim.
+ */
+extern void json_write_raw(JsonWriter *writer, const char *text);
+
+/**
+ * Append `length` bytes of `text` as a quoted, escaped JSON string.
+ */
+extern void json_write_string(JsonWriter *writer, const char *text, size_t length);
+
+extern void json_write_integer(JsonWriter *writer, i64 number);
+
+/**
+ * Append the serialization of `value`, e.g. to echo a request id.
+ */
+extern void json_write_value(JsonWriter *writer, JsonValue *value);
+
+
+#endif
@@ -0,0 +1,444 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "server.h"
+#include "json.h"
+#include "document.h"
+
+#define LSP_HEADER_LENGTH 0x100
+
+// JSON-RPC error code for requests the server does not implement.
+#define LSP_METHOD_NOT_FOUND -32601
+
+// LSP `DiagnosticSeverity.Error` and `SymbolKind.Function`.
+#define LSP_SEVERITY_ERROR 1
+#define LSP_SYMBOL_FUNCTION 12
+
+
+typedef struct OpenDocument {
+    char *uri;
+    Document document;
+    struct OpenDocument *next;
+} OpenDocument;
+
+
+typedef struct {
+    OpenDocument *documents;
+    // What the columns of positions count, as agreed on in `initialize`.
+    DocumentEncoding encoding;
+    bool shutdown_requested;
+    bool running;
+} LanguageServer;
+
+
+/**
+ * Read one `Content-Length` framed message from stdin.
+ *
+ * @return The parsed message, or `NULL` at the end of the input. A
+ * malformed message is returned as a JSON null.
+ */
+static JsonValue *lsp_read_message(void) {
+    char header[LSP_HEADER_LENGTH];
+    size_t content_length = 0;
+    bool has_length = false;
+
+    while (1) {
+        if (fgets(header, sizeof(header), stdin) == NULL) {
+            return NULL;
+        }
+        if (strcmp(header, "\r\n") == 0 || strcmp(header, "\n") == 0) {
+            break;
+        }
+        if (strncmp(header, "Content-Length:", sizeof("Content-Length:") - 1) == 0) {
+            content_length = (size_t) strtoull(header + sizeof("Content-Length:") - 1, NULL, 10);
+            has_length = true;
+        }
+    }
+
+    if (!has_length) {
+        return json_parse("null", 4);
+    }
+
+    char *content = (char *) malloc(content_length + 1);
+    if (fread(content, 1, content_length, stdin) != content_length) {
+        free(content);
+        return NULL;
+    }
+
+    JsonValue *message = json_parse(content, content_length);
+    free(content);
+
+    return message != NULL ? message : json_parse("null", 4);
+}
+
+
+static void lsp_send(JsonWriter *writer) {
+    printf("Content-Length: %zu\r\n\r\n", writer->length);
+    fwrite(writer->data, 1, writer->length, stdout);
+    fflush(stdout);
+}
+
+
+static void lsp_begin_response(JsonWriter *writer, JsonValue *id) {
+    json_write_raw(writer, "{\"jsonrpc\":\"2.0\",\"id\":");
+    json_write_value(writer, id);
+    json_write_raw(writer, ",\"result\":");
+}
+
+
+static void lsp_write_position(JsonWriter *writer, LanguageServer *server, Document *document, size_t offset) {
+    size_t line, column;
+    document_position_of(document, offset, server->encoding, &line, &column);
+    json_write_raw(writer, "{\"line\":");
+    json_write_integer(writer, (i64) line);
+    json_write_raw(writer, ",\"character\":");
+    json_write_integer(writer, (i64) column);
+    json_write_raw(writer, "}");
+}
+
+
+static void lsp_write_range(JsonWriter *writer, LanguageServer *server, Document *document,
+        size_t start, size_t end) {
+    json_write_raw(writer, "{\"start\":");
+    lsp_write_position(writer, server, document, start);
+    json_write_raw(writer, ",\"end\":");
+    lsp_write_position(writer, server, document, end);
+    json_write_raw(writer, "}");
+}
+
+
+static size_t lsp_read_position(LanguageServer *server, Document *document, JsonValue *position) {
+    return document_offset_at(document,
+        (size_t) json_get_integer(position, "line", 0),
+        (size_t) json_get_integer(position, "character", 0),
+        server->encoding);
+}
+
+
+static OpenDocument *lsp_find_document(LanguageServer *server, JsonValue *params) {
+    JsonValue *uri = json_get_string(json_get(params, "textDocument"), "uri");
+    if (uri == NULL) {
+        return NULL;
+    }
+    for (OpenDocument *open = server->documents; open != NULL; open = open->next) {
+        if (strcmp(open->uri, uri->string.chars) == 0) {
+            return open;
+        }
+    }
+    return NULL;
+}
+
+
+static void lsp_publish_diagnostics(LanguageServer *server, OpenDocument *open) {
+    JsonWriter writer;
+    json_writer_init(&writer);
+
+    json_write_raw(&writer, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":");
+    json_write_string(&writer, open->uri, strlen(open->uri));
+    json_write_raw(&writer, ",\"diagnostics\":[");
+
+    Document *document = &open->document;
+    bool first = true;
+    for (size_t i = 0; i < document->form_count; ++i) {
+        DocumentForm *form = &document->forms[i];
+        if (form->error == NULL) {
+            continue;
+        }
+
+        size_t start = document_form_error_offset(form);
+        size_t end = start < form->end ? start + 1 : start;
+
+        json_write_raw(&writer, first ? "{\"range\":" : ",{\"range\":");
+        lsp_write_range(&writer, server, document, start, end);
+        json_write_raw(&writer, ",\"severity\":");
+        json_write_integer(&writer, LSP_SEVERITY_ERROR);
+        json_write_raw(&writer, ",\"source\":\"mylisp\",\"message\":");
+        json_write_string(&writer, form->error->message, strlen(form->error->message));
+        json_write_raw(&writer, "}");
+        first = false;
+    }
+
+    json_write_raw(&writer, "]}}");
+    lsp_send(&writer);
+    json_writer_free(&writer);
+}
+
+
+/**
+ * Agree on the encoding of positions: UTF-8 if the client offers it,
+ * since that is what the server works in, or else UTF-16, which every
+ * client supports.
+ */
+static DocumentEncoding lsp_negotiate_encoding(JsonValue *params) {
+    JsonValue *encodings = json_get(json_get(json_get(params, "capabilities"), "general"), "positionEncodings");
+    if (encodings == NULL || encodings->type != JSON_ARRAY) {
+        return DOCUMENT_UTF16;
+    }
+    for (size_t i = 0; i < encodings->array.count; ++i) {
+        JsonValue *encoding = encodings->array.items[i];
+        if (encoding->type == JSON_STRING && strcmp(encoding->string.chars, "utf-8") == 0) {
+            return DOCUMENT_UTF8;
+        }
+    }
+    return DOCUMENT_UTF16;
+}
+
+
+static void lsp_initialize(LanguageServer *server, JsonValue *id, JsonValue *params) {
+    JsonWriter writer;
+    json_writer_init(&writer);
+
+    server->encoding = lsp_negotiate_encoding(params);
+    lsp_begin_response(&writer, id);
+    json_write_raw(&writer, "{\"capabilities\":{\"positionEncoding\":");
+    json_write_raw(&writer, server->encoding == DOCUMENT_UTF8 ? "\"utf-8\"," : "\"utf-16\",");
+    json_write_raw(&writer,
+            "\"textDocumentSync\":{\"openClose\":true,\"change\":2},"
+            "\"documentSymbolProvider\":true,"
+            "\"definitionProvider\":true"
+        "},\"serverInfo\":{\"name\":\"mylisp\"}}}");
+
+    lsp_send(&writer);
+    json_writer_free(&writer);
+}
+
+
+static void lsp_did_open(LanguageServer *server, JsonValue *params) {
+    JsonValue *item = json_get(params, "textDocument");
+    JsonValue *uri = json_get_string(item, "uri");
+    JsonValue *text = json_get_string(item, "text");
+    if (uri == NULL || text == NULL) {
+        return;
+    }
+
+    OpenDocument *open = (OpenDocument *) calloc(1, sizeof(OpenDocument));
+    open->uri = (char *) calloc(uri->string.length + 1, sizeof(char));
+    memcpy(open->uri, uri->string.chars, uri->string.length);
+    document_init(&open->document, text->string.chars, text->string.length);
+    open->next = server->documents;
+    server->documents = open;
+
+    lsp_publish_diagnostics(server, open);
+}
+
+
+static void lsp_did_change(LanguageServer *server, JsonValue *params) {
+    OpenDocument *open = lsp_find_document(server, params);
+    JsonValue *changes = json_get(params, "contentChanges");
+    if (open == NULL || changes == NULL || changes->type != JSON_ARRAY) {
+        return;
+    }
+
+    Document *document = &open->document;
+    for (size_t i = 0; i < changes->array.count; ++i) {
+        JsonValue *change = changes->array.items[i];
+        JsonValue *text = json_get_string(change, "text");
+        JsonValue *range = json_get(change, "range");
+        if (text == NULL) {
+            continue;
+        }
+
+        if (range == NULL) {
+            document_edit(document, 0, document->length, text->string.chars, text->string.length);
+            continue;
+        }
+
+        size_t start = lsp_read_position(server, document, json_get(range, "start"));
+        size_t end = lsp_read_position(server, document, json_get(range, "end"));
+        document_edit(document, start, end, text->string.chars, text->string.length);
+    }
+
+    lsp_publish_diagnostics(server, open);
+}
+
+
+static void lsp_did_close(LanguageServer *server, JsonValue *params) {
+    OpenDocument *open = lsp_find_document(server, params);
+    if (open == NULL) {
+        return;
+    }
+
+    OpenDocument **link = &server->documents;
+    while (*link != open) {
+        link = &(*link)->next;
+    }
+    *link = open->next;
+
+    // Clear the diagnostics of the closed document.
+    document_free(&open->document);
+    document_init(&open->document, "", 0);
+    lsp_publish_diagnostics(server, open);
+
+    document_free(&open->document);
+    free(open->uri);
+    free(open);
+}
+
+
+static void lsp_write_symbols(JsonWriter *writer, LanguageServer *server, Document *document,
+        DocumentForm *form, i32 parent) {
+    bool first = true;
+
+    for (u32 i = 0; i < form->symbol_count; ++i) {
+        FormSymbol *symbol = &form->symbols[i];
+        if (symbol->parent != parent) {
+            continue;
+        }
+
+        json_write_raw(writer, first ? "{\"name\":" : ",{\"name\":");
+        json_write_string(writer, symbol->name, strlen(symbol->name));
+        json_write_raw(writer, ",\"kind\":");
+        json_write_integer(writer, LSP_SYMBOL_FUNCTION);
+        json_write_raw(writer, ",\"range\":");
+        lsp_write_range(writer, server, document, form->start + symbol->start, form->start + symbol->end);
+        json_write_raw(writer, ",\"selectionRange\":");
+        lsp_write_range(writer, server, document, form->start + symbol->name_start, form->start + symbol->name_end);
+        json_write_raw(writer, ",\"children\":[");
+        lsp_write_symbols(writer, server, document, form, (i32) i);
+        json_write_raw(writer, "]}");
+        first = false;
+    }
+}
+
+
+static void lsp_document_symbol(LanguageServer *server, JsonValue *id, JsonValue *params) {
+    JsonWriter writer;
+    json_writer_init(&writer);
+    lsp_begin_response(&writer, id);
+
+    OpenDocument *open = lsp_find_document(server, params);
+    json_write_raw(&writer, "[");
+    if (open != NULL) {
+        bool first = true;
+        for (size_t i = 0; i < open->document.form_count; ++i) {
+            DocumentForm *form = &open->document.forms[i];
+            if (form->symbol_count == 0) {
+                continue;
+            }
+            if (!first) {
+                json_write_raw(&writer, ",");
+            }
+            lsp_write_symbols(&writer, server, &open->document, form, -1);
+            first = false;
+        }
+    }
+    json_write_raw(&writer, "]}");
+
+    lsp_send(&writer);
+    json_writer_free(&writer);
+}
+
+
+static void lsp_definition(LanguageServer *server, JsonValue *id, JsonValue *params) {
+    JsonWriter writer;
+    json_writer_init(&writer);
+    lsp_begin_response(&writer, id);
+
+    OpenDocument *open = lsp_find_document(server, params);
+    size_t name_start, name_end;
+
+    if (open != NULL && document_find_definition(&open->document,
+            lsp_read_position(server, &open->document, json_get(params, "position")),
+            &name_start, &name_end)) {
+        json_write_raw(&writer, "{\"uri\":");
+        json_write_string(&writer, open->uri, strlen(open->uri));
+        json_write_raw(&writer, ",\"range\":");
+        lsp_write_range(&writer, server, &open->document, name_start, name_end);
+        json_write_raw(&writer, "}}");
+    } else {
+        json_write_raw(&writer, "null}");
+    }
+
+    lsp_send(&writer);
+    json_writer_free(&writer);
+}
+
+
+static void lsp_respond_null(JsonValue *id) {
+    JsonWriter writer;
+    json_writer_init(&writer);
+    lsp_begin_response(&writer, id);
+    json_write_raw(&writer, "null}");
+    lsp_send(&writer);
+    json_writer_free(&writer);
+}
+
+
+static void lsp_respond_method_not_found(JsonValue *id) {
+    JsonWriter writer;
+    json_writer_init(&writer);
+    json_write_raw(&writer, "{\"jsonrpc\":\"2.0\",\"id\":");
+    json_write_value(&writer, id);
+    json_write_raw(&writer, ",\"error\":{\"code\":");
+    json_write_integer(&writer, LSP_METHOD_NOT_FOUND);
+    json_write_raw(&writer, ",\"message\":\"Method not found\"}}");
+    lsp_send(&writer);
+    json_writer_free(&writer);
+}
+
+
+static void lsp_dispatch(LanguageServer *server, JsonValue *message) {
+    JsonValue *method = json_get_string(message, "method");
+    JsonValue *id = json_get(message, "id");
+    JsonValue *params = json_get(message, "params");
+
+    if (method == NULL) {
+        return;
+    }
+
+    const char *name = method->string.chars;
+
+    if (strcmp(name, "initialize") == 0) {
+        lsp_initialize(server, id, params);
+    } else if (strcmp(name, "shutdown") == 0) {
+        server->shutdown_requested = true;
+        lsp_respond_null(id);
+    } else if (strcmp(name, "exit") == 0) {
+        server->running = false;
+    } else if (strcmp(name, "textDocument/didOpen") == 0) {
+        lsp_did_open(server, params);
+    } else if (strcmp(name, "textDocument/didChange") == 0) {
+        lsp_did_change(server, params);
+    } else if (strcmp(name, "textDocument/didClose") == 0) {
+        lsp_did_close(server, params);
+    } else if (strcmp(name, "textDocument/documentSymbol") == 0) {
+        lsp_document_symbol(server, id, params);
+    } else if (strcmp(name, "textDocument/definition") == 0) {
+        lsp_definition(server, id, params);
+    } else if (id != NULL) {
+        // Notifications the server does not handle are ignored,
+        // requests must be answered.
+        lsp_respond_method_not_found(id);
+    }
+}
+
+
+// @see server.h
+extern i32 lsp_run(void) {
+    LanguageServer server = {
+        .documents = NULL,
+        .encoding = DOCUMENT_UTF16,
+        .shutdown_requested = false,
+        .running = true
+    };
+
+    while (server.running) {
+        JsonValue *message = lsp_read_message();
+        if (message == NULL) {
+            break;
+        }
+        lsp_dispatch(&server, message);
+        json_free(message);
+    }
+
+    while (server.documents != NULL) {
+        OpenDocument *next = server.documents->next;
+        document_free(&server.documents->document);
+        free(server.documents->uri);
+        free(server.documents);
+        server.documents = next;
+    }
+
+    return server.shutdown_requested ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "../util_types.h"
+
+
+/**
+ * Run a language server speaking JSON-RPC over stdin and stdout until
+ * the client sends `exit`. Supports incremental document sync,
+ * diagnostics, document symbols and go-to-definition.
+ *
+ * Positions are exchanged as byte offsets within a line: the server
+ * announces the `utf-8` position encoding.
+ *
+ * @return The process exit code.
+ */
+extern i32 lsp_run(void);
+
+
+#endif
@@ -1,89 +1,484 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "util_types.h"
 #include "lisp/error.h"
 #include "lexer/token.h"
 #include "lexer/lexer.h"
 #include "parser/parser.h"
+#include "repl/reader.h"
+#include "lsp/server.h"
+#include "dump/dump.h"
+#include "module/module.h"
+#include "serve/serve.h"
+#include "compiler/compiler.h"
+#include "vm/vm.h"
+#include "vm/governor.h"
+#include "trace/trace.h"
+#include "runtime/vector_kernels.h"
+#include "runtime/symbol.h"
+#include "runtime/printer.h"
 
-#define MAX_LINE_LENGTH 0x400
-
-
-static void next_line(char *buffer, char *prompt, size_t *out_length) {
-    printf("%s > ", prompt);
-
-    u16 number_read = 0;
-
-    int ch;
-    while ((ch = getchar()) != EOF && ch != '\n') {
-        if (number_read == MAX_LINE_LENGTH - 1) {
-            goto terminate_string;
-        }
-        buffer[number_read++] = ch;
+/**
+ * Print `error`, prefixed with the file it occurred in if there is one,
+ * and free it.
+ */
+static void report_error_in(const char *file_name, LispError *error) {
+    if (file_name != NULL) {
+        fprintf(stderr, "%s:", file_name);
     }
 
-terminate_string:
-    *out_length = number_read;
-    buffer[number_read] = (char) 0;
-}
-
-
-static void report_error(LispError *error) {
     switch (error->type) {
-        case LISP_INTERNAL_ERROR: {
-            fprintf(stderr, "\x1b[31merror:\x1b[0m %s\n", error->message);
+        case LISP_INTERNAL_ERROR:
+        case LISP_RUNTIME_ERROR:
+        case LISP_RESOURCE_ERROR: {
+            fprintf(stderr, "%s\x1b[31merror:\x1b[0m %s\n", file_name != NULL ? " " : "", error->message);
             break;
         }
         case LISP_LEXER_ERROR: {
             fprintf(stderr, "%u:%u: \x1b[31merror:\x1b[0m %s\n", 
-                error->lexer_error.line, 
-                error->lexer_error.column,
+                error->lexer_error.position.line, 
+                error->lexer_error.position.column,
                 error->message);
             break;
         }
         case LISP_PARSER_ERROR: {
             fprintf(stderr, "%u:%u: \x1b[31merror:\x1b[0m %s\n", 
-                error->parser_error.line, 
-                error->parser_error.column,
+                error->parser_error.position.line, 
+                error->parser_error.position.column,
                 error->message);
             break;
         }
     }
-    free(error);
+    lisp_error_free(error);
 }
 
 
-static void run_repl(void) {
-    char buffer[MAX_LINE_LENGTH];
-    size_t line_length = 0;
-    while (1) {
-        next_line(buffer, "lisp", &line_length);
-        if (strncmp(buffer, ".quit", sizeof(".quit")) == 0) {
-            break;
+static void report_error(LispError *error) {
+    report_error_in(NULL, error);
+}
+
+
+typedef struct {
+    bool lsp;
+    // Whether to run the program rather than dump it.
+    bool run;
+    bool dump_tokens;
+    bool dump_ast;
+    DumpFormat dump_format;
+    // The file to read, or NULL to read forms from standard input.
+    char *file_name;
+    // Directories to search for imported modules.
+    char **module_paths;
+    u32 module_path_count;
+    // Whether to bypass the compiled module cache.
+    bool no_cache;
+    // The socket to serve requests on, or to forward this one to.
+    char *serve_path;
+    char *connect_path;
+    // The limits of each evaluation: of the whole program when running a
+    // file, or of each form in the REPL.
+    GovernorLimits limits;
+    // The file the trace is written to on exit, or NULL to only write it
+    // on a signal or a crash, to a file in the temporary directory.
+    char *trace_path;
+    // Whether the trace records every call and return, which slows calls.
+    bool trace_calls;
+} Options;
+
+
+static void print_usage(char *program) {
+    fprintf(stderr, 
+        "usage: %s [--lsp] [--run] [--dump-tokens] [--dump-ast] [--dump-format=text|binary]\n"
+        "          [--module-path=DIRECTORY]... [--no-cache] [--max-instructions=COUNT]\n"
+        "          [--max-heap=BYTES] [--max-depth=FRAMES] [--timeout=MILLISECONDS]\n"
+        "          [--trace-out=FILE] [--trace-calls] [file]\n"
+        "       %s --serve SOCKET\n"
+        "       %s --connect SOCKET [option]... [file]\n",
+        program, program, program);
+}
+
+
+/**
+ * Parse the value of the option `name`, if `argument` is that option.
+ *
+ * @param valid Cleared if the value is not a number.
+ * @return Whether `argument` is the option `name`.
+ */
+static bool parse_number_option(char *argument, const char *name, u64 *value, bool *valid) {
+    size_t length = strlen(name);
+    if (strncmp(argument, name, length) != 0) {
+        return false;
+    }
+
+    char *end;
+    unsigned long long number = strtoull(&argument[length], &end, 10);
+    if (argument[length] < '0' || argument[length] > '9' || *end != '\0') {
+        *valid = false;
+    }
+    *value = (u64) number;
+    return true;
+}
+
+
+/**
+ * Parse the command line into `options`.
+ * 
+ * @return Whether the command line was valid.
+ */
+static bool parse_options(i32 argc, char *argv[], Options *options) {
+    *options = (Options) { .dump_format = DUMP_TEXT };
+    options->module_paths = (char **) malloc(argc * sizeof(char *));
+    bool valid = true;
+    u64 stack_depth = 0;
+
+    for (i32 i = 1; i < argc; ++i) {
+        char *argument = argv[i];
+        if (parse_number_option(argument, "--max-instructions=", &options->limits.instructions, &valid)
+                || parse_number_option(argument, "--max-heap=", &options->limits.heap_bytes, &valid)
+                || parse_number_option(argument, "--max-depth=", &stack_depth, &valid)
+                || parse_number_option(argument, "--timeout=", &options->limits.milliseconds, &valid)) {
+            continue;
+        } else if (strcmp(argument, "--lsp") == 0) {
+            options->lsp = true;
+        } else if (strcmp(argument, "--run") == 0) {
+            options->run = true;
+        } else if (strcmp(argument, "--dump-tokens") == 0) {
+            options->dump_tokens = true;
+        } else if (strcmp(argument, "--dump-ast") == 0) {
+            options->dump_ast = true;
+        } else if (strcmp(argument, "--dump-format=text") == 0) {
+            options->dump_format = DUMP_TEXT;
+        } else if (strcmp(argument, "--dump-format=binary") == 0) {
+            options->dump_format = DUMP_BINARY;
+        } else if (strncmp(argument, "--module-path=", strlen("--module-path=")) == 0) {
+            options->module_paths[options->module_path_count++] = &argument[strlen("--module-path=")];
+        } else if (strncmp(argument, "--trace-out=", strlen("--trace-out=")) == 0) {
+            options->trace_path = &argument[strlen("--trace-out=")];
+        } else if (strcmp(argument, "--trace-calls") == 0) {
+            options->trace_calls = true;
+        } else if (strcmp(argument, "--no-cache") == 0) {
+            options->no_cache = true;
+        } else if (strcmp(argument, "--serve") == 0 && i + 1 < argc) {
+            options->serve_path = argv[++i];
+        } else if (strcmp(argument, "--connect") == 0 && i + 1 < argc) {
+            options->connect_path = argv[++i];
+        } else if (argument[0] == '-' || options->file_name != NULL) {
+            return false;
+        } else {
+            options->file_name = argument;
+        }
+    }
+
+    if (!valid || stack_depth > UINT32_MAX) {
+        return false;
+    }
+    options->limits.stack_depth = (u32) stack_depth;
+
+    // Without any dump options every token is shown, as it always has been.
+    if (!options->dump_tokens && !options->dump_ast) {
+        options->dump_tokens = true;
+    }
+
+    return true;
+}
+
+
+/**
+ * Dump one form as requested by `options`.
+ */
+static void dump_form(DumpBuffer *buffer, TokenList *tokens, Options *options) {
+    if (options->dump_tokens) {
+        dump_tokens(buffer, tokens, options->dump_format);
+    }
+
+    AstResult parser_result = parser_build_ast(tokens);
+    if (parser_result.failed) {
+        // Only report syntax errors when the tree was asked for.
+        if (options->dump_ast) {
+            dump_buffer_flush(buffer);
+            report_error_in(tokens->file_name, parser_result.error);
+        } else {
+            lisp_error_free(parser_result.error);
         }
+        return;
+    }
+
+    if (options->dump_ast) {
+        dump_ast(buffer, tokens, parser_result.ast, options->dump_format);
+    }
+    ast_free(parser_result.ast);
+}
+
+
+/**
+ * Compile and run one form.
+ *
+ * @return The value of its last form.
+ */
+static ValueResult run_form(TokenList *tokens) {
+    AstResult parser_result = parser_build_ast(tokens);
+    if (parser_result.failed) {
+        ValueResult result = { .failed = true, .error = parser_result.error };
+        return result;
+    }
+
+    CompileResult compile_result = compiler_compile(tokens, parser_result.ast);
+    ast_free(parser_result.ast);
+    if (compile_result.failed) {
+        ValueResult result = { .failed = true, .error = compile_result.error };
+        return result;
+    }
+    return vm_run(compile_result.function);
+}
+
+
+/**
+ * Append `module` to `order` after the modules it imports, unless it has
+ * been `seen` already. `seen` is indexed like `loader->modules`.
+ */
+static void order_modules(ModuleLoader *loader, Module *module, Module **order, u32 *count, bool *seen) {
+    u32 index = 0;
+    while (loader->modules[index] != module) {
+        index++;
+    }
+    if (seen[index]) {
+        return;
+    }
+    seen[index] = true;
+
+    for (u32 i = 0; i < module->import_count; ++i) {
+        order_modules(loader, module->imports[i], order, count, seen);
+    }
+    order[(*count)++] = module;
+}
+
 
-        TokenListResult lexer_result = lexer_tokenize(buffer, line_length);
+/**
+ * Run every module of the program, imported modules before their
+ * importers, and then call its `Main` function, if it defines one.
+ */
+static i32 run_program(ModuleLoader *loader, Options *options) {
+    governor_begin(&options->limits);
+
+    Module **order = (Module **) malloc(loader->module_count * sizeof(Module *));
+    bool *seen = (bool *) calloc(loader->module_count, sizeof(bool));
+    u32 count = 0;
+    order_modules(loader, loader->modules[0], order, &count, seen);
+    free(seen);
+
+    i32 status = 0;
+    for (u32 i = 0; i < count && status == 0; ++i) {
+        ValueResult result = vm_run(order[i]->function);
+        if (result.failed) {
+            fflush(stdout);
+            report_error_in(order[i]->path, result.error);
+            status = 1;
+        }
+    }
+    free(order);
+
+    LispValue main_function;
+    if (status == 0 && vm_find_global(symbol_intern("Main", strlen("Main")), &main_function)) {
+        ValueResult result = vm_apply(main_function, NULL, 0);
+        if (result.failed) {
+            fflush(stdout);
+            report_error_in(loader->modules[0]->path, result.error);
+            status = 1;
+        }
+    }
+
+    // The limits are lifted whether or not the program failed.
+    LispError *error = governor_finish();
+    if (status != 0) {
+        lisp_error_free(error);
+    } else if (error != NULL) {
+        fflush(stdout);
+        report_error_in(loader->modules[0]->path, error);
+        status = 1;
+    }
+
+    fflush(stdout);
+    return status;
+}
+
+
+/**
+ * Load the program in `options->file_name` and the modules it imports,
+ * and run it, or dump each of them, imported modules after their
+ * importers.
+ */
+static i32 run_file(Options *options) {
+    ModuleLoader loader;
+    module_loader_init(&loader);
+    for (u32 i = 0; i < options->module_path_count; ++i) {
+        module_loader_add_search_path(&loader, options->module_paths[i]);
+    }
+    if (options->no_cache) {
+        free(loader.cache_directory);
+        loader.cache_directory = NULL;
+    }
+    loader.compile = options->run;
+
+    ModuleResult result = module_loader_load(&loader, options->file_name);
+    if (result.failed) {
+        char *file_name = result.failed_module != NULL ? result.failed_module->path : options->file_name;
+        report_error_in(file_name, result.error);
+        if (result.failed_module != NULL) {
+            result.failed_module->error = NULL;
+        }
+        module_loader_free(&loader);
+        return 1;
+    }
+
+    i32 status = 0;
+    if (options->run) {
+        status = run_program(&loader, options);
+    } else {
+        DumpBuffer buffer;
+        dump_buffer_init(&buffer, stdout);
+        for (u32 i = 0; i < loader.module_count; ++i) {
+            dump_form(&buffer, loader.modules[i]->tokens, options);
+        }
+        dump_buffer_free(&buffer);
+    }
+
+    module_loader_free(&loader);
+    return status;
+}
+
+
+/**
+ * Run one form read by the REPL and print its value.
+ */
+static void run_repl_form(TokenList *tokens, Options *options) {
+    // String literals refer to the source code, which the reader reuses
+    // for the next form, so the form keeps a copy of its own.
+    if (tokens->count > 0) {
+        LispToken *last = &tokens->tokens[tokens->count - 1];
+        size_t length = last->offset + last->length;
+        char *source = (char *) malloc(length + 1);
+        memcpy(source, tokens->source, length);
+        tokens->source = source;
+    }
+
+    governor_begin(&options->limits);
+    ValueResult result = run_form(tokens);
+    LispError *error = governor_finish();
+    if (result.failed) {
+        lisp_error_free(error);
+    } else if (error != NULL) {
+        result = (ValueResult) { .failed = true, .error = error };
+    }
+    if (result.failed) {
+        fflush(stdout);
+        report_error(result.error);
+        return;
+    }
+    printer_write(stdout, result.value, true);
+    putchar('\n');
+}
+
+
+static void run_repl(Options *options) {
+    Reader reader;
+    reader_init(&reader, STDIN_FILENO);
+
+    DumpBuffer buffer;
+    dump_buffer_init(&buffer, stdout);
+
+    while (1) {
+        TokenListResult lexer_result = reader_next_form(&reader, "lisp");
         if (lexer_result.failed) {
             report_error(lexer_result.error);
             continue;
         }
+        if (lexer_result.tokens == NULL) {
+            break;
+        }
+
         TokenList *tokens = lexer_result.tokens;
-        parser_build_ast(tokens);
-        while (tokens != NULL) {
-            TokenList *next = tokens->next;
-            char *repr = token_to_string(tokens->token);
-            puts(repr);
-            free(repr);
-            free(tokens->token);
-            free(tokens);
-            tokens = next;
+        if (options->run) {
+            run_repl_form(tokens, options);
+        } else {
+            dump_form(&buffer, tokens, options);
+        }
+        token_list_free(tokens);
+
+        // Only hold output back across forms when nobody is waiting for it.
+        if (reader.interactive) {
+            dump_buffer_flush(&buffer);
+            fflush(stdout);
+        }
+    }
+
+    dump_buffer_free(&buffer);
+    reader_free(&reader);
+}
+
+/**
+ * Do everything that does not depend on the request before serving any,
+ * so that each forked request starts with it done.
+ */
+static void warm_up(void) {
+    lexer_initialize_keywords();
+    vector_kernels();
+}
+
+
+/**
+ * Send the command line, without its `--connect` option, to a server.
+ */
+static i32 run_forwarded(i32 argc, char *argv[], Options *options) {
+    char **forwarded = (char **) malloc(argc * sizeof(char *));
+    i32 count = 0;
+    for (i32 i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc && argv[i + 1] == options->connect_path) {
+            i++;
+        } else {
+            forwarded[count++] = argv[i];
         }
     }
+
+    i32 status = serve_forward(options->connect_path, count, forwarded);
+    free(forwarded);
+    return status;
+}
+
+
+/**
+ * Run the command line `argv`, either for this process or for a request
+ * to the server.
+ */
+static i32 run(i32 argc, char *argv[]) {
+    Options options;
+    if (!parse_options(argc, argv, &options)) {
+        print_usage(argv[0]);
+        free(options.module_paths);
+        return 1;
+    }
+    trace_initialize(options.trace_path, options.trace_calls);
+
+    i32 status = 0;
+    if (options.serve_path != NULL) {
+        warm_up();
+        status = serve_run(options.serve_path, run);
+    } else if (options.connect_path != NULL) {
+        status = run_forwarded(argc, argv, &options);
+    } else if (options.lsp) {
+        status = lsp_run();
+    } else if (options.file_name != NULL) {
+        status = run_file(&options);
+    } else {
+        run_repl(&options);
+    }
+
+    free(options.module_paths);
+    return status;
 }
 
 i32 main(i32 argc, char *argv[]) {
-    (void) argv[argc * 0];
-    run_repl();
-}
\ No newline at end of file
+    return run(argc, argv);
+}
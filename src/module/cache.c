@@ -0,0 +1,786 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+#include "../lisp/version.h"
+#include "../dump/dump.h"
+#include "../runtime/bignum.h"
+#include "../runtime/symbol.h"
+#include "../runtime/lisp_string.h"
+#include "build_id.h"
+
+
+/**
+ * The kinds of constant of a compiled function in a cache file.
+ */
+typedef enum {
+    // A fixnum, `nil`, `true` or `false`, written as the value itself.
+    MODULE_CACHE_IMMEDIATE,
+    // The eight bytes of a double.
+    MODULE_CACHE_FLOAT,
+    MODULE_CACHE_BIGNUM,
+    MODULE_CACHE_SYMBOL,
+    MODULE_CACHE_STRING,
+    MODULE_CACHE_FUNCTION
+} ModuleCacheConstant;
+
+
+/**
+ * What the code of a cached function requires of the closures it runs
+ * in, and how the rest of the module runs it, gathered while checking
+ * the code.
+ */
+typedef struct {
+    // The captures of every closure made of the function, or -1 if none
+    // is made. The closures made of a function must all be alike.
+    i64 captures;
+    // The number of captures the function's code reads.
+    u32 captures_read;
+    // Whether the code reads the closure it runs in, and whether the
+    // function is ever run without one.
+    bool reads_closure;
+    bool runs_without_closure;
+} ModuleCacheUse;
+
+
+/**
+ * The functions of a compiled module, numbered in the order they are
+ * found from its top level, with a hash table from each function to its
+ * number.
+ */
+typedef struct {
+    LispFunction **functions;
+    u32 count;
+    u32 capacity;
+    // Each slot is 0 if empty, or a function's number plus one.
+    u32 *slots;
+    u32 slot_count;
+} ModuleCacheFunctions;
+
+
+static char *module_cache_join(const char *directory, const char *name) {
+    size_t length = strlen(directory) + strlen(name) + 2;
+    char *path = (char *) malloc(length);
+    snprintf(path, length, "%s/%s", directory, name);
+    return path;
+}
+
+
+/**
+ * Get the path of the cache file for `key`.
+ */
+static char *module_cache_path(const char *directory, u64 key) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 ".lmod", key);
+    return module_cache_join(directory, name);
+}
+
+
+/**
+ * Create `directory` and any missing parents.
+ */
+static bool module_cache_create_directory(const char *directory) {
+    char *path = strdup(directory);
+    bool created = true;
+
+    for (char *cursor = path + 1; created; ++cursor) {
+        bool end = *cursor == '\0';
+        if (*cursor == '/' || end) {
+            *cursor = '\0';
+            created = mkdir(path, 0755) == 0 || errno == EEXIST;
+            *cursor = '/';
+        }
+        if (end) {
+            break;
+        }
+    }
+
+    free(path);
+    return created;
+}
+
+
+// @see cache.h
+extern char *module_cache_default_directory(void) {
+    const char *directory = getenv("MYLISP_CACHE_DIR");
+    if (directory != NULL && *directory != '\0') {
+        return strdup(directory);
+    }
+
+    directory = getenv("XDG_CACHE_HOME");
+    if (directory != NULL && *directory != '\0') {
+        return module_cache_join(directory, "mylisp");
+    }
+
+    directory = getenv("HOME");
+    if (directory != NULL && *directory != '\0') {
+        return module_cache_join(directory, ".cache/mylisp");
+    }
+
+    return NULL;
+}
+
+
+inline static u64 module_cache_hash(u64 hash, const char *bytes, size_t length) {
+    // FNV-1a
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (u8) bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+
+// @see cache.h
+extern u64 module_cache_key(const char *source, size_t source_length) {
+    // The fingerprint of the build, each part with its terminator, then
+    // the source.
+    static const char fingerprint[] = LISP_VERSION "\0" LISP_BUILD_ID;
+    u32 versions[] = { BYTECODE_VERSION, MODULE_CACHE_FORMAT_VERSION };
+
+    u64 hash = 14695981039346656037ull;
+    hash = module_cache_hash(hash, fingerprint, sizeof(fingerprint));
+    hash = module_cache_hash(hash, (const char *) versions, sizeof(versions));
+    return module_cache_hash(hash, source, source_length);
+}
+
+
+inline static u32 module_cache_function_slot(ModuleCacheFunctions *table, LispFunction *function) {
+    return (u32) (value_hash(value_from_object(function)) & (table->slot_count - 1));
+}
+
+
+static void module_cache_functions_grow(ModuleCacheFunctions *table) {
+    free(table->slots);
+    table->slot_count = table->slot_count == 0 ? 0x40 : table->slot_count * 2;
+    table->slots = (u32 *) calloc(table->slot_count, sizeof(u32));
+    for (u32 i = 0; i < table->count; ++i) {
+        u32 slot = module_cache_function_slot(table, table->functions[i]);
+        while (table->slots[slot] != 0) {
+            slot = (slot + 1) & (table->slot_count - 1);
+        }
+        table->slots[slot] = i + 1;
+    }
+}
+
+
+/**
+ * Get the number of `function`, numbering it if it has not been seen.
+ */
+static u32 module_cache_function_index(ModuleCacheFunctions *table, LispFunction *function) {
+    if (2 * (table->count + 1) > table->slot_count) {
+        module_cache_functions_grow(table);
+    }
+
+    u32 slot = module_cache_function_slot(table, function);
+    while (table->slots[slot] != 0) {
+        if (table->functions[table->slots[slot] - 1] == function) {
+            return table->slots[slot] - 1;
+        }
+        slot = (slot + 1) & (table->slot_count - 1);
+    }
+
+    if (table->count == table->capacity) {
+        table->capacity = table->capacity == 0 ? 0x40 : table->capacity * 2;
+        table->functions = (LispFunction **) realloc(table->functions, table->capacity * sizeof(LispFunction *));
+    }
+    table->functions[table->count] = function;
+    table->slots[slot] = ++table->count;
+    return table->count - 1;
+}
+
+
+/**
+ * Number every function reachable from `function`, and check that all of
+ * their constants can be written: string literals must still refer to
+ * `source`.
+ */
+static bool module_cache_collect(ModuleCacheFunctions *table, LispFunction *function,
+        const char *source, size_t source_length) {
+    module_cache_function_index(table, function);
+
+    for (u32 i = 0; i < table->count; ++i) {
+        LispFunction *next = table->functions[i];
+        for (u32 j = 0; j < next->constant_count; ++j) {
+            LispValue constant = next->constants[j];
+            if (!value_is_object(constant)) {
+                continue;
+            }
+            switch (value_as_object(constant)->type) {
+                case LISP_OBJECT_FLOAT:
+                case LISP_OBJECT_BIGNUM:
+                case LISP_OBJECT_SYMBOL: break;
+                case LISP_OBJECT_STRING: {
+                    const char *bytes = value_string(constant)->bytes;
+                    if (bytes == NULL || bytes <= source || bytes >= source + source_length) {
+                        return false;
+                    }
+                    break;
+                }
+                case LISP_OBJECT_FUNCTION: {
+                    module_cache_function_index(table, value_function(constant));
+                    break;
+                }
+                default: return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+static void module_cache_write_text(DumpBuffer *buffer, const char *text, size_t length) {
+    dump_write_varint(buffer, length);
+    dump_write_bytes(buffer, text, length);
+}
+
+
+static void module_cache_write_constant(DumpBuffer *buffer, ModuleCacheFunctions *table,
+        LispValue constant, const char *source) {
+    if (!value_is_object(constant)) {
+        dump_write_varint(buffer, MODULE_CACHE_IMMEDIATE);
+        dump_write_varint(buffer, constant);
+        return;
+    }
+
+    switch (value_as_object(constant)->type) {
+        case LISP_OBJECT_FLOAT: {
+            double number = value_float(constant);
+            dump_write_varint(buffer, MODULE_CACHE_FLOAT);
+            dump_write_bytes(buffer, (const char *) &number, sizeof(number));
+            break;
+        }
+        case LISP_OBJECT_BIGNUM: {
+            char *digits = bignum_to_string(constant);
+            dump_write_varint(buffer, MODULE_CACHE_BIGNUM);
+            module_cache_write_text(buffer, digits, strlen(digits));
+            free(digits);
+            break;
+        }
+        case LISP_OBJECT_SYMBOL: {
+            LispSymbol *symbol = value_symbol(constant);
+            dump_write_varint(buffer, MODULE_CACHE_SYMBOL);
+            module_cache_write_text(buffer, symbol->name, symbol->length);
+            break;
+        }
+        case LISP_OBJECT_STRING: {
+            // The literal, with its quotes, around the bytes of the string.
+            LispString *string = value_string(constant);
+            dump_write_varint(buffer, MODULE_CACHE_STRING);
+            dump_write_varint(buffer, (u64) (string->bytes - 1 - source));
+            dump_write_varint(buffer, (u64) string->length + 2);
+            break;
+        }
+        default: {
+            dump_write_varint(buffer, MODULE_CACHE_FUNCTION);
+            dump_write_varint(buffer, module_cache_function_index(table, value_function(constant)));
+            break;
+        }
+    }
+}
+
+
+/**
+ * Write the compiled code of a module whose top level is `function`, or
+ * just a 0 if it has none or its constants cannot be written.
+ */
+static void module_cache_write_functions(DumpBuffer *buffer, LispFunction *function,
+        const char *source, size_t source_length) {
+    ModuleCacheFunctions table = { .functions = NULL };
+    if (function == NULL || !module_cache_collect(&table, function, source, source_length)) {
+        dump_write_varint(buffer, 0);
+        free(table.functions);
+        free(table.slots);
+        return;
+    }
+
+    dump_write_varint(buffer, table.count);
+    for (u32 i = 0; i < table.count; ++i) {
+        LispFunction *next = table.functions[i];
+        if (value_is_symbol(next->name)) {
+            LispSymbol *name = value_symbol(next->name);
+            module_cache_write_text(buffer, name->name, name->length);
+        } else {
+            // Names are never empty, so an empty one means `nil`.
+            dump_write_varint(buffer, 0);
+        }
+        dump_write_varint(buffer, next->parameter_count);
+        dump_write_varint(buffer, next->local_count);
+        dump_write_varint(buffer, next->stack_size);
+        dump_write_varint(buffer, next->cache_count);
+        module_cache_write_text(buffer, (const char *) next->code, next->code_length);
+        dump_write_varint(buffer, next->constant_count);
+        for (u32 j = 0; j < next->constant_count; ++j) {
+            module_cache_write_constant(buffer, &table, next->constants[j], source);
+        }
+    }
+
+    free(table.functions);
+    free(table.slots);
+}
+
+
+/**
+ * Read text written by `module_cache_write_text`.
+ *
+ * @return The text, which is not terminated, or `NULL` if it does not fit.
+ */
+static const char *module_cache_read_text(const u8 **cursor, const u8 *end, u64 *length) {
+    if (!dump_read_varint(cursor, end, length) || *length > (u64) (end - *cursor)) {
+        return NULL;
+    }
+    const char *text = (const char *) *cursor;
+    *cursor += *length;
+    return text;
+}
+
+
+static bool module_cache_read_u32(const u8 **cursor, const u8 *end, u32 *number) {
+    u64 value;
+    if (!dump_read_varint(cursor, end, &value) || value > UINT32_MAX) {
+        return false;
+    }
+    *number = (u32) value;
+    return true;
+}
+
+
+static bool module_cache_read_constant(const u8 **cursor, const u8 *end, LispFunction **functions,
+        u32 function_count, char *source, size_t source_length, LispValue *constant) {
+    u64 tag, number, length;
+    if (!dump_read_varint(cursor, end, &tag)) {
+        return false;
+    }
+
+    switch ((ModuleCacheConstant) tag) {
+        case MODULE_CACHE_IMMEDIATE: {
+            if (!dump_read_varint(cursor, end, &number) || value_is_object(number)) {
+                return false;
+            }
+            *constant = number;
+            return true;
+        }
+        case MODULE_CACHE_FLOAT: {
+            double value;
+            if ((size_t) (end - *cursor) < sizeof(value)) {
+                return false;
+            }
+            memcpy(&value, *cursor, sizeof(value));
+            *cursor += sizeof(value);
+            *constant = value_make_float(value);
+            return true;
+        }
+        case MODULE_CACHE_BIGNUM:
+        case MODULE_CACHE_SYMBOL: {
+            const char *text = module_cache_read_text(cursor, end, &length);
+            if (text == NULL || length == 0) {
+                return false;
+            }
+            for (u64 i = 0; i < length && tag == MODULE_CACHE_BIGNUM; ++i) {
+                if ((text[i] < '0' || text[i] > '9') && !(i == 0 && text[i] == '-' && length > 1)) {
+                    return false;
+                }
+            }
+            *constant = tag == MODULE_CACHE_BIGNUM ? bignum_from_string(text, length) : symbol_intern(text, length);
+            return true;
+        }
+        case MODULE_CACHE_STRING: {
+            if (!dump_read_varint(cursor, end, &number) || !dump_read_varint(cursor, end, &length)
+                    || length < 2 || number > source_length || length > source_length - number
+                    || source[number] != '"' || source[number + length - 1] != '"') {
+                return false;
+            }
+            *constant = string_from_literal(&source[number], (u32) length);
+            return true;
+        }
+        case MODULE_CACHE_FUNCTION: {
+            if (!dump_read_varint(cursor, end, &number) || number >= function_count) {
+                return false;
+            }
+            *constant = value_from_object(functions[number]);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**
+ * Get the function the constant `index` of `function` is, or `NULL` if
+ * there is no such constant or it is not a function.
+ */
+static LispFunction *module_cache_function_constant(LispFunction *function, u32 index) {
+    if (index >= function->constant_count || !value_is_function(function->constants[index])) {
+        return NULL;
+    }
+    return value_function(function->constants[index]);
+}
+
+
+/**
+ * Check the code of the function numbered `index`, which was read from a
+ * cache file and so may be anything: that every instruction and operand
+ * is within the code, every constant, local variable and inline cache
+ * exists, every jump lands on an instruction further on, the stack never
+ * drops below the function's locals, and that its deepest is exactly
+ * `stack_size`. What the code requires of other functions is gathered in
+ * `uses`, to be checked once every function has been.
+ *
+ * @return Whether the code can be run safely.
+ */
+static bool module_cache_check_code(ModuleCacheFunctions *table, ModuleCacheUse *uses, u32 index) {
+    LispFunction *function = table->functions[index];
+    u32 length = function->code_length;
+    const u8 *code = function->code;
+
+    // The height of the stack above the locals at each offset that is
+    // jumped to, or -1, and whether each offset starts an instruction.
+    i64 *heights = (i64 *) malloc((length + 1) * sizeof(i64));
+    bool *starts = (bool *) calloc(length + 1, sizeof(bool));
+    for (u32 i = 0; i <= length; ++i) {
+        heights[i] = -1;
+    }
+
+    // The height at the current instruction, or -1 if it is unreachable.
+    i64 height = 0;
+    i64 deepest = 0;
+    bool valid = true;
+    u32 offset = 0;
+    while (offset < length && valid) {
+        starts[offset] = true;
+        if (heights[offset] >= 0) {
+            valid = height < 0 || height == heights[offset];
+            height = heights[offset];
+        }
+
+        OpCode op = (OpCode) code[offset];
+        static const u8 operand_sizes[] = {
+            [OP_CONSTANT] = 2, [OP_LOCAL] = 2, [OP_SET_LOCAL] = 2, [OP_CAPTURED] = 2,
+            [OP_GLOBAL] = 4, [OP_DEFINE_GLOBAL] = 2, [OP_JUMP] = 4, [OP_JUMP_IF_FALSE] = 4,
+            [OP_CLOSURE] = 4, [OP_CALL] = 2, [OP_CALL_KNOWN] = 4, [OP_ADD] = 4, [OP_SUBTRACT] = 4,
+            [OP_MULTIPLY] = 4, [OP_DIVIDE] = 4, [OP_EQUAL] = 4, [OP_RETURN] = 0
+        };
+        if (!valid || op > OP_RETURN || length - offset - 1 < operand_sizes[op]) {
+            valid = false;
+            break;
+        }
+        const u8 *operands = &code[offset + 1];
+        u32 next = offset + 1 + operand_sizes[op];
+
+        // The values the instruction pops, and pushes.
+        i64 popped = 0;
+        i64 pushed = 1;
+        switch (op) {
+            case OP_CONSTANT: {
+                valid = bytecode_read_u16(operands) < function->constant_count;
+                break;
+            }
+            case OP_NIL:
+            case OP_TRUE:
+            case OP_FALSE: break;
+            case OP_LOCAL: {
+                valid = bytecode_read_u16(operands) < function->local_count;
+                break;
+            }
+            case OP_SET_LOCAL: {
+                valid = bytecode_read_u16(operands) < function->local_count;
+                popped = 1;
+                break;
+            }
+            case OP_CAPTURED: {
+                u32 capture = (u32) bytecode_read_u16(operands) + 1;
+                uses[index].reads_closure = true;
+                if (capture > uses[index].captures_read) {
+                    uses[index].captures_read = capture;
+                }
+                break;
+            }
+            case OP_SELF: {
+                uses[index].reads_closure = true;
+                break;
+            }
+            case OP_GLOBAL:
+            case OP_DEFINE_GLOBAL:
+            case OP_ADD:
+            case OP_SUBTRACT:
+            case OP_MULTIPLY:
+            case OP_DIVIDE:
+            case OP_EQUAL: {
+                u16 name = bytecode_read_u16(operands);
+                valid = name < function->constant_count && value_is_symbol(function->constants[name])
+                    && (op == OP_DEFINE_GLOBAL || bytecode_read_u16(operands + 2) < function->cache_count);
+                popped = op == OP_GLOBAL ? 0 : op == OP_DEFINE_GLOBAL ? 1 : 2;
+                break;
+            }
+            case OP_POP: {
+                popped = 1;
+                pushed = 0;
+                break;
+            }
+            case OP_JUMP:
+            case OP_JUMP_IF_FALSE: {
+                // Jumps only ever go forward, which is what bounds the
+                // instructions run between calls.
+                u32 target = bytecode_read_u32(operands);
+                popped = op == OP_JUMP_IF_FALSE ? 1 : 0;
+                pushed = 0;
+                i64 landing = height - popped;
+                if (target <= offset || target >= length) {
+                    valid = false;
+                } else if (height >= 0 && landing >= 0) {
+                    valid = heights[target] < 0 || heights[target] == landing;
+                    heights[target] = landing;
+                }
+                break;
+            }
+            case OP_CLOSURE: {
+                LispFunction *closed = module_cache_function_constant(function, bytecode_read_u16(operands));
+                u16 count = bytecode_read_u16(operands + 2);
+                valid = closed != NULL;
+                if (valid) {
+                    ModuleCacheUse *use = &uses[module_cache_function_index(table, closed)];
+                    valid = use->captures < 0 || use->captures == count;
+                    use->captures = count;
+                }
+                popped = count;
+                break;
+            }
+            case OP_CALL: {
+                popped = (i64) bytecode_read_u16(operands) + 1;
+                break;
+            }
+            case OP_CALL_KNOWN: {
+                LispFunction *called = module_cache_function_constant(function, bytecode_read_u16(operands));
+                u16 count = bytecode_read_u16(operands + 2);
+                valid = called != NULL && called->parameter_count == count;
+                if (valid) {
+                    uses[module_cache_function_index(table, called)].runs_without_closure = true;
+                }
+                popped = count;
+                break;
+            }
+            case OP_RETURN: {
+                popped = 1;
+                pushed = 0;
+                break;
+            }
+        }
+
+        if (height >= 0) {
+            valid = valid && height >= popped;
+            height += pushed - popped;
+            if (height > deepest) {
+                deepest = height;
+            }
+        }
+        // Nothing follows a jump or a return but what is jumped to.
+        if (op == OP_JUMP || op == OP_RETURN) {
+            height = -1;
+        }
+        offset = next;
+    }
+
+    // The code must not run off its end, and must land on instructions.
+    valid = valid && height < 0;
+    for (u32 i = 0; i < length && valid; ++i) {
+        valid = heights[i] < 0 || starts[i];
+    }
+    valid = valid && deepest == function->stack_size;
+
+    free(heights);
+    free(starts);
+    return valid;
+}
+
+
+/**
+ * Check the code of every function read from a cache file, numbered in
+ * `table` with the module's top level first.
+ *
+ * @return Whether the module can be run safely.
+ */
+static bool module_cache_check_functions(ModuleCacheFunctions *table) {
+    ModuleCacheUse *uses = (ModuleCacheUse *) calloc(table->count, sizeof(ModuleCacheUse));
+    for (u32 i = 0; i < table->count; ++i) {
+        uses[i].captures = -1;
+    }
+    // The top level is run without a closure.
+    uses[0].runs_without_closure = true;
+
+    bool valid = true;
+    for (u32 i = 0; i < table->count && valid; ++i) {
+        LispFunction *function = table->functions[i];
+        valid = function->parameter_count <= function->local_count
+            && function->local_count <= UINT16_MAX + 1
+            && module_cache_check_code(table, uses, i);
+    }
+    for (u32 i = 0; i < table->count && valid; ++i) {
+        ModuleCacheUse *use = &uses[i];
+        valid = !use->reads_closure || (!use->runs_without_closure && use->captures >= use->captures_read);
+    }
+
+    free(uses);
+    return valid;
+}
+
+
+/**
+ * Read the compiled code written by `module_cache_write_functions`.
+ *
+ * @return The module's top level, or `NULL` if it was not compiled or
+ * the code is malformed.
+ */
+static LispFunction *module_cache_read_functions(const u8 **cursor, const u8 *end,
+        char *source, size_t source_length) {
+    u64 count;
+    // Every function takes at least a byte for each of its fields.
+    if (!dump_read_varint(cursor, end, &count) || count == 0 || count > (u64) (end - *cursor)) {
+        return NULL;
+    }
+
+    LispFunction **functions = (LispFunction **) malloc(count * sizeof(LispFunction *));
+    for (u64 i = 0; i < count; ++i) {
+        functions[i] = value_allocate_object(LISP_OBJECT_FUNCTION, sizeof(LispFunction));
+    }
+
+    bool valid = true;
+    for (u64 i = 0; i < count && valid; ++i) {
+        LispFunction *function = functions[i];
+        u64 length;
+        const char *name = module_cache_read_text(cursor, end, &length);
+        valid = name != NULL
+            && module_cache_read_u32(cursor, end, &function->parameter_count)
+            && module_cache_read_u32(cursor, end, &function->local_count)
+            && module_cache_read_u32(cursor, end, &function->stack_size)
+            && module_cache_read_u32(cursor, end, &function->cache_count)
+            && function->cache_count <= UINT16_MAX + 1;
+        if (!valid) {
+            break;
+        }
+        function->name = length > 0 ? symbol_intern(name, length) : LISP_NIL;
+
+        u64 code_length;
+        const char *code = module_cache_read_text(cursor, end, &code_length);
+        valid = code != NULL && code_length > 0 && code_length <= UINT32_MAX
+            && module_cache_read_u32(cursor, end, &function->constant_count)
+            && function->constant_count <= (u64) (end - *cursor);
+        if (!valid) {
+            break;
+        }
+        function->code = (u8 *) malloc(code_length);
+        memcpy(function->code, code, code_length);
+        function->code_length = (u32) code_length;
+        function->caches = (GlobalCache *) calloc(function->cache_count, sizeof(GlobalCache));
+
+        function->constants = (LispValue *) malloc(function->constant_count * sizeof(LispValue));
+        for (u32 j = 0; j < function->constant_count && valid; ++j) {
+            valid = module_cache_read_constant(cursor, end, functions, (u32) count,
+                source, source_length, &function->constants[j]);
+        }
+    }
+
+    // Number the functions as they were written, to check their code.
+    ModuleCacheFunctions table = { .functions = NULL };
+    for (u64 i = 0; i < count && valid; ++i) {
+        valid = module_cache_function_index(&table, functions[i]) == i;
+    }
+    valid = valid && module_cache_check_functions(&table);
+
+    LispFunction *top_level = valid ? functions[0] : NULL;
+    free(table.functions);
+    free(table.slots);
+    free(functions);
+    return top_level;
+}
+
+
+// @see cache.h
+extern CachedModule module_cache_load(const char *directory, u64 key, char *source, size_t source_length) {
+    CachedModule cached = { .tokens = NULL, .function = NULL };
+    char *path = module_cache_path(directory, key);
+    int fd = open(path, O_RDONLY);
+    free(path);
+    if (fd < 0) {
+        return cached;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size == 0) {
+        close(fd);
+        return cached;
+    }
+
+    size_t length = (size_t) status.st_size;
+    void *data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return cached;
+    }
+
+    const u8 *cursor = (const u8 *) data;
+    const u8 *end = cursor + length;
+    size_t magic_length = sizeof(MODULE_CACHE_MAGIC) - 1;
+
+    u64 version, cached_length;
+    if (length >= magic_length && memcmp(cursor, MODULE_CACHE_MAGIC, magic_length) == 0) {
+        cursor += magic_length;
+        if (dump_read_varint(&cursor, end, &version) && version == MODULE_CACHE_FORMAT_VERSION
+                && dump_read_varint(&cursor, end, &cached_length) && cached_length == source_length) {
+            cached.tokens = dump_read_tokens(&cursor, end, source, source_length);
+        }
+        if (cached.tokens != NULL) {
+            cached.function = module_cache_read_functions(&cursor, end, source, source_length);
+        }
+    }
+
+    munmap(data, length);
+    return cached;
+}
+
+
+// @see cache.h
+extern bool module_cache_store(const char *directory, u64 key, TokenList *tokens, LispFunction *function,
+        const char *source, size_t source_length) {
+    if (!module_cache_create_directory(directory)) {
+        return false;
+    }
+
+    char *temporary = module_cache_join(directory, "module.XXXXXX");
+    int fd = mkstemp(temporary);
+    if (fd < 0) {
+        free(temporary);
+        return false;
+    }
+
+    FILE *file = fdopen(fd, "wb");
+    DumpBuffer buffer;
+    dump_buffer_init(&buffer, file);
+    dump_write_bytes(&buffer, MODULE_CACHE_MAGIC, sizeof(MODULE_CACHE_MAGIC) - 1);
+    dump_write_varint(&buffer, MODULE_CACHE_FORMAT_VERSION);
+    dump_write_varint(&buffer, source_length);
+    dump_tokens(&buffer, tokens, DUMP_BINARY);
+    module_cache_write_functions(&buffer, function, source, source_length);
+    dump_buffer_free(&buffer);
+
+    bool written = !ferror(file);
+    written = fclose(file) == 0 && written;
+
+    char *path = module_cache_path(directory, key);
+    bool stored = written && rename(temporary, path) == 0;
+    if (!stored) {
+        unlink(temporary);
+    }
+
+    free(path);
+    free(temporary);
+    return stored;
+}
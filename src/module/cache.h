@@ -0,0 +1,83 @@
+#ifndef CACHE_H
+#define CACHE_H
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../util_types.h"
+#include "../lexer/token.h"
+#include "../vm/bytecode.h"
+
+#define MODULE_CACHE_MAGIC "LMOD"
+#define MODULE_CACHE_FORMAT_VERSION 3
+
+
+/**
+ * The on-disk cache of compiled modules. A compiled module is stored in
+ * a file named after a hash of its source code and of the compiler that
+ * compiled it: `LISP_VERSION`, `BYTECODE_VERSION`, the format version,
+ * and `LISP_BUILD_ID`, a hash of the sources of the build. So an edited
+ * module, or one compiled by another build, simply misses the cache and
+ * nothing ever has to be invalidated.
+ *
+ * A cache file is the magic `LMOD`, then as varints the format version
+ * and the length of the source code, followed by the module's tokens in
+ * the binary dump format of `dump/dump.h`, and then its compiled code if
+ * it was compiled. Files are written under a temporary name and renamed
+ * into place, so concurrent writers and readers never see a partial file.
+ *
+ * The compiled code is a varint that is 0 if the module was not
+ * compiled, or else the number of functions, the module's top level
+ * first, followed by each function. A function is its name, its
+ * parameter, local variable, stack and inline cache counts, its code as
+ * a length and the bytes, and its constants as a count and each tagged
+ * with a `ModuleCacheConstant`. Names, symbols and bignums are written
+ * as a length and the bytes of their text, string literals as the
+ * offset and length of the literal in the source code, and functions as
+ * their index, so that a function can refer to itself.
+ *
+ * A cache file may have been damaged, so compiled code is checked
+ * before it is used, as thoroughly as the machine relies on it, and a
+ * module whose code fails the check is compiled again.
+ */
+
+
+typedef struct {
+    TokenList *tokens;
+    // The module's top level, or `NULL` if it was cached uncompiled.
+    LispFunction *function;
+} CachedModule;
+
+
+/**
+ * Get the directory to cache compiled modules in: `$MYLISP_CACHE_DIR`,
+ * `$XDG_CACHE_HOME/mylisp` or `$HOME/.cache/mylisp`.
+ *
+ * @return A heap allocated path, or `NULL` if none is configured.
+ */
+extern char *module_cache_default_directory(void);
+
+/**
+ * Compute the cache key of a module from its source code and the build.
+ */
+extern u64 module_cache_key(const char *source, size_t source_length);
+
+/**
+ * Look up a module in the cache.
+ *
+ * @return The module's tokens, which are `NULL` on a cache miss, and its
+ * top level if it was cached compiled.
+ */
+extern CachedModule module_cache_load(const char *directory, u64 key, char *source, size_t source_length);
+
+/**
+ * Store a module in the cache, along with its top level `function` unless
+ * it is `NULL`, creating the cache directory if needed. A function whose
+ * constants cannot be written is left out.
+ *
+ * @return Whether the module was stored.
+ */
+extern bool module_cache_store(const char *directory, u64 key, TokenList *tokens, LispFunction *function,
+    const char *source, size_t source_length);
+
+
+#endif
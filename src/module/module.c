@@ -0,0 +1,409 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "module.h"
+#include "cache.h"
+#include "../lexer/lexer.h"
+#include "../parser/parser.h"
+#include "../compiler/compiler.h"
+
+#define MODULE_EXTENSION ".lisp"
+
+
+static Module *module_create(char *path) {
+    Module *module = (Module *) calloc(1, sizeof(Module));
+    module->path = path;
+    return module;
+}
+
+
+static void module_free(Module *module) {
+    for (u32 i = 0; i < module->import_count && module->import_paths != NULL; ++i) {
+        free(module->import_paths[i]);
+    }
+    free(module->import_paths);
+    free(module->imports);
+    token_list_free(module->tokens);
+    free(module->source);
+    free(module->path);
+    free(module);
+}
+
+
+/**
+ * Read all of the file at `path` into a null-terminated buffer.
+ *
+ * @return The contents of the file, or `NULL` if it could not be read.
+ */
+static char *module_read_file(const char *path, size_t *length) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    size_t capacity = 0x10000;
+    char *contents = (char *) malloc(capacity);
+    *length = 0;
+
+    size_t count;
+    while ((count = fread(&contents[*length], 1, capacity - *length - 1, file)) > 0) {
+        *length += count;
+        if (capacity - *length == 1) {
+            capacity *= 2;
+            contents = (char *) realloc(contents, capacity);
+        }
+    }
+
+    bool failed = ferror(file);
+    fclose(file);
+    if (failed) {
+        free(contents);
+        return NULL;
+    }
+
+    contents[*length] = '\0';
+    return contents;
+}
+
+
+/**
+ * Get the absolute path of `name` in `directory`, if such a file exists.
+ */
+static char *module_find_file(const char *directory, size_t directory_length, const char *name) {
+    size_t length = directory_length + strlen(name) + 2;
+    char *candidate = (char *) malloc(length);
+    snprintf(candidate, length, "%.*s/%s", (int) directory_length, directory, name);
+
+    char *path = realpath(candidate, NULL);
+    free(candidate);
+    return path;
+}
+
+
+/**
+ * Resolve the module name of an import in `module` to the absolute path
+ * of its source file: first relative to the directory of `module`, then
+ * to each directory of the search path.
+ *
+ * @return The path, or `NULL` if there is no such module.
+ */
+static char *module_resolve(ModuleLoader *loader, Module *module, const char *name, size_t name_length) {
+    size_t extension_length = sizeof(MODULE_EXTENSION) - 1;
+    bool has_extension = name_length >= extension_length
+        && memcmp(&name[name_length - extension_length], MODULE_EXTENSION, extension_length) == 0;
+
+    char *file = (char *) malloc(name_length + extension_length + 1);
+    memcpy(file, name, name_length);
+    strcpy(&file[name_length], has_extension ? "" : MODULE_EXTENSION);
+
+    char *path = NULL;
+    if (file[0] == '/') {
+        path = realpath(file, NULL);
+    } else {
+        path = module_find_file(module->path, (size_t) (strrchr(module->path, '/') - module->path), file);
+        for (u32 i = 0; i < loader->search_path_count && path == NULL; ++i) {
+            path = module_find_file(loader->search_paths[i], strlen(loader->search_paths[i]), file);
+        }
+    }
+
+    free(file);
+    return path;
+}
+
+
+static LispError *module_import_error(Module *module, LispToken *token, const char *format, const char *name, size_t name_length) {
+    size_t length = strlen(format) + name_length + 1;
+    char *message = (char *) malloc(length);
+    snprintf(message, length, format, (int) name_length, name);
+    return lisp_parser_error(message, token_position(module->tokens, token));
+}
+
+
+/**
+ * Find the `(import name)` forms of `module` and resolve their names
+ * into `module->import_paths`.
+ */
+static LispError *module_find_imports(ModuleLoader *loader, Module *module) {
+    TokenList *tokens = module->tokens;
+    u32 capacity = 0;
+
+    for (u32 i = 0; i < tokens->count; ++i) {
+        LispToken *token = &tokens->tokens[i];
+        if (token->type != TOKEN_IMPORT) {
+            continue;
+        }
+
+        LispToken *name = &tokens->tokens[i + 1];
+        if (i == 0 || tokens->tokens[i - 1].type != TOKEN_LPAREN || i + 2 >= tokens->count
+                || (name->type != TOKEN_IDENTIFIER && name->type != TOKEN_STRING)
+                || tokens->tokens[i + 2].type != TOKEN_RPAREN) {
+            return lisp_parser_error("Expected (import name).", token_position(tokens, token));
+        }
+
+        // String names are written without their quotes.
+        const char *text = token_lexeme(tokens, name);
+        size_t length = name->length;
+        if (name->type == TOKEN_STRING) {
+            text++;
+            length -= 2;
+        }
+
+        char *path = module_resolve(loader, module, text, length);
+        if (path == NULL) {
+            return module_import_error(module, name, "Cannot find module '%.*s'.", text, length);
+        }
+
+        if (module->import_count == capacity) {
+            capacity = capacity == 0 ? 4 : capacity * 2;
+            module->import_paths = (char **) realloc(module->import_paths, capacity * sizeof(char *));
+        }
+        module->import_paths[module->import_count++] = path;
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Parse and compile the tokens of `module`.
+ */
+static LispError *module_compile_tokens(Module *module) {
+    AstResult parser_result = parser_build_ast(module->tokens);
+    if (parser_result.failed) {
+        return parser_result.error;
+    }
+
+    CompileResult compile_result = compiler_compile(module->tokens, parser_result.ast);
+    ast_free(parser_result.ast);
+    if (compile_result.failed) {
+        return compile_result.error;
+    }
+    module->function = compile_result.function;
+    return NULL;
+}
+
+
+/**
+ * Load a single module: read it, then take its tokens and compiled code
+ * from the cache, or scan and compile it and add it to the cache, and
+ * find its imports.
+ */
+static void module_compile(ModuleLoader *loader, Module *module) {
+    module->source = module_read_file(module->path, &module->source_length);
+    if (module->source == NULL) {
+        module->error = lisp_runtime_error("Could not read the file.");
+        return;
+    }
+
+    module->key = module_cache_key(module->source, module->source_length);
+
+    if (loader->cache_directory != NULL) {
+        CachedModule cached = module_cache_load(loader->cache_directory, module->key, module->source, module->source_length);
+        module->tokens = cached.tokens;
+        module->function = cached.function;
+        module->cached = module->tokens != NULL && (module->function != NULL || !loader->compile);
+    }
+
+    if (module->tokens == NULL) {
+        TokenListResult lexer_result = lexer_tokenize(module->source, module->source_length);
+        if (lexer_result.failed) {
+            module->error = lexer_result.error;
+            return;
+        }
+        module->tokens = lexer_result.tokens;
+    }
+
+    module->tokens->file_name = module->path;
+    module->error = module_find_imports(loader, module);
+    if (module->error == NULL && loader->compile && module->function == NULL) {
+        module->error = module_compile_tokens(module);
+    }
+
+    if (module->error == NULL && !module->cached && loader->cache_directory != NULL) {
+        module_cache_store(loader->cache_directory, module->key, module->tokens, module->function,
+            module->source, module->source_length);
+    }
+}
+
+
+/**
+ * Queue `module` to be loaded. Must be called with the loader locked.
+ */
+static void module_loader_append(ModuleLoader *loader, Module *module) {
+    if (loader->module_count == loader->module_capacity) {
+        loader->module_capacity = loader->module_capacity == 0 ? 0x10 : loader->module_capacity * 2;
+        loader->modules = (Module **) realloc(loader->modules, loader->module_capacity * sizeof(Module *));
+    }
+    loader->modules[loader->module_count++] = module;
+}
+
+
+/**
+ * Link the imports of a loaded module to their modules, queueing the
+ * ones not seen before. Must be called with the loader locked.
+ */
+static void module_loader_link(ModuleLoader *loader, Module *module) {
+    if (module->import_count == 0) {
+        return;
+    }
+
+    module->imports = (Module **) malloc(module->import_count * sizeof(Module *));
+
+    for (u32 i = 0; i < module->import_count; ++i) {
+        char *path = module->import_paths[i];
+        Module *imported = NULL;
+
+        for (u32 j = 0; j < loader->module_count && imported == NULL; ++j) {
+            if (strcmp(loader->modules[j]->path, path) == 0) {
+                imported = loader->modules[j];
+            }
+        }
+
+        if (imported == NULL) {
+            imported = module_create(path);
+            module_loader_append(loader, imported);
+        } else {
+            free(path);
+        }
+
+        module->imports[i] = imported;
+    }
+
+    free(module->import_paths);
+    module->import_paths = NULL;
+}
+
+
+/**
+ * Take modules off the queue and load them until the queue is empty and
+ * no other worker can add to it any more.
+ */
+static void *module_worker(void *argument) {
+    ModuleLoader *loader = (ModuleLoader *) argument;
+
+    pthread_mutex_lock(&loader->lock);
+
+    while (1) {
+        while (loader->next_module == loader->module_count && loader->active_workers > 0) {
+            pthread_cond_wait(&loader->changed, &loader->lock);
+        }
+        if (loader->next_module == loader->module_count) {
+            break;
+        }
+
+        Module *module = loader->modules[loader->next_module++];
+        loader->active_workers++;
+        pthread_mutex_unlock(&loader->lock);
+
+        module_compile(loader, module);
+
+        pthread_mutex_lock(&loader->lock);
+        if (module->error == NULL) {
+            module_loader_link(loader, module);
+        }
+        loader->active_workers--;
+        pthread_cond_broadcast(&loader->changed);
+    }
+
+    pthread_mutex_unlock(&loader->lock);
+    return NULL;
+}
+
+
+// @see module.h
+extern void module_loader_init(ModuleLoader *loader) {
+    *loader = (ModuleLoader) { .search_paths = NULL };
+    loader->cache_directory = module_cache_default_directory();
+
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    loader->thread_count = processors < 1 ? 1
+        : processors > MODULE_MAX_THREADS ? MODULE_MAX_THREADS : (u32) processors;
+
+    pthread_mutex_init(&loader->lock, NULL);
+    pthread_cond_init(&loader->changed, NULL);
+
+    const char *search_path = getenv("MYLISP_PATH");
+    while (search_path != NULL && *search_path != '\0') {
+        const char *separator = strchr(search_path, ':');
+        size_t length = separator != NULL ? (size_t) (separator - search_path) : strlen(search_path);
+        if (length > 0) {
+            char *directory = strndup(search_path, length);
+            module_loader_add_search_path(loader, directory);
+            free(directory);
+        }
+        search_path = separator != NULL ? separator + 1 : NULL;
+    }
+}
+
+
+// @see module.h
+extern void module_loader_add_search_path(ModuleLoader *loader, const char *directory) {
+    loader->search_paths = (char **) realloc(loader->search_paths, (loader->search_path_count + 1) * sizeof(char *));
+    loader->search_paths[loader->search_path_count++] = strdup(directory);
+}
+
+
+// @see module.h
+extern ModuleResult module_loader_load(ModuleLoader *loader, const char *path) {
+    ModuleResult result = { .failed = false, .module = NULL, .failed_module = NULL };
+
+    char *resolved = realpath(path, NULL);
+    if (resolved == NULL) {
+        result.failed = true;
+        result.error = lisp_runtime_error("Could not read the file.");
+        return result;
+    }
+
+    // The keyword table is shared by every thread.
+    lexer_initialize_keywords();
+
+    Module *main_module = module_create(resolved);
+    module_loader_append(loader, main_module);
+
+    pthread_t threads[MODULE_MAX_THREADS];
+    u32 started = 0;
+    for (u32 i = 1; i < loader->thread_count; ++i) {
+        if (pthread_create(&threads[started], NULL, module_worker, loader) == 0) {
+            started++;
+        }
+    }
+
+    module_worker(loader);
+    for (u32 i = 0; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (u32 i = 0; i < loader->module_count; ++i) {
+        if (loader->modules[i]->error != NULL) {
+            result.failed = true;
+            result.error = loader->modules[i]->error;
+            result.failed_module = loader->modules[i];
+            return result;
+        }
+    }
+
+    result.module = main_module;
+    return result;
+}
+
+
+// @see module.h
+extern void module_loader_free(ModuleLoader *loader) {
+    for (u32 i = 0; i < loader->module_count; ++i) {
+        module_free(loader->modules[i]);
+    }
+    free(loader->modules);
+
+    for (u32 i = 0; i < loader->search_path_count; ++i) {
+        free(loader->search_paths[i]);
+    }
+    free(loader->search_paths);
+    free(loader->cache_directory);
+
+    pthread_mutex_destroy(&loader->lock);
+    pthread_cond_destroy(&loader->changed);
+}
@@ -0,0 +1,107 @@
+#ifndef MODULE_H
+#define MODULE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "../util_types.h"
+#include "../lisp/error.h"
+#include "../lexer/token.h"
+#include "../vm/bytecode.h"
+
+// The most threads that compile modules at the same time.
+#define MODULE_MAX_THREADS 8
+
+
+/**
+ * A source file of a program. A module names the modules it depends on
+ * with `(import name)`, which refers to `name.lisp`, or `(import "path")`
+ * for a module in another directory, relative to the importing module's
+ * directory or to a directory on the search path.
+ */
+typedef struct Module {
+    // The absolute path of the source file, which identifies the module.
+    char *path;
+    char *source;
+    size_t source_length;
+    // The key of the module in the compilation cache.
+    u64 key;
+    // Whether the module was loaded from the cache rather than compiled.
+    bool cached;
+    TokenList *tokens;
+    // The compiled top level of the module, if the loader compiles.
+    LispFunction *function;
+    // Set if the module could not be loaded.
+    LispError *error;
+    struct Module **imports;
+    u32 import_count;
+    // The resolved paths of the imports, until they are linked to modules.
+    char **import_paths;
+} Module;
+
+
+typedef struct {
+    bool failed;
+    union {
+        Module *module;
+        LispError *error;
+    };
+    // The module that failed to load, if any.
+    Module *failed_module;
+} ModuleResult;
+
+
+/**
+ * Loads a program and everything it imports. Each module is read,
+ * looked up in the compilation cache and, on a miss, scanned, parsed and
+ * compiled by a pool of worker threads; modules are queued as their
+ * importers discover them, so independent imports are compiled in
+ * parallel. Every module is loaded once, however many modules import it.
+ */
+typedef struct {
+    char **search_paths;
+    u32 search_path_count;
+    // The cache directory, or `NULL` to compile every module.
+    char *cache_directory;
+    u32 thread_count;
+    // Whether modules are compiled, or only scanned.
+    bool compile;
+
+    // Every module discovered so far, in the order they were discovered.
+    Module **modules;
+    u32 module_count;
+    u32 module_capacity;
+
+    // The queue of modules to load is `modules[next_module..module_count)`.
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    u32 next_module;
+    u32 active_workers;
+} ModuleLoader;
+
+
+/**
+ * Create a loader using the default cache directory, and the directories
+ * in `$MYLISP_PATH`, separated by colons, as the search path.
+ */
+extern void module_loader_init(ModuleLoader *loader);
+
+/**
+ * Append `directory` to the search path.
+ */
+extern void module_loader_add_search_path(ModuleLoader *loader, const char *directory);
+
+/**
+ * Load the program whose main module is the file at `path`, along with
+ * every module it imports, directly or not. The modules are then in
+ * `loader->modules`, main module first.
+ */
+extern ModuleResult module_loader_load(ModuleLoader *loader, const char *path);
+
+/**
+ * Free `loader` and all of its modules.
+ */
+extern void module_loader_free(ModuleLoader *loader);
+
+
+#endif
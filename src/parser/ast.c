@@ -0,0 +1,36 @@
+#include <stdlib.h>
+
+#include "ast.h"
+
+
+// @see ast.h
+extern void ast_free(AstNode *node) {
+    if (node == NULL) {
+        return;
+    }
+
+    // The nodes whose children are still to be freed.
+    AstNode **pending = (AstNode **) malloc(16 * sizeof(AstNode *));
+    u32 count = 0;
+    u32 capacity = 16;
+    pending[count++] = node;
+
+    while (count > 0) {
+        AstNode *next = pending[--count];
+
+        if (count + next->child_count > capacity) {
+            while (count + next->child_count > capacity) {
+                capacity *= 2;
+            }
+            pending = (AstNode **) realloc(pending, capacity * sizeof(AstNode *));
+        }
+        for (u32 i = 0; i < next->child_count; ++i) {
+            pending[count++] = next->children[i];
+        }
+
+        free(next->children);
+        free(next);
+    }
+
+    free(pending);
+}
@@ -2,53 +2,60 @@
 #define AST_H
 
 #include "../lexer/token.h"
-
+#include "../runtime/value.h"
+
+/**
+ * The kinds of nodes, as named by the actions in `docs/grammar.txt`. The
+ * children of each kind of node are, in order:
+ * - Program: the top-level forms.
+ * - FunctionDefinition: the parameters, then the body.
+ * - LambdaExpression: the parameters, then the body.
+ * - FunctionCall: the function, then the arguments.
+ * - IfStatement: the condition, the consequent and the alternative.
+ * - VariableDeclaration: the initial value, if there is one.
+ * - Grouping: the expressions, in the order they are evaluated.
+ * - Import, Parameter, Identifier and Literal: none.
+ * - NoArguments: none. It is the `()` of a call with no arguments, which
+ *   is taken out of the call, so it is never part of a finished tree.
+ */
 typedef enum {
+    AST_PROGRAM,
     AST_FUNCTION_DEFINITION,
+    AST_PARAMETER,
     AST_FUNCTION_CALL,
     AST_IF_STATEMENT,
     AST_LAMBDA_EXPRESSION,
     AST_VARIABLE_DECLARATION,
+    AST_GROUPING,
+    AST_IMPORT,
     AST_LITERAL,
-    AST_IDENTIFIER
+    AST_IDENTIFIER,
+    AST_NO_ARGUMENTS
 } AstNodeType;
 
-struct AstNode;
-
-
-typedef struct {
-    LispToken *value;
-    union {
-        char *identifier_value;
-        char *string_value;
-        i64 int_value;
-        float float_value;
-        bool bool_value;
-    };
-} TerminalNode;
-
-
-typedef struct ParameterList {
-    TerminalNode *parameter_name;
-    struct ParameterList *next;
-} ParameterList;
-
-
-typedef struct {
-    LispToken *identifier;
-    ParameterList *first_parameter;
-    ParameterList *last_parameter;
-    struct AstNode *body;
-} FunctionDefinition;
+#define AST_NODE_TYPE_COUNT (AST_NO_ARGUMENTS + 1)
 
 
 typedef struct AstNode {
     AstNodeType type;
-    union {
-        FunctionDefinition function_definition;
-        ParameterList parameter_list;
-        TerminalNode terminal;
-    };
+    // The token the node is located at: the name of a definition,
+    // declaration, parameter or import, or otherwise its first token.
+    LispToken *token;
+    // The value of a literal, except that string literals are `nil`: the
+    // compiler makes each with `string_from_literal`, which refers to the
+    // lexeme in the source code rather than copying it, and leaves its
+    // escapes to be processed once the bytes are needed.
+    LispValue value;
+    u32 child_count;
+    struct AstNode **children;
 } AstNode;
 
-#endif
\ No newline at end of file
+
+/**
+ * Free `node` and all of its children. Tokens referenced by the tree
+ * belong to the token list and are not freed. Trees of any depth can be
+ * freed, since this does not recurse.
+ */
+extern void ast_free(AstNode *node);
+
+#endif
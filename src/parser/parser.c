@@ -3,202 +3,276 @@
 #include <string.h>
 
 #include "../util_types.h"
+#include "../util_array.h"
 #include "../lexer/token.h"
+#include "../runtime/number.h"
+#include "../trace/trace.h"
 #include "ast.h"
 #include "parser.h"
 
+// Set on a symbol of a production that locates the node being built at
+// the token it starts at.
+#define PARSER_CAPTURE 0x8000
 
-typedef struct Parser {
-    TokenList *token_stream;
-} Parser;
+// The node type of a nonterminal that does not build a node.
+#define PARSER_NO_NODE -1
 
 
 typedef struct {
-    bool failed;
-    union {
-        LispError *error;
-        AstNode *node;
-    };
-} ParseResult;
+    // The type of node a match of the nonterminal builds, or `PARSER_NO_NODE`.
+    i32 node_type;
+    // Whether a match with a single child is that child rather than a node.
+    bool collapse;
+    // The error when the next token cannot start the nonterminal.
+    const char *error;
+} ParserNonterminal;
 
 
-static LispToken *parser_advance(Parser *parser) {
-    if (parser->token_stream == NULL) {
-        return NULL;
-    }
-    LispToken *token = parser->token_stream->token;
-    parser->token_stream = parser->token_stream->next;
-    return token;
-}
+typedef struct {
+    // The index of the first symbol in `parser_symbols`.
+    u16 first;
+    u16 length;
+} ParserProduction;
+
+
+/**
+ * The tables generated from `docs/grammar.txt`:
+ * - `parser_nonterminals`, indexed by nonterminal.
+ * - `parser_productions`, with the symbols of each production at
+ *   `parser_symbols[first..first + length)`, last symbol first.
+ * - `parser_table`, the production to expand for a nonterminal and the
+ *   type of the next token, or 0 if the token cannot come next.
+ * - `parser_terminal_errors`, the error when a token is missing.
+ *
+ * Symbols below `PARSER_NONTERMINAL_BASE` are token types, which match
+ * themselves. A nonterminal `n` is `PARSER_NONTERMINAL_BASE + n`, and on
+ * the parser's stack, `PARSER_ACTION_BASE + n` marks the end of a match
+ * of `n` that builds a node.
+ */
+#include "parse_table.h"
+
+
+/**
+ * A node being built: the match of a nonterminal with an action that has
+ * not ended yet.
+ */
+typedef struct {
+    u16 nonterminal;
+    // Where the node's children start on the value stack.
+    u32 value_base;
+    LispToken *token;
+} ParserFrame;
 
 
-static bool parser_has_next(Parser *parser) {
-    return parser->token_stream != NULL;
-}
+typedef struct Parser {
+    TokenList *token_stream;
+    // The index of the next token in `token_stream`.
+    u32 position;
+
+    // The symbols still to be matched, the next one last.
+    u16 *symbols;
+    u32 symbol_count;
+    u32 symbol_capacity;
+
+    // The nodes built so far that have no parent yet.
+    AstNode **values;
+    u32 value_count;
+    u32 value_capacity;
+
+    ParserFrame *frames;
+    u32 frame_count;
+    u32 frame_capacity;
+} Parser;
 
 
-static LispToken *parser_peek(Parser *parser) {
-    if (parser == NULL || parser->token_stream == NULL) {
-        return NULL;
-    }
-    return parser->token_stream->token;
+/**
+ * Create a parser error located at the next token, or at the end of the
+ * source code if there are no tokens left.
+ */
+static LispError *parser_error(Parser *parser, const char *message) {
+    TokenList *tokens = parser->token_stream;
+    u32 offset = parser->position < tokens->count
+        ? tokens->tokens[parser->position].offset
+        : (tokens->count > 0 ? tokens->tokens[tokens->count - 1].offset : 0);
+    return lisp_parser_error((char *) message, line_table_position(&tokens->lines, offset));
 }
 
 
-static ParseResult parser_parse_identifier(Parser *parser) {
-    ParseResult result = { .failed = false, .error = NULL };
-
-    LispToken *identifier = parser_advance(parser);
-    AstNode *node = calloc(1, sizeof(AstNode));
-
-    size_t identifier_length = identifier->end - identifier->begin;
-    node->type = AST_IDENTIFIER;
-    node->terminal.identifier_value = calloc(identifier_length + 1, sizeof(char));
-    strncpy(node->terminal.identifier_value, identifier->begin, identifier_length);
-
-    result.node = node;
-
-    return result;
+static void parser_finish_literal(Parser *parser, AstNode *node) {
+    LispToken *token = node->token;
+    switch (token->type) {
+        case TOKEN_INTEGER:
+        case TOKEN_FLOAT: {
+            node->value = number_from_literal(token_lexeme(parser->token_stream, token), token->length);
+            break;
+        }
+        case TOKEN_TRUE: node->value = LISP_TRUE; break;
+        case TOKEN_FALSE: node->value = LISP_FALSE; break;
+        default: node->value = LISP_NIL; break;
+    }
 }
 
 
-static ParseResult parser_parse_parameter(Parser *parser) {
-    ParseResult result = { .failed = false, .error = NULL };
-
-    if (!parser_has_next(parser) || parser_peek(parser)->type != TOKEN_IDENTIFIER) {
-        result.failed = true;
-        result.error = lisp_parser_error("Expected an identifier", 0, 0);
-        return result;
+/**
+ * Take the `()` out of a call with no arguments, leaving just the
+ * function.
+ */
+static void parser_finish_call(Parser *parser, AstNode *node) {
+    (void) parser;
+    AstNode *last = node->children[node->child_count - 1];
+    if (last->type == AST_NO_ARGUMENTS) {
+        ast_free(last);
+        node->child_count--;
     }
+}
 
-    result = parser_parse_identifier(parser);
-    if (result.failed) {
-        return result;
-    }
 
-    AstNode *node = result.node;
+/**
+ * What is done to each type of node once its children are built, if
+ * anything.
+ */
+static void (*const parser_finishers[AST_NODE_TYPE_COUNT])(Parser *parser, AstNode *node) = {
+    [AST_FUNCTION_CALL] = parser_finish_call,
+    [AST_LITERAL] = parser_finish_literal
+};
+
+
+/**
+ * Replace `production` by its symbols at the top of the symbol stack.
+ */
+inline static void parser_expand(Parser *parser, const ParserProduction *production) {
+    parser->symbols = array_reserve(parser->symbols, &parser->symbol_capacity,
+        parser->symbol_count, production->length, sizeof(u16));
+    memcpy(&parser->symbols[parser->symbol_count], &parser_symbols[production->first],
+        production->length * sizeof(u16));
+    parser->symbol_count += production->length;
+}
 
-    return result;
+
+/**
+ * Begin a node for the nonterminal `nonterminal`, starting at `token`.
+ */
+inline static void parser_open_node(Parser *parser, u16 nonterminal, LispToken *token) {
+    parser->symbols = array_reserve(parser->symbols, &parser->symbol_capacity,
+        parser->symbol_count, 1, sizeof(u16));
+    parser->symbols[parser->symbol_count++] = (u16) (PARSER_ACTION_BASE + nonterminal);
+
+    parser->frames = array_reserve(parser->frames, &parser->frame_capacity,
+        parser->frame_count, 1, sizeof(ParserFrame));
+    parser->frames[parser->frame_count++] = (ParserFrame) {
+        .nonterminal = nonterminal,
+        .value_base = parser->value_count,
+        .token = token
+    };
 }
 
 
-static ParseResult parser_parse_function_definition(Parser *parser) {
-    ParseResult result = { .failed = false, .error = NULL };
+/**
+ * End the innermost node, taking the nodes built since it began as its
+ * children.
+ */
+static void parser_close_node(Parser *parser) {
+    ParserFrame *frame = &parser->frames[--parser->frame_count];
+    const ParserNonterminal *nonterminal = &parser_nonterminals[frame->nonterminal];
+    u32 child_count = parser->value_count - frame->value_base;
 
-    if (!parser_has_next(parser) || parser_peek(parser)->type != TOKEN_IDENTIFIER) {
-        result.failed = true;
-        result.error = lisp_parser_error("Expected an identifier", 0, 0);
-        return result;
+    if (nonterminal->collapse && child_count == 1) {
+        return;
     }
 
-
     AstNode *node = (AstNode *) calloc(1, sizeof(AstNode));
-    LispToken *identifier = parser_advance(parser);
-    node->function_definition.identifier = identifier;
-
-    if (!parser_has_next(parser) || parser_peek(parser)->type != TOKEN_LPAREN) {
-        result.failed = true;
-        result.error = lisp_parser_error("Expected a (", 0, 0);
-        return result;
+    node->type = (AstNodeType) nonterminal->node_type;
+    node->token = frame->token;
+    node->child_count = child_count;
+    if (child_count > 0) {
+        node->children = (AstNode **) malloc(child_count * sizeof(AstNode *));
+        memcpy(node->children, &parser->values[frame->value_base], child_count * sizeof(AstNode *));
     }
 
-    parser_advance(parser);
-    
-    while (parser_has_next(parser) && parser_peek(parser)->type != TOKEN_RPAREN) {
-        result = parser_parse_parameter(parser);
-        if (result.failed) {
-            return result;
-        }
+    if (parser_finishers[node->type] != NULL) {
+        parser_finishers[node->type](parser, node);
     }
 
-    return result;
+    parser->value_count = frame->value_base;
+    parser->values = array_reserve(parser->values, &parser->value_capacity,
+        parser->value_count, 1, sizeof(AstNode *));
+    parser->values[parser->value_count++] = node;
 }
 
 
-static ParseResult parser_parse_expression(Parser *parser) {
-    ParseResult result = { .failed = false, .error = NULL };
-
-    LispToken *token = parser_peek(parser);
-    switch (token->type) {
-        case TOKEN_DEFINE: {
-            result = parser_parse_function_definition(parser);
-            break;
-        }
-        case TOKEN_IF: {
-            break;
-        }
-        case TOKEN_LAMBDA: {
-            break;
-        }
-        case TOKEN_IDENTIFIER: {
-            result = parser_parse_identifier(parser);
-            break;
-        }
-        case TOKEN_VAR: {
-            break;
-        };
-        case TOKEN_INTEGER: {
-            break;
-        }
-        case TOKEN_FLOAT: {
-            break;
-        }
-        case TOKEN_GROUP: {
-            break;
-        }
-        default: {
-            result.failed = true;
-            result.error = lisp_parser_error(
-                "Expected an expression: ", token->line, token->column);
-            return result;
-        }
+static void parser_free(Parser *parser) {
+    for (u32 i = 0; i < parser->value_count; ++i) {
+        ast_free(parser->values[i]);
     }
-
-    return result;
+    free(parser->values);
+    free(parser->symbols);
+    free(parser->frames);
 }
 
 
-static ParseResult parser_parse_declaration(Parser *parser) {
-    ParseResult result = { .failed = false, .error = NULL };
-
-    if (!parser_has_next(parser) || parser_peek(parser)->type != TOKEN_LPAREN) {
-        result.failed = true;
-        result.error = lisp_parser_error("Expected a '('", 0, 0); // TODO() fix
-        return result;
-    }
+// @see parser.h
+extern AstResult parser_build_ast(TokenList *token_stream) {
+    AstResult result = { .failed = false, .error = NULL };
 
-    // Skip the '('
-    parser_advance(parser);
-    result = parser_parse_expression(parser);
+    Parser parser = {
+        .token_stream = token_stream,
+        .position = 0
+    };
 
-    if (!parser_has_next(parser) || parser_peek(parser)->type != TOKEN_RPAREN) {
-        result.failed = true;
-        result.error = lisp_parser_error("Expected a ')'", 0, 0); // TODO() fix
+    if (token_stream->count == 0) {
+        result.ast = (AstNode *) calloc(1, sizeof(AstNode));
+        result.ast->type = AST_PROGRAM;
         return result;
     }
 
-    // Skip the ')'
-    parser_advance(parser);
+    trace_begin(TRACE_PARSER);
 
-    return result;
-}
+    parser.symbols = array_reserve(NULL, &parser.symbol_capacity, 0, 1, sizeof(u16));
+    parser.symbols[parser.symbol_count++] = PARSER_START_SYMBOL;
 
+    // The token list always ends with an EOF token, which is matched last.
+    LispToken *last = &token_stream->tokens[token_stream->count - 1];
 
-extern AstResult parser_build_ast(TokenList *token_stream) {
-    AstResult result = { .failed = false, .error = NULL };
+    while (parser.symbol_count > 0) {
+        u16 symbol = parser.symbols[--parser.symbol_count];
+        LispToken *token = parser.position < token_stream->count ? &token_stream->tokens[parser.position] : last;
 
-    Parser parser = {
-        .token_stream = token_stream
-    };
+        if ((symbol & PARSER_CAPTURE) != 0) {
+            symbol &= ~PARSER_CAPTURE;
+            parser.frames[parser.frame_count - 1].token = token;
+        }
 
-    ParseResult parse_result = parser_parse_declaration(&parser);
-    if (parse_result.failed) {
-        result.failed = true;
-        result.error = parse_result.error;
-        return result;
+        if (symbol < PARSER_NONTERMINAL_BASE) {
+            if (token->type != symbol || parser.position == token_stream->count) {
+                result.error = parser_error(&parser, parser_terminal_errors[symbol]);
+                break;
+            }
+            parser.position++;
+        } else if (symbol < PARSER_ACTION_BASE) {
+            u16 nonterminal = symbol - PARSER_NONTERMINAL_BASE;
+            u8 production = parser_table[nonterminal][token->type];
+            if (production == 0) {
+                result.error = parser_error(&parser, parser_nonterminals[nonterminal].error);
+                break;
+            }
+
+            if (parser_nonterminals[nonterminal].node_type != PARSER_NO_NODE) {
+                parser_open_node(&parser, nonterminal, token);
+            }
+            parser_expand(&parser, &parser_productions[production]);
+        } else {
+            parser_close_node(&parser);
+        }
     }
 
-    result.ast = parse_result.node;
+    if (result.error != NULL) {
+        result.failed = true;
+    } else {
+        // Only the start symbol's node is left.
+        result.ast = parser.values[--parser.value_count];
+    }
 
+    parser_free(&parser);
+    trace_end(TRACE_PARSER);
     return result;
-}
\ No newline at end of file
+}
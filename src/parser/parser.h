@@ -13,6 +13,13 @@ typedef struct {
 } AstResult;
 
 
+/**
+ * Parse every form in `token_stream` into an `AST_PROGRAM` node.
+ *
+ * The parser is driven by the LL(1) table generated from the grammar in
+ * `docs/grammar.txt`, with explicit stacks rather than recursion, so any
+ * depth of nesting can be parsed.
+ */
 extern AstResult parser_build_ast(TokenList *token_stream);
 
 
@@ -0,0 +1,161 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "reader.h"
+#include "../lexer/token.h"
+
+#define QUIT_COMMAND ".quit\n"
+
+
+/**
+ * Read the next block of input.
+ *
+ * @return Whether any bytes were read.
+ */
+static bool reader_fill(Reader *reader) {
+    ssize_t count;
+    do {
+        count = read(reader->fd, reader->input, READER_BLOCK_SIZE);
+    } while (count < 0 && errno == EINTR);
+
+    reader->input_position = 0;
+    reader->input_length = count > 0 ? (size_t) count : 0;
+
+    return count > 0;
+}
+
+
+/**
+ * Append `length` bytes to the pending form.
+ */
+static void reader_append(Reader *reader, char *text, size_t length) {
+    if (reader->pending_length + length > reader->pending_capacity) {
+        while (reader->pending_capacity < reader->pending_length + length) {
+            reader->pending_capacity *= 2;
+        }
+        reader->pending = (char *) realloc(reader->pending, reader->pending_capacity);
+    }
+
+    memcpy(&reader->pending[reader->pending_length], text, length);
+    reader->pending_length += length;
+}
+
+
+/**
+ * Append the next line of input, including its newline, to the pending form.
+ *
+ * @return Whether anything was appended.
+ */
+static bool reader_read_line(Reader *reader) {
+    bool appended = false;
+
+    while (1) {
+        if (reader->input_position == reader->input_length && !reader_fill(reader)) {
+            return appended;
+        }
+
+        char *start = &reader->input[reader->input_position];
+        size_t available = reader->input_length - reader->input_position;
+        char *newline = (char *) memchr(start, '\n', available);
+        size_t length = newline != NULL ? (size_t) (newline - start) + 1 : available;
+
+        reader_append(reader, start, length);
+        reader->input_position += length;
+        appended = true;
+
+        if (newline != NULL) {
+            return true;
+        }
+    }
+}
+
+
+static void reader_prompt(Reader *reader, char *prompt) {
+    if (!reader->interactive) {
+        return;
+    }
+
+    // Continuation lines get a prompt of the same width.
+    if (reader->lexer.tokens->count > 0 || reader->lexer.suspended) {
+        printf("%*s > ", (int) strlen(prompt), "...");
+    } else {
+        printf("%s > ", prompt);
+    }
+    fflush(stdout);
+}
+
+
+// @see reader.h
+extern void reader_init(Reader *reader, int fd) {
+    reader->fd = fd;
+    reader->interactive = isatty(fd);
+    reader->end_of_input = false;
+    reader->input = (char *) malloc(READER_BLOCK_SIZE);
+    reader->input_length = 0;
+    reader->input_position = 0;
+    reader->pending_capacity = 0x400;
+    reader->pending = (char *) malloc(reader->pending_capacity);
+    reader->pending_length = 0;
+}
+
+
+// @see reader.h
+extern TokenListResult reader_next_form(Reader *reader, char *prompt) {
+    TokenListResult result = { .failed = false, .tokens = NULL };
+
+    reader->pending_length = 0;
+    lexer_init(&reader->lexer, reader->pending);
+
+    while (!reader->end_of_input) {
+        reader_prompt(reader, prompt);
+
+        size_t line_start = reader->pending_length;
+        if (!reader_read_line(reader)) {
+            reader->end_of_input = true;
+            break;
+        }
+
+        if (line_start == 0 && reader->pending_length == sizeof(QUIT_COMMAND) - 1
+                && memcmp(reader->pending, QUIT_COMMAND, sizeof(QUIT_COMMAND) - 1) == 0) {
+            reader->end_of_input = true;
+            token_list_free(reader->lexer.tokens);
+            return result;
+        }
+
+        ScanResult scan_result = lexer_resume(&reader->lexer, reader->pending, reader->pending_length);
+        if (scan_result.failed) {
+            token_list_free(reader->lexer.tokens);
+            result.failed = true;
+            result.error = scan_result.error;
+            return result;
+        }
+
+        if (lexer_is_balanced(&reader->lexer)) {
+            return lexer_finish(&reader->lexer);
+        }
+    }
+
+    // The input ended in the middle of a form; hand over what there is.
+    if (reader->lexer.tokens->count > 0 || reader->lexer.suspended) {
+        result = lexer_finish(&reader->lexer);
+        if (result.failed) {
+            token_list_free(reader->lexer.tokens);
+        }
+        return result;
+    }
+
+    token_list_free(reader->lexer.tokens);
+    return result;
+}
+
+
+// @see reader.h
+extern void reader_free(Reader *reader) {
+    free(reader->input);
+    free(reader->pending);
+}
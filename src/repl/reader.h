@@ -0,0 +1,60 @@
+#ifndef READER_H
+#define READER_H
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../lexer/lexer.h"
+
+// The number of bytes requested from the input per `read` call.
+#define READER_BLOCK_SIZE 0x10000
+
+
+/**
+ * Reads complete forms from a file descriptor for the REPL. Input is read
+ * in large blocks and split into lines, and lines are accumulated until
+ * their parentheses balance, so that a form may span several lines.
+ * Each appended line is lexed on its own by resuming the lexer, rather
+ * than re-tokenizing the whole pending form.
+ */
+typedef struct {
+    // The file descriptor to read from.
+    int fd;
+    // Whether to print prompts, i.e. whether the input is a terminal.
+    bool interactive;
+    // Whether the input has been exhausted or `.quit` was entered.
+    bool end_of_input;
+    // A block of raw input, and how much of it has been consumed.
+    char *input;
+    size_t input_length;
+    size_t input_position;
+    // The source code of the form being accumulated.
+    char *pending;
+    size_t pending_length;
+    size_t pending_capacity;
+    // The lexer resuming over `pending`.
+    Lexer lexer;
+} Reader;
+
+
+/**
+ * Prepare `reader` to read forms from `fd`.
+ */
+extern void reader_init(Reader *reader, int fd);
+
+/**
+ * Read the next complete form, printing `prompt` if the input is
+ * interactive.
+ *
+ * @return The tokens of the form, whose lexemes point into the reader
+ * and remain valid until the next call, or a lexer error. The tokens are
+ * `NULL` once the input is exhausted or `.quit` is entered on its own line.
+ */
+extern TokenListResult reader_next_form(Reader *reader, char *prompt);
+
+/**
+ * Free the buffers owned by `reader`.
+ */
+extern void reader_free(Reader *reader);
+
+
+#endif
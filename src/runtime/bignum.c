@@ -0,0 +1,668 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "bignum.h"
+
+// Operands with at least this many limbs are multiplied with Karatsuba's
+// algorithm; below it the quadratic schoolbook method is faster.
+#define KARATSUBA_THRESHOLD 32
+
+// The largest power of ten that fits in a single limb, and its exponent.
+#define DECIMAL_LIMB_BASE 10000000000000000000ULL
+#define DECIMAL_LIMB_DIGITS 19
+
+
+__extension__ typedef unsigned __int128 u128;
+
+
+/**
+ * A read-only view of an integer's sign and magnitude, so that fixnums
+ * and bignums can be handled by the same magnitude routines.
+ */
+typedef struct {
+    const u64 *limbs;
+    size_t length;
+    bool negative;
+} IntegerView;
+
+
+/**
+ * Get a view of `integer`. If it is a fixnum, its magnitude is stored
+ * in `scratch`, which must outlive the view.
+ */
+static IntegerView integer_view(LispValue integer, u64 *scratch) {
+    IntegerView view;
+
+    if (value_is_fixnum(integer)) {
+        i64 number = value_fixnum(integer);
+        *scratch = number < 0 ? (u64) 0 - (u64) number : (u64) number;
+        view.limbs = scratch;
+        view.length = number != 0;
+        view.negative = number < 0;
+        return view;
+    }
+
+    LispBignum *bignum = (LispBignum *) value_as_object(integer);
+    view.limbs = bignum->limbs;
+    view.length = bignum->length;
+    view.negative = bignum->negative;
+
+    return view;
+}
+
+
+/**
+ * Allocate a bignum with room for `length` limbs, all set to zero.
+ */
+static LispBignum *bignum_allocate(size_t length) {
+    LispBignum *bignum = value_allocate_object(
+        LISP_OBJECT_BIGNUM, sizeof(LispBignum) + length * sizeof(u64));
+    bignum->length = (u32) length;
+    return bignum;
+}
+
+
+/**
+ * Allocate the result of arithmetic, whose length the program controls,
+ * like `bignum_allocate`.
+ *
+ * @return The bignum, or `NULL` if it cannot be allocated.
+ */
+static LispBignum *bignum_try_allocate(size_t length) {
+    LispBignum *bignum = value_try_allocate_object(
+        LISP_OBJECT_BIGNUM, sizeof(LispBignum) + length * sizeof(u64));
+    if (bignum != NULL) {
+        bignum->length = (u32) length;
+    }
+    return bignum;
+}
+
+
+/**
+ * Get the length of a magnitude once its leading zero limbs are removed.
+ */
+static size_t magnitude_length(const u64 *limbs, size_t length) {
+    while (length > 0 && limbs[length - 1] == 0) {
+        length--;
+    }
+    return length;
+}
+
+
+/**
+ * Strip the leading zero limbs of `bignum`, and demote it to a fixnum
+ * if it is small enough, in which case `bignum` is freed.
+ */
+static LispValue bignum_normalize(LispBignum *bignum) {
+    bignum->length = (u32) magnitude_length(bignum->limbs, bignum->length);
+
+    if (bignum->length == 0) {
+        free(bignum);
+        return value_make_fixnum(0);
+    }
+
+    if (bignum->length == 1) {
+        u64 magnitude = bignum->limbs[0];
+        bool negative = bignum->negative;
+
+        if (!negative && magnitude <= (u64) LISP_FIXNUM_MAX) {
+            free(bignum);
+            return value_make_fixnum((i64) magnitude);
+        }
+
+        if (negative && magnitude <= (u64) LISP_FIXNUM_MAX + 1) {
+            free(bignum);
+            return value_make_fixnum((i64) ((u64) 0 - magnitude));
+        }
+    }
+
+    return value_from_object(bignum);
+}
+
+
+static i32 magnitude_compare(const u64 *a, size_t a_length, const u64 *b, size_t b_length) {
+    if (a_length != b_length) {
+        return a_length < b_length ? -1 : 1;
+    }
+    for (size_t i = a_length; i-- > 0;) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Compute `result = a + b` where `a_length >= b_length`. `result` must
+ * have room for `a_length` limbs.
+ *
+ * @return The carry out of the most significant limb.
+ */
+static u64 magnitude_add(u64 *result, const u64 *a, size_t a_length, const u64 *b, size_t b_length) {
+    u64 carry = 0;
+    size_t i = 0;
+
+    for (; i < b_length; ++i) {
+        u128 sum = (u128) a[i] + b[i] + carry;
+        result[i] = (u64) sum;
+        carry = (u64) (sum >> 64);
+    }
+
+    for (; i < a_length; ++i) {
+        u128 sum = (u128) a[i] + carry;
+        result[i] = (u64) sum;
+        carry = (u64) (sum >> 64);
+    }
+
+    return carry;
+}
+
+
+/**
+ * Compute `result = a - b` where `a >= b`. `result` must have room for
+ * `a_length` limbs, and may alias `a`.
+ */
+static void magnitude_subtract(u64 *result, const u64 *a, size_t a_length, const u64 *b, size_t b_length) {
+    u64 borrow = 0;
+    size_t i = 0;
+
+    for (; i < b_length; ++i) {
+        u64 difference = a[i] - b[i];
+        u64 next_borrow = (a[i] < b[i]) || (difference < borrow);
+        result[i] = difference - borrow;
+        borrow = next_borrow;
+    }
+
+    for (; i < a_length; ++i) {
+        u64 limb = a[i];
+        result[i] = limb - borrow;
+        borrow = limb < borrow;
+    }
+}
+
+
+/**
+ * Add `source` into `destination` in place. The sum must fit in
+ * `destination_length` limbs.
+ */
+static void magnitude_add_into(u64 *destination, size_t destination_length, const u64 *source, size_t source_length) {
+    u64 carry = magnitude_add(destination, destination, source_length, source, source_length);
+    for (size_t i = source_length; carry != 0 && i < destination_length; ++i) {
+        destination[i]++;
+        carry = destination[i] == 0;
+    }
+}
+
+
+/**
+ * Subtract `source` from `destination` in place, where `destination >= source`.
+ */
+static void magnitude_subtract_into(u64 *destination, size_t destination_length, const u64 *source, size_t source_length) {
+    magnitude_subtract(destination, destination, destination_length, source, source_length);
+}
+
+
+static void magnitude_multiply(u64 *result, const u64 *a, size_t a_length, const u64 *b, size_t b_length);
+
+
+static void magnitude_multiply_schoolbook(u64 *result, const u64 *a, size_t a_length, const u64 *b, size_t b_length) {
+    for (size_t i = 0; i < b_length; ++i) {
+        u64 carry = 0;
+        for (size_t j = 0; j < a_length; ++j) {
+            u128 product = (u128) a[j] * b[i] + result[i + j] + carry;
+            result[i + j] = (u64) product;
+            carry = (u64) (product >> 64);
+        }
+        result[i + a_length] = carry;
+    }
+}
+
+
+/**
+ * Multiply a long `a` by a much shorter `b` by splitting `a` into
+ * `b_length`-sized chunks, so that each partial product is balanced.
+ */
+static void magnitude_multiply_unbalanced(u64 *result, const u64 *a, size_t a_length, const u64 *b, size_t b_length) {
+    u64 *product = (u64 *) malloc(2 * b_length * sizeof(u64));
+
+    for (size_t i = 0; i < a_length; i += b_length) {
+        size_t chunk_length = a_length - i < b_length ? a_length - i : b_length;
+        magnitude_multiply(product, a + i, chunk_length, b, b_length);
+        magnitude_add_into(result + i, a_length + b_length - i, product, chunk_length + b_length);
+    }
+
+    free(product);
+}
+
+
+/**
+ * Karatsuba multiplication, for `b_length <= a_length < 2 * b_length`.
+ * With `a = a1 * B^h + a0` and `b = b1 * B^h + b0`, the product is
+ * `z2 * B^2h + z1 * B^h + z0` where `z1 = (a0 + a1)(b0 + b1) - z0 - z2`,
+ * which takes three half-size multiplications instead of four.
+ */
+static void magnitude_multiply_karatsuba(u64 *result, const u64 *a, size_t a_length, const u64 *b, size_t b_length) {
+    size_t half = a_length / 2;
+    size_t a_high_length = a_length - half;
+    size_t b_high_length = b_length - half;
+
+    // z0 and z2 are computed directly into the low and high halves of the result.
+    magnitude_multiply(result, a, half, b, half);
+    magnitude_multiply(result + 2 * half, a + half, a_high_length, b + half, b_high_length);
+
+    size_t a_sum_length = a_high_length + 1;
+    u64 *a_sum = (u64 *) calloc(a_sum_length, sizeof(u64));
+    a_sum[a_high_length] = magnitude_add(a_sum, a + half, a_high_length, a, half);
+
+    size_t b_sum_length = (b_high_length > half ? b_high_length : half) + 1;
+    u64 *b_sum = (u64 *) calloc(b_sum_length, sizeof(u64));
+    if (b_high_length >= half) {
+        b_sum[b_high_length] = magnitude_add(b_sum, b + half, b_high_length, b, half);
+    } else {
+        b_sum[half] = magnitude_add(b_sum, b, half, b + half, b_high_length);
+    }
+
+    size_t middle_length = a_sum_length + b_sum_length;
+    u64 *middle = (u64 *) malloc(middle_length * sizeof(u64));
+    magnitude_multiply(middle, a_sum, a_sum_length, b_sum, b_sum_length);
+    magnitude_subtract_into(middle, middle_length, result, 2 * half);
+    magnitude_subtract_into(middle, middle_length, result + 2 * half, a_length + b_length - 2 * half);
+
+    magnitude_add_into(result + half, a_length + b_length - half,
+        middle, magnitude_length(middle, middle_length));
+
+    free(a_sum);
+    free(b_sum);
+    free(middle);
+}
+
+
+/**
+ * Compute `result = a * b`. `result` must have room for
+ * `a_length + b_length` limbs and must not alias either operand.
+ */
+static void magnitude_multiply(u64 *result, const u64 *a, size_t a_length, const u64 *b, size_t b_length) {
+    memset(result, 0, (a_length + b_length) * sizeof(u64));
+
+    a_length = magnitude_length(a, a_length);
+    b_length = magnitude_length(b, b_length);
+
+    if (a_length < b_length) {
+        const u64 *limbs = a;
+        size_t length = a_length;
+        a = b;
+        a_length = b_length;
+        b = limbs;
+        b_length = length;
+    }
+
+    if (b_length == 0) {
+        return;
+    }
+
+    if (b_length < KARATSUBA_THRESHOLD) {
+        magnitude_multiply_schoolbook(result, a, a_length, b, b_length);
+        return;
+    }
+
+    if (a_length >= 2 * b_length) {
+        magnitude_multiply_unbalanced(result, a, a_length, b, b_length);
+        return;
+    }
+
+    magnitude_multiply_karatsuba(result, a, a_length, b, b_length);
+}
+
+
+/**
+ * Divide `a` by the single limb `divisor`, storing the quotient in
+ * `quotient`, which may alias `a`.
+ *
+ * @return The remainder.
+ */
+static u64 magnitude_divide_limb(u64 *quotient, const u64 *a, size_t a_length, u64 divisor) {
+    u128 remainder = 0;
+    for (size_t i = a_length; i-- > 0;) {
+        u128 current = (remainder << 64) | a[i];
+        quotient[i] = (u64) (current / divisor);
+        remainder = current % divisor;
+    }
+    return (u64) remainder;
+}
+
+
+/**
+ * Long division of `u` (`m` limbs) by `v` (`n` limbs), following Knuth's
+ * Algorithm D. Requires `m >= n >= 2` and a non-zero top limb in `v`.
+ * `quotient` receives `m - n + 1` limbs.
+ */
+static void magnitude_divide(u64 *quotient, const u64 *u, size_t m, const u64 *v, size_t n) {
+    u64 *v_normal = (u64 *) malloc(n * sizeof(u64));
+    u64 *u_normal = (u64 *) malloc((m + 1) * sizeof(u64));
+
+    // Shift both operands so that the divisor's top bit is set, which
+    // bounds the error of each quotient digit estimate by two.
+    i32 shift = __builtin_clzll(v[n - 1]);
+    for (size_t i = n - 1; i > 0; --i) {
+        v_normal[i] = (v[i] << shift) | (shift ? v[i - 1] >> (64 - shift) : 0);
+    }
+    v_normal[0] = v[0] << shift;
+
+    u_normal[m] = shift ? u[m - 1] >> (64 - shift) : 0;
+    for (size_t i = m - 1; i > 0; --i) {
+        u_normal[i] = (u[i] << shift) | (shift ? u[i - 1] >> (64 - shift) : 0);
+    }
+    u_normal[0] = u[0] << shift;
+
+    for (size_t j = m - n + 1; j-- > 0;) {
+        u128 numerator = ((u128) u_normal[j + n] << 64) | u_normal[j + n - 1];
+        u128 estimate = numerator / v_normal[n - 1];
+        u128 remainder = numerator - estimate * v_normal[n - 1];
+
+        while ((estimate >> 64) != 0
+                || estimate * v_normal[n - 2] > ((remainder << 64) | u_normal[j + n - 2])) {
+            estimate--;
+            remainder += v_normal[n - 1];
+            if ((remainder >> 64) != 0) {
+                break;
+            }
+        }
+
+        // Multiply and subtract the estimate times the divisor.
+        u64 carry = 0;
+        u64 borrow = 0;
+        for (size_t i = 0; i < n; ++i) {
+            u128 product = estimate * v_normal[i] + carry;
+            carry = (u64) (product >> 64);
+            u64 low = (u64) product;
+            u64 difference = u_normal[i + j] - low;
+            u64 next_borrow = (u_normal[i + j] < low) || (difference < borrow);
+            u_normal[i + j] = difference - borrow;
+            borrow = next_borrow;
+        }
+        u64 top = u_normal[j + n];
+        bool overshot = top < carry || top - carry < borrow;
+        u_normal[j + n] = top - carry - borrow;
+
+        quotient[j] = (u64) estimate;
+
+        // The estimate was one too large; add the divisor back.
+        if (overshot) {
+            quotient[j]--;
+            u_normal[j + n] += magnitude_add(&u_normal[j], &u_normal[j], n, v_normal, n);
+        }
+    }
+
+    free(v_normal);
+    free(u_normal);
+}
+
+
+static LispValue integer_add_views(IntegerView a, IntegerView b) {
+    if (a.negative == b.negative) {
+        if (a.length < b.length) {
+            IntegerView swap = a;
+            a = b;
+            b = swap;
+        }
+        LispBignum *sum = bignum_try_allocate(a.length + 1);
+        if (sum == NULL) {
+            return LISP_ALLOCATION_FAILED;
+        }
+        sum->limbs[a.length] = magnitude_add(sum->limbs, a.limbs, a.length, b.limbs, b.length);
+        sum->negative = a.negative;
+        return bignum_normalize(sum);
+    }
+
+    i32 order = magnitude_compare(a.limbs, a.length, b.limbs, b.length);
+    if (order == 0) {
+        return value_make_fixnum(0);
+    }
+    if (order < 0) {
+        IntegerView swap = a;
+        a = b;
+        b = swap;
+    }
+
+    LispBignum *difference = bignum_try_allocate(a.length);
+    if (difference == NULL) {
+        return LISP_ALLOCATION_FAILED;
+    }
+    magnitude_subtract(difference->limbs, a.limbs, a.length, b.limbs, b.length);
+    difference->negative = a.negative;
+
+    return bignum_normalize(difference);
+}
+
+
+// @see bignum.h
+extern LispValue bignum_add(LispValue a, LispValue b) {
+    u64 a_scratch, b_scratch;
+    return integer_add_views(integer_view(a, &a_scratch), integer_view(b, &b_scratch));
+}
+
+
+// @see bignum.h
+extern LispValue bignum_subtract(LispValue a, LispValue b) {
+    u64 a_scratch, b_scratch;
+    IntegerView negated = integer_view(b, &b_scratch);
+    negated.negative = !negated.negative;
+    return integer_add_views(integer_view(a, &a_scratch), negated);
+}
+
+
+// @see bignum.h
+extern LispValue bignum_multiply(LispValue a, LispValue b) {
+    u64 a_scratch, b_scratch;
+    IntegerView a_view = integer_view(a, &a_scratch);
+    IntegerView b_view = integer_view(b, &b_scratch);
+
+    if (a_view.length == 0 || b_view.length == 0) {
+        return value_make_fixnum(0);
+    }
+
+    LispBignum *product = bignum_try_allocate(a_view.length + b_view.length);
+    if (product == NULL) {
+        return LISP_ALLOCATION_FAILED;
+    }
+    magnitude_multiply(product->limbs, a_view.limbs, a_view.length, b_view.limbs, b_view.length);
+    product->negative = a_view.negative != b_view.negative;
+
+    return bignum_normalize(product);
+}
+
+
+// @see bignum.h
+extern LispValue bignum_divide(LispValue a, LispValue b) {
+    u64 a_scratch, b_scratch;
+    IntegerView a_view = integer_view(a, &a_scratch);
+    IntegerView b_view = integer_view(b, &b_scratch);
+
+    if (magnitude_compare(a_view.limbs, a_view.length, b_view.limbs, b_view.length) < 0) {
+        return value_make_fixnum(0);
+    }
+
+    bool negative = a_view.negative != b_view.negative;
+
+    if (b_view.length == 1) {
+        LispBignum *wide = bignum_try_allocate(a_view.length);
+        if (wide == NULL) {
+            return LISP_ALLOCATION_FAILED;
+        }
+        magnitude_divide_limb(wide->limbs, a_view.limbs, a_view.length, b_view.limbs[0]);
+        wide->negative = negative;
+        return bignum_normalize(wide);
+    }
+
+    LispBignum *quotient = bignum_try_allocate(a_view.length - b_view.length + 1);
+    if (quotient == NULL) {
+        return LISP_ALLOCATION_FAILED;
+    }
+    quotient->negative = negative;
+
+    magnitude_divide(quotient->limbs, a_view.limbs, a_view.length, b_view.limbs, b_view.length);
+
+    return bignum_normalize(quotient);
+}
+
+
+// @see bignum.h
+extern i32 bignum_compare(LispValue a, LispValue b) {
+    u64 a_scratch, b_scratch;
+    IntegerView a_view = integer_view(a, &a_scratch);
+    IntegerView b_view = integer_view(b, &b_scratch);
+
+    bool a_negative = a_view.negative && a_view.length != 0;
+    bool b_negative = b_view.negative && b_view.length != 0;
+    if (a_negative != b_negative) {
+        return a_negative ? -1 : 1;
+    }
+
+    i32 order = magnitude_compare(a_view.limbs, a_view.length, b_view.limbs, b_view.length);
+    return a_negative ? -order : order;
+}
+
+
+// @see bignum.h
+extern LispValue bignum_from_string(const char *digits, size_t length) {
+    bool negative = false;
+    if (length > 0 && (digits[0] == '-' || digits[0] == '+')) {
+        negative = digits[0] == '-';
+        digits++;
+        length--;
+    }
+
+    LispBignum *bignum = bignum_allocate(length / DECIMAL_LIMB_DIGITS + 1);
+    bignum->negative = negative;
+    size_t limb_count = 0;
+
+    // Consume the digits in chunks of up to 19, each of which fits in a limb,
+    // so that the magnitude is updated once per chunk rather than per digit.
+    size_t chunk_length = length % DECIMAL_LIMB_DIGITS;
+    if (chunk_length == 0) {
+        chunk_length = DECIMAL_LIMB_DIGITS;
+    }
+
+    for (size_t position = 0; position < length; position += chunk_length, chunk_length = DECIMAL_LIMB_DIGITS) {
+        u64 chunk = 0;
+        u64 scale = 1;
+        for (size_t i = 0; i < chunk_length; ++i) {
+            chunk = chunk * 10 + (u64) (digits[position + i] - '0');
+            scale *= 10;
+        }
+
+        u64 carry = chunk;
+        for (size_t i = 0; i < limb_count; ++i) {
+            u128 product = (u128) bignum->limbs[i] * scale + carry;
+            bignum->limbs[i] = (u64) product;
+            carry = (u64) (product >> 64);
+        }
+        if (carry != 0) {
+            bignum->limbs[limb_count++] = carry;
+        }
+    }
+
+    bignum->length = (u32) limb_count;
+
+    return bignum_normalize(bignum);
+}
+
+
+// @see bignum.h
+extern char *bignum_to_string(LispValue integer) {
+    u64 scratch;
+    IntegerView view = integer_view(integer, &scratch);
+
+    size_t length = view.length;
+    u64 *magnitude = (u64 *) malloc((length + 1) * sizeof(u64));
+    memcpy(magnitude, view.limbs, length * sizeof(u64));
+
+    // Each limb holds fewer than 20 decimal digits, so this bounds the
+    // number of base 10^19 chunks.
+    u64 *chunks = (u64 *) malloc((length * 2 + 1) * sizeof(u64));
+    size_t chunk_count = 0;
+    while (length > 0) {
+        chunks[chunk_count++] = magnitude_divide_limb(magnitude, magnitude, length, DECIMAL_LIMB_BASE);
+        length = magnitude_length(magnitude, length);
+    }
+
+    char *string = (char *) calloc(chunk_count * DECIMAL_LIMB_DIGITS + 3, sizeof(char));
+    char *cursor = string;
+
+    if (chunk_count == 0) {
+        *cursor++ = '0';
+    } else {
+        if (view.negative) {
+            *cursor++ = '-';
+        }
+        cursor += sprintf(cursor, "%" PRIu64, chunks[chunk_count - 1]);
+        for (size_t i = chunk_count - 1; i-- > 0;) {
+            cursor += sprintf(cursor, "%019" PRIu64, chunks[i]);
+        }
+    }
+
+    free(magnitude);
+    free(chunks);
+
+    return string;
+}
+
+
+// @see bignum.h
+extern double bignum_to_double(LispValue integer) {
+    u64 scratch;
+    IntegerView view = integer_view(integer, &scratch);
+
+    double result = 0.0;
+    for (size_t i = view.length; i-- > 0;) {
+        result = result * 18446744073709551616.0 + (double) view.limbs[i];
+    }
+
+    return view.negative ? -result : result;
+}
+
+
+// @see bignum.h
+extern LispValue bignum_from_i64(i64 number) {
+    if (value_fits_fixnum(number)) {
+        return value_make_fixnum(number);
+    }
+
+    LispBignum *bignum = bignum_allocate(1);
+    bignum->negative = number < 0;
+    bignum->limbs[0] = number < 0 ? (u64) 0 - (u64) number : (u64) number;
+    return value_from_object(bignum);
+}
+
+
+// @see bignum.h
+extern bool bignum_to_i64(LispValue integer, i64 *number) {
+    u64 scratch;
+    IntegerView view = integer_view(integer, &scratch);
+
+    if (view.length == 0) {
+        *number = 0;
+        return true;
+    }
+    if (view.length > 1) {
+        return false;
+    }
+
+    u64 magnitude = view.limbs[0];
+    if (view.negative) {
+        if (magnitude > (u64) INT64_MAX + 1) {
+            return false;
+        }
+        *number = (i64) ((u64) 0 - magnitude);
+        return true;
+    }
+
+    if (magnitude > (u64) INT64_MAX) {
+        return false;
+    }
+    *number = (i64) magnitude;
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef BIGNUM_H
+#define BIGNUM_H
+#include <stddef.h>
+
+#include "../util_types.h"
+#include "value.h"
+
+
+/**
+ * An arbitrary precision integer, stored as a sign and a little-endian
+ * magnitude of 64-bit limbs. A bignum is always normalized: its most
+ * significant limb is non-zero and its value never fits in a fixnum,
+ * so every integer has exactly one representation.
+ */
+typedef struct {
+    LispObject header;
+    bool negative;
+    u32 length;
+    u64 limbs[];
+} LispBignum;
+
+
+/**
+ * Add two integers, either of which may be a fixnum or a bignum.
+ *
+ * @return The normalized sum, demoted to a fixnum if it fits, or
+ * `LISP_ALLOCATION_FAILED` if it cannot be allocated, as is the case for
+ * each of the arithmetic operations.
+ */
+extern LispValue bignum_add(LispValue a, LispValue b);
+
+/**
+ * Subtract the integer `b` from the integer `a`.
+ */
+extern LispValue bignum_subtract(LispValue a, LispValue b);
+
+/**
+ * Multiply two integers. Operands above `KARATSUBA_THRESHOLD` limbs
+ * are multiplied with Karatsuba's algorithm.
+ */
+extern LispValue bignum_multiply(LispValue a, LispValue b);
+
+/**
+ * Divide the integer `a` by the integer `b`, truncating toward zero.
+ * The caller is responsible for rejecting a zero divisor.
+ */
+extern LispValue bignum_divide(LispValue a, LispValue b);
+
+/**
+ * Compare two integers.
+ *
+ * @return A negative number, zero or a positive number when `a` is
+ * respectively less than, equal to or greater than `b`.
+ */
+extern i32 bignum_compare(LispValue a, LispValue b);
+
+/**
+ * Convert a string of decimal digits, with an optional leading sign,
+ * to an integer.
+ */
+extern LispValue bignum_from_string(const char *digits, size_t length);
+
+/**
+ * Get the decimal representation of an integer.
+ *
+ * @return A heap allocated, NUL-terminated string owned by the caller.
+ */
+extern char *bignum_to_string(LispValue integer);
+
+/**
+ * Convert an integer to the nearest double.
+ */
+extern double bignum_to_double(LispValue integer);
+
+/**
+ * Get the integer equal to `number`, which is a bignum only if it does
+ * not fit in a fixnum.
+ */
+extern LispValue bignum_from_i64(i64 number);
+
+/**
+ * Convert an integer to a 64-bit machine integer.
+ *
+ * @return Whether the integer fits in 64 bits.
+ */
+extern bool bignum_to_i64(LispValue integer, i64 *number);
+
+
+#endif
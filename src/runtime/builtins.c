@@ -0,0 +1,585 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "builtins.h"
+#include "number.h"
+#include "bignum.h"
+#include "map.h"
+#include "vector.h"
+#include "task.h"
+#include "channel.h"
+#include "printer.h"
+#include "lisp_string.h"
+#include "../vm/bytecode.h"
+#include "../vm/vm.h"
+#include "../vm/governor.h"
+
+
+inline static ValueResult builtin_value(LispValue value) {
+    ValueResult result = { .failed = false, .value = value };
+    return result;
+}
+
+
+inline static ValueResult builtin_error(char *message) {
+    ValueResult result = { .failed = true, .error = lisp_runtime_error(message) };
+    return result;
+}
+
+
+/**
+ * Fold `arguments` from the left with `operation`.
+ */
+static ValueResult builtin_fold(ValueResult (*operation)(LispValue, LispValue),
+        LispValue *arguments, u32 argument_count) {
+    ValueResult result = builtin_value(arguments[0]);
+    for (u32 i = 1; i < argument_count && !result.failed; ++i) {
+        result = operation(result.value, arguments[i]);
+    }
+    return result;
+}
+
+
+/**
+ * (+ number ...)
+ */
+static ValueResult builtin_add(LispValue *arguments, u32 argument_count) {
+    if (argument_count == 0) {
+        return builtin_value(value_make_fixnum(0));
+    }
+    return builtin_fold(number_add, arguments, argument_count);
+}
+
+
+/**
+ * (- number ...)
+ */
+static ValueResult builtin_subtract(LispValue *arguments, u32 argument_count) {
+    if (argument_count == 1) {
+        return number_subtract(value_make_fixnum(0), arguments[0]);
+    }
+    return builtin_fold(number_subtract, arguments, argument_count);
+}
+
+
+/**
+ * (* number ...)
+ */
+static ValueResult builtin_multiply(LispValue *arguments, u32 argument_count) {
+    if (argument_count == 0) {
+        return builtin_value(value_make_fixnum(1));
+    }
+    return builtin_fold(number_multiply, arguments, argument_count);
+}
+
+
+/**
+ * (/ number ...)
+ */
+static ValueResult builtin_divide(LispValue *arguments, u32 argument_count) {
+    if (argument_count == 1) {
+        return number_divide(value_make_fixnum(1), arguments[0]);
+    }
+    return builtin_fold(number_divide, arguments, argument_count);
+}
+
+
+/**
+ * Check whether two values are equal. Unlike for map keys, numbers of
+ * different kinds are equal if they have the same value.
+ */
+static bool builtin_equal(LispValue a, LispValue b) {
+    if (value_is_fixnum(a & b) || !value_is_number(a) || !value_is_number(b)) {
+        return value_equal(a, b);
+    }
+    if (value_is_float(a) || value_is_float(b)) {
+        return number_to_double(a) == number_to_double(b);
+    }
+    return bignum_compare(a, b) == 0;
+}
+
+
+/**
+ * (= value ...)
+ */
+static ValueResult builtin_equals(LispValue *arguments, u32 argument_count) {
+    for (u32 i = 1; i < argument_count; ++i) {
+        if (!builtin_equal(arguments[i - 1], arguments[i])) {
+            return builtin_value(LISP_FALSE);
+        }
+    }
+    return builtin_value(LISP_TRUE);
+}
+
+
+/**
+ * (concat string ...)
+ */
+static ValueResult builtin_concat(LispValue *arguments, u32 argument_count) {
+    LispValue result = string_create("", 0);
+    for (u32 i = 0; i < argument_count; ++i) {
+        if (!value_is_string(arguments[i])) {
+            return builtin_error("Expected a string.");
+        }
+        if ((u64) string_length(result) + string_length(arguments[i]) > STRING_MAX_LENGTH) {
+            return builtin_error("The string is too long.");
+        }
+        result = string_concat(result, arguments[i]);
+        if (result == LISP_ALLOCATION_FAILED) {
+            ValueResult failure = { .failed = true, .error = value_allocation_error() };
+            return failure;
+        }
+    }
+    return builtin_value(result);
+}
+
+
+/**
+ * (print value ...)
+ */
+static ValueResult builtin_print(LispValue *arguments, u32 argument_count) {
+    for (u32 i = 0; i < argument_count; ++i) {
+        printer_write(stdout, arguments[i], false);
+    }
+    return builtin_value(LISP_NIL);
+}
+
+
+/**
+ * (hashmap key value ...)
+ */
+static ValueResult builtin_hashmap(LispValue *arguments, u32 argument_count) {
+    if (argument_count % 2 != 0) {
+        return builtin_error("Expected a value for every key.");
+    }
+
+    LispValue map = map_transient(map_empty());
+    for (u32 i = 0; i < argument_count; i += 2) {
+        map_transient_assoc(map, arguments[i], arguments[i + 1]);
+    }
+    return builtin_value(map_persistent(map));
+}
+
+
+/**
+ * (assoc map key value ...)
+ */
+static ValueResult builtin_assoc(LispValue *arguments, u32 argument_count) {
+    if (!value_is_map(arguments[0])) {
+        return builtin_error("Expected a map.");
+    }
+    if (argument_count % 2 != 1) {
+        return builtin_error("Expected a value for every key.");
+    }
+
+    if (argument_count == 3) {
+        return builtin_value(map_assoc(arguments[0], arguments[1], arguments[2]));
+    }
+
+    LispValue map = map_transient(arguments[0]);
+    for (u32 i = 1; i < argument_count; i += 2) {
+        map_transient_assoc(map, arguments[i], arguments[i + 1]);
+    }
+    return builtin_value(map_persistent(map));
+}
+
+
+/**
+ * (dissoc map key ...)
+ */
+static ValueResult builtin_dissoc(LispValue *arguments, u32 argument_count) {
+    if (!value_is_map(arguments[0])) {
+        return builtin_error("Expected a map.");
+    }
+
+    if (argument_count == 2) {
+        return builtin_value(map_dissoc(arguments[0], arguments[1]));
+    }
+
+    LispValue map = map_transient(arguments[0]);
+    for (u32 i = 1; i < argument_count; ++i) {
+        map_transient_dissoc(map, arguments[i]);
+    }
+    return builtin_value(map_persistent(map));
+}
+
+
+/**
+ * (get map key [default])
+ * (get vector index [default])
+ */
+static ValueResult builtin_get(LispValue *arguments, u32 argument_count) {
+    if (value_is_vector(arguments[0])) {
+        ValueResult result = vector_ref(arguments[0], arguments[1]);
+        if (result.failed && argument_count == 3) {
+            lisp_error_free(result.error);
+            return builtin_value(arguments[2]);
+        }
+        return result;
+    }
+
+    if (!value_is_map(arguments[0])) {
+        return builtin_error("Expected a map or a vector.");
+    }
+
+    LispValue value = argument_count == 3 ? arguments[2] : LISP_NIL;
+    map_find(arguments[0], arguments[1], &value);
+    return builtin_value(value);
+}
+
+
+/**
+ * (contains map key)
+ */
+static ValueResult builtin_contains(LispValue *arguments, u32 argument_count) {
+    (void) argument_count;
+    if (!value_is_map(arguments[0])) {
+        return builtin_error("Expected a map.");
+    }
+
+    LispValue value;
+    return builtin_value(map_find(arguments[0], arguments[1], &value) ? LISP_TRUE : LISP_FALSE);
+}
+
+
+/**
+ * (count map)
+ * (count vector)
+ * (count string)
+ */
+static ValueResult builtin_count(LispValue *arguments, u32 argument_count) {
+    (void) argument_count;
+    if (value_is_vector(arguments[0])) {
+        return builtin_value(value_make_fixnum(vector_length(arguments[0])));
+    }
+    if (value_is_string(arguments[0])) {
+        return builtin_value(value_make_fixnum(string_length(arguments[0])));
+    }
+    if (!value_is_map(arguments[0])) {
+        return builtin_error("Expected a map, a vector or a string.");
+    }
+    return builtin_value(value_make_fixnum(map_count(arguments[0])));
+}
+
+
+/**
+ * (f64vector number ...)
+ */
+static ValueResult builtin_f64vector(LispValue *arguments, u32 argument_count) {
+    return vector_from_values(LISP_OBJECT_F64VECTOR, arguments, argument_count);
+}
+
+
+/**
+ * (i64vector integer ...)
+ */
+static ValueResult builtin_i64vector(LispValue *arguments, u32 argument_count) {
+    return vector_from_values(LISP_OBJECT_I64VECTOR, arguments, argument_count);
+}
+
+
+/**
+ * (makef64vector length [fill])
+ */
+static ValueResult builtin_makef64vector(LispValue *arguments, u32 argument_count) {
+    LispValue fill = argument_count == 2 ? arguments[1] : value_make_fixnum(0);
+    return vector_filled(LISP_OBJECT_F64VECTOR, arguments[0], fill);
+}
+
+
+/**
+ * (makei64vector length [fill])
+ */
+static ValueResult builtin_makei64vector(LispValue *arguments, u32 argument_count) {
+    LispValue fill = argument_count == 2 ? arguments[1] : value_make_fixnum(0);
+    return vector_filled(LISP_OBJECT_I64VECTOR, arguments[0], fill);
+}
+
+
+/**
+ * (dot vector vector)
+ */
+static ValueResult builtin_dot(LispValue *arguments, u32 argument_count) {
+    (void) argument_count;
+    return vector_dot(arguments[0], arguments[1]);
+}
+
+
+/**
+ * (sum vector)
+ */
+static ValueResult builtin_sum(LispValue *arguments, u32 argument_count) {
+    (void) argument_count;
+    return vector_sum(arguments[0]);
+}
+
+
+/**
+ * (min vector)
+ */
+static ValueResult builtin_min(LispValue *arguments, u32 argument_count) {
+    (void) argument_count;
+    return vector_min(arguments[0]);
+}
+
+
+/**
+ * (max vector)
+ */
+static ValueResult builtin_max(LispValue *arguments, u32 argument_count) {
+    (void) argument_count;
+    return vector_max(arguments[0]);
+}
+
+
+/**
+ * (scale vector number)
+ */
+static ValueResult builtin_scale(LispValue *arguments, u32 argument_count) {
+    (void) argument_count;
+    if (!value_is_vector(arguments[0]) || !value_is_number(arguments[1])) {
+        return builtin_error("Expected a vector and a number.");
+    }
+    return vector_apply(NUMBER_MULTIPLY, arguments[0], arguments[1]);
+}
+
+
+/**
+ * What a task started by `spawn` calls.
+ */
+typedef struct {
+    LispValue function;
+    u32 argument_count;
+    LispValue arguments[];
+} SpawnedCall;
+
+
+static ValueResult builtin_spawned(void *argument) {
+    SpawnedCall *call = (SpawnedCall *) argument;
+    ValueResult result = builtin_apply(call->function, call->arguments, call->argument_count);
+    free(call);
+    return result;
+}
+
+
+/**
+ * (spawn function argument ...)
+ */
+static ValueResult builtin_spawn(LispValue *arguments, u32 argument_count) {
+    if (!value_is_builtin(arguments[0]) && !value_is_closure(arguments[0])) {
+        return builtin_error("Expected a function.");
+    }
+
+    u32 count = argument_count - 1;
+    SpawnedCall *call = (SpawnedCall *) malloc(sizeof(SpawnedCall) + count * sizeof(LispValue));
+    call->function = arguments[0];
+    call->argument_count = count;
+    memcpy(call->arguments, &arguments[1], count * sizeof(LispValue));
+
+    Task *task = task_spawn(builtin_spawned, call);
+    if (task == NULL) {
+        free(call);
+        return builtin_error("Could not allocate a task.");
+    }
+    return builtin_value(value_from_object(task));
+}
+
+
+/**
+ * (join task)
+ */
+static ValueResult builtin_join(LispValue *arguments, u32 argument_count) {
+    (void) argument_count;
+    if (!value_is_task(arguments[0])) {
+        return builtin_error("Expected a task.");
+    }
+    return task_join(value_task(arguments[0]));
+}
+
+
+/**
+ * (yield)
+ */
+static ValueResult builtin_yield(LispValue *arguments, u32 argument_count) {
+    (void) arguments;
+    (void) argument_count;
+    task_yield();
+    return builtin_value(LISP_NIL);
+}
+
+
+/**
+ * (channel [capacity])
+ */
+static ValueResult builtin_channel(LispValue *arguments, u32 argument_count) {
+    i64 capacity = 0;
+    if (argument_count == 1) {
+        if (!value_is_fixnum(arguments[0]) || value_fixnum(arguments[0]) < 0
+                || value_fixnum(arguments[0]) > UINT32_MAX) {
+            return builtin_error("Expected a capacity.");
+        }
+        capacity = value_fixnum(arguments[0]);
+    }
+
+    LispChannel *channel = channel_create((u32) capacity);
+    if (channel == NULL) {
+        return builtin_error("Could not allocate a channel.");
+    }
+    return builtin_value(value_from_object(channel));
+}
+
+
+/**
+ * (send channel value)
+ */
+static ValueResult builtin_send(LispValue *arguments, u32 argument_count) {
+    (void) argument_count;
+    if (!value_is_channel(arguments[0])) {
+        return builtin_error("Expected a channel.");
+    }
+    return channel_send(value_channel(arguments[0]), arguments[1]);
+}
+
+
+/**
+ * (receive channel)
+ */
+static ValueResult builtin_receive(LispValue *arguments, u32 argument_count) {
+    (void) argument_count;
+    if (!value_is_channel(arguments[0])) {
+        return builtin_error("Expected a channel.");
+    }
+    return channel_receive(value_channel(arguments[0]));
+}
+
+
+/**
+ * (close channel)
+ */
+static ValueResult builtin_close(LispValue *arguments, u32 argument_count) {
+    (void) argument_count;
+    if (!value_is_channel(arguments[0])) {
+        return builtin_error("Expected a channel.");
+    }
+    if (!channel_close(value_channel(arguments[0]))) {
+        return builtin_error("The channel is already closed.");
+    }
+    return builtin_value(LISP_NIL);
+}
+
+
+static ValueResult builtin_wait_fd(LispValue fd, TaskEvent events) {
+    if (!value_is_fixnum(fd) || value_fixnum(fd) < 0 || value_fixnum(fd) > INT32_MAX) {
+        return builtin_error("Expected a file descriptor.");
+    }
+    if (!task_wait_fd((int) value_fixnum(fd), events)) {
+        if (errno == ETIMEDOUT) {
+            ValueResult result = { .failed = true, .error = governor_time_error() };
+            return result;
+        }
+        return builtin_error("Cannot wait for the file descriptor.");
+    }
+    return builtin_value(LISP_TRUE);
+}
+
+
+/**
+ * (waitreadable fd)
+ */
+static ValueResult builtin_waitreadable(LispValue *arguments, u32 argument_count) {
+    (void) argument_count;
+    return builtin_wait_fd(arguments[0], TASK_READABLE);
+}
+
+
+/**
+ * (waitwritable fd)
+ */
+static ValueResult builtin_waitwritable(LispValue *arguments, u32 argument_count) {
+    (void) argument_count;
+    return builtin_wait_fd(arguments[0], TASK_WRITABLE);
+}
+
+
+static const Builtin builtins[] = {
+    { "+", builtin_add, 0, BUILTIN_VARIADIC },
+    { "-", builtin_subtract, 1, BUILTIN_VARIADIC },
+    { "*", builtin_multiply, 0, BUILTIN_VARIADIC },
+    { "/", builtin_divide, 1, BUILTIN_VARIADIC },
+    { "=", builtin_equals, 1, BUILTIN_VARIADIC },
+    { "print", builtin_print, 0, BUILTIN_VARIADIC },
+    { "concat", builtin_concat, 0, BUILTIN_VARIADIC },
+    { "hashmap", builtin_hashmap, 0, BUILTIN_VARIADIC },
+    { "assoc", builtin_assoc, 3, BUILTIN_VARIADIC },
+    { "dissoc", builtin_dissoc, 2, BUILTIN_VARIADIC },
+    { "get", builtin_get, 2, 3 },
+    { "contains", builtin_contains, 2, 2 },
+    { "count", builtin_count, 1, 1 },
+    { "f64vector", builtin_f64vector, 0, BUILTIN_VARIADIC },
+    { "i64vector", builtin_i64vector, 0, BUILTIN_VARIADIC },
+    { "makef64vector", builtin_makef64vector, 1, 2 },
+    { "makei64vector", builtin_makei64vector, 1, 2 },
+    { "dot", builtin_dot, 2, 2 },
+    { "sum", builtin_sum, 1, 1 },
+    { "min", builtin_min, 1, 1 },
+    { "max", builtin_max, 1, 1 },
+    { "scale", builtin_scale, 2, 2 },
+    { "spawn", builtin_spawn, 1, BUILTIN_VARIADIC },
+    { "join", builtin_join, 1, 1 },
+    { "yield", builtin_yield, 0, 0 },
+    { "channel", builtin_channel, 0, 1 },
+    { "send", builtin_send, 2, 2 },
+    { "receive", builtin_receive, 1, 1 },
+    { "close", builtin_close, 1, 1 },
+    { "waitreadable", builtin_waitreadable, 1, 1 },
+    { "waitwritable", builtin_waitwritable, 1, 1 },
+};
+
+
+// @see builtins.h
+extern const Builtin *builtin_find(const char *name, size_t length) {
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); ++i) {
+        if (strlen(builtins[i].name) == length && memcmp(builtins[i].name, name, length) == 0) {
+            return &builtins[i];
+        }
+    }
+    return NULL;
+}
+
+
+// @see builtins.h
+extern const Builtin *builtin_list(u32 *count) {
+    *count = sizeof(builtins) / sizeof(builtins[0]);
+    return builtins;
+}
+
+
+// @see builtins.h
+extern ValueResult builtin_call(const Builtin *builtin, LispValue *arguments, u32 argument_count) {
+    if (argument_count < builtin->min_arguments || argument_count > builtin->max_arguments) {
+        return builtin_error("Wrong number of arguments.");
+    }
+    return builtin->function(arguments, argument_count);
+}
+
+
+// @see builtins.h
+extern LispValue builtin_make_value(const Builtin *builtin) {
+    LispBuiltin *value = value_allocate_object(LISP_OBJECT_BUILTIN, sizeof(LispBuiltin));
+    value->builtin = builtin;
+    return value_from_object(value);
+}
+
+
+// @see builtins.h
+extern ValueResult builtin_apply(LispValue function, LispValue *arguments, u32 argument_count) {
+    if (value_is_closure(function)) {
+        return vm_apply(function, arguments, argument_count);
+    }
+    if (!value_is_builtin(function)) {
+        return builtin_error("Expected a function.");
+    }
+    return builtin_call(value_builtin(function)->builtin, arguments, argument_count);
+}
@@ -0,0 +1,76 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+#include <stddef.h>
+
+#include "../util_types.h"
+#include "value.h"
+
+// The maximum argument count of a builtin taking any number of arguments.
+#define BUILTIN_VARIADIC UINT32_MAX
+
+
+typedef ValueResult (*BuiltinFunction)(LispValue *arguments, u32 argument_count);
+
+
+/**
+ * A function provided by the runtime rather than defined in Lisp.
+ */
+typedef struct {
+    const char *name;
+    BuiltinFunction function;
+    u32 min_arguments;
+    u32 max_arguments;
+} Builtin;
+
+
+/**
+ * A builtin as a value, so that it can be passed to other functions.
+ */
+typedef struct {
+    LispObject header;
+    const Builtin *builtin;
+} LispBuiltin;
+
+
+inline static bool value_is_builtin(LispValue value) {
+    return value_is_object_type(value, LISP_OBJECT_BUILTIN);
+}
+
+
+inline static LispBuiltin *value_builtin(LispValue value) {
+    return (LispBuiltin *) value_as_object(value);
+}
+
+
+/**
+ * Find the builtin named by the `length` bytes at `name`.
+ *
+ * @return The builtin, or `NULL` if there is none by that name.
+ */
+extern const Builtin *builtin_find(const char *name, size_t length);
+
+/**
+ * Get every builtin.
+ *
+ * @param count Set to the number of builtins.
+ */
+extern const Builtin *builtin_list(u32 *count);
+
+/**
+ * Call `builtin`, first checking that it accepts `argument_count` arguments.
+ */
+extern ValueResult builtin_call(const Builtin *builtin, LispValue *arguments, u32 argument_count);
+
+/**
+ * Get `builtin` as a value.
+ */
+extern LispValue builtin_make_value(const Builtin *builtin);
+
+/**
+ * Call the function value `function`, which is either a builtin or a
+ * closure.
+ */
+extern ValueResult builtin_apply(LispValue function, LispValue *arguments, u32 argument_count);
+
+
+#endif
@@ -0,0 +1,129 @@
+#include <stdlib.h>
+
+#include "channel.h"
+
+
+inline static ValueResult channel_value(LispValue value) {
+    ValueResult result = { .failed = false, .value = value };
+    return result;
+}
+
+
+inline static ValueResult channel_error(char *message) {
+    ValueResult result = { .failed = true, .error = lisp_runtime_error(message) };
+    return result;
+}
+
+
+inline static void channel_buffer_push(LispChannel *channel, LispValue value) {
+    channel->buffer[(channel->head + channel->count) % channel->capacity] = value;
+    channel->count++;
+}
+
+
+// @see channel.h
+extern LispChannel *channel_create(u32 capacity) {
+    LispChannel *channel = value_allocate_object(LISP_OBJECT_CHANNEL,
+        sizeof(LispChannel) + capacity * sizeof(LispValue));
+    if (channel != NULL) {
+        channel->capacity = capacity;
+    }
+    return channel;
+}
+
+
+// @see channel.h
+extern ValueResult channel_send(LispChannel *channel, LispValue value) {
+    if (channel->closed) {
+        return channel_error("Cannot send to a closed channel.");
+    }
+
+    Task *receiver = task_queue_pop(&channel->receivers);
+    if (receiver != NULL) {
+        receiver->transfer = value;
+        task_wake(receiver);
+        return channel_value(value);
+    }
+
+    if (channel->count < channel->capacity) {
+        channel_buffer_push(channel, value);
+        return channel_value(value);
+    }
+
+    Task *sender = task_current();
+    sender->transfer = value;
+    task_queue_push(&channel->senders, sender);
+    if (!task_block()) {
+        task_queue_remove(&channel->senders, sender);
+        ValueResult result = { .failed = true, .error = task_block_error() };
+        return result;
+    }
+
+    if (sender->closed) {
+        sender->closed = false;
+        return channel_error("Cannot send to a closed channel.");
+    }
+    return channel_value(value);
+}
+
+
+// @see channel.h
+extern ValueResult channel_receive(LispChannel *channel) {
+    if (channel->count > 0) {
+        LispValue value = channel->buffer[channel->head];
+        channel->head = (channel->head + 1) % channel->capacity;
+        channel->count--;
+
+        // Room was made for the longest blocked sender.
+        Task *sender = task_queue_pop(&channel->senders);
+        if (sender != NULL) {
+            channel_buffer_push(channel, sender->transfer);
+            task_wake(sender);
+        }
+        return channel_value(value);
+    }
+
+    Task *sender = task_queue_pop(&channel->senders);
+    if (sender != NULL) {
+        task_wake(sender);
+        return channel_value(sender->transfer);
+    }
+
+    if (channel->closed) {
+        return channel_value(LISP_NIL);
+    }
+
+    Task *receiver = task_current();
+    task_queue_push(&channel->receivers, receiver);
+    if (!task_block()) {
+        task_queue_remove(&channel->receivers, receiver);
+        ValueResult result = { .failed = true, .error = task_block_error() };
+        return result;
+    }
+
+    if (receiver->closed) {
+        receiver->closed = false;
+        return channel_value(LISP_NIL);
+    }
+    return channel_value(receiver->transfer);
+}
+
+
+// @see channel.h
+extern bool channel_close(LispChannel *channel) {
+    if (channel->closed) {
+        return false;
+    }
+    channel->closed = true;
+
+    Task *task;
+    while ((task = task_queue_pop(&channel->receivers)) != NULL) {
+        task->closed = true;
+        task_wake(task);
+    }
+    while ((task = task_queue_pop(&channel->senders)) != NULL) {
+        task->closed = true;
+        task_wake(task);
+    }
+    return true;
+}
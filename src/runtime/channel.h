@@ -0,0 +1,68 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+#include <stdbool.h>
+
+#include "../util_types.h"
+#include "value.h"
+#include "task.h"
+
+
+/**
+ * A queue of values between tasks. A channel holds up to `capacity`
+ * values; sending to a full channel blocks the sender until a receiver
+ * makes room, and receiving from an empty one blocks the receiver until
+ * a value is sent. A channel of capacity zero hands each value directly
+ * from a sender to a receiver.
+ *
+ * Once a channel is closed, receivers get the values still buffered and
+ * then `nil`, and sending to it is an error.
+ */
+typedef struct {
+    LispObject header;
+    u32 capacity;
+    u32 count;
+    // The index in `buffer` of the oldest value.
+    u32 head;
+    bool closed;
+    // The blocked senders, each with the value it is sending in `transfer`.
+    TaskQueue senders;
+    TaskQueue receivers;
+    LispValue buffer[];
+} LispChannel;
+
+
+inline static bool value_is_channel(LispValue value) {
+    return value_is_object_type(value, LISP_OBJECT_CHANNEL);
+}
+
+
+inline static LispChannel *value_channel(LispValue value) {
+    return (LispChannel *) value_as_object(value);
+}
+
+
+extern LispChannel *channel_create(u32 capacity);
+
+/**
+ * Send `value` on `channel`, blocking the current task until there is
+ * room for it.
+ */
+extern ValueResult channel_send(LispChannel *channel, LispValue value);
+
+/**
+ * Receive the oldest value sent on `channel`, blocking the current task
+ * until there is one.
+ *
+ * @return The value, or `nil` if the channel is closed and empty.
+ */
+extern ValueResult channel_receive(LispChannel *channel);
+
+/**
+ * Close `channel`, waking every task blocked on it.
+ *
+ * @return Whether the channel was open.
+ */
+extern bool channel_close(LispChannel *channel);
+
+
+#endif
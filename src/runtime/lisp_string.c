@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "lisp_string.h"
+
+
+// @see lisp_string.h
+extern LispValue string_create(const char *bytes, u32 length) {
+    LispString *string = value_allocate_object(LISP_OBJECT_STRING, sizeof(LispString) + length);
+    char *copy = (char *) (string + 1);
+    memcpy(copy, bytes, length);
+    string->bytes = copy;
+    string->length = length;
+    return value_from_object(string);
+}
+
+
+/**
+ * Allocate `size` bytes for the contents of a string, stopping the
+ * program if there is not enough memory.
+ */
+static void *string_allocate(size_t size) {
+    void *bytes = malloc(size);
+    if (bytes == NULL && size > 0) {
+        fprintf(stderr, "\x1b[31merror:\x1b[0m Out of memory for a string of %zu bytes.\n", size);
+        abort();
+    }
+    return bytes;
+}
+
+
+/**
+ * Find the first backslash in the `length` bytes at `bytes`, sixteen bytes
+ * at a time where SSE2 is available, as it always is on x86-64.
+ *
+ * @return The backslash, or `NULL` if there is none.
+ */
+static const char *string_find_backslash(const char *bytes, u32 length) {
+    u32 i = 0;
+#if defined(__SSE2__)
+    const __m128i backslashes = _mm_set1_epi8('\\');
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *) &bytes[i]);
+        i32 mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, backslashes));
+        if (mask != 0) {
+            return &bytes[i + __builtin_ctz(mask)];
+        }
+    }
+#endif
+    return (const char *) memchr(&bytes[i], '\\', length - i);
+}
+
+
+// @see lisp_string.h
+extern LispValue string_from_literal(const char *lexeme, u32 length) {
+    LispString *string = value_allocate_object(LISP_OBJECT_STRING, sizeof(LispString));
+    string->bytes = lexeme + 1;
+    string->length = length - 2;
+    string->escaped = string_find_backslash(string->bytes, string->length) != NULL;
+    return value_from_object(string);
+}
+
+
+// @see lisp_string.h
+extern LispValue string_concat(LispValue a, LispValue b) {
+    u32 length_a = string_length(a);
+    u32 length_b = string_length(b);
+    if (length_a == 0) {
+        return b;
+    }
+    if (length_b == 0) {
+        return a;
+    }
+    // The bytes are only allocated once the string is flattened, where
+    // the heap limit can no longer be enforced.
+    if (!value_can_allocate((u64) length_a + length_b)) {
+        return LISP_ALLOCATION_FAILED;
+    }
+
+    if ((u64) length_a + length_b < STRING_ROPE_MIN) {
+        LispString *string = value_allocate_object(LISP_OBJECT_STRING, sizeof(LispString) + length_a + length_b);
+        char *bytes = (char *) (string + 1);
+        memcpy(bytes, string_bytes(a), length_a);
+        memcpy(bytes + length_a, string_bytes(b), length_b);
+        string->bytes = bytes;
+        string->length = length_a + length_b;
+        return value_from_object(string);
+    }
+
+    LispString *rope = value_allocate_object(LISP_OBJECT_STRING, sizeof(LispString));
+    rope->length = length_a + length_b;
+    rope->left = value_string(a);
+    rope->right = value_string(b);
+    return value_from_object(rope);
+}
+
+
+/**
+ * Process the escapes of a literal, copying the runs of bytes between
+ * them whole.
+ */
+static void string_unescape(LispString *string) {
+    const char *next = string->bytes;
+    const char *end = next + string->length;
+    char *bytes = (char *) string_allocate(string->length);
+    value_count_allocation(string->length);
+    u32 count = 0;
+
+    while (next < end) {
+        const char *backslash = string_find_backslash(next, (u32) (end - next));
+        const char *run_end = backslash != NULL ? backslash : end;
+        memcpy(&bytes[count], next, run_end - next);
+        count += run_end - next;
+        next = run_end;
+        if (backslash == NULL) {
+            break;
+        }
+
+        if (backslash + 1 == end) {
+            bytes[count++] = '\\';
+            break;
+        }
+        switch (backslash[1]) {
+            case 'n': bytes[count++] = '\n'; break;
+            case 't': bytes[count++] = '\t'; break;
+            case 'r': bytes[count++] = '\r'; break;
+            case '0': bytes[count++] = '\0'; break;
+            case '\\': bytes[count++] = '\\'; break;
+            case '"': bytes[count++] = '"'; break;
+            default: {
+                bytes[count++] = '\\';
+                bytes[count++] = backslash[1];
+                break;
+            }
+        }
+        next = backslash + 2;
+    }
+
+    string->bytes = bytes;
+    string->length = count;
+    string->escaped = false;
+}
+
+
+// @see lisp_string.h
+extern void string_flatten(LispString *string) {
+    if (string->escaped) {
+        string_unescape(string);
+        return;
+    }
+    if (string->bytes != NULL) {
+        return;
+    }
+
+    char *bytes = (char *) string_allocate(string->length);
+    value_count_allocation(string->length);
+    u32 count = 0;
+
+    // The parts still to be copied, the next one last. Ropes may be as
+    // deep as they are long, so this does not recurse.
+    u32 capacity = 0x20;
+    u32 pending_count = 0;
+    LispString **pending = (LispString **) string_allocate(capacity * sizeof(LispString *));
+    pending[pending_count++] = string;
+
+    while (pending_count > 0) {
+        LispString *part = pending[--pending_count];
+        if (part->bytes == NULL) {
+            if (pending_count + 2 > capacity) {
+                LispString **grown = (LispString **) string_allocate(2 * capacity * sizeof(LispString *));
+                memcpy(grown, pending, pending_count * sizeof(LispString *));
+                free(pending);
+                pending = grown;
+                capacity *= 2;
+            }
+            pending[pending_count++] = part->right;
+            pending[pending_count++] = part->left;
+            continue;
+        }
+
+        // The halves of a rope had their escapes processed when they
+        // were concatenated.
+        memcpy(&bytes[count], part->bytes, part->length);
+        count += part->length;
+    }
+    free(pending);
+
+    string->bytes = bytes;
+    string->left = NULL;
+    string->right = NULL;
+}
@@ -0,0 +1,108 @@
+#ifndef LISP_STRING_H
+#define LISP_STRING_H
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../util_types.h"
+#include "value.h"
+
+// Concatenations shorter than this are copied rather than made into ropes.
+#define STRING_ROPE_MIN 0x40
+
+// The longest a string can be.
+#define STRING_MAX_LENGTH UINT32_MAX
+
+
+/**
+ * An immutable string of bytes, in one of three forms:
+ * - A flat string, whose bytes are its own or, for a string literal,
+ *   the bytes of the literal in the source code, which are not copied.
+ * - A literal with escapes in it, whose bytes are still those of the
+ *   source code until the escapes are first needed, and then processed.
+ * - A rope, the concatenation of two strings, which is only copied into
+ *   a flat string the first time its bytes are needed. Concatenating
+ *   onto a string over and over therefore takes linear time overall.
+ *
+ * Use `string_bytes` and `string_length` rather than the fields, which
+ * turn a string of any form into a flat one first.
+ */
+typedef struct LispString {
+    LispObject header;
+    u32 length;
+    // Whether `bytes` are those of a literal whose escapes are not yet
+    // processed, in which case `length` is the literal's length.
+    bool escaped;
+    // The bytes, or `NULL` for a rope that has not been flattened yet.
+    const char *bytes;
+    // The halves of a rope that has not been flattened yet.
+    struct LispString *left;
+    struct LispString *right;
+} LispString;
+
+
+inline static bool value_is_string(LispValue value) {
+    return value_is_object_type(value, LISP_OBJECT_STRING);
+}
+
+
+inline static LispString *value_string(LispValue value) {
+    return (LispString *) value_as_object(value);
+}
+
+
+/**
+ * Create a string of a copy of the `length` bytes at `bytes`.
+ */
+extern LispValue string_create(const char *bytes, u32 length);
+
+/**
+ * Create the string a string literal stands for, given the lexeme of the
+ * literal with its quotes. The escapes `\n`, `\t`, `\r`, `\0`, `\\` and
+ * `\"` stand for the characters they name, and a backslash before any
+ * other character is kept.
+ *
+ * The string refers to the lexeme rather than copying it, so the source
+ * code must outlive it.
+ */
+extern LispValue string_from_literal(const char *lexeme, u32 length);
+
+/**
+ * Concatenate two strings, whose lengths must add up to at most
+ * `STRING_MAX_LENGTH`.
+ *
+ * @return The concatenation, or `LISP_ALLOCATION_FAILED` if its bytes
+ * would take the evaluation past its heap limit.
+ */
+extern LispValue string_concat(LispValue a, LispValue b);
+
+/**
+ * Make `string` flat, processing its escapes or flattening it if it is a
+ * rope. Strings are flattened where no error can be returned, such as
+ * when they are printed or hashed, so running out of memory here stops
+ * the program.
+ */
+extern void string_flatten(LispString *string);
+
+
+/**
+ * Get the bytes of `string`, which are not followed by a zero byte.
+ */
+inline static const char *string_bytes(LispValue value) {
+    LispString *string = value_string(value);
+    if (string->bytes == NULL || string->escaped) {
+        string_flatten(string);
+    }
+    return string->bytes;
+}
+
+
+inline static u32 string_length(LispValue value) {
+    LispString *string = value_string(value);
+    if (string->escaped) {
+        string_flatten(string);
+    }
+    return string->length;
+}
+
+
+#endif
@@ -0,0 +1,436 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+
+#define MAP_MASK (MAP_BRANCH - 1)
+
+
+// The owner number of the next transient. 0 marks a persistent map.
+static u64 map_next_owner = 1;
+
+static LispMap empty_map = {
+    .header = { .type = LISP_OBJECT_MAP },
+    .owner = 0,
+    .count = 0,
+    .root = NULL
+};
+
+
+inline static u32 map_hash(LispValue key) {
+    u64 hash = value_hash(key);
+    return (u32) (hash ^ (hash >> 32));
+}
+
+
+/**
+ * Get the bit standing for the slot of `hash` in a node at depth `shift`.
+ */
+inline static u32 map_bit(u32 hash, u32 shift) {
+    return 1u << ((hash >> shift) & MAP_MASK);
+}
+
+
+/**
+ * Get the index within a node of the slot standing for `bit`.
+ */
+inline static u32 map_index(u32 bitmap, u32 bit) {
+    return (u32) __builtin_popcount(bitmap & (bit - 1));
+}
+
+
+static MapNode *map_node_allocate(u64 owner, u32 capacity) {
+    // A transient leaves its nodes room to grow in place.
+    if (owner != 0) {
+        u32 rounded = 4;
+        while (rounded < capacity) {
+            rounded *= 2;
+        }
+        capacity = rounded;
+    }
+
+    MapNode *node = (MapNode *) malloc(sizeof(MapNode) + capacity * sizeof(MapEntry));
+    value_count_allocation(sizeof(MapNode) + capacity * sizeof(MapEntry));
+    node->owner = owner;
+    node->bitmap = 0;
+    node->collision = false;
+    node->count = 0;
+    node->capacity = capacity;
+    return node;
+}
+
+
+/**
+ * Get a version of `node` that `owner` may change, with room for `extra`
+ * more entries: `node` itself if `owner` is the transient that created it
+ * and it has the room, otherwise a copy.
+ */
+static MapNode *map_node_editable(MapNode *node, u64 owner, u32 extra) {
+    if (owner != 0 && node->owner == owner && node->count + extra <= node->capacity) {
+        return node;
+    }
+
+    MapNode *copy = map_node_allocate(owner, node->count + extra);
+    copy->bitmap = node->bitmap;
+    copy->collision = node->collision;
+    copy->count = node->count;
+    memcpy(copy->entries, node->entries, node->count * sizeof(MapEntry));
+    return copy;
+}
+
+
+static void map_node_insert(MapNode *node, u32 index, LispValue key, LispValue value) {
+    memmove(&node->entries[index + 1], &node->entries[index], (node->count - index) * sizeof(MapEntry));
+    node->entries[index].key = key;
+    node->entries[index].value = value;
+    node->count++;
+}
+
+
+static void map_node_remove(MapNode *node, u32 index) {
+    memmove(&node->entries[index], &node->entries[index + 1], (node->count - index - 1) * sizeof(MapEntry));
+    node->count--;
+}
+
+
+static bool map_node_find(MapNode *node, u32 hash, LispValue key, LispValue *value) {
+    for (u32 shift = 0; node != NULL; shift += MAP_BITS) {
+        if (node->collision) {
+            for (u32 i = 0; i < node->count; ++i) {
+                if (value_equal(node->entries[i].key, key)) {
+                    *value = node->entries[i].value;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        u32 bit = map_bit(hash, shift);
+        if ((node->bitmap & bit) == 0) {
+            return false;
+        }
+
+        MapEntry *entry = &node->entries[map_index(node->bitmap, bit)];
+        if (entry->key == MAP_CHILD) {
+            node = entry->child;
+            continue;
+        }
+        if (!value_equal(entry->key, key)) {
+            return false;
+        }
+
+        *value = entry->value;
+        return true;
+    }
+
+    return false;
+}
+
+
+/**
+ * Build the subtree at depth `shift` holding two entries whose hashes
+ * agree on every bit above it.
+ */
+static MapNode *map_node_merge(u64 owner, u32 shift, MapEntry first, u32 first_hash, MapEntry second, u32 second_hash) {
+    if (shift >= MAP_HASH_BITS) {
+        MapNode *node = map_node_allocate(owner, 2);
+        node->collision = true;
+        node->bitmap = first_hash;
+        node->entries[0] = first;
+        node->entries[1] = second;
+        node->count = 2;
+        return node;
+    }
+
+    u32 first_bit = map_bit(first_hash, shift);
+    u32 second_bit = map_bit(second_hash, shift);
+
+    if (first_bit == second_bit) {
+        MapNode *node = map_node_allocate(owner, 1);
+        node->bitmap = first_bit;
+        node->entries[0].key = MAP_CHILD;
+        node->entries[0].child = map_node_merge(owner, shift + MAP_BITS, first, first_hash, second, second_hash);
+        node->count = 1;
+        return node;
+    }
+
+    MapNode *node = map_node_allocate(owner, 2);
+    node->bitmap = first_bit | second_bit;
+    node->entries[first_bit < second_bit ? 0 : 1] = first;
+    node->entries[first_bit < second_bit ? 1 : 0] = second;
+    node->count = 2;
+    return node;
+}
+
+
+/**
+ * Map `key` to `value` in the subtree `node` at depth `shift`.
+ *
+ * @param added Set if `key` was not in the subtree before.
+ * @return The new subtree, which is `node` itself if it was edited in
+ * place or did not need to change.
+ */
+static MapNode *map_node_assoc(MapNode *node, u64 owner, u32 shift, u32 hash, LispValue key, LispValue value, bool *added) {
+    if (node->collision) {
+        for (u32 i = 0; i < node->count; ++i) {
+            if (value_equal(node->entries[i].key, key)) {
+                if (node->entries[i].value == value) {
+                    return node;
+                }
+                MapNode *edited = map_node_editable(node, owner, 0);
+                edited->entries[i].value = value;
+                return edited;
+            }
+        }
+
+        MapNode *edited = map_node_editable(node, owner, 1);
+        map_node_insert(edited, edited->count, key, value);
+        *added = true;
+        return edited;
+    }
+
+    u32 bit = map_bit(hash, shift);
+    u32 index = map_index(node->bitmap, bit);
+
+    if ((node->bitmap & bit) == 0) {
+        MapNode *edited = map_node_editable(node, owner, 1);
+        map_node_insert(edited, index, key, value);
+        edited->bitmap |= bit;
+        *added = true;
+        return edited;
+    }
+
+    MapEntry *entry = &node->entries[index];
+
+    if (entry->key == MAP_CHILD) {
+        MapNode *child = map_node_assoc(entry->child, owner, shift + MAP_BITS, hash, key, value, added);
+        if (child == entry->child) {
+            return node;
+        }
+        MapNode *edited = map_node_editable(node, owner, 0);
+        edited->entries[index].child = child;
+        return edited;
+    }
+
+    if (value_equal(entry->key, key)) {
+        if (entry->value == value) {
+            return node;
+        }
+        MapNode *edited = map_node_editable(node, owner, 0);
+        edited->entries[index].value = value;
+        return edited;
+    }
+
+    // Two different keys want the same slot: push both down a level.
+    MapEntry added_entry = { .key = key, .value = value };
+    MapNode *child = map_node_merge(owner, shift + MAP_BITS, *entry, map_hash(entry->key), added_entry, hash);
+
+    MapNode *edited = map_node_editable(node, owner, 0);
+    edited->entries[index].key = MAP_CHILD;
+    edited->entries[index].child = child;
+    *added = true;
+    return edited;
+}
+
+
+/**
+ * Remove `key` from the subtree `node` at depth `shift`.
+ *
+ * @param removed Set if `key` was in the subtree.
+ * @return The new subtree, or `NULL` if it is now empty.
+ */
+static MapNode *map_node_dissoc(MapNode *node, u64 owner, u32 shift, u32 hash, LispValue key, bool *removed) {
+    if (node->collision) {
+        for (u32 i = 0; i < node->count; ++i) {
+            if (value_equal(node->entries[i].key, key)) {
+                *removed = true;
+                if (node->count == 1) {
+                    return NULL;
+                }
+                MapNode *edited = map_node_editable(node, owner, 0);
+                map_node_remove(edited, i);
+                return edited;
+            }
+        }
+        return node;
+    }
+
+    u32 bit = map_bit(hash, shift);
+    if ((node->bitmap & bit) == 0) {
+        return node;
+    }
+
+    u32 index = map_index(node->bitmap, bit);
+    MapEntry *entry = &node->entries[index];
+
+    if (entry->key == MAP_CHILD) {
+        MapNode *child = map_node_dissoc(entry->child, owner, shift + MAP_BITS, hash, key, removed);
+        if (!*removed) {
+            return node;
+        }
+
+        if (child != NULL) {
+            // A child left with a single entry is folded into this node,
+            // so that removals undo the levels insertions added.
+            if (child->count == 1 && child->entries[0].key != MAP_CHILD) {
+                MapNode *edited = map_node_editable(node, owner, 0);
+                edited->entries[index] = child->entries[0];
+                return edited;
+            }
+            if (child == entry->child) {
+                return node;
+            }
+            MapNode *edited = map_node_editable(node, owner, 0);
+            edited->entries[index].child = child;
+            return edited;
+        }
+    } else {
+        if (!value_equal(entry->key, key)) {
+            return node;
+        }
+        *removed = true;
+    }
+
+    if (node->count == 1) {
+        return NULL;
+    }
+
+    MapNode *edited = map_node_editable(node, owner, 0);
+    map_node_remove(edited, index);
+    edited->bitmap &= ~bit;
+    return edited;
+}
+
+
+static void map_node_for_each(MapNode *node, MapVisitor visitor, void *context) {
+    for (u32 i = 0; i < node->count; ++i) {
+        MapEntry *entry = &node->entries[i];
+        if (entry->key == MAP_CHILD) {
+            map_node_for_each(entry->child, visitor, context);
+        } else {
+            visitor(entry->key, entry->value, context);
+        }
+    }
+}
+
+
+static MapNode *map_root_assoc(MapNode *root, u64 owner, LispValue key, LispValue value, bool *added) {
+    u32 hash = map_hash(key);
+
+    if (root == NULL) {
+        root = map_node_allocate(owner, 1);
+        root->bitmap = map_bit(hash, 0);
+        map_node_insert(root, 0, key, value);
+        *added = true;
+        return root;
+    }
+
+    return map_node_assoc(root, owner, 0, hash, key, value, added);
+}
+
+
+static MapNode *map_root_dissoc(MapNode *root, u64 owner, LispValue key, bool *removed) {
+    if (root == NULL) {
+        return NULL;
+    }
+    return map_node_dissoc(root, owner, 0, map_hash(key), key, removed);
+}
+
+
+static LispValue map_create(u64 owner, u32 count, MapNode *root) {
+    LispMap *map = value_allocate_object(LISP_OBJECT_MAP, sizeof(LispMap));
+    map->owner = owner;
+    map->count = count;
+    map->root = root;
+    return value_from_object(map);
+}
+
+
+// @see map.h
+extern LispValue map_empty(void) {
+    return value_from_object(&empty_map);
+}
+
+
+// @see map.h
+extern bool map_find(LispValue map, LispValue key, LispValue *value) {
+    MapNode *root = value_map(map)->root;
+    if (root == NULL) {
+        return false;
+    }
+    return map_node_find(root, map_hash(key), key, value);
+}
+
+
+// @see map.h
+extern LispValue map_assoc(LispValue map, LispValue key, LispValue value) {
+    LispMap *original = value_map(map);
+    bool added = false;
+
+    MapNode *root = map_root_assoc(original->root, 0, key, value, &added);
+    if (root == original->root) {
+        return map;
+    }
+
+    return map_create(0, original->count + added, root);
+}
+
+
+// @see map.h
+extern LispValue map_dissoc(LispValue map, LispValue key) {
+    LispMap *original = value_map(map);
+    bool removed = false;
+
+    MapNode *root = map_root_dissoc(original->root, 0, key, &removed);
+    if (!removed) {
+        return map;
+    }
+    if (root == NULL) {
+        return map_empty();
+    }
+
+    return map_create(0, original->count - 1, root);
+}
+
+
+// @see map.h
+extern void map_for_each(LispValue map, MapVisitor visitor, void *context) {
+    MapNode *root = value_map(map)->root;
+    if (root != NULL) {
+        map_node_for_each(root, visitor, context);
+    }
+}
+
+
+// @see map.h
+extern LispValue map_transient(LispValue map) {
+    LispMap *original = value_map(map);
+    return map_create(map_next_owner++, original->count, original->root);
+}
+
+
+// @see map.h
+extern void map_transient_assoc(LispValue transient, LispValue key, LispValue value) {
+    LispMap *map = value_map(transient);
+    bool added = false;
+
+    map->root = map_root_assoc(map->root, map->owner, key, value, &added);
+    map->count += added;
+}
+
+
+// @see map.h
+extern void map_transient_dissoc(LispValue transient, LispValue key) {
+    LispMap *map = value_map(transient);
+    bool removed = false;
+
+    map->root = map_root_dissoc(map->root, map->owner, key, &removed);
+    map->count -= removed;
+}
+
+
+// @see map.h
+extern LispValue map_persistent(LispValue transient) {
+    value_map(transient)->owner = 0;
+    return transient;
+}
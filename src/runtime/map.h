@@ -0,0 +1,146 @@
+#ifndef MAP_H
+#define MAP_H
+#include <stdbool.h>
+
+#include "../util_types.h"
+#include "value.h"
+
+
+/**
+ * An immutable map from values to values, stored as a hash array mapped
+ * trie. Each level of the trie consumes `MAP_BITS` bits of a key's hash.
+ * A node only stores the slots that are in use, and a bitmap of which of
+ * the `MAP_BRANCH` possible slots those are; the index of a slot in the
+ * node is the number of bits set below its own. Keys whose hashes are
+ * equal in every bit share a collision node, which is searched linearly.
+ *
+ * Adding or removing a key copies only the path from the root to it, so
+ * every older version of a map stays valid and shares the rest.
+ *
+ * A transient map is a map that may be updated in place while building
+ * it in bulk. Every transient gets an owner number that is never reused,
+ * and the nodes it creates are tagged with it; it edits those nodes in
+ * place and copies any other node the first time it touches it. Turning
+ * it back into a persistent map simply clears its owner, so that no node
+ * can be edited again.
+ */
+
+#define MAP_BITS 5
+#define MAP_BRANCH (1u << MAP_BITS)
+#define MAP_HASH_BITS 32
+
+
+struct MapNode;
+
+
+/**
+ * A slot in a node. A slot holds either a key and its value, or, if its
+ * key is `MAP_CHILD`, a child node.
+ */
+typedef struct {
+    LispValue key;
+    union {
+        LispValue value;
+        struct MapNode *child;
+    };
+} MapEntry;
+
+// Never a valid `LispValue`.
+#define MAP_CHILD ((LispValue) 0)
+
+
+typedef struct MapNode {
+    // The transient that may edit this node in place, or 0.
+    u64 owner;
+    // Which slots are in use, or for a collision node, the shared hash.
+    u32 bitmap;
+    bool collision;
+    u32 count;
+    u32 capacity;
+    MapEntry entries[];
+} MapNode;
+
+
+typedef struct {
+    LispObject header;
+    // The owner number while the map is transient, or 0.
+    u64 owner;
+    u32 count;
+    MapNode *root;
+} LispMap;
+
+
+typedef void (*MapVisitor)(LispValue key, LispValue value, void *context);
+
+
+inline static bool value_is_map(LispValue value) {
+    return value_is_object_type(value, LISP_OBJECT_MAP);
+}
+
+
+inline static LispMap *value_map(LispValue value) {
+    return (LispMap *) value_as_object(value);
+}
+
+
+inline static u32 map_count(LispValue map) {
+    return value_map(map)->count;
+}
+
+
+/**
+ * Get the empty map.
+ */
+extern LispValue map_empty(void);
+
+/**
+ * Look up `key` in `map`.
+ *
+ * @param value Set to the value of `key`, if it is found.
+ * @return Whether `key` is in `map`.
+ */
+extern bool map_find(LispValue map, LispValue key, LispValue *value);
+
+/**
+ * Get a map with the entries of `map` and `key` mapped to `value`.
+ * `map` itself is unchanged.
+ */
+extern LispValue map_assoc(LispValue map, LispValue key, LispValue value);
+
+/**
+ * Get a map with the entries of `map` except for `key`.
+ * `map` itself is unchanged.
+ */
+extern LispValue map_dissoc(LispValue map, LispValue key);
+
+/**
+ * Call `visitor` with every entry of `map`, in no particular order.
+ */
+extern void map_for_each(LispValue map, MapVisitor visitor, void *context);
+
+/**
+ * Get a transient map with the same entries as `map`, which may then be
+ * updated in place. `map` itself is unchanged.
+ */
+extern LispValue map_transient(LispValue map);
+
+/**
+ * Map `key` to `value` in the transient map `transient`, in place.
+ */
+extern void map_transient_assoc(LispValue transient, LispValue key, LispValue value);
+
+/**
+ * Remove `key` from the transient map `transient`, in place.
+ */
+extern void map_transient_dissoc(LispValue transient, LispValue key);
+
+/**
+ * Freeze a transient map. It becomes an ordinary persistent map, and
+ * none of its nodes can be edited in place again.
+ *
+ * @return `transient`, which is now persistent.
+ */
+extern LispValue map_persistent(LispValue transient);
+
+
+#endif
@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "number.h"
+#include "bignum.h"
+#include "vector.h"
+
+
+// @see number.h
+extern double number_to_double(LispValue number) {
+    if (value_is_float(number)) {
+        return value_float(number);
+    }
+    if (value_is_fixnum(number)) {
+        return (double) value_fixnum(number);
+    }
+    return bignum_to_double(number);
+}
+
+
+/**
+ * The general case of every arithmetic operation: type checking,
+ * float contagion, bignum arithmetic and elementwise vector arithmetic.
+ */
+static ValueResult number_apply_slow(NumberOperation operation, LispValue a, LispValue b) {
+    ValueResult result = { .failed = false, .error = NULL };
+
+    if (value_is_vector(a) || value_is_vector(b)) {
+        return vector_apply(operation, a, b);
+    }
+
+    if (!value_is_number(a) || !value_is_number(b)) {
+        result.failed = true;
+        result.error = lisp_runtime_error("Expected a number.");
+        return result;
+    }
+
+    if (value_is_float(a) || value_is_float(b)) {
+        double x = number_to_double(a);
+        double y = number_to_double(b);
+        switch (operation) {
+            case NUMBER_ADD: result.value = value_make_float(x + y); break;
+            case NUMBER_SUBTRACT: result.value = value_make_float(x - y); break;
+            case NUMBER_MULTIPLY: result.value = value_make_float(x * y); break;
+            case NUMBER_DIVIDE: result.value = value_make_float(x / y); break;
+        }
+        return result;
+    }
+
+    switch (operation) {
+        case NUMBER_ADD: {
+            result.value = bignum_add(a, b);
+            break;
+        }
+        case NUMBER_SUBTRACT: {
+            result.value = bignum_subtract(a, b);
+            break;
+        }
+        case NUMBER_MULTIPLY: {
+            result.value = bignum_multiply(a, b);
+            break;
+        }
+        case NUMBER_DIVIDE: {
+            if (b == value_make_fixnum(0)) {
+                result.failed = true;
+                result.error = lisp_runtime_error("Division by zero.");
+                break;
+            }
+            result.value = bignum_divide(a, b);
+            break;
+        }
+    }
+
+    if (!result.failed && result.value == LISP_ALLOCATION_FAILED) {
+        result.failed = true;
+        result.error = value_allocation_error();
+    }
+    return result;
+}
+
+
+// @see number.h
+extern ValueResult number_add_slow(LispValue a, LispValue b) {
+    return number_apply_slow(NUMBER_ADD, a, b);
+}
+
+
+// @see number.h
+extern ValueResult number_subtract_slow(LispValue a, LispValue b) {
+    return number_apply_slow(NUMBER_SUBTRACT, a, b);
+}
+
+
+// @see number.h
+extern ValueResult number_multiply_slow(LispValue a, LispValue b) {
+    return number_apply_slow(NUMBER_MULTIPLY, a, b);
+}
+
+
+// @see number.h
+extern ValueResult number_divide_slow(LispValue a, LispValue b) {
+    return number_apply_slow(NUMBER_DIVIDE, a, b);
+}
+
+
+// @see number.h
+extern LispValue number_from_literal(const char *begin, size_t length) {
+    if (memchr(begin, '.', length) != NULL) {
+        char *text = (char *) calloc(length + 1, sizeof(char));
+        memcpy(text, begin, length);
+        double number = strtod(text, NULL);
+        free(text);
+        return value_make_float(number);
+    }
+
+    // Most literals fit in a fixnum, so try that before building a bignum.
+    i64 number = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (__builtin_mul_overflow(number, 10, &number)
+                || __builtin_add_overflow(number, begin[i] - '0', &number)
+                || number > LISP_FIXNUM_MAX) {
+            return bignum_from_string(begin, length);
+        }
+    }
+
+    return value_make_fixnum(number);
+}
+
+
+// @see number.h
+extern char *number_to_string(LispValue number) {
+    if (value_is_float(number)) {
+        i32 length = snprintf(NULL, 0, "%.17g", value_float(number));
+        char *string = (char *) calloc(length + 1, sizeof(char));
+        snprintf(string, length + 1, "%.17g", value_float(number));
+        return string;
+    }
+    return bignum_to_string(number);
+}
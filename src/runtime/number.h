@@ -0,0 +1,121 @@
+#ifndef NUMBER_H
+#define NUMBER_H
+#include <stddef.h>
+
+#include "../util_types.h"
+#include "value.h"
+
+
+/**
+ * The numeric tower: fixnum -> bignum -> float. Integer arithmetic is
+ * exact, promoting fixnums to bignums on overflow and demoting results
+ * back to fixnums whenever they fit. If either operand is a float the
+ * operation is carried out in double precision.
+ *
+ * The `number_*` arithmetic functions are inline so that the common
+ * fixnum case compiles down to a tag test and an overflow-checked machine
+ * instruction. Because fixnums are stored as `2n + 1`, `a + (b - 1)`
+ * is exactly the tagged sum, and the hardware overflow flag is exactly
+ * the fixnum overflow condition. Everything else goes to the out of line
+ * `number_*_slow` functions.
+ */
+
+
+typedef enum {
+    NUMBER_ADD,
+    NUMBER_SUBTRACT,
+    NUMBER_MULTIPLY,
+    NUMBER_DIVIDE
+} NumberOperation;
+
+
+extern ValueResult number_add_slow(LispValue a, LispValue b);
+
+extern ValueResult number_subtract_slow(LispValue a, LispValue b);
+
+extern ValueResult number_multiply_slow(LispValue a, LispValue b);
+
+extern ValueResult number_divide_slow(LispValue a, LispValue b);
+
+
+inline static ValueResult number_add(LispValue a, LispValue b) {
+    ValueResult result = { .failed = false, .error = NULL };
+    i64 sum;
+
+    if (value_is_fixnum(a & b)
+            && !__builtin_add_overflow((i64) a, (i64) (b - LISP_FIXNUM_TAG), &sum)) {
+        result.value = (LispValue) sum;
+        return result;
+    }
+
+    return number_add_slow(a, b);
+}
+
+
+inline static ValueResult number_subtract(LispValue a, LispValue b) {
+    ValueResult result = { .failed = false, .error = NULL };
+    i64 difference;
+
+    if (value_is_fixnum(a & b)
+            && !__builtin_sub_overflow((i64) a, (i64) (b - LISP_FIXNUM_TAG), &difference)) {
+        result.value = (LispValue) difference;
+        return result;
+    }
+
+    return number_subtract_slow(a, b);
+}
+
+
+inline static ValueResult number_multiply(LispValue a, LispValue b) {
+    ValueResult result = { .failed = false, .error = NULL };
+    i64 product;
+
+    // n * 2m is the tagged product with its tag bit cleared.
+    if (value_is_fixnum(a & b)
+            && !__builtin_mul_overflow(value_fixnum(a), (i64) (b - LISP_FIXNUM_TAG), &product)) {
+        result.value = (LispValue) product | LISP_FIXNUM_TAG;
+        return result;
+    }
+
+    return number_multiply_slow(a, b);
+}
+
+
+/**
+ * Divide `a` by `b`. Integer division truncates toward zero; dividing
+ * an integer by zero is a runtime error.
+ */
+inline static ValueResult number_divide(LispValue a, LispValue b) {
+    ValueResult result = { .failed = false, .error = NULL };
+
+    // The only fixnum quotient that overflows is LISP_FIXNUM_MIN / -1.
+    if (value_is_fixnum(a & b) && b != value_make_fixnum(0)
+            && !(a == value_make_fixnum(LISP_FIXNUM_MIN) && b == value_make_fixnum(-1))) {
+        result.value = value_make_fixnum(value_fixnum(a) / value_fixnum(b));
+        return result;
+    }
+
+    return number_divide_slow(a, b);
+}
+
+
+/**
+ * Convert the text of an integer or float literal to a number. Integer
+ * literals too large for a fixnum become bignums.
+ */
+extern LispValue number_from_literal(const char *begin, size_t length);
+
+/**
+ * Convert a number to the nearest double.
+ */
+extern double number_to_double(LispValue number);
+
+/**
+ * Get the string representation of a number.
+ *
+ * @return A heap allocated string owned by the caller.
+ */
+extern char *number_to_string(LispValue number);
+
+
+#endif
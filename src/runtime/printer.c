@@ -0,0 +1,134 @@
+#include <stdlib.h>
+
+#include "printer.h"
+#include "number.h"
+#include "symbol.h"
+#include "map.h"
+#include "vector.h"
+#include "builtins.h"
+#include "task.h"
+#include "lisp_string.h"
+#include "../vm/bytecode.h"
+
+
+static void printer_write_string(FILE *stream, LispValue string) {
+    const char *bytes = string_bytes(string);
+    u32 length = string_length(string);
+    fputc('"', stream);
+    for (u32 i = 0; i < length; ++i) {
+        char next = bytes[i];
+        switch (next) {
+            case '\n': fputs("\\n", stream); break;
+            case '\t': fputs("\\t", stream); break;
+            case '\r': fputs("\\r", stream); break;
+            case '\0': fputs("\\0", stream); break;
+            case '\\': fputs("\\\\", stream); break;
+            case '"': fputs("\\\"", stream); break;
+            default: fputc(next, stream); break;
+        }
+    }
+    fputc('"', stream);
+}
+
+
+static void printer_write_entry(LispValue key, LispValue value, void *context) {
+    FILE *stream = (FILE *) context;
+    fputc(' ', stream);
+    printer_write(stream, key, true);
+    fputc(' ', stream);
+    printer_write(stream, value, true);
+}
+
+
+static void printer_write_vector(FILE *stream, LispValue vector) {
+    u32 length = vector_length(vector);
+    fputs(value_is_f64vector(vector) ? "(f64vector" : "(i64vector", stream);
+    for (u32 i = 0; i < length; ++i) {
+        if (value_is_f64vector(vector)) {
+            fprintf(stream, " %.17g", value_f64vector(vector)->elements[i]);
+        } else {
+            fprintf(stream, " %lld", (long long) value_i64vector(vector)->elements[i]);
+        }
+    }
+    fputc(')', stream);
+}
+
+
+static void printer_write_function(FILE *stream, LispFunction *function) {
+    if (value_is_symbol(function->name)) {
+        LispSymbol *name = value_symbol(function->name);
+        fprintf(stream, "#<function %.*s>", (int) name->length, name->name);
+    } else {
+        fputs("#<function>", stream);
+    }
+}
+
+
+// @see printer.h
+extern void printer_write(FILE *stream, LispValue value, bool readable) {
+    if (value_is_fixnum(value)) {
+        fprintf(stream, "%lld", (long long) value_fixnum(value));
+        return;
+    }
+
+    switch (value) {
+        case LISP_NIL: fputs("nil", stream); return;
+        case LISP_TRUE: fputs("true", stream); return;
+        case LISP_FALSE: fputs("false", stream); return;
+        default: break;
+    }
+
+    switch (value_as_object(value)->type) {
+        case LISP_OBJECT_FLOAT:
+        case LISP_OBJECT_BIGNUM: {
+            char *number = number_to_string(value);
+            fputs(number, stream);
+            free(number);
+            break;
+        }
+        case LISP_OBJECT_SYMBOL: {
+            LispSymbol *symbol = value_symbol(value);
+            fwrite(symbol->name, 1, symbol->length, stream);
+            break;
+        }
+        case LISP_OBJECT_STRING: {
+            if (readable) {
+                printer_write_string(stream, value);
+            } else {
+                fwrite(string_bytes(value), 1, string_length(value), stream);
+            }
+            break;
+        }
+        case LISP_OBJECT_MAP: {
+            fputs("(hashmap", stream);
+            map_for_each(value, printer_write_entry, stream);
+            fputc(')', stream);
+            break;
+        }
+        case LISP_OBJECT_F64VECTOR:
+        case LISP_OBJECT_I64VECTOR: {
+            printer_write_vector(stream, value);
+            break;
+        }
+        case LISP_OBJECT_BUILTIN: {
+            fprintf(stream, "#<builtin %s>", value_builtin(value)->builtin->name);
+            break;
+        }
+        case LISP_OBJECT_FUNCTION: {
+            printer_write_function(stream, value_function(value));
+            break;
+        }
+        case LISP_OBJECT_CLOSURE: {
+            printer_write_function(stream, value_closure(value)->function);
+            break;
+        }
+        case LISP_OBJECT_TASK: {
+            fprintf(stream, "#<task %u>", value_task(value)->id);
+            break;
+        }
+        case LISP_OBJECT_CHANNEL: {
+            fputs("#<channel>", stream);
+            break;
+        }
+    }
+}
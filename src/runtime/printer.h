@@ -0,0 +1,18 @@
+#ifndef PRINTER_H
+#define PRINTER_H
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "../util_types.h"
+#include "value.h"
+
+
+/**
+ * Write `value` to `stream`. A readable value is written as it would be
+ * written in source code where there is a way to, so that strings are
+ * quoted and escaped; otherwise strings are written as their bytes.
+ */
+extern void printer_write(FILE *stream, LispValue value, bool readable);
+
+
+#endif
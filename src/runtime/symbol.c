@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "symbol.h"
+
+
+/**
+ * The symbol table: an open addressing hash table of symbols keyed by
+ * name, kept at most half full, and the symbols in order of their IDs.
+ * Modules are compiled on several threads at once, so interning is
+ * done under a lock.
+ *
+ * The symbols in order of their IDs are also read without the lock, by
+ * `symbol_table` in a signal handler. So `by_id` and `count` are
+ * published with atomic stores, and an array that has been outgrown is
+ * never freed, since a reader may still be using it. Those arrays add
+ * up to less than the current one.
+ */
+static struct {
+    pthread_mutex_t lock;
+    LispSymbol **slots;
+    u32 slot_count;
+    LispSymbol **by_id;
+    u32 count;
+    u32 capacity;
+} symbols = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+
+static u32 symbol_name_hash(const char *name, size_t length) {
+    // FNV-1a
+    u32 hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (u8) name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+static void symbol_table_grow(void) {
+    u32 slot_count = symbols.slot_count == 0 ? 0x100 : symbols.slot_count * 2;
+    LispSymbol **slots = (LispSymbol **) calloc(slot_count, sizeof(LispSymbol *));
+
+    for (u32 i = 0; i < symbols.count; ++i) {
+        LispSymbol *symbol = symbols.by_id[i];
+        u32 slot = symbol_name_hash(symbol->name, symbol->length) & (slot_count - 1);
+        while (slots[slot] != NULL) {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots[slot] = symbol;
+    }
+
+    free(symbols.slots);
+    symbols.slots = slots;
+    symbols.slot_count = slot_count;
+}
+
+
+// @see symbol.h
+extern LispValue symbol_intern(const char *name, size_t length) {
+    pthread_mutex_lock(&symbols.lock);
+    if (2 * (symbols.count + 1) > symbols.slot_count) {
+        symbol_table_grow();
+    }
+
+    u32 slot = symbol_name_hash(name, length) & (symbols.slot_count - 1);
+    for (LispSymbol *symbol; (symbol = symbols.slots[slot]) != NULL; slot = (slot + 1) & (symbols.slot_count - 1)) {
+        if (symbol->length == length && memcmp(symbol->name, name, length) == 0) {
+            pthread_mutex_unlock(&symbols.lock);
+            return value_from_object(symbol);
+        }
+    }
+
+    LispSymbol *symbol = value_allocate_object(LISP_OBJECT_SYMBOL, sizeof(LispSymbol) + length + 1);
+    symbol->id = symbols.count;
+    symbol->length = (u32) length;
+    memcpy(symbol->name, name, length);
+    symbol->name[length] = '\0';
+
+    if (symbols.count == symbols.capacity) {
+        symbols.capacity = symbols.capacity == 0 ? 0x100 : symbols.capacity * 2;
+        LispSymbol **by_id = (LispSymbol **) malloc(symbols.capacity * sizeof(LispSymbol *));
+        if (symbols.count > 0) {
+            memcpy(by_id, symbols.by_id, symbols.count * sizeof(LispSymbol *));
+        }
+        __atomic_store_n(&symbols.by_id, by_id, __ATOMIC_RELEASE);
+    }
+    symbols.by_id[symbols.count] = symbol;
+    __atomic_store_n(&symbols.count, symbols.count + 1, __ATOMIC_RELEASE);
+    symbols.slots[slot] = symbol;
+
+    pthread_mutex_unlock(&symbols.lock);
+    return value_from_object(symbol);
+}
+
+
+// @see symbol.h
+extern LispValue symbol_from_id(u32 id) {
+    return value_from_object(__atomic_load_n(&symbols.by_id, __ATOMIC_ACQUIRE)[id]);
+}
+
+
+// @see symbol.h
+extern u32 symbol_count(void) {
+    return __atomic_load_n(&symbols.count, __ATOMIC_ACQUIRE);
+}
+
+
+// @see symbol.h
+extern LispSymbol *const *symbol_table(u32 *count) {
+    // The count is read first, so that the array read after it holds at
+    // least that many symbols.
+    *count = __atomic_load_n(&symbols.count, __ATOMIC_ACQUIRE);
+    return __atomic_load_n(&symbols.by_id, __ATOMIC_ACQUIRE);
+}
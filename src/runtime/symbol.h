@@ -0,0 +1,59 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+#include <stddef.h>
+
+#include "../util_types.h"
+#include "value.h"
+
+
+/**
+ * An interned name. There is exactly one symbol per distinct name, so
+ * symbols are compared by identity, and each has a small sequential ID
+ * that is used in place of hashing its name.
+ */
+typedef struct {
+    LispObject header;
+    u32 id;
+    u32 length;
+    char name[];
+} LispSymbol;
+
+
+inline static bool value_is_symbol(LispValue value) {
+    return value_is_object_type(value, LISP_OBJECT_SYMBOL);
+}
+
+
+inline static LispSymbol *value_symbol(LispValue value) {
+    return (LispSymbol *) value_as_object(value);
+}
+
+
+/**
+ * Get the symbol named by the `length` bytes at `name`, creating it
+ * the first time the name is seen.
+ */
+extern LispValue symbol_intern(const char *name, size_t length);
+
+/**
+ * Get the symbol with the ID `id`, which must have been interned.
+ */
+extern LispValue symbol_from_id(u32 id);
+
+/**
+ * Get the number of symbols interned so far. IDs range from 0 up to,
+ * but not including, this number.
+ */
+extern u32 symbol_count(void);
+
+/**
+ * Get the symbols interned so far, in order of their IDs, and their
+ * number in `count`. Unlike the rest of the table, this takes no lock,
+ * so it is safe to call from a signal handler, even one that interrupts
+ * `symbol_intern`. The array stays valid, but symbols interned after the
+ * call are not in it.
+ */
+extern LispSymbol *const *symbol_table(u32 *count);
+
+
+#endif
@@ -0,0 +1,477 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+
+#include "task.h"
+#include "../vm/governor.h"
+
+#if !defined(__x86_64__)
+#include <ucontext.h>
+#endif
+
+// The most ready file descriptors taken from `epoll` at once.
+#define TASK_POLL_EVENTS 0x40
+
+// The top of a recycled stack that is kept backed by memory, since most
+// tasks never go deeper. Anything below it is given back to the kernel.
+#define TASK_STACK_RETAINED 0x10000
+
+
+typedef struct {
+    Task main;
+    Task *current;
+    TaskQueue runnable;
+
+    // A task that has just finished, whose stack cannot be recycled until
+    // the scheduler has switched off it.
+    Task *finished;
+    u8 *stack_pool[TASK_STACK_POOL_SIZE];
+    u32 stack_pool_count;
+    size_t page_size;
+
+    u32 next_id;
+    int epoll;
+    u32 waiting_fds;
+    u32 switches;
+} Scheduler;
+
+
+static Scheduler scheduler = { .current = NULL };
+
+
+#if defined(__x86_64__)
+
+/**
+ * Save the callee-saved registers of the running code on its stack and
+ * its stack pointer in `*from`, then restore the ones saved at `to`.
+ */
+extern void task_context_switch(void **from, void *to);
+
+__asm__(
+    ".text\n"
+    ".p2align 4\n"
+    ".type task_context_switch, @function\n"
+    "task_context_switch:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size task_context_switch, .-task_context_switch\n"
+);
+
+
+/**
+ * Lay out a stack so that switching to it enters `entry` as if it had
+ * been called, with the stack aligned as the ABI requires.
+ */
+static bool task_context_create(Task *task, void (*entry)(void)) {
+    void **top = (void **) (task->stack + TASK_STACK_SIZE);
+    // A null return address, then where `ret` goes, then the six registers.
+    *--top = NULL;
+    *--top = (void *) entry;
+    for (u32 i = 0; i < 6; ++i) {
+        *--top = NULL;
+    }
+    task->context = top;
+    return true;
+}
+
+
+inline static void task_context_free(Task *task) {
+    (void) task;
+}
+
+
+inline static void task_switch_context(Task *from, Task *to) {
+    task_context_switch(&from->context, to->context);
+}
+
+#else
+
+// Elsewhere the switch goes through `ucontext`, which is slower since it
+// also saves the signal mask, but is portable.
+
+static bool task_context_create(Task *task, void (*entry)(void)) {
+    ucontext_t *context = (ucontext_t *) malloc(sizeof(ucontext_t));
+    if (context == NULL || getcontext(context) != 0) {
+        free(context);
+        return false;
+    }
+    context->uc_stack.ss_sp = task->stack + scheduler.page_size;
+    context->uc_stack.ss_size = TASK_STACK_SIZE - scheduler.page_size;
+    context->uc_link = NULL;
+    makecontext(context, entry, 0);
+    task->context = context;
+    return true;
+}
+
+
+inline static void task_context_free(Task *task) {
+    free(task->context);
+    task->context = NULL;
+}
+
+
+inline static void task_switch_context(Task *from, Task *to) {
+    if (from->context == NULL) {
+        from->context = malloc(sizeof(ucontext_t));
+    }
+    swapcontext((ucontext_t *) from->context, (ucontext_t *) to->context);
+}
+
+#endif
+
+
+/**
+ * Set up the scheduler, with the running code as the main task, the
+ * first time any task function is used.
+ */
+inline static void task_initialize(void) {
+    if (scheduler.current != NULL) {
+        return;
+    }
+
+    scheduler.main.header.type = LISP_OBJECT_TASK;
+    scheduler.main.state = TASK_RUNNING;
+    scheduler.current = &scheduler.main;
+    scheduler.page_size = (size_t) sysconf(_SC_PAGESIZE);
+    scheduler.epoll = -1;
+}
+
+
+/**
+ * Reserve a stack, reusing the stack of a finished task if there is one.
+ * The lowest page is a guard page, so that overflowing the stack faults
+ * rather than overwriting whatever is mapped below it.
+ */
+static u8 *task_stack_allocate(void) {
+    if (scheduler.stack_pool_count > 0) {
+        return scheduler.stack_pool[--scheduler.stack_pool_count];
+    }
+
+    void *stack = mmap(NULL, TASK_STACK_SIZE, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (stack == MAP_FAILED) {
+        return NULL;
+    }
+    mprotect(stack, scheduler.page_size, PROT_NONE);
+    return (u8 *) stack;
+}
+
+
+/**
+ * Recycle the stack of the task that last finished, now that nothing is
+ * running on it.
+ */
+static void task_reclaim(void) {
+    Task *task = scheduler.finished;
+    if (task == NULL) {
+        return;
+    }
+    scheduler.finished = NULL;
+
+    if (scheduler.stack_pool_count < TASK_STACK_POOL_SIZE) {
+        madvise(task->stack + scheduler.page_size,
+            TASK_STACK_SIZE - TASK_STACK_RETAINED - scheduler.page_size, MADV_DONTNEED);
+        scheduler.stack_pool[scheduler.stack_pool_count++] = task->stack;
+    } else {
+        munmap(task->stack, TASK_STACK_SIZE);
+    }
+
+    task_context_free(task);
+    task->stack = NULL;
+}
+
+
+/**
+ * Wake the tasks whose file descriptors are ready. If `block`, wait
+ * until at least one is, but not past the deadline of the evaluation.
+ *
+ * @return Whether the deadline has not passed.
+ */
+static bool task_poll(bool block) {
+    struct epoll_event events[TASK_POLL_EVENTS];
+    int timeout = block ? governor_remaining_milliseconds() : 0;
+    int count = epoll_wait(scheduler.epoll, events, TASK_POLL_EVENTS, timeout);
+
+    for (int i = 0; i < count; ++i) {
+        scheduler.waiting_fds--;
+        task_wake((Task *) events[i].data.ptr);
+    }
+    return !block || count != 0 || timeout < 0;
+}
+
+
+/**
+ * Switch from the current task, which has already been queued wherever
+ * it is waiting, to the next runnable task.
+ */
+static void task_schedule(void) {
+    if (scheduler.waiting_fds > 0 && ++scheduler.switches % TASK_POLL_INTERVAL == 0) {
+        task_poll(false);
+    }
+
+    Task *next = task_queue_pop(&scheduler.runnable);
+    while (next == NULL) {
+        if (scheduler.waiting_fds > 0 && task_poll(true)) {
+            next = task_queue_pop(&scheduler.runnable);
+            continue;
+        }
+
+        // Nothing can run again, or not before the deadline, and the main
+        // task, which is not running and cannot finish, must be blocked:
+        // wake it to fail.
+        next = &scheduler.main;
+        if (scheduler.waiting_fds > 0) {
+            next->timed_out = true;
+        } else {
+            next->deadlocked = true;
+        }
+    }
+
+    Task *previous = scheduler.current;
+    scheduler.current = next;
+    next->state = TASK_RUNNING;
+    if (next != previous) {
+        task_switch_context(previous, next);
+    }
+    task_reclaim();
+}
+
+
+/**
+ * Where every task starts running, on its own stack.
+ */
+static void task_entry(void) {
+    task_reclaim();
+
+    Task *task = scheduler.current;
+    task->result = task->function(task->argument);
+    task->state = TASK_FINISHED;
+
+    Task *joiner;
+    while ((joiner = task_queue_pop(&task->joiners)) != NULL) {
+        task_wake(joiner);
+    }
+
+    scheduler.finished = task;
+    task_schedule();
+}
+
+
+// @see task.h
+extern Task *task_current(void) {
+    task_initialize();
+    return scheduler.current;
+}
+
+
+// @see task.h
+extern Task *task_spawn(TaskFunction function, void *argument) {
+    task_initialize();
+
+    Task *task = value_allocate_object(LISP_OBJECT_TASK, sizeof(Task));
+    if (task == NULL) {
+        return NULL;
+    }
+
+    task->stack = task_stack_allocate();
+    if (task->stack == NULL || !task_context_create(task, task_entry)) {
+        if (task->stack != NULL) {
+            munmap(task->stack, TASK_STACK_SIZE);
+        }
+        free(task);
+        return NULL;
+    }
+
+    task->id = ++scheduler.next_id;
+    task->function = function;
+    task->argument = argument;
+    task_wake(task);
+    return task;
+}
+
+
+// @see task.h
+extern void task_yield(void) {
+    task_initialize();
+    if (scheduler.runnable.head == NULL) {
+        return;
+    }
+
+    scheduler.current->state = TASK_RUNNABLE;
+    task_queue_push(&scheduler.runnable, scheduler.current);
+    task_schedule();
+}
+
+
+// @see task.h
+extern bool task_block(void) {
+    task_initialize();
+
+    Task *task = scheduler.current;
+    task->state = TASK_BLOCKED;
+    task_schedule();
+
+    if (task->deadlocked || task->timed_out) {
+        task->deadlocked = false;
+        return false;
+    }
+    return true;
+}
+
+
+// @see task.h
+extern LispError *task_block_error(void) {
+    Task *task = task_current();
+    if (task->timed_out) {
+        task->timed_out = false;
+        return governor_time_error();
+    }
+    return lisp_runtime_error(TASK_DEADLOCK_MESSAGE);
+}
+
+
+// @see task.h
+extern void task_wake(Task *task) {
+    task->state = TASK_RUNNABLE;
+    task_queue_push(&scheduler.runnable, task);
+}
+
+
+// @see task.h
+extern bool task_wait_fd(int fd, TaskEvent events) {
+    task_initialize();
+
+    if (scheduler.epoll < 0) {
+        scheduler.epoll = epoll_create1(EPOLL_CLOEXEC);
+        if (scheduler.epoll < 0) {
+            return false;
+        }
+    }
+
+    // The descriptor stays in the set, disabled, after it fires once, so
+    // waiting on it again only needs to modify its entry.
+    struct epoll_event event = {
+        .events = EPOLLONESHOT
+            | ((events & TASK_READABLE) != 0 ? EPOLLIN : 0)
+            | ((events & TASK_WRITABLE) != 0 ? EPOLLOUT : 0),
+        .data.ptr = scheduler.current
+    };
+    if (epoll_ctl(scheduler.epoll, EPOLL_CTL_MOD, fd, &event) != 0) {
+        if (errno != ENOENT || epoll_ctl(scheduler.epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+            return false;
+        }
+    }
+
+    scheduler.waiting_fds++;
+    if (!task_block()) {
+        // Only the deadline wakes a task that is still waiting, and the
+        // descriptor must not wake it once it has moved on.
+        epoll_ctl(scheduler.epoll, EPOLL_CTL_DEL, fd, NULL);
+        scheduler.waiting_fds--;
+        scheduler.current->timed_out = false;
+        errno = ETIMEDOUT;
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * Make `fd` return `EAGAIN` rather than block.
+ */
+static bool task_set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0) {
+        return false;
+    }
+    return (flags & O_NONBLOCK) != 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+
+// @see task.h
+extern ssize_t task_read(int fd, void *buffer, size_t size) {
+    if (!task_set_nonblocking(fd)) {
+        return -1;
+    }
+
+    while (1) {
+        ssize_t count = read(fd, buffer, size);
+        if (count >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            return count;
+        }
+        if (errno != EINTR && !task_wait_fd(fd, TASK_READABLE)) {
+            return -1;
+        }
+    }
+}
+
+
+// @see task.h
+extern ssize_t task_write(int fd, const void *buffer, size_t size) {
+    if (!task_set_nonblocking(fd)) {
+        return -1;
+    }
+
+    while (1) {
+        ssize_t count = write(fd, buffer, size);
+        if (count >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            return count;
+        }
+        if (errno != EINTR && !task_wait_fd(fd, TASK_WRITABLE)) {
+            return -1;
+        }
+    }
+}
+
+
+// @see task.h
+extern ValueResult task_join(Task *task) {
+    while (task->state != TASK_FINISHED) {
+        Task *current = task_current();
+        if (task == current) {
+            ValueResult result = { .failed = true, .error = lisp_runtime_error("A task cannot join itself.") };
+            return result;
+        }
+
+        task_queue_push(&task->joiners, current);
+        if (!task_block()) {
+            task_queue_remove(&task->joiners, current);
+            ValueResult result = { .failed = true, .error = task_block_error() };
+            return result;
+        }
+    }
+    return task->result;
+}
+
+
+// @see task.h
+extern void task_run(void) {
+    task_initialize();
+    while (scheduler.runnable.head != NULL || scheduler.waiting_fds > 0) {
+        if (scheduler.runnable.head == NULL) {
+            if (!task_poll(true)) {
+                return;
+            }
+        } else {
+            task_yield();
+        }
+    }
+}
@@ -0,0 +1,243 @@
+#ifndef TASK_H
+#define TASK_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "../util_types.h"
+#include "value.h"
+
+// The address space reserved for the stack of each task. Pages are only
+// backed by memory once the task touches them, so a task that stays
+// shallow costs a few kilobytes however large the reservation is.
+#define TASK_STACK_SIZE 0x100000
+
+// The most stacks of finished tasks kept around for new tasks to reuse.
+#define TASK_STACK_POOL_SIZE 0x100
+
+// How many task switches may pass between checks for ready file
+// descriptors while other tasks are still runnable.
+#define TASK_POLL_INTERVAL 0x40
+
+// The error of an operation that would block a task that nothing can wake.
+#define TASK_DEADLOCK_MESSAGE "Every task is blocked."
+
+
+/**
+ * Lightweight cooperative tasks. Every task runs on a stack of its own,
+ * so it can be suspended anywhere, even deep inside a builtin, and all of
+ * them share the one OS thread that created them. A task runs until it
+ * yields, blocks on a channel, waits for a file descriptor or finishes;
+ * the scheduler then resumes the task that has been runnable longest.
+ *
+ * Tasks waiting for file descriptors are parked in an `epoll` set, which
+ * is polled whenever no task can run and every `TASK_POLL_INTERVAL`
+ * switches otherwise, so thousands of streams can be served by as many
+ * tasks without a thread for each.
+ *
+ * The code that was running before the first task was spawned is the
+ * main task. When every task is blocked and no file descriptor can wake
+ * one of them, the main task is woken with a deadlock error, and when the
+ * deadline of the evaluation passes while they wait for file descriptors,
+ * with a time limit error.
+ */
+
+typedef enum {
+    TASK_RUNNABLE,
+    TASK_RUNNING,
+    TASK_BLOCKED,
+    TASK_FINISHED
+} TaskState;
+
+
+typedef enum {
+    TASK_READABLE = 0x1,
+    TASK_WRITABLE = 0x2
+} TaskEvent;
+
+
+struct Task;
+
+
+/**
+ * A first-in first-out list of tasks, linked through the tasks. A task
+ * is in at most one queue at a time.
+ */
+typedef struct {
+    struct Task *head;
+    struct Task *tail;
+} TaskQueue;
+
+
+/**
+ * The body of a task. Its result becomes the result of the task.
+ */
+typedef ValueResult (*TaskFunction)(void *argument);
+
+
+typedef struct Task {
+    LispObject header;
+    u32 id;
+    TaskState state;
+
+    // Where the task was suspended: its saved stack pointer, or on other
+    // processors than x86-64 a `ucontext_t`.
+    void *context;
+    // The reserved stack, including its guard page, or `NULL` for the
+    // main task, which runs on the stack of the thread.
+    u8 *stack;
+
+    TaskFunction function;
+    void *argument;
+    // Set once the task has finished.
+    ValueResult result;
+
+    // The next task in whichever queue the task is in.
+    struct Task *next;
+    // A value handed to or from the task while it is blocked on a channel.
+    LispValue transfer;
+    // Set if the task was woken because a channel was closed.
+    bool closed;
+    // Set if the task was woken because it can never be woken otherwise.
+    bool deadlocked;
+    // Set if the task was woken because the deadline of the evaluation
+    // passed while every task was blocked.
+    bool timed_out;
+
+    // The tasks waiting for this one to finish.
+    TaskQueue joiners;
+} Task;
+
+
+inline static bool value_is_task(LispValue value) {
+    return value_is_object_type(value, LISP_OBJECT_TASK);
+}
+
+
+inline static Task *value_task(LispValue value) {
+    return (Task *) value_as_object(value);
+}
+
+
+inline static void task_queue_push(TaskQueue *queue, Task *task) {
+    task->next = NULL;
+    if (queue->tail == NULL) {
+        queue->head = task;
+    } else {
+        queue->tail->next = task;
+    }
+    queue->tail = task;
+}
+
+
+inline static Task *task_queue_pop(TaskQueue *queue) {
+    Task *task = queue->head;
+    if (task != NULL) {
+        queue->head = task->next;
+        if (queue->head == NULL) {
+            queue->tail = NULL;
+        }
+        task->next = NULL;
+    }
+    return task;
+}
+
+
+/**
+ * Take `task` out of `queue`, if it is there.
+ */
+inline static void task_queue_remove(TaskQueue *queue, Task *task) {
+    Task *previous = NULL;
+    for (Task *entry = queue->head; entry != NULL; previous = entry, entry = entry->next) {
+        if (entry != task) {
+            continue;
+        }
+        if (previous == NULL) {
+            queue->head = entry->next;
+        } else {
+            previous->next = entry->next;
+        }
+        if (queue->tail == entry) {
+            queue->tail = previous;
+        }
+        entry->next = NULL;
+        return;
+    }
+}
+
+
+/**
+ * Get the task that is running.
+ */
+extern Task *task_current(void);
+
+/**
+ * Create a task that runs `function(argument)` and make it runnable. It
+ * first runs when the current task next gives way.
+ *
+ * @return The task, or `NULL` if its stack could not be allocated.
+ */
+extern Task *task_spawn(TaskFunction function, void *argument);
+
+/**
+ * Let every other runnable task run before the current one continues.
+ */
+extern void task_yield(void);
+
+/**
+ * Suspend the current task, which must have been put in a queue where
+ * something will find it, until `task_wake` is called on it.
+ *
+ * @return Whether the task was woken normally, or `false` if it is the
+ * main task and no task could wake it before the deadline, in which case
+ * `task_block_error` tells why.
+ */
+extern bool task_block(void);
+
+/**
+ * Get the error for the current task not being woken normally.
+ */
+extern LispError *task_block_error(void);
+
+/**
+ * Make a blocked task runnable again.
+ */
+extern void task_wake(Task *task);
+
+/**
+ * Suspend the current task until `fd` is ready for any of `events`. Only
+ * one task may wait for a given file descriptor at a time.
+ *
+ * @return Whether the wait succeeded; if not, `errno` is set, to
+ * `ETIMEDOUT` if the deadline of the evaluation passed first.
+ */
+extern bool task_wait_fd(int fd, TaskEvent events);
+
+/**
+ * Read from `fd` like `read`, but suspend the current task rather than
+ * the whole thread while there is nothing to read. `fd` is switched to
+ * non-blocking mode.
+ */
+extern ssize_t task_read(int fd, void *buffer, size_t size);
+
+/**
+ * Write to `fd` like `write`, suspending only the current task while
+ * `fd` is full. `fd` is switched to non-blocking mode.
+ */
+extern ssize_t task_write(int fd, const void *buffer, size_t size);
+
+/**
+ * Suspend the current task until `task` has finished.
+ *
+ * @return The result of `task`.
+ */
+extern ValueResult task_join(Task *task);
+
+/**
+ * Run the other tasks until every one of them has finished or is blocked
+ * forever, or until the deadline passes while they wait.
+ */
+extern void task_run(void);
+
+
+#endif
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "value.h"
+#include "bignum.h"
+#include "symbol.h"
+#include "lisp_string.h"
+#include "../vm/governor.h"
+
+
+// The bytes allocated for values by each thread.
+static __thread u64 value_allocated = 0;
+
+// The total past which the thread refuses allocations, or interrupts
+// the governor for those it only counts.
+static __thread u64 value_threshold = UINT64_MAX;
+
+// The size of the last allocation the thread refused for passing the
+// threshold, or 0 if the last one it could not make ran out of memory.
+static __thread u64 value_refused = 0;
+
+
+/**
+ * Count `size` more bytes, and interrupt the governor the first time the
+ * total passes the threshold.
+ */
+inline static void value_count(size_t size) {
+    bool within = value_allocated <= value_threshold;
+    value_allocated += size;
+    if (within && value_allocated > value_threshold) {
+        governor_interrupt();
+    }
+}
+
+
+// @see value.h
+extern void *value_allocate_object(LispObjectType type, size_t size) {
+    LispObject *object = (LispObject *) calloc(1, size);
+    if (object == NULL) {
+        fprintf(stderr, "\x1b[31merror:\x1b[0m Out of memory for a value of %zu bytes.\n", size);
+        abort();
+    }
+    value_count(size);
+    object->type = type;
+    return object;
+}
+
+
+// @see value.h
+extern void *value_try_allocate_object(LispObjectType type, size_t size) {
+    if (!value_can_allocate(size)) {
+        return NULL;
+    }
+    LispObject *object = (LispObject *) calloc(1, size);
+    if (object == NULL) {
+        value_refused = 0;
+        return NULL;
+    }
+    value_count(size);
+    object->type = type;
+    return object;
+}
+
+
+// @see value.h
+extern bool value_can_allocate(u64 size) {
+    if (value_allocated <= value_threshold && size <= value_threshold - value_allocated) {
+        return true;
+    }
+    value_refused = size;
+    return false;
+}
+
+
+// @see value.h
+extern LispError *value_allocation_error(void) {
+    if (value_refused != 0) {
+        return governor_heap_error(value_refused);
+    }
+    return lisp_internal_error("Out of memory.", LISP_OUT_OF_MEMORY);
+}
+
+
+// @see value.h
+extern void value_count_allocation(size_t size) {
+    value_count(size);
+}
+
+
+// @see value.h
+extern void value_set_threshold(u64 threshold) {
+    value_threshold = threshold;
+}
+
+
+// @see value.h
+extern u64 value_allocated_bytes(void) {
+    return value_allocated;
+}
+
+
+// @see value.h
+extern LispValue value_make_float(double number) {
+    LispFloat *boxed = value_allocate_object(LISP_OBJECT_FLOAT, sizeof(LispFloat));
+    boxed->value = number;
+    return value_from_object(boxed);
+}
+
+
+/**
+ * Scramble the bits of `x` so that nearby inputs give unrelated hashes.
+ * This is the finalizer of SplitMix64.
+ */
+inline static u64 value_hash_mix(u64 x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+
+// @see value.h
+extern bool value_equal(LispValue a, LispValue b) {
+    if (a == b) {
+        return true;
+    }
+    if (!value_is_object(a) || !value_is_object(b)) {
+        return false;
+    }
+
+    LispObject *object_a = value_as_object(a);
+    LispObject *object_b = value_as_object(b);
+    if (object_a->type != object_b->type) {
+        return false;
+    }
+
+    switch (object_a->type) {
+        case LISP_OBJECT_FLOAT: return value_float(a) == value_float(b);
+        case LISP_OBJECT_BIGNUM: return bignum_compare(a, b) == 0;
+        case LISP_OBJECT_STRING: {
+            return string_length(a) == string_length(b)
+                && memcmp(string_bytes(a), string_bytes(b), string_length(a)) == 0;
+        }
+        default: return false;
+    }
+}
+
+
+// @see value.h
+extern u64 value_hash(LispValue value) {
+    if (!value_is_object(value)) {
+        return value_hash_mix(value);
+    }
+
+    switch (value_as_object(value)->type) {
+        case LISP_OBJECT_FLOAT: {
+            double number = value_float(value);
+            // Zero and negative zero are equal, so they must hash alike.
+            if (number == 0.0) {
+                number = 0.0;
+            }
+            u64 bits;
+            memcpy(&bits, &number, sizeof(bits));
+            return value_hash_mix(bits);
+        }
+        case LISP_OBJECT_BIGNUM: {
+            LispBignum *bignum = (LispBignum *) value_as_object(value);
+            u64 hash = bignum->negative;
+            for (u32 i = 0; i < bignum->length; ++i) {
+                hash = value_hash_mix(hash ^ bignum->limbs[i]);
+            }
+            return hash;
+        }
+        case LISP_OBJECT_SYMBOL: {
+            return value_hash_mix(value_symbol(value)->id);
+        }
+        case LISP_OBJECT_STRING: {
+            // FNV-1a, finished off by the mixer.
+            const char *bytes = string_bytes(value);
+            u32 length = string_length(value);
+            u64 hash = 0xcbf29ce484222325ull;
+            for (u32 i = 0; i < length; ++i) {
+                hash = (hash ^ (u8) bytes[i]) * 0x100000001b3ull;
+            }
+            return value_hash_mix(hash);
+        }
+        default: {
+            return value_hash_mix(value);
+        }
+    }
+}
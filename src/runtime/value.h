@@ -0,0 +1,220 @@
+#ifndef VALUE_H
+#define VALUE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../util_types.h"
+#include "../lisp/error.h"
+
+
+/**
+ * A runtime value. A `LispValue` is a single tagged machine word:
+ * - Fixnums are stored immediately, shifted left by one with the lowest
+ *   bit set, so that most integer arithmetic never touches the heap.
+ * - `nil`, `true` and `false` are small tagged constants.
+ * - Every other value is a pointer to a heap allocated `LispObject`, which
+ *   is always at least 8-byte aligned and therefore has its low bits clear.
+ */
+typedef u64 LispValue;
+
+#define LISP_FIXNUM_TAG ((LispValue) 0x1)
+#define LISP_IMMEDIATE_MASK ((LispValue) 0x7)
+
+#define LISP_NIL ((LispValue) 0x2)
+#define LISP_FALSE ((LispValue) 0x6)
+#define LISP_TRUE ((LispValue) 0xA)
+
+// Not a value: what the functions that make a value of a size the
+// program controls return when they cannot allocate it, in which case
+// `value_allocation_error` tells why.
+#define LISP_ALLOCATION_FAILED ((LispValue) 0)
+
+#define LISP_FIXNUM_MAX ((i64) (INT64_MAX >> 1))
+#define LISP_FIXNUM_MIN (-LISP_FIXNUM_MAX - 1)
+
+
+typedef enum {
+    LISP_OBJECT_FLOAT,
+    LISP_OBJECT_BIGNUM,
+    LISP_OBJECT_SYMBOL,
+    LISP_OBJECT_MAP,
+    LISP_OBJECT_F64VECTOR,
+    LISP_OBJECT_I64VECTOR,
+    LISP_OBJECT_BUILTIN,
+    LISP_OBJECT_TASK,
+    LISP_OBJECT_CHANNEL,
+    LISP_OBJECT_STRING,
+    LISP_OBJECT_FUNCTION,
+    LISP_OBJECT_CLOSURE
+} LispObjectType;
+
+
+/**
+ * The header shared by every heap allocated value. Concrete object
+ * types embed it as their first member.
+ */
+typedef struct {
+    LispObjectType type;
+} LispObject;
+
+
+typedef struct {
+    LispObject header;
+    double value;
+} LispFloat;
+
+
+typedef struct {
+    bool failed;
+    union {
+        LispValue value;
+        LispError *error;
+    };
+} ValueResult;
+
+
+inline static bool value_is_fixnum(LispValue value) {
+    return (value & LISP_FIXNUM_TAG) != 0;
+}
+
+
+inline static LispValue value_make_fixnum(i64 number) {
+    return (((u64) number) << 1) | LISP_FIXNUM_TAG;
+}
+
+
+inline static i64 value_fixnum(LispValue value) {
+    return ((i64) value) >> 1;
+}
+
+
+inline static bool value_fits_fixnum(i64 number) {
+    return number >= LISP_FIXNUM_MIN && number <= LISP_FIXNUM_MAX;
+}
+
+
+inline static bool value_is_object(LispValue value) {
+    return value != 0 && (value & LISP_IMMEDIATE_MASK) == 0;
+}
+
+
+inline static LispObject *value_as_object(LispValue value) {
+    return (LispObject *) (uintptr_t) value;
+}
+
+
+inline static LispValue value_from_object(void *object) {
+    return (LispValue) (uintptr_t) object;
+}
+
+
+inline static bool value_is_object_type(LispValue value, LispObjectType type) {
+    return value_is_object(value) && value_as_object(value)->type == type;
+}
+
+
+inline static bool value_is_float(LispValue value) {
+    return value_is_object_type(value, LISP_OBJECT_FLOAT);
+}
+
+
+inline static bool value_is_bignum(LispValue value) {
+    return value_is_object_type(value, LISP_OBJECT_BIGNUM);
+}
+
+
+inline static bool value_is_integer(LispValue value) {
+    return value_is_fixnum(value) || value_is_bignum(value);
+}
+
+
+inline static bool value_is_number(LispValue value) {
+    return value_is_integer(value) || value_is_float(value);
+}
+
+
+inline static double value_float(LispValue value) {
+    return ((LispFloat *) value_as_object(value))->value;
+}
+
+
+/**
+ * Allocate a zeroed heap object of `size` bytes and tag it with `type`.
+ * This is for objects of a small, fixed size, which are only counted
+ * against the heap limit, so that the evaluation fails at its next call
+ * once past it. Running out of memory for one stops the program.
+ *
+ * @return A pointer to the new object.
+ */
+extern void *value_allocate_object(LispObjectType type, size_t size);
+
+/**
+ * Allocate a zeroed heap object of `size` bytes and tag it with `type`,
+ * unless it would take the evaluation past its heap limit. This is for
+ * objects whose size the program controls, such as vectors and bignums.
+ *
+ * @return A pointer to the new object, or `NULL` if it would pass the
+ * heap limit or memory ran out, as `value_allocation_error` tells.
+ */
+extern void *value_try_allocate_object(LispObjectType type, size_t size);
+
+/**
+ * Check that `size` more bytes can be allocated for a value without
+ * passing the heap limit, for a value that will allocate them later.
+ *
+ * @return Whether they can, and if not `value_allocation_error` says so.
+ */
+extern bool value_can_allocate(u64 size);
+
+/**
+ * Get the error for the last allocation the calling thread could not
+ * make.
+ */
+extern LispError *value_allocation_error(void);
+
+
+/**
+ * Count `size` bytes allocated for a value other than through
+ * `value_allocate_object`, such as the storage of a map or a string.
+ */
+extern void value_count_allocation(size_t size);
+
+/**
+ * Get the number of bytes allocated for values by the calling thread so
+ * far. Values are never freed, so this only grows.
+ */
+extern u64 value_allocated_bytes(void);
+
+/**
+ * Limit the bytes the calling thread allocates to `threshold` in total,
+ * or to none for `UINT64_MAX`. Allocations that are checked beforehand
+ * are refused past it, and the first that is only counted past it
+ * interrupts the governor, so that the next call checks the limits.
+ */
+extern void value_set_threshold(u64 threshold);
+
+
+/**
+ * Box a double precision float.
+ */
+extern LispValue value_make_float(double number);
+
+
+/**
+ * Check whether two values are the same for the purposes of keying a map.
+ * Numbers are equal if they are of the same kind and have the same value,
+ * so `1` and `1.0` are different keys. Strings are equal if they have the
+ * same bytes. Symbols, being interned, and all other objects are compared
+ * by identity.
+ */
+extern bool value_equal(LispValue a, LispValue b);
+
+/**
+ * Hash a value consistently with `value_equal`. A symbol hashes by its
+ * interned ID rather than by its name.
+ */
+extern u64 value_hash(LispValue value);
+
+
+#endif
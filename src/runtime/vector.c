@@ -0,0 +1,444 @@
+#include <stdlib.h>
+
+#include "vector.h"
+#include "vector_kernels.h"
+#include "bignum.h"
+
+
+inline static ValueResult vector_value(LispValue value) {
+    ValueResult result = { .failed = false, .value = value };
+    return result;
+}
+
+
+inline static ValueResult vector_error(char *message) {
+    ValueResult result = { .failed = true, .error = lisp_runtime_error(message) };
+    return result;
+}
+
+
+inline static ValueResult vector_allocation_error(void) {
+    ValueResult result = { .failed = true, .error = value_allocation_error() };
+    return result;
+}
+
+
+inline static ValueResult vector_out_of_memory(void) {
+    ValueResult result = { .failed = true, .error = lisp_internal_error("Out of memory.", LISP_OUT_OF_MEMORY) };
+    return result;
+}
+
+
+/**
+ * Wrap a number that the exact arithmetic may have failed to allocate.
+ */
+inline static ValueResult vector_number(LispValue value) {
+    return value == LISP_ALLOCATION_FAILED ? vector_allocation_error() : vector_value(value);
+}
+
+
+/**
+ * Convert an integer to an `i64vector` element.
+ */
+static bool vector_integer_element(LispValue value, i64 *element) {
+    if (value_is_fixnum(value)) {
+        *element = value_fixnum(value);
+        return true;
+    }
+    return value_is_bignum(value) && bignum_to_i64(value, element);
+}
+
+
+// @see vector.h
+extern LispF64Vector *vector_f64_allocate(u32 length) {
+    LispF64Vector *vector = value_try_allocate_object(
+        LISP_OBJECT_F64VECTOR, sizeof(LispF64Vector) + (size_t) length * sizeof(double));
+    if (vector != NULL) {
+        vector->length = length;
+    }
+    return vector;
+}
+
+
+// @see vector.h
+extern LispI64Vector *vector_i64_allocate(u32 length) {
+    LispI64Vector *vector = value_try_allocate_object(
+        LISP_OBJECT_I64VECTOR, sizeof(LispI64Vector) + (size_t) length * sizeof(i64));
+    if (vector != NULL) {
+        vector->length = length;
+    }
+    return vector;
+}
+
+
+// @see vector.h
+extern ValueResult vector_from_values(LispObjectType type, LispValue *values, u32 count) {
+    if (type == LISP_OBJECT_F64VECTOR) {
+        LispF64Vector *vector = vector_f64_allocate(count);
+        if (vector == NULL) {
+            return vector_allocation_error();
+        }
+        for (u32 i = 0; i < count; ++i) {
+            if (!value_is_number(values[i])) {
+                free(vector);
+                return vector_error("Expected a number.");
+            }
+            vector->elements[i] = number_to_double(values[i]);
+        }
+        return vector_value(value_from_object(vector));
+    }
+
+    LispI64Vector *vector = vector_i64_allocate(count);
+    if (vector == NULL) {
+        return vector_allocation_error();
+    }
+    for (u32 i = 0; i < count; ++i) {
+        if (!vector_integer_element(values[i], &vector->elements[i])) {
+            free(vector);
+            return vector_error("Expected a 64-bit integer.");
+        }
+    }
+    return vector_value(value_from_object(vector));
+}
+
+
+// @see vector.h
+extern ValueResult vector_filled(LispObjectType type, LispValue length, LispValue fill) {
+    if (!value_is_fixnum(length) || value_fixnum(length) < 0 || value_fixnum(length) > UINT32_MAX) {
+        return vector_error("Expected a vector length.");
+    }
+    u32 count = (u32) value_fixnum(length);
+
+    if (type == LISP_OBJECT_F64VECTOR) {
+        if (!value_is_number(fill)) {
+            return vector_error("Expected a number.");
+        }
+        double element = number_to_double(fill);
+        LispF64Vector *vector = vector_f64_allocate(count);
+        if (vector == NULL) {
+            return vector_allocation_error();
+        }
+        for (u32 i = 0; i < count; ++i) {
+            vector->elements[i] = element;
+        }
+        return vector_value(value_from_object(vector));
+    }
+
+    i64 element;
+    if (!vector_integer_element(fill, &element)) {
+        return vector_error("Expected a 64-bit integer.");
+    }
+    LispI64Vector *vector = vector_i64_allocate(count);
+    if (vector == NULL) {
+        return vector_allocation_error();
+    }
+    for (u32 i = 0; i < count; ++i) {
+        vector->elements[i] = element;
+    }
+    return vector_value(value_from_object(vector));
+}
+
+
+// @see vector.h
+extern ValueResult vector_ref(LispValue vector, LispValue index) {
+    if (!value_is_vector(vector)) {
+        return vector_error("Expected a vector.");
+    }
+    if (!value_is_fixnum(index) || value_fixnum(index) < 0 || value_fixnum(index) >= vector_length(vector)) {
+        return vector_error("Index out of range.");
+    }
+
+    i64 position = value_fixnum(index);
+    if (value_is_f64vector(vector)) {
+        return vector_value(value_make_float(value_f64vector(vector)->elements[position]));
+    }
+    return vector_value(bignum_from_i64(value_i64vector(vector)->elements[position]));
+}
+
+
+/**
+ * Get the elements of an operand of floating point vector arithmetic.
+ *
+ * @param scalar Where a number operand is stored.
+ * @param converted Set to a temporary copy of an `i64vector` operand as
+ * doubles, which the caller frees.
+ * @return The elements, or `NULL` if the copy cannot be allocated.
+ */
+static const double *vector_f64_operand(LispValue operand, double *scalar, double **converted) {
+    if (value_is_f64vector(operand)) {
+        return value_f64vector(operand)->elements;
+    }
+
+    if (value_is_i64vector(operand)) {
+        LispI64Vector *vector = value_i64vector(operand);
+        *converted = (double *) malloc(((size_t) vector->length + 1) * sizeof(double));
+        if (*converted == NULL) {
+            return NULL;
+        }
+        for (u32 i = 0; i < vector->length; ++i) {
+            (*converted)[i] = (double) vector->elements[i];
+        }
+        return *converted;
+    }
+
+    *scalar = number_to_double(operand);
+    return scalar;
+}
+
+
+static ValueResult vector_apply_f64(NumberOperation operation, LispValue a, LispValue b, u32 length) {
+    double a_scalar, b_scalar;
+    double *a_converted = NULL;
+    double *b_converted = NULL;
+
+    LispF64Vector *result = vector_f64_allocate(length);
+    if (result == NULL) {
+        return vector_allocation_error();
+    }
+
+    const double *a_elements = vector_f64_operand(a, &a_scalar, &a_converted);
+    const double *b_elements = vector_f64_operand(b, &b_scalar, &b_converted);
+    if (a_elements == NULL || b_elements == NULL) {
+        free(a_converted);
+        free(b_converted);
+        free(result);
+        return vector_out_of_memory();
+    }
+
+    vector_kernels()->f64_apply(operation, result->elements,
+        a_elements, !value_is_vector(a), b_elements, !value_is_vector(b), length);
+
+    free(a_converted);
+    free(b_converted);
+
+    return vector_value(value_from_object(result));
+}
+
+
+static bool vector_i64_multiply(i64 *result, const i64 *a, bool a_scalar, const i64 *b, bool b_scalar, u32 length) {
+    for (u32 i = 0; i < length; ++i) {
+        if (__builtin_mul_overflow(a_scalar ? a[0] : a[i], b_scalar ? b[0] : b[i], &result[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static ValueResult vector_i64_divide(i64 *result, const i64 *a, bool a_scalar, const i64 *b, bool b_scalar, u32 length) {
+    ValueResult status = { .failed = false, .error = NULL };
+
+    for (u32 i = 0; i < length; ++i) {
+        i64 dividend = a_scalar ? a[0] : a[i];
+        i64 divisor = b_scalar ? b[0] : b[i];
+        if (divisor == 0) {
+            return vector_error("Division by zero.");
+        }
+        if (dividend == INT64_MIN && divisor == -1) {
+            return vector_error("Integer overflow in an i64vector.");
+        }
+        result[i] = dividend / divisor;
+    }
+
+    return status;
+}
+
+
+static ValueResult vector_apply_i64(NumberOperation operation, LispValue a, LispValue b, u32 length) {
+    i64 a_scalar, b_scalar;
+    const i64 *a_elements = &a_scalar;
+    const i64 *b_elements = &b_scalar;
+
+    if (value_is_vector(a)) {
+        a_elements = value_i64vector(a)->elements;
+    } else if (!vector_integer_element(a, &a_scalar)) {
+        return vector_error("Expected a 64-bit integer.");
+    }
+
+    if (value_is_vector(b)) {
+        b_elements = value_i64vector(b)->elements;
+    } else if (!vector_integer_element(b, &b_scalar)) {
+        return vector_error("Expected a 64-bit integer.");
+    }
+
+    bool a_is_scalar = !value_is_vector(a);
+    bool b_is_scalar = !value_is_vector(b);
+    LispI64Vector *result = vector_i64_allocate(length);
+    if (result == NULL) {
+        return vector_allocation_error();
+    }
+    bool exact = true;
+
+    switch (operation) {
+        case NUMBER_ADD: {
+            exact = vector_kernels()->i64_add(result->elements, a_elements, a_is_scalar, b_elements, b_is_scalar, length);
+            break;
+        }
+        case NUMBER_SUBTRACT: {
+            exact = vector_kernels()->i64_subtract(result->elements, a_elements, a_is_scalar, b_elements, b_is_scalar, length);
+            break;
+        }
+        case NUMBER_MULTIPLY: {
+            exact = vector_i64_multiply(result->elements, a_elements, a_is_scalar, b_elements, b_is_scalar, length);
+            break;
+        }
+        case NUMBER_DIVIDE: {
+            ValueResult status = vector_i64_divide(result->elements, a_elements, a_is_scalar, b_elements, b_is_scalar, length);
+            if (status.failed) {
+                free(result);
+                return status;
+            }
+            break;
+        }
+    }
+
+    if (!exact) {
+        free(result);
+        return vector_error("Integer overflow in an i64vector.");
+    }
+
+    return vector_value(value_from_object(result));
+}
+
+
+// @see vector.h
+extern ValueResult vector_apply(NumberOperation operation, LispValue a, LispValue b) {
+    if ((!value_is_vector(a) && !value_is_number(a)) || (!value_is_vector(b) && !value_is_number(b))) {
+        return vector_error("Expected a number or a vector.");
+    }
+
+    if (value_is_vector(a) && value_is_vector(b) && vector_length(a) != vector_length(b)) {
+        return vector_error("Vector lengths differ.");
+    }
+
+    u32 length = vector_length(value_is_vector(a) ? a : b);
+
+    if (value_is_f64vector(a) || value_is_f64vector(b) || value_is_float(a) || value_is_float(b)) {
+        return vector_apply_f64(operation, a, b, length);
+    }
+
+    return vector_apply_i64(operation, a, b, length);
+}
+
+
+// @see vector.h
+extern ValueResult vector_dot(LispValue a, LispValue b) {
+    if (!value_is_vector(a) || !value_is_vector(b)) {
+        return vector_error("Expected a vector.");
+    }
+    if (vector_length(a) != vector_length(b)) {
+        return vector_error("Vector lengths differ.");
+    }
+
+    u32 length = vector_length(a);
+
+    if (value_is_i64vector(a) && value_is_i64vector(b)) {
+        const i64 *x = value_i64vector(a)->elements;
+        const i64 *y = value_i64vector(b)->elements;
+
+        i64 sum = 0;
+        u32 i = 0;
+        for (; i < length; ++i) {
+            i64 product;
+            if (__builtin_mul_overflow(x[i], y[i], &product) || __builtin_add_overflow(sum, product, &sum)) {
+                break;
+            }
+        }
+        if (i == length) {
+            return vector_value(bignum_from_i64(sum));
+        }
+
+        // The sum no longer fits in 64 bits; redo it exactly.
+        LispValue exact = value_make_fixnum(0);
+        for (i = 0; i < length && exact != LISP_ALLOCATION_FAILED; ++i) {
+            LispValue product = bignum_multiply(bignum_from_i64(x[i]), bignum_from_i64(y[i]));
+            exact = product != LISP_ALLOCATION_FAILED ? bignum_add(exact, product) : product;
+        }
+        return vector_number(exact);
+    }
+
+    double a_scalar, b_scalar;
+    double *a_converted = NULL;
+    double *b_converted = NULL;
+    const double *x = vector_f64_operand(a, &a_scalar, &a_converted);
+    const double *y = vector_f64_operand(b, &b_scalar, &b_converted);
+    if (x == NULL || y == NULL) {
+        free(a_converted);
+        free(b_converted);
+        return vector_out_of_memory();
+    }
+
+    double dot = vector_kernels()->f64_dot(x, y, length);
+
+    free(a_converted);
+    free(b_converted);
+
+    return vector_value(value_make_float(dot));
+}
+
+
+// @see vector.h
+extern ValueResult vector_sum(LispValue vector) {
+    if (value_is_f64vector(vector)) {
+        LispF64Vector *elements = value_f64vector(vector);
+        return vector_value(value_make_float(vector_kernels()->f64_sum(elements->elements, elements->length)));
+    }
+
+    if (!value_is_i64vector(vector)) {
+        return vector_error("Expected a vector.");
+    }
+
+    LispI64Vector *elements = value_i64vector(vector);
+    i64 sum;
+    if (vector_kernels()->i64_sum(elements->elements, elements->length, &sum)) {
+        return vector_value(bignum_from_i64(sum));
+    }
+
+    // The sum no longer fits in 64 bits; redo it exactly.
+    LispValue exact = value_make_fixnum(0);
+    for (u32 i = 0; i < elements->length && exact != LISP_ALLOCATION_FAILED; ++i) {
+        exact = bignum_add(exact, bignum_from_i64(elements->elements[i]));
+    }
+    return vector_number(exact);
+}
+
+
+/**
+ * Find the smallest or largest element of a non-empty vector.
+ */
+static ValueResult vector_extreme(LispValue vector, bool maximum) {
+    if (!value_is_vector(vector)) {
+        return vector_error("Expected a vector.");
+    }
+    if (vector_length(vector) == 0) {
+        return vector_error("Expected a non-empty vector.");
+    }
+
+    const VectorKernels *kernels = vector_kernels();
+
+    if (value_is_f64vector(vector)) {
+        LispF64Vector *elements = value_f64vector(vector);
+        double extreme = maximum
+            ? kernels->f64_max(elements->elements, elements->length)
+            : kernels->f64_min(elements->elements, elements->length);
+        return vector_value(value_make_float(extreme));
+    }
+
+    LispI64Vector *elements = value_i64vector(vector);
+    i64 extreme = maximum
+        ? kernels->i64_max(elements->elements, elements->length)
+        : kernels->i64_min(elements->elements, elements->length);
+    return vector_value(bignum_from_i64(extreme));
+}
+
+
+// @see vector.h
+extern ValueResult vector_min(LispValue vector) {
+    return vector_extreme(vector, false);
+}
+
+
+// @see vector.h
+extern ValueResult vector_max(LispValue vector) {
+    return vector_extreme(vector, true);
+}
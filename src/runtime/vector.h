@@ -0,0 +1,113 @@
+#ifndef VECTOR_H
+#define VECTOR_H
+#include <stdbool.h>
+
+#include "../util_types.h"
+#include "value.h"
+#include "number.h"
+
+
+/**
+ * Packed numeric vectors. The elements are stored unboxed and contiguously,
+ * so that arithmetic on whole vectors runs through the SIMD kernels in
+ * `vector_kernels.h` rather than one boxed number at a time.
+ *
+ * Arithmetic between two vectors is elementwise and requires them to have
+ * the same length; arithmetic between a vector and a number applies the
+ * number to every element. As with numbers, an `f64vector` operand or a
+ * float makes the result an `f64vector`. `i64vector` arithmetic is exact:
+ * a result that does not fit in 64 bits is a runtime error, while sums
+ * and dot products that do not fit become bignums.
+ */
+
+typedef struct {
+    LispObject header;
+    u32 length;
+    double elements[];
+} LispF64Vector;
+
+
+typedef struct {
+    LispObject header;
+    u32 length;
+    i64 elements[];
+} LispI64Vector;
+
+
+inline static bool value_is_f64vector(LispValue value) {
+    return value_is_object_type(value, LISP_OBJECT_F64VECTOR);
+}
+
+
+inline static bool value_is_i64vector(LispValue value) {
+    return value_is_object_type(value, LISP_OBJECT_I64VECTOR);
+}
+
+
+inline static bool value_is_vector(LispValue value) {
+    return value_is_f64vector(value) || value_is_i64vector(value);
+}
+
+
+inline static LispF64Vector *value_f64vector(LispValue value) {
+    return (LispF64Vector *) value_as_object(value);
+}
+
+
+inline static LispI64Vector *value_i64vector(LispValue value) {
+    return (LispI64Vector *) value_as_object(value);
+}
+
+
+/**
+ * Get the number of elements of either kind of vector.
+ */
+inline static u32 vector_length(LispValue vector) {
+    return value_is_f64vector(vector)
+        ? value_f64vector(vector)->length
+        : value_i64vector(vector)->length;
+}
+
+
+/**
+ * Allocate a vector of `length` zeroes.
+ *
+ * @return The vector, or `NULL` if it cannot be allocated, as
+ * `value_allocation_error` tells.
+ */
+extern LispF64Vector *vector_f64_allocate(u32 length);
+
+extern LispI64Vector *vector_i64_allocate(u32 length);
+
+/**
+ * Create a vector of type `type`, either `LISP_OBJECT_F64VECTOR` or
+ * `LISP_OBJECT_I64VECTOR`, from `count` numbers.
+ */
+extern ValueResult vector_from_values(LispObjectType type, LispValue *values, u32 count);
+
+/**
+ * Create a vector of type `type` of `length` copies of `fill`.
+ */
+extern ValueResult vector_filled(LispObjectType type, LispValue length, LispValue fill);
+
+/**
+ * Get the element of `vector` at the fixnum `index`.
+ */
+extern ValueResult vector_ref(LispValue vector, LispValue index);
+
+/**
+ * Apply an arithmetic operation where at least one of `a` and `b` is a
+ * vector and the other is a vector or a number.
+ */
+extern ValueResult vector_apply(NumberOperation operation, LispValue a, LispValue b);
+
+extern ValueResult vector_dot(LispValue a, LispValue b);
+
+extern ValueResult vector_sum(LispValue vector);
+
+extern ValueResult vector_min(LispValue vector);
+
+extern ValueResult vector_max(LispValue vector);
+
+
+#endif
@@ -0,0 +1,438 @@
+#include "vector_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VECTOR_KERNELS_AVX2
+#include <immintrin.h>
+#endif
+
+
+/**
+ * Apply `OPERATOR` elementwise, reading an operand's first element
+ * throughout if it is scalar.
+ */
+#define VECTOR_APPLY_SCALAR(OPERATOR, START) \
+    for (size_t k = (START); k < length; ++k) { \
+        result[k] = (a_scalar ? a[0] : a[k]) OPERATOR (b_scalar ? b[0] : b[k]); \
+    }
+
+
+static void f64_apply_scalar(NumberOperation operation, double *result,
+        const double *a, bool a_scalar, const double *b, bool b_scalar, size_t length) {
+    switch (operation) {
+        case NUMBER_ADD: VECTOR_APPLY_SCALAR(+, 0); break;
+        case NUMBER_SUBTRACT: VECTOR_APPLY_SCALAR(-, 0); break;
+        case NUMBER_MULTIPLY: VECTOR_APPLY_SCALAR(*, 0); break;
+        case NUMBER_DIVIDE: VECTOR_APPLY_SCALAR(/, 0); break;
+    }
+}
+
+
+static double f64_sum_scalar(const double *a, size_t length) {
+    double sum = 0.0;
+    for (size_t i = 0; i < length; ++i) {
+        sum += a[i];
+    }
+    return sum;
+}
+
+
+static double f64_dot_scalar(const double *a, const double *b, size_t length) {
+    double sum = 0.0;
+    for (size_t i = 0; i < length; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+
+static double f64_min_scalar(const double *a, size_t length) {
+    double minimum = a[0];
+    for (size_t i = 1; i < length; ++i) {
+        minimum = a[i] < minimum ? a[i] : minimum;
+    }
+    return minimum;
+}
+
+
+static double f64_max_scalar(const double *a, size_t length) {
+    double maximum = a[0];
+    for (size_t i = 1; i < length; ++i) {
+        maximum = a[i] > maximum ? a[i] : maximum;
+    }
+    return maximum;
+}
+
+
+static bool i64_add_scalar(i64 *result, const i64 *a, bool a_scalar, const i64 *b, bool b_scalar, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if (__builtin_add_overflow(a_scalar ? a[0] : a[i], b_scalar ? b[0] : b[i], &result[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static bool i64_subtract_scalar(i64 *result, const i64 *a, bool a_scalar, const i64 *b, bool b_scalar, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if (__builtin_sub_overflow(a_scalar ? a[0] : a[i], b_scalar ? b[0] : b[i], &result[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static bool i64_sum_scalar(const i64 *a, size_t length, i64 *sum) {
+    *sum = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (__builtin_add_overflow(*sum, a[i], sum)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static i64 i64_min_scalar(const i64 *a, size_t length) {
+    i64 minimum = a[0];
+    for (size_t i = 1; i < length; ++i) {
+        minimum = a[i] < minimum ? a[i] : minimum;
+    }
+    return minimum;
+}
+
+
+static i64 i64_max_scalar(const i64 *a, size_t length) {
+    i64 maximum = a[0];
+    for (size_t i = 1; i < length; ++i) {
+        maximum = a[i] > maximum ? a[i] : maximum;
+    }
+    return maximum;
+}
+
+
+static const VectorKernels scalar_kernels = {
+    .name = "scalar",
+    .f64_apply = f64_apply_scalar,
+    .f64_sum = f64_sum_scalar,
+    .f64_dot = f64_dot_scalar,
+    .f64_min = f64_min_scalar,
+    .f64_max = f64_max_scalar,
+    .i64_add = i64_add_scalar,
+    .i64_subtract = i64_subtract_scalar,
+    .i64_sum = i64_sum_scalar,
+    .i64_min = i64_min_scalar,
+    .i64_max = i64_max_scalar
+};
+
+
+#if defined(VECTOR_KERNELS_AVX2)
+
+#define AVX2 __attribute__((target("avx2")))
+
+
+/**
+ * Apply `INTRINSIC` to four doubles at a time, then `OPERATOR` to the
+ * remaining elements.
+ */
+#define F64_APPLY_AVX2(INTRINSIC, OPERATOR) { \
+    __m256d a_all = _mm256_set1_pd(a[0]); \
+    __m256d b_all = _mm256_set1_pd(b[0]); \
+    size_t i = 0; \
+    for (; i + 4 <= length; i += 4) { \
+        __m256d x = a_scalar ? a_all : _mm256_loadu_pd(&a[i]); \
+        __m256d y = b_scalar ? b_all : _mm256_loadu_pd(&b[i]); \
+        _mm256_storeu_pd(&result[i], INTRINSIC(x, y)); \
+    } \
+    VECTOR_APPLY_SCALAR(OPERATOR, i) \
+}
+
+
+AVX2 static void f64_apply_avx2(NumberOperation operation, double *result,
+        const double *a, bool a_scalar, const double *b, bool b_scalar, size_t length) {
+    if (length == 0) {
+        return;
+    }
+
+    switch (operation) {
+        case NUMBER_ADD: F64_APPLY_AVX2(_mm256_add_pd, +); break;
+        case NUMBER_SUBTRACT: F64_APPLY_AVX2(_mm256_sub_pd, -); break;
+        case NUMBER_MULTIPLY: F64_APPLY_AVX2(_mm256_mul_pd, *); break;
+        case NUMBER_DIVIDE: F64_APPLY_AVX2(_mm256_div_pd, /); break;
+    }
+}
+
+
+AVX2 static double f64_horizontal_sum_avx2(__m256d sums) {
+    __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(sums), _mm256_extractf128_pd(sums, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+
+AVX2 static double f64_sum_avx2(const double *a, size_t length) {
+    // Four independent accumulators hide the latency of each addition.
+    __m256d sums[4] = {
+        _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd()
+    };
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        for (size_t j = 0; j < 4; ++j) {
+            sums[j] = _mm256_add_pd(sums[j], _mm256_loadu_pd(&a[i + 4 * j]));
+        }
+    }
+    for (; i + 4 <= length; i += 4) {
+        sums[0] = _mm256_add_pd(sums[0], _mm256_loadu_pd(&a[i]));
+    }
+
+    __m256d total = _mm256_add_pd(_mm256_add_pd(sums[0], sums[1]), _mm256_add_pd(sums[2], sums[3]));
+    double sum = f64_horizontal_sum_avx2(total);
+    for (; i < length; ++i) {
+        sum += a[i];
+    }
+    return sum;
+}
+
+
+AVX2 static double f64_dot_avx2(const double *a, const double *b, size_t length) {
+    __m256d sums[4] = {
+        _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd()
+    };
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        for (size_t j = 0; j < 4; ++j) {
+            __m256d product = _mm256_mul_pd(_mm256_loadu_pd(&a[i + 4 * j]), _mm256_loadu_pd(&b[i + 4 * j]));
+            sums[j] = _mm256_add_pd(sums[j], product);
+        }
+    }
+    for (; i + 4 <= length; i += 4) {
+        sums[0] = _mm256_add_pd(sums[0], _mm256_mul_pd(_mm256_loadu_pd(&a[i]), _mm256_loadu_pd(&b[i])));
+    }
+
+    __m256d total = _mm256_add_pd(_mm256_add_pd(sums[0], sums[1]), _mm256_add_pd(sums[2], sums[3]));
+    double sum = f64_horizontal_sum_avx2(total);
+    for (; i < length; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+
+AVX2 static double f64_min_avx2(const double *a, size_t length) {
+    size_t i = 0;
+    double minimum = a[0];
+
+    if (length >= 4) {
+        __m256d minimums = _mm256_loadu_pd(a);
+        for (i = 4; i + 4 <= length; i += 4) {
+            minimums = _mm256_min_pd(_mm256_loadu_pd(&a[i]), minimums);
+        }
+        double lanes[4];
+        _mm256_storeu_pd(lanes, minimums);
+        minimum = f64_min_scalar(lanes, 4);
+    }
+
+    for (; i < length; ++i) {
+        minimum = a[i] < minimum ? a[i] : minimum;
+    }
+    return minimum;
+}
+
+
+AVX2 static double f64_max_avx2(const double *a, size_t length) {
+    size_t i = 0;
+    double maximum = a[0];
+
+    if (length >= 4) {
+        __m256d maximums = _mm256_loadu_pd(a);
+        for (i = 4; i + 4 <= length; i += 4) {
+            maximums = _mm256_max_pd(_mm256_loadu_pd(&a[i]), maximums);
+        }
+        double lanes[4];
+        _mm256_storeu_pd(lanes, maximums);
+        maximum = f64_max_scalar(lanes, 4);
+    }
+
+    for (; i < length; ++i) {
+        maximum = a[i] > maximum ? a[i] : maximum;
+    }
+    return maximum;
+}
+
+
+/**
+ * Check whether any lane of `overflow` has its sign bit set.
+ */
+AVX2 static bool i64_any_sign_avx2(__m256i overflow) {
+    return _mm256_movemask_pd(_mm256_castsi256_pd(overflow)) != 0;
+}
+
+
+AVX2 static bool i64_add_avx2(i64 *result, const i64 *a, bool a_scalar, const i64 *b, bool b_scalar, size_t length) {
+    if (length == 0) {
+        return true;
+    }
+
+    __m256i a_all = _mm256_set1_epi64x(a[0]);
+    __m256i b_all = _mm256_set1_epi64x(b[0]);
+    // A sum overflows when both operands have a different sign from it.
+    __m256i overflow = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4) {
+        __m256i x = a_scalar ? a_all : _mm256_loadu_si256((const __m256i *) &a[i]);
+        __m256i y = b_scalar ? b_all : _mm256_loadu_si256((const __m256i *) &b[i]);
+        __m256i sum = _mm256_add_epi64(x, y);
+        overflow = _mm256_or_si256(overflow,
+            _mm256_and_si256(_mm256_xor_si256(x, sum), _mm256_xor_si256(y, sum)));
+        _mm256_storeu_si256((__m256i *) &result[i], sum);
+    }
+
+    if (i64_any_sign_avx2(overflow)) {
+        return false;
+    }
+    return i64_add_scalar(&result[i], a_scalar ? a : &a[i], a_scalar, b_scalar ? b : &b[i], b_scalar, length - i);
+}
+
+
+AVX2 static bool i64_subtract_avx2(i64 *result, const i64 *a, bool a_scalar, const i64 *b, bool b_scalar, size_t length) {
+    if (length == 0) {
+        return true;
+    }
+
+    __m256i a_all = _mm256_set1_epi64x(a[0]);
+    __m256i b_all = _mm256_set1_epi64x(b[0]);
+    // A difference overflows when the operands differ in sign and the
+    // result differs in sign from the first.
+    __m256i overflow = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4) {
+        __m256i x = a_scalar ? a_all : _mm256_loadu_si256((const __m256i *) &a[i]);
+        __m256i y = b_scalar ? b_all : _mm256_loadu_si256((const __m256i *) &b[i]);
+        __m256i difference = _mm256_sub_epi64(x, y);
+        overflow = _mm256_or_si256(overflow,
+            _mm256_and_si256(_mm256_xor_si256(x, y), _mm256_xor_si256(x, difference)));
+        _mm256_storeu_si256((__m256i *) &result[i], difference);
+    }
+
+    if (i64_any_sign_avx2(overflow)) {
+        return false;
+    }
+    return i64_subtract_scalar(&result[i], a_scalar ? a : &a[i], a_scalar, b_scalar ? b : &b[i], b_scalar, length - i);
+}
+
+
+AVX2 static bool i64_sum_avx2(const i64 *a, size_t length, i64 *sum) {
+    __m256i sums = _mm256_setzero_si256();
+    __m256i overflow = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) &a[i]);
+        __m256i next = _mm256_add_epi64(sums, x);
+        overflow = _mm256_or_si256(overflow,
+            _mm256_and_si256(_mm256_xor_si256(sums, next), _mm256_xor_si256(x, next)));
+        sums = next;
+    }
+
+    if (i64_any_sign_avx2(overflow)) {
+        return false;
+    }
+
+    i64 lanes[4];
+    _mm256_storeu_si256((__m256i *) lanes, sums);
+
+    i64 rest;
+    if (!i64_sum_scalar(lanes, 4, sum) || !i64_sum_scalar(&a[i], length - i, &rest)) {
+        return false;
+    }
+    return !__builtin_add_overflow(*sum, rest, sum);
+}
+
+
+AVX2 static i64 i64_min_avx2(const i64 *a, size_t length) {
+    size_t i = 0;
+    i64 minimum = a[0];
+
+    if (length >= 4) {
+        __m256i minimums = _mm256_loadu_si256((const __m256i *) a);
+        for (i = 4; i + 4 <= length; i += 4) {
+            __m256i x = _mm256_loadu_si256((const __m256i *) &a[i]);
+            minimums = _mm256_blendv_epi8(minimums, x, _mm256_cmpgt_epi64(minimums, x));
+        }
+        i64 lanes[4];
+        _mm256_storeu_si256((__m256i *) lanes, minimums);
+        minimum = i64_min_scalar(lanes, 4);
+    }
+
+    for (; i < length; ++i) {
+        minimum = a[i] < minimum ? a[i] : minimum;
+    }
+    return minimum;
+}
+
+
+AVX2 static i64 i64_max_avx2(const i64 *a, size_t length) {
+    size_t i = 0;
+    i64 maximum = a[0];
+
+    if (length >= 4) {
+        __m256i maximums = _mm256_loadu_si256((const __m256i *) a);
+        for (i = 4; i + 4 <= length; i += 4) {
+            __m256i x = _mm256_loadu_si256((const __m256i *) &a[i]);
+            maximums = _mm256_blendv_epi8(maximums, x, _mm256_cmpgt_epi64(x, maximums));
+        }
+        i64 lanes[4];
+        _mm256_storeu_si256((__m256i *) lanes, maximums);
+        maximum = i64_max_scalar(lanes, 4);
+    }
+
+    for (; i < length; ++i) {
+        maximum = a[i] > maximum ? a[i] : maximum;
+    }
+    return maximum;
+}
+
+
+static const VectorKernels avx2_kernels = {
+    .name = "avx2",
+    .f64_apply = f64_apply_avx2,
+    .f64_sum = f64_sum_avx2,
+    .f64_dot = f64_dot_avx2,
+    .f64_min = f64_min_avx2,
+    .f64_max = f64_max_avx2,
+    .i64_add = i64_add_avx2,
+    .i64_subtract = i64_subtract_avx2,
+    .i64_sum = i64_sum_avx2,
+    .i64_min = i64_min_avx2,
+    .i64_max = i64_max_avx2
+};
+
+#endif
+
+
+// @see vector_kernels.h
+extern const VectorKernels *vector_kernels_scalar(void) {
+    return &scalar_kernels;
+}
+
+
+// @see vector_kernels.h
+extern const VectorKernels *vector_kernels(void) {
+    static const VectorKernels *selected = NULL;
+
+    if (selected == NULL) {
+        selected = &scalar_kernels;
+#if defined(VECTOR_KERNELS_AVX2)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            selected = &avx2_kernels;
+        }
+#endif
+    }
+
+    return selected;
+}
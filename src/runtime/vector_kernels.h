@@ -0,0 +1,60 @@
+#ifndef VECTOR_KERNELS_H
+#define VECTOR_KERNELS_H
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../util_types.h"
+#include "number.h"
+
+
+/**
+ * The inner loops of the vector builtins. There is a portable scalar
+ * version of each, and on x86 an AVX2 version that is picked at runtime
+ * when the processor supports it.
+ *
+ * Binary kernels take an operand flag `a_scalar` or `b_scalar` to repeat
+ * the first element of that operand instead of reading it elementwise.
+ * Floating point reductions may add in a different order from one set
+ * of kernels to the other, so their results can differ in the last bits.
+ */
+typedef struct {
+    // The name of the instruction set the kernels use.
+    const char *name;
+
+    void (*f64_apply)(NumberOperation operation, double *result,
+        const double *a, bool a_scalar, const double *b, bool b_scalar, size_t length);
+    double (*f64_sum)(const double *a, size_t length);
+    double (*f64_dot)(const double *a, const double *b, size_t length);
+    double (*f64_min)(const double *a, size_t length);
+    double (*f64_max)(const double *a, size_t length);
+
+    /**
+     * Add or subtract two i64 vectors.
+     *
+     * @return Whether every element was computed without overflowing.
+     */
+    bool (*i64_add)(i64 *result, const i64 *a, bool a_scalar, const i64 *b, bool b_scalar, size_t length);
+    bool (*i64_subtract)(i64 *result, const i64 *a, bool a_scalar, const i64 *b, bool b_scalar, size_t length);
+
+    /**
+     * @return Whether the sum was computed without overflowing. A partial
+     * sum may overflow even though the total would fit.
+     */
+    bool (*i64_sum)(const i64 *a, size_t length, i64 *sum);
+    i64 (*i64_min)(const i64 *a, size_t length);
+    i64 (*i64_max)(const i64 *a, size_t length);
+} VectorKernels;
+
+
+/**
+ * Get the best kernels for the processor the program is running on.
+ */
+extern const VectorKernels *vector_kernels(void);
+
+/**
+ * Get the portable kernels, which every other set must agree with.
+ */
+extern const VectorKernels *vector_kernels_scalar(void);
+
+
+#endif
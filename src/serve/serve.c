@@ -0,0 +1,354 @@
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "serve.h"
+
+// The streams passed with every request: standard input, output and error.
+#define SERVE_STREAM_COUNT 3
+
+extern char **environ;
+
+
+static volatile sig_atomic_t serve_stopping = 0;
+
+
+static void serve_stop(int signal_number) {
+    (void) signal_number;
+    serve_stopping = 1;
+}
+
+
+/**
+ * Read exactly `length` bytes from `fd`.
+ *
+ * @return Whether all of them could be read.
+ */
+static bool serve_read(int fd, void *buffer, size_t length) {
+    u8 *cursor = (u8 *) buffer;
+    while (length > 0) {
+        ssize_t count = read(fd, cursor, length);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        cursor += count;
+        length -= (size_t) count;
+    }
+    return true;
+}
+
+
+/**
+ * Send all `length` bytes to the socket `fd`, failing rather than being
+ * killed if the other end has gone away.
+ */
+static bool serve_write(int fd, const void *buffer, size_t length) {
+    const u8 *cursor = (const u8 *) buffer;
+    while (length > 0) {
+        ssize_t count = send(fd, cursor, length, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        cursor += count;
+        length -= (size_t) count;
+    }
+    return true;
+}
+
+
+/**
+ * Fill `address` with the address of the socket at `socket_path`.
+ *
+ * @return Whether the path fits in an address.
+ */
+static bool serve_address(const char *socket_path, struct sockaddr_un *address) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address->sun_path)) {
+        fprintf(stderr, "%s: The socket path is too long.\n", socket_path);
+        return false;
+    }
+    strcpy(address->sun_path, socket_path);
+    return true;
+}
+
+
+/**
+ * Receive the length of a request along with the streams sent with it.
+ *
+ * @return Whether both were received.
+ */
+static bool serve_receive_header(int connection, u32 *length, int streams[SERVE_STREAM_COUNT]) {
+    union {
+        struct cmsghdr header;
+        char data[CMSG_SPACE(SERVE_STREAM_COUNT * sizeof(int))];
+    } control;
+
+    struct iovec vector = { .iov_base = length, .iov_len = sizeof(u32) };
+    struct msghdr message = {
+        .msg_iov = &vector,
+        .msg_iovlen = 1,
+        .msg_control = control.data,
+        .msg_controllen = sizeof(control.data)
+    };
+
+    ssize_t count;
+    do {
+        count = recvmsg(connection, &message, MSG_CMSG_CLOEXEC);
+    } while (count < 0 && errno == EINTR);
+    if (count <= 0) {
+        return false;
+    }
+
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if (header == NULL || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS
+            || header->cmsg_len != CMSG_LEN(SERVE_STREAM_COUNT * sizeof(int))) {
+        return false;
+    }
+    memcpy(streams, CMSG_DATA(header), SERVE_STREAM_COUNT * sizeof(int));
+
+    return serve_read(connection, (u8 *) length + count, sizeof(u32) - (size_t) count);
+}
+
+
+/**
+ * Split `count` null terminated strings off the front of `*cursor`.
+ *
+ * @return A null terminated array of the strings, or `NULL` if the
+ * request ends too soon.
+ */
+static char **serve_split(char **cursor, char *end, u32 count) {
+    char **strings = (char **) malloc((count + 1) * sizeof(char *));
+    for (u32 i = 0; i < count; ++i) {
+        char *terminator = memchr(*cursor, '\0', (size_t) (end - *cursor));
+        if (terminator == NULL) {
+            free(strings);
+            return NULL;
+        }
+        strings[i] = *cursor;
+        *cursor = terminator + 1;
+    }
+    strings[count] = NULL;
+    return strings;
+}
+
+
+/**
+ * Handle the request on `connection`, in a child of the server.
+ *
+ * @return The exit code to send back, or a negative number if the
+ * request was malformed.
+ */
+static i32 serve_handle(int connection, ServeHandler handler) {
+    u32 length;
+    int streams[SERVE_STREAM_COUNT];
+    if (!serve_receive_header(connection, &length, streams)) {
+        return -1;
+    }
+
+    for (int i = 0; i < SERVE_STREAM_COUNT; ++i) {
+        dup2(streams[i], i);
+        close(streams[i]);
+    }
+
+    if (length < 2 * sizeof(u32) || length > SERVE_MAX_REQUEST) {
+        return -1;
+    }
+    char *request = (char *) malloc(length);
+    if (!serve_read(connection, request, length)) {
+        return -1;
+    }
+
+    u32 argc, envc;
+    memcpy(&argc, request, sizeof(u32));
+    memcpy(&envc, request + sizeof(u32), sizeof(u32));
+    char *cursor = request + 2 * sizeof(u32);
+    char *end = request + length;
+
+    char **directory = serve_split(&cursor, end, 1);
+    char **argv = directory != NULL && argc > 0 && argc < length ? serve_split(&cursor, end, argc) : NULL;
+    char **envp = argv != NULL && envc < length ? serve_split(&cursor, end, envc) : NULL;
+    if (envp == NULL || chdir(directory[0]) != 0) {
+        return -1;
+    }
+
+    environ = envp;
+    return handler((i32) argc, argv);
+}
+
+
+// @see serve.h
+extern i32 serve_run(const char *socket_path, ServeHandler handler) {
+    struct sockaddr_un address;
+    if (!serve_address(socket_path, &address)) {
+        return 1;
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    unlink(socket_path);
+    mode_t mask = umask(0077);
+    int bound = bind(listener, (struct sockaddr *) &address, sizeof(address));
+    umask(mask);
+    if (bound != 0 || listen(listener, SOMAXCONN) != 0) {
+        perror(socket_path);
+        close(listener);
+        return 1;
+    }
+
+    // Children are never waited for, so let the kernel reap them; and
+    // stop accepting, rather than restart, when asked to stop.
+    struct sigaction ignore = { .sa_handler = SIG_IGN, .sa_flags = SA_NOCLDWAIT };
+    struct sigaction stop = { .sa_handler = serve_stop };
+    struct sigaction previous_child;
+    sigemptyset(&ignore.sa_mask);
+    sigemptyset(&stop.sa_mask);
+    sigaction(SIGCHLD, &ignore, &previous_child);
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+
+    fflush(NULL);
+    while (!serve_stopping) {
+        int connection = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+        if (connection < 0) {
+            if (errno != EINTR && errno != ECONNABORTED) {
+                perror("accept");
+            }
+            continue;
+        }
+
+        pid_t child = fork();
+        if (child == 0) {
+            close(listener);
+            sigaction(SIGCHLD, &previous_child, NULL);
+            signal(SIGINT, SIG_DFL);
+            signal(SIGTERM, SIG_DFL);
+
+            i32 status = serve_handle(connection, handler);
+            fflush(NULL);
+            if (status >= 0) {
+                u32 frame[2] = { sizeof(i32), (u32) status };
+                serve_write(connection, frame, sizeof(frame));
+            }
+            _exit(status >= 0 ? status : 1);
+        }
+
+        if (child < 0) {
+            perror("fork");
+        }
+        close(connection);
+    }
+
+    close(listener);
+    unlink(socket_path);
+    return 0;
+}
+
+
+// @see serve.h
+extern i32 serve_forward(const char *socket_path, i32 argc, char *argv[]) {
+    struct sockaddr_un address;
+    if (!serve_address(socket_path, &address)) {
+        return 1;
+    }
+
+    int connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (connection < 0 || connect(connection, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        perror(socket_path);
+        return 1;
+    }
+
+    char *directory = getcwd(NULL, 0);
+    if (directory == NULL) {
+        perror("getcwd");
+        close(connection);
+        return 1;
+    }
+
+    u32 envc = 0;
+    while (environ[envc] != NULL) {
+        envc++;
+    }
+
+    // The frame is its length, the counts, then every string.
+    size_t length = 2 * sizeof(u32) + strlen(directory) + 1;
+    for (i32 i = 0; i < argc; ++i) {
+        length += strlen(argv[i]) + 1;
+    }
+    for (u32 i = 0; i < envc; ++i) {
+        length += strlen(environ[i]) + 1;
+    }
+
+    char *request = (char *) malloc(length + sizeof(u32));
+    u32 counts[3] = { (u32) length, (u32) argc, envc };
+    memcpy(request, counts, sizeof(counts));
+    char *cursor = request + sizeof(counts);
+
+    cursor = stpcpy(cursor, directory) + 1;
+    for (i32 i = 0; i < argc; ++i) {
+        cursor = stpcpy(cursor, argv[i]) + 1;
+    }
+    for (u32 i = 0; i < envc; ++i) {
+        cursor = stpcpy(cursor, environ[i]) + 1;
+    }
+    free(directory);
+
+    // The streams go along with the first bytes of the frame.
+    int streams[SERVE_STREAM_COUNT] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    union {
+        struct cmsghdr header;
+        char data[CMSG_SPACE(SERVE_STREAM_COUNT * sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct iovec vector = { .iov_base = request, .iov_len = length + sizeof(u32) };
+    struct msghdr message = {
+        .msg_iov = &vector,
+        .msg_iovlen = 1,
+        .msg_control = control.data,
+        .msg_controllen = sizeof(control.data)
+    };
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(streams));
+    memcpy(CMSG_DATA(header), streams, sizeof(streams));
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(connection, &message, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+
+    bool written = sent > 0
+        && serve_write(connection, request + sent, length + sizeof(u32) - (size_t) sent);
+    free(request);
+
+    u32 frame[2];
+    if (!written || !serve_read(connection, frame, sizeof(frame)) || frame[0] != sizeof(i32)) {
+        fprintf(stderr, "%s: The server did not finish the request.\n", socket_path);
+        close(connection);
+        return 1;
+    }
+
+    close(connection);
+    return (i32) frame[1];
+}
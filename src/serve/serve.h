@@ -0,0 +1,44 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include "../util_types.h"
+
+// The largest request a server accepts, in bytes.
+#define SERVE_MAX_REQUEST 0x100000
+
+
+/**
+ * Runs a command line as if `mylisp` had been started with it, returning
+ * the exit code.
+ */
+typedef i32 (*ServeHandler)(i32 argc, char *argv[]);
+
+
+/**
+ * Serve requests on the Unix domain socket at `socket_path` until the
+ * process is interrupted or terminated, then remove the socket.
+ *
+ * Every request is a command line for `handler`, along with the working
+ * directory and environment of the client and its standard streams,
+ * which are passed over the socket. Each connection is handled by a
+ * child forked from the server, so that requests start from the state
+ * the server was warmed up to and cannot affect one another.
+ *
+ * A request is a frame of the form `length argc envc cwd argv... envp...`,
+ * where the three counts are 32-bit integers and the strings are null
+ * terminated; the response is a frame holding the 32-bit exit code.
+ *
+ * @return The process exit code.
+ */
+extern i32 serve_run(const char *socket_path, ServeHandler handler);
+
+/**
+ * Forward the command line `argv` to the server at `socket_path`, and
+ * wait for it to finish running it.
+ *
+ * @return The exit code of the request.
+ */
+extern i32 serve_forward(const char *socket_path, i32 argc, char *argv[]);
+
+
+#endif
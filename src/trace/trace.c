@@ -0,0 +1,229 @@
+#define _XOPEN_SOURCE 700
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "../runtime/symbol.h"
+
+// The longest path a trace can be written to.
+#define TRACE_MAX_PATH 0x1000
+
+// The size of the stack signal handlers run on, so that the trace can be
+// written after a stack overflow.
+#define TRACE_SIGNAL_STACK_SIZE 0x10000
+
+
+__thread TraceBuffer *trace_thread_buffer = NULL;
+bool trace_calls = false;
+
+
+static struct {
+    // Every thread's buffer, the newest first. Buffers are pushed without
+    // locks, and never freed, so the events of threads that have exited
+    // are still written.
+    TraceBuffer *buffers;
+    u32 thread_count;
+
+    // The first anchor of the timestamps.
+    u64 start_timestamp;
+    u64 start_nanoseconds;
+
+    char path[TRACE_MAX_PATH];
+    bool write_on_exit;
+    bool exit_handler_installed;
+    // The stack signal handlers run on.
+    void *signal_stack;
+} trace;
+
+
+// The signals the trace is written on before the process dies.
+static const int trace_fatal_signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+
+
+// @see trace.h
+extern u64 trace_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u64) now.tv_sec * 1000000000 + (u64) now.tv_nsec;
+}
+
+
+// @see trace.h
+extern TraceBuffer *trace_attach(void) {
+    TraceBuffer *buffer = (TraceBuffer *) calloc(1, sizeof(TraceBuffer));
+    buffer->thread = __atomic_fetch_add(&trace.thread_count, 1, __ATOMIC_RELAXED);
+
+    buffer->next = __atomic_load_n(&trace.buffers, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&trace.buffers, &buffer->next, buffer,
+            true, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+
+    trace_thread_buffer = buffer;
+    return buffer;
+}
+
+
+/**
+ * Write all `size` bytes at `data` to `fd`, with nothing but `write`.
+ */
+static bool trace_write_all(int fd, const void *data, size_t size) {
+    const char *next = (const char *) data;
+    while (size > 0) {
+        ssize_t written = write(fd, next, size);
+        if (written <= 0) {
+            return false;
+        }
+        next += written;
+        size -= (size_t) written;
+    }
+    return true;
+}
+
+
+static bool trace_write_u32(int fd, u32 value) {
+    return trace_write_all(fd, &value, sizeof(value));
+}
+
+
+static bool trace_write_u64(int fd, u64 value) {
+    return trace_write_all(fd, &value, sizeof(value));
+}
+
+
+/**
+ * Write the events of `buffer` that have not been overwritten, oldest
+ * first. Events recorded while this runs may be torn, since the thread
+ * is not stopped, but those before it began are whole.
+ */
+static bool trace_write_buffer(int fd, TraceBuffer *buffer) {
+    u64 head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+    u32 count = head < TRACE_BUFFER_EVENTS ? (u32) head : TRACE_BUFFER_EVENTS;
+    u32 first = (u32) ((head - count) & (TRACE_BUFFER_EVENTS - 1));
+    // The events wrap around the end of the buffer after this many.
+    u32 before_end = TRACE_BUFFER_EVENTS - first < count ? TRACE_BUFFER_EVENTS - first : count;
+
+    return trace_write_u32(fd, buffer->thread)
+        && trace_write_u32(fd, count)
+        && trace_write_all(fd, &buffer->events[first], before_end * sizeof(TraceEvent))
+        && trace_write_all(fd, &buffer->events[0], (count - before_end) * sizeof(TraceEvent));
+}
+
+
+// @see trace.h
+extern bool trace_write(int fd) {
+    bool written = trace_write_all(fd, TRACE_MAGIC, sizeof(TRACE_MAGIC))
+        && trace_write_u32(fd, TRACE_VERSION)
+        && trace_write_u64(fd, trace.start_timestamp)
+        && trace_write_u64(fd, trace.start_nanoseconds)
+        && trace_write_u64(fd, trace_timestamp())
+        && trace_write_u64(fd, trace_clock());
+
+    u32 symbol_total;
+    LispSymbol *const *table = symbol_table(&symbol_total);
+    written = written && trace_write_u32(fd, symbol_total);
+    for (u32 id = 0; id < symbol_total && written; ++id) {
+        const LispSymbol *symbol = table[id];
+        written = trace_write_u32(fd, symbol->length) && trace_write_all(fd, symbol->name, symbol->length);
+    }
+
+    TraceBuffer *buffers = __atomic_load_n(&trace.buffers, __ATOMIC_ACQUIRE);
+    u32 buffer_count = 0;
+    for (TraceBuffer *buffer = buffers; buffer != NULL; buffer = buffer->next) {
+        buffer_count++;
+    }
+    written = written && trace_write_u32(fd, buffer_count);
+    for (TraceBuffer *buffer = buffers; buffer != NULL && written; buffer = buffer->next) {
+        written = trace_write_buffer(fd, buffer);
+    }
+    return written;
+}
+
+
+/**
+ * Write the trace to `trace.path`, with nothing that is unsafe in a
+ * signal handler.
+ */
+static bool trace_write_file(void) {
+    int fd = open(trace.path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool written = trace_write(fd);
+    return close(fd) == 0 && written;
+}
+
+
+static void trace_on_request(int signal) {
+    (void) signal;
+    trace_write_file();
+}
+
+
+/**
+ * Write the trace as the process dies, then die of `signal` as it would
+ * have, the handler having been reset.
+ */
+static void trace_on_fatal_signal(int signal) {
+    if (trace_write_file()) {
+        const char *message = "The trace was written to ";
+        trace_write_all(STDERR_FILENO, message, strlen(message));
+        trace_write_all(STDERR_FILENO, trace.path, strlen(trace.path));
+        trace_write_all(STDERR_FILENO, ".\n", 2);
+    }
+    raise(signal);
+}
+
+
+static void trace_on_exit(void) {
+    if (trace.write_on_exit && !trace_write_file()) {
+        fprintf(stderr, "%s: \x1b[31merror:\x1b[0m Could not write the trace.\n", trace.path);
+    }
+}
+
+
+// @see trace.h
+extern void trace_initialize(const char *path, bool calls) {
+    if (trace.start_nanoseconds == 0) {
+        trace.start_timestamp = trace_timestamp();
+        trace.start_nanoseconds = trace_clock();
+    }
+
+    if (path != NULL) {
+        snprintf(trace.path, sizeof(trace.path), "%s", path);
+    } else {
+        const char *directory = getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp";
+        snprintf(trace.path, sizeof(trace.path), "%s/mylisp-%ld.trace", directory, (long) getpid());
+    }
+    trace.write_on_exit = path != NULL;
+    trace_calls = calls;
+    if (!trace.exit_handler_installed) {
+        atexit(trace_on_exit);
+        trace.exit_handler_installed = true;
+    }
+
+    // Handle fatal signals on a stack of their own, since the one that
+    // overflowed cannot be used.
+    if (trace.signal_stack == NULL) {
+        trace.signal_stack = malloc(TRACE_SIGNAL_STACK_SIZE);
+        stack_t signal_stack = { .ss_sp = trace.signal_stack, .ss_size = TRACE_SIGNAL_STACK_SIZE };
+        sigaltstack(&signal_stack, NULL);
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_handler = trace_on_request;
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+
+    action.sa_handler = trace_on_fatal_signal;
+    action.sa_flags = SA_ONSTACK | SA_RESETHAND | SA_NODEFER;
+    for (size_t i = 0; i < sizeof(trace_fatal_signals) / sizeof(trace_fatal_signals[0]); ++i) {
+        sigaction(trace_fatal_signals[i], &action, NULL);
+    }
+}
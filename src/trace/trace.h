@@ -0,0 +1,171 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "../util_types.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_TSC
+#endif
+
+// The number of events each thread keeps, the oldest being overwritten.
+// Must be a power of two.
+#define TRACE_BUFFER_EVENTS 0x8000
+
+// The function of a call event that has no name.
+#define TRACE_ANONYMOUS UINT32_MAX
+
+// The first bytes of a trace file, and the version of its format.
+#define TRACE_MAGIC "MLTRACE"
+#define TRACE_VERSION 1
+
+
+/**
+ * The flight recorder. Every thread records what the interpreter does
+ * into a ring buffer of its own, without locks, and the buffers are
+ * written to a file when asked for, on `SIGUSR1`, when the process
+ * crashes, or on exit when a trace file is named. `trace_converter`
+ * turns the file into the JSON trace format of Chrome's trace viewer.
+ *
+ * Phases and errors are always recorded. Calls and returns are only
+ * recorded when `trace_calls` is set, since recording one costs about as
+ * much as the call itself.
+ *
+ * A trace file, in the byte order of the machine that wrote it, is:
+ * - `TRACE_MAGIC`, with its terminating zero, and the version as a u32.
+ * - Two anchors, each a timestamp and the time of the monotonic clock
+ *   in nanoseconds when it was taken, as u64s: one from when recording
+ *   began, and one from when the file was written. Timestamps are
+ *   converted to times by interpolating between them.
+ * - The number of symbols, as a u32, then each symbol's name, as its
+ *   length as a u32 followed by its bytes, in the order of their IDs.
+ * - The number of threads, as a u32, then for each thread its number
+ *   and the number of its events, as u32s, followed by its events,
+ *   oldest first.
+ */
+
+
+typedef enum {
+    // A phase, in `argument`, began or ended.
+    TRACE_PHASE_BEGIN,
+    TRACE_PHASE_END,
+    // A function, the symbol ID of its name in `argument`, was called or
+    // returned.
+    TRACE_CALL,
+    TRACE_RETURN,
+    // An error of the type in `detail`, at the line in `argument` and the
+    // column in `column`, or at line 0 if it has no position.
+    TRACE_ERROR
+} TraceEventType;
+
+
+typedef enum {
+    TRACE_LEXER,
+    TRACE_PARSER,
+    TRACE_COMPILER,
+    TRACE_VM
+} TracePhase;
+
+
+typedef struct {
+    // The time of the event: the processor's time-stamp counter where
+    // there is one, and the monotonic clock in nanoseconds elsewhere.
+    u64 timestamp;
+    u32 argument;
+    u16 column;
+    u8 type;
+    u8 detail;
+} TraceEvent;
+
+
+typedef struct TraceBuffer {
+    // The number of events ever recorded. The latest is at index
+    // `(head - 1) % TRACE_BUFFER_EVENTS`.
+    u64 head;
+    u32 thread;
+    struct TraceBuffer *next;
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+} TraceBuffer;
+
+
+/**
+ * The buffer of the calling thread, once it has recorded an event.
+ */
+extern __thread TraceBuffer *trace_thread_buffer;
+
+/**
+ * Whether calls and returns are recorded.
+ */
+extern bool trace_calls;
+
+
+/**
+ * Install the signal handlers that write the trace, to the file at
+ * `path`, or to a file named after the process in the temporary
+ * directory if `path` is `NULL`. The trace is also written to `path` on
+ * exit if it is given. Calls and returns are recorded if `calls` is set.
+ */
+extern void trace_initialize(const char *path, bool calls);
+
+/**
+ * Give the calling thread a buffer.
+ */
+extern TraceBuffer *trace_attach(void);
+
+/**
+ * Get the time of the monotonic clock, in nanoseconds.
+ */
+extern u64 trace_clock(void);
+
+/**
+ * Write the trace to `fd`. This is safe to call from a signal handler.
+ *
+ * @return Whether all of it was written.
+ */
+extern bool trace_write(int fd);
+
+
+inline static u64 trace_timestamp(void) {
+#if defined(TRACE_TSC)
+    return __rdtsc();
+#else
+    return trace_clock();
+#endif
+}
+
+
+/**
+ * Record an event. The thread's buffer is only ever written by the
+ * thread, and the new head is published after the event, so that a
+ * reader on another thread sees whole events.
+ */
+inline static void trace_record(TraceEventType type, u32 argument, u8 detail, u16 column) {
+    TraceBuffer *buffer = trace_thread_buffer;
+    if (buffer == NULL) {
+        buffer = trace_attach();
+    }
+
+    u64 head = buffer->head;
+    TraceEvent *event = &buffer->events[head & (TRACE_BUFFER_EVENTS - 1)];
+    event->timestamp = trace_timestamp();
+    event->argument = argument;
+    event->column = column;
+    event->type = (u8) type;
+    event->detail = detail;
+    __atomic_store_n(&buffer->head, head + 1, __ATOMIC_RELEASE);
+}
+
+
+inline static void trace_begin(TracePhase phase) {
+    trace_record(TRACE_PHASE_BEGIN, phase, 0, 0);
+}
+
+
+inline static void trace_end(TracePhase phase) {
+    trace_record(TRACE_PHASE_END, phase, 0, 0);
+}
+
+
+#endif
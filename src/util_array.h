@@ -0,0 +1,25 @@
+#ifndef UTIL_ARRAY_H
+#define UTIL_ARRAY_H
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "util_types.h"
+
+
+/**
+ * Make room for `count` more elements in a growable array of `length`
+ * elements of `size` bytes, doubling `capacity` as often as needed.
+ *
+ * @return The array, which may have moved.
+ */
+inline static void *array_reserve(void *array, u32 *capacity, u32 length, u32 count, size_t size) {
+    if (length + count <= *capacity) {
+        return array;
+    }
+    while (length + count > *capacity) {
+        *capacity = *capacity == 0 ? 0x10 : *capacity * 2;
+    }
+    return realloc(array, *capacity * size);
+}
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+#include <stdbool.h>
+
+#include "../util_types.h"
+#include "../runtime/value.h"
+
+
+// The version of the instructions, and of the code the compiler emits
+// with them, which must change whenever either does. Compiled modules
+// are cached per version.
+#define BYTECODE_VERSION 2
+
+
+/**
+ * The instructions of the virtual machine. Each is a byte, followed by its
+ * operands, which are 16-bit unsigned integers except for jump targets,
+ * which are 32-bit offsets from the start of the code. Operands are
+ * stored little-endian.
+ *
+ * The machine works on a stack of values. A call's frame is a window of
+ * the stack holding its arguments, and then its other local variables,
+ * and the values being worked on are pushed above it.
+ */
+typedef enum {
+    // Push the constant `index`.
+    OP_CONSTANT,
+    OP_NIL,
+    OP_TRUE,
+    OP_FALSE,
+    // Push the local variable `slot` of the frame.
+    OP_LOCAL,
+    // Set the local variable `slot` to the value on top of the stack,
+    // leaving it there.
+    OP_SET_LOCAL,
+    // Push the value the running closure captured at `index`.
+    OP_CAPTURED,
+    // Push the running closure.
+    OP_SELF,
+    // Push the value of the global named by the symbol constant `index`,
+    // through the function's inline cache `cache`.
+    OP_GLOBAL,
+    // Define the global named by the symbol constant `index` as the value
+    // on top of the stack, leaving it there.
+    OP_DEFINE_GLOBAL,
+    OP_POP,
+    OP_JUMP,
+    // Pop a value and jump if it is `false` or `nil`.
+    OP_JUMP_IF_FALSE,
+    // Pop `count` values, and push a closure of the function constant
+    // `index` that captured them.
+    OP_CLOSURE,
+    // Call the function below the `count` arguments on top of the stack,
+    // replacing both with its result.
+    OP_CALL,
+    // Call the function constant `index` with the `count` arguments on top
+    // of the stack, without a closure, replacing them with its result.
+    OP_CALL_KNOWN,
+    // Call the global named by the symbol constant `index`, through the
+    // inline cache `cache`, with the two arguments on top of the stack,
+    // replacing them with its result. While the global is the builtin `+`,
+    // `-`, `*`, `/` or `=` respectively, two fixnums are worked on in
+    // place; anything else is called like `OP_CALL` would.
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_EQUAL,
+    OP_RETURN
+} OpCode;
+
+
+/**
+ * The inline cache of one place a global is used: the value the global
+ * had when it was last looked up there, and the version of the globals
+ * then. Defining any global changes the version, so a cache is used
+ * only while every global is as it was when it was filled.
+ */
+typedef struct {
+    u64 version;
+    LispValue value;
+} GlobalCache;
+
+
+/**
+ * A compiled function. Calls pass it `parameter_count` arguments, which
+ * become its first local variables.
+ */
+typedef struct {
+    LispObject header;
+    // The symbol the function was defined as, or `nil` if it is anonymous.
+    LispValue name;
+    u32 parameter_count;
+    // The number of local variables, arguments included.
+    u32 local_count;
+    // The most values the function has on the stack above its locals.
+    u32 stack_size;
+    u8 *code;
+    u32 code_length;
+    LispValue *constants;
+    u32 constant_count;
+    GlobalCache *caches;
+    u32 cache_count;
+} LispFunction;
+
+
+/**
+ * A function together with the values of the variables of its enclosing
+ * functions that it uses. Closures are flat: each holds exactly the
+ * values it uses, however deeply they are nested, rather than a chain of
+ * environments.
+ */
+typedef struct {
+    LispObject header;
+    LispFunction *function;
+    u32 capture_count;
+    LispValue captures[];
+} LispClosure;
+
+
+inline static bool value_is_function(LispValue value) {
+    return value_is_object_type(value, LISP_OBJECT_FUNCTION);
+}
+
+
+inline static LispFunction *value_function(LispValue value) {
+    return (LispFunction *) value_as_object(value);
+}
+
+
+inline static bool value_is_closure(LispValue value) {
+    return value_is_object_type(value, LISP_OBJECT_CLOSURE);
+}
+
+
+inline static LispClosure *value_closure(LispValue value) {
+    return (LispClosure *) value_as_object(value);
+}
+
+
+inline static u16 bytecode_read_u16(const u8 *code) {
+    return (u16) (code[0] | (code[1] << 8));
+}
+
+
+inline static u32 bytecode_read_u32(const u8 *code) {
+    return (u32) code[0] | ((u32) code[1] << 8) | ((u32) code[2] << 16) | ((u32) code[3] << 24);
+}
+
+
+#endif
@@ -0,0 +1,156 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <time.h>
+
+#include "governor.h"
+#include "../runtime/value.h"
+
+
+i64 governor_countdown = GOVERNOR_CHECK_INTERVAL;
+u32 governor_stack_depth = UINT32_MAX;
+
+
+/**
+ * The evaluation in progress.
+ */
+static struct {
+    GovernorLimits limits;
+    // The calls counted by the countdowns that have run out.
+    u64 executed;
+    // What the current countdown started at.
+    i64 batch;
+    u64 heap_start;
+    u64 start_milliseconds;
+} governor;
+
+
+static u64 governor_milliseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u64) now.tv_sec * 1000 + (u64) now.tv_nsec / 1000000;
+}
+
+
+/**
+ * Start a countdown to the next check, which is no later than when the
+ * instruction limit would be exceeded.
+ */
+static void governor_restart(void) {
+    governor.batch = GOVERNOR_CHECK_INTERVAL;
+    if (governor.limits.instructions != 0 && governor.limits.instructions - governor.executed < (u64) governor.batch) {
+        governor.batch = (i64) (governor.limits.instructions - governor.executed);
+    }
+    governor_countdown = governor.batch;
+}
+
+
+/**
+ * Check the limits that do not count calls.
+ */
+static LispError *governor_check_resources(void) {
+    GovernorLimits *limits = &governor.limits;
+    u64 heap = value_allocated_bytes() - governor.heap_start;
+    if (limits->heap_bytes != 0 && heap > limits->heap_bytes) {
+        return lisp_resource_error("The evaluation exceeded its heap limit.",
+            LISP_HEAP_LIMIT, heap, limits->heap_bytes);
+    }
+
+    if (limits->milliseconds != 0) {
+        u64 elapsed = governor_milliseconds() - governor.start_milliseconds;
+        if (elapsed > limits->milliseconds) {
+            return lisp_resource_error("The evaluation exceeded its time limit.",
+                LISP_TIME_LIMIT, elapsed, limits->milliseconds);
+        }
+    }
+    return NULL;
+}
+
+
+// @see governor.h
+extern void governor_begin(const GovernorLimits *limits) {
+    governor.limits = *limits;
+    governor.executed = 0;
+    governor.heap_start = value_allocated_bytes();
+    governor.start_milliseconds = limits->milliseconds != 0 ? governor_milliseconds() : 0;
+    governor_stack_depth = limits->stack_depth != 0 ? limits->stack_depth : UINT32_MAX;
+    value_set_threshold(limits->heap_bytes != 0 ? governor.heap_start + limits->heap_bytes : UINT64_MAX);
+    governor_restart();
+}
+
+
+// @see governor.h
+extern LispError *governor_check(void) {
+    GovernorLimits *limits = &governor.limits;
+    governor.executed += (u64) governor.batch;
+
+    // The countdown stays run out once a limit is exceeded, so that every
+    // call after it fails too, until the next evaluation.
+    governor.batch = 0;
+    governor_countdown = 0;
+
+    if (limits->instructions != 0 && governor.executed >= limits->instructions) {
+        return lisp_resource_error("The evaluation exceeded its instruction limit.",
+            LISP_INSTRUCTION_LIMIT, governor.executed + 1, limits->instructions);
+    }
+
+    LispError *error = governor_check_resources();
+    if (error != NULL) {
+        return error;
+    }
+
+    governor_restart();
+    // This call is the first of the new countdown.
+    governor_countdown--;
+    return NULL;
+}
+
+
+// @see governor.h
+extern LispError *governor_finish(void) {
+    value_set_threshold(UINT64_MAX);
+    return governor_check_resources();
+}
+
+
+// @see governor.h
+extern void governor_interrupt(void) {
+    // Only the calls made so far are counted when the countdown runs out.
+    governor.batch -= governor_countdown;
+    governor_countdown = 0;
+}
+
+
+// @see governor.h
+extern int governor_remaining_milliseconds(void) {
+    if (governor.limits.milliseconds == 0) {
+        return -1;
+    }
+    u64 elapsed = governor_milliseconds() - governor.start_milliseconds;
+    if (elapsed > governor.limits.milliseconds) {
+        return 0;
+    }
+    // The deadline has passed once a whole millisecond more has elapsed.
+    u64 remaining = governor.limits.milliseconds - elapsed + 1;
+    return remaining < INT32_MAX ? (int) remaining : INT32_MAX;
+}
+
+
+// @see governor.h
+extern LispError *governor_time_error(void) {
+    return lisp_resource_error("The evaluation exceeded its time limit.",
+        LISP_TIME_LIMIT, governor_milliseconds() - governor.start_milliseconds, governor.limits.milliseconds);
+}
+
+
+// @see governor.h
+extern LispError *governor_heap_error(u64 size) {
+    return lisp_resource_error("The evaluation exceeded its heap limit.",
+        LISP_HEAP_LIMIT, value_allocated_bytes() - governor.heap_start + size, governor.limits.heap_bytes);
+}
+
+
+// @see governor.h
+extern LispError *governor_stack_error(u32 depth) {
+    return lisp_resource_error("The evaluation exceeded its stack depth limit.",
+        LISP_STACK_LIMIT, depth, governor_stack_depth);
+}
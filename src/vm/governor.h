@@ -0,0 +1,109 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+#include <stdbool.h>
+
+#include "../util_types.h"
+#include "../lisp/error.h"
+
+// The most calls between checks of the deadline. The heap is checked on
+// the first call after it passes its limit.
+#define GOVERNOR_CHECK_INTERVAL 0x4000
+
+
+/**
+ * The limits of an evaluation, each 0 for no limit.
+ *
+ * The machine executes a bounded number of instructions between calls,
+ * since it only ever jumps forward, so instructions are counted as calls:
+ * each call of a function, builtins included, is one.
+ */
+typedef struct {
+    u64 instructions;
+    // The bytes of values the evaluation may allocate.
+    u64 heap_bytes;
+    // The deepest the calls of a machine may nest.
+    u32 stack_depth;
+    // The wall-clock time the evaluation may take, in milliseconds.
+    u64 milliseconds;
+} GovernorLimits;
+
+
+/**
+ * Counts down the calls until the limits are checked next. Calls only
+ * decrement it, and the limits are checked in full only when it runs
+ * out, so that checking them costs next to nothing.
+ */
+extern i64 governor_countdown;
+
+/**
+ * The deepest calls may nest, or `UINT32_MAX` for no limit, which is
+ * compared on every call, since it is just as cheap as a countdown.
+ */
+extern u32 governor_stack_depth;
+
+
+/**
+ * Start an evaluation with the limits `limits`, from now on.
+ */
+extern void governor_begin(const GovernorLimits *limits);
+
+/**
+ * Check every limit, once the countdown has run out.
+ *
+ * @return The error for a limit that has been exceeded, or `NULL`.
+ */
+extern LispError *governor_check(void);
+
+/**
+ * Check the heap and the deadline once more, when the evaluation ends,
+ * since it may have exceeded them after the last call.
+ *
+ * @return The error for a limit that has been exceeded, or `NULL`.
+ */
+extern LispError *governor_finish(void);
+
+/**
+ * End the countdown early, so that the next call checks every limit.
+ */
+extern void governor_interrupt(void);
+
+/**
+ * Get how long waiting may take without passing the deadline, for waits
+ * that would otherwise outlast it.
+ *
+ * @return The milliseconds until the deadline has passed, or -1 if the
+ * evaluation has no time limit.
+ */
+extern int governor_remaining_milliseconds(void);
+
+/**
+ * Get the error for an evaluation that has passed its deadline.
+ */
+extern LispError *governor_time_error(void);
+
+/**
+ * Get the error for an allocation of `size` bytes that would have taken
+ * the evaluation past its heap limit.
+ */
+extern LispError *governor_heap_error(u64 size);
+
+/**
+ * Get the error for calls nested `depth` deep.
+ */
+extern LispError *governor_stack_error(u32 depth);
+
+
+/**
+ * Count a call.
+ *
+ * @return The error for a limit that has been exceeded, or `NULL`.
+ */
+inline static LispError *governor_tick(void) {
+    if (--governor_countdown >= 0) {
+        return NULL;
+    }
+    return governor_check();
+}
+
+
+#endif
@@ -0,0 +1,467 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vm.h"
+#include "governor.h"
+#include "../runtime/builtins.h"
+#include "../runtime/number.h"
+#include "../runtime/symbol.h"
+#include "../runtime/map.h"
+#include "../trace/trace.h"
+
+// The number of values a machine's stack starts with room for.
+#define VM_INITIAL_STACK 0x100
+
+
+/**
+ * A call in progress.
+ */
+typedef struct {
+    LispFunction *function;
+    // The closure being run, or `NULL` for a call without one.
+    LispClosure *closure;
+    // The next instruction, once the frame is returned to.
+    const u8 *ip;
+    // Where the frame's local variables start on the stack.
+    u32 base;
+    // The height of the stack once the call returns, before its result
+    // is pushed.
+    u32 return_height;
+} VmFrame;
+
+
+/**
+ * A machine runs one call from C, along with every call it makes in
+ * turn. Each has its own stacks, so that tasks, which may switch in the
+ * middle of a call to a builtin, never share one.
+ */
+typedef struct {
+    LispValue *stack;
+    u32 height;
+    u32 stack_capacity;
+
+    VmFrame *frames;
+    u32 frame_count;
+    u32 frame_capacity;
+} Vm;
+
+
+// Every global, by symbol, as a transient map, once the first is needed.
+static LispValue vm_globals = 0;
+
+// Changed whenever a global is defined, which invalidates every inline
+// cache. Caches start at version 0, and so start out invalid.
+static u64 vm_global_version = 1;
+
+// The builtins `OP_ADD` and the instructions after it work on fixnums in
+// place while their globals are, in the order of the instructions.
+static const char *const vm_operator_names[] = { "+", "-", "*", "/", "=" };
+static const Builtin *vm_operators[OP_EQUAL - OP_ADD + 1];
+
+
+static LispValue vm_get_globals(void) {
+    if (vm_globals != 0) {
+        return vm_globals;
+    }
+
+    for (u32 i = 0; i < OP_EQUAL - OP_ADD + 1; ++i) {
+        vm_operators[i] = builtin_find(vm_operator_names[i], 1);
+    }
+
+    vm_globals = map_transient(map_empty());
+    u32 count;
+    const Builtin *builtins = builtin_list(&count);
+    for (u32 i = 0; i < count; ++i) {
+        LispValue name = symbol_intern(builtins[i].name, strlen(builtins[i].name));
+        map_transient_assoc(vm_globals, name, builtin_make_value(&builtins[i]));
+    }
+    return vm_globals;
+}
+
+
+// @see vm.h
+extern bool vm_find_global(LispValue name, LispValue *value) {
+    return map_find(vm_get_globals(), name, value);
+}
+
+
+inline static ValueResult vm_error(char *message) {
+    ValueResult result = { .failed = true, .error = lisp_runtime_error(message) };
+    return result;
+}
+
+
+static ValueResult vm_undefined_error(LispValue name) {
+    LispSymbol *symbol = value_symbol(name);
+    ValueResult result = { .failed = true,
+        .error = lisp_runtime_error_format("Undefined variable '%.*s'.", (int) symbol->length, symbol->name) };
+    return result;
+}
+
+
+/**
+ * Start a call of `function` with the `argument_count` values on top of
+ * the stack as its arguments.
+ *
+ * @return `NULL`, or the error if the call cannot be made.
+ */
+static LispError *vm_enter(Vm *vm, LispFunction *function, LispClosure *closure,
+        u32 argument_count, u32 return_height) {
+    if (argument_count != function->parameter_count) {
+        return lisp_runtime_error("Wrong number of arguments.");
+    }
+    if (vm->frame_count >= governor_stack_depth) {
+        return governor_stack_error(vm->frame_count + 1);
+    }
+    LispError *error = governor_tick();
+    if (error != NULL) {
+        return error;
+    }
+
+    u32 base = vm->height - argument_count;
+    u32 needed = base + function->local_count + function->stack_size;
+    if (needed > vm->stack_capacity) {
+        while (needed > vm->stack_capacity) {
+            vm->stack_capacity *= 2;
+        }
+        vm->stack = (LispValue *) realloc(vm->stack, vm->stack_capacity * sizeof(LispValue));
+    }
+    for (u32 i = vm->height; i < base + function->local_count; ++i) {
+        vm->stack[i] = LISP_NIL;
+    }
+    vm->height = base + function->local_count;
+
+    if (vm->frame_count == vm->frame_capacity) {
+        vm->frame_capacity *= 2;
+        vm->frames = (VmFrame *) realloc(vm->frames, vm->frame_capacity * sizeof(VmFrame));
+    }
+    vm->frames[vm->frame_count++] = (VmFrame) {
+        .function = function,
+        .closure = closure,
+        .ip = function->code,
+        .base = base,
+        .return_height = return_height
+    };
+    if (trace_calls) {
+        trace_record(TRACE_CALL,
+            value_is_symbol(function->name) ? value_symbol(function->name)->id : TRACE_ANONYMOUS, 0, 0);
+    }
+    return NULL;
+}
+
+
+inline static ValueResult vm_failure(LispError *error) {
+    ValueResult result = { .failed = true, .error = error };
+    return result;
+}
+
+
+/**
+ * Call a builtin, counting the call against the evaluation's limits.
+ */
+inline static ValueResult vm_call_builtin(LispValue builtin, LispValue *arguments, u32 argument_count) {
+    LispError *error = governor_tick();
+    if (error != NULL) {
+        return vm_failure(error);
+    }
+    return builtin_call(value_builtin(builtin)->builtin, arguments, argument_count);
+}
+
+
+/**
+ * Get the global an instruction names by its operands, the index of the
+ * symbol constant and of the inline cache to look it up through.
+ *
+ * @return The up to date cache, or `NULL` if the global is not defined.
+ */
+inline static GlobalCache *vm_global(LispFunction *function, const u8 *operands) {
+    GlobalCache *cache = &function->caches[bytecode_read_u16(operands + 2)];
+    if (cache->version != vm_global_version) {
+        if (!map_find(vm_get_globals(), function->constants[bytecode_read_u16(operands)], &cache->value)) {
+            return NULL;
+        }
+        cache->version = vm_global_version;
+    }
+    return cache;
+}
+
+
+/**
+ * Apply the operator `op` to the fixnums `a` and `b`, as its builtin
+ * would.
+ */
+inline static ValueResult vm_operate(OpCode op, LispValue a, LispValue b) {
+    ValueResult result = { .failed = false, .error = NULL };
+    switch (op) {
+        case OP_SUBTRACT: return number_subtract(a, b);
+        case OP_MULTIPLY: return number_multiply(a, b);
+        case OP_DIVIDE: return number_divide(a, b);
+        case OP_EQUAL:
+            result.value = a == b ? LISP_TRUE : LISP_FALSE;
+            return result;
+        default: return number_add(a, b);
+    }
+}
+
+
+/**
+ * Run the innermost call of `vm` until it returns, along with the calls
+ * it makes.
+ */
+static ValueResult vm_execute(Vm *vm) {
+    VmFrame *frame = &vm->frames[vm->frame_count - 1];
+    const u8 *ip = frame->ip;
+    LispValue *constants = frame->function->constants;
+    LispValue *stack = vm->stack;
+
+    while (true) {
+        OpCode op = (OpCode) *ip++;
+        switch (op) {
+            case OP_CONSTANT: {
+                stack[vm->height++] = constants[bytecode_read_u16(ip)];
+                ip += 2;
+                break;
+            }
+            case OP_NIL: stack[vm->height++] = LISP_NIL; break;
+            case OP_TRUE: stack[vm->height++] = LISP_TRUE; break;
+            case OP_FALSE: stack[vm->height++] = LISP_FALSE; break;
+            case OP_LOCAL: {
+                stack[vm->height++] = stack[frame->base + bytecode_read_u16(ip)];
+                ip += 2;
+                break;
+            }
+            case OP_SET_LOCAL: {
+                stack[frame->base + bytecode_read_u16(ip)] = stack[vm->height - 1];
+                ip += 2;
+                break;
+            }
+            case OP_CAPTURED: {
+                stack[vm->height++] = frame->closure->captures[bytecode_read_u16(ip)];
+                ip += 2;
+                break;
+            }
+            case OP_SELF: {
+                stack[vm->height++] = value_from_object(frame->closure);
+                break;
+            }
+            case OP_GLOBAL: {
+                GlobalCache *cache = vm_global(frame->function, ip);
+                if (cache == NULL) {
+                    return vm_undefined_error(constants[bytecode_read_u16(ip)]);
+                }
+                stack[vm->height++] = cache->value;
+                ip += 4;
+                break;
+            }
+            case OP_DEFINE_GLOBAL: {
+                map_transient_assoc(vm_get_globals(), constants[bytecode_read_u16(ip)], stack[vm->height - 1]);
+                vm_global_version++;
+                ip += 2;
+                break;
+            }
+            case OP_POP: vm->height--; break;
+            case OP_JUMP: {
+                ip = frame->function->code + bytecode_read_u32(ip);
+                break;
+            }
+            case OP_JUMP_IF_FALSE: {
+                LispValue condition = stack[--vm->height];
+                if (condition == LISP_FALSE || condition == LISP_NIL) {
+                    ip = frame->function->code + bytecode_read_u32(ip);
+                } else {
+                    ip += 4;
+                }
+                break;
+            }
+            case OP_CLOSURE: {
+                LispFunction *function = value_function(constants[bytecode_read_u16(ip)]);
+                u16 count = bytecode_read_u16(ip + 2);
+                ip += 4;
+
+                LispClosure *closure = value_allocate_object(LISP_OBJECT_CLOSURE,
+                    sizeof(LispClosure) + count * sizeof(LispValue));
+                closure->function = function;
+                closure->capture_count = count;
+                vm->height -= count;
+                memcpy(closure->captures, &stack[vm->height], count * sizeof(LispValue));
+                stack[vm->height++] = value_from_object(closure);
+                break;
+            }
+            case OP_CALL: {
+                u16 count = bytecode_read_u16(ip);
+                ip += 2;
+                u32 callee_height = vm->height - count - 1;
+                LispValue callee = stack[callee_height];
+
+                if (value_is_builtin(callee)) {
+                    ValueResult result = vm_call_builtin(callee, &stack[callee_height + 1], count);
+                    if (result.failed) {
+                        return result;
+                    }
+                    vm->height = callee_height;
+                    stack[vm->height++] = result.value;
+                    break;
+                }
+                if (!value_is_closure(callee)) {
+                    return vm_error("Expected a function.");
+                }
+
+                LispClosure *closure = value_closure(callee);
+                frame->ip = ip;
+                LispError *error = vm_enter(vm, closure->function, closure, count, callee_height);
+                if (error != NULL) {
+                    return vm_failure(error);
+                }
+                frame = &vm->frames[vm->frame_count - 1];
+                ip = frame->ip;
+                constants = frame->function->constants;
+                stack = vm->stack;
+                break;
+            }
+            case OP_CALL_KNOWN: {
+                LispFunction *function = value_function(constants[bytecode_read_u16(ip)]);
+                u16 count = bytecode_read_u16(ip + 2);
+                ip += 4;
+
+                // The compiler has checked the number of arguments.
+                frame->ip = ip;
+                LispError *error = vm_enter(vm, function, NULL, count, vm->height - count);
+                if (error != NULL) {
+                    return vm_failure(error);
+                }
+                frame = &vm->frames[vm->frame_count - 1];
+                ip = frame->ip;
+                constants = frame->function->constants;
+                stack = vm->stack;
+                break;
+            }
+            case OP_ADD:
+            case OP_SUBTRACT:
+            case OP_MULTIPLY:
+            case OP_DIVIDE:
+            case OP_EQUAL: {
+                GlobalCache *cache = vm_global(frame->function, ip);
+                if (cache == NULL) {
+                    return vm_undefined_error(constants[bytecode_read_u16(ip)]);
+                }
+                ip += 4;
+                LispValue callee = cache->value;
+                LispValue a = stack[vm->height - 2];
+                LispValue b = stack[vm->height - 1];
+
+                if (value_is_fixnum(a & b) && value_is_builtin(callee)
+                        && value_builtin(callee)->builtin == vm_operators[op - OP_ADD]) {
+                    ValueResult result = vm_operate(op, a, b);
+                    if (result.failed) {
+                        return result;
+                    }
+                    stack[--vm->height - 1] = result.value;
+                    break;
+                }
+                if (value_is_builtin(callee)) {
+                    ValueResult result = vm_call_builtin(callee, &stack[vm->height - 2], 2);
+                    if (result.failed) {
+                        return result;
+                    }
+                    stack[--vm->height - 1] = result.value;
+                    break;
+                }
+                if (!value_is_closure(callee)) {
+                    return vm_error("Expected a function.");
+                }
+
+                LispClosure *closure = value_closure(callee);
+                frame->ip = ip;
+                LispError *error = vm_enter(vm, closure->function, closure, 2, vm->height - 2);
+                if (error != NULL) {
+                    return vm_failure(error);
+                }
+                frame = &vm->frames[vm->frame_count - 1];
+                ip = frame->ip;
+                constants = frame->function->constants;
+                stack = vm->stack;
+                break;
+            }
+            case OP_RETURN: {
+                LispValue value = stack[vm->height - 1];
+                vm->height = frame->return_height;
+                if (trace_calls) {
+                    trace_record(TRACE_RETURN, 0, 0, 0);
+                }
+                if (--vm->frame_count == 0) {
+                    ValueResult result = { .failed = false, .value = value };
+                    return result;
+                }
+                stack[vm->height++] = value;
+
+                frame = &vm->frames[vm->frame_count - 1];
+                ip = frame->ip;
+                constants = frame->function->constants;
+                break;
+            }
+        }
+    }
+}
+
+
+static void vm_init(Vm *vm) {
+    *vm = (Vm) {
+        .stack = (LispValue *) malloc(VM_INITIAL_STACK * sizeof(LispValue)),
+        .stack_capacity = VM_INITIAL_STACK,
+        .frames = (VmFrame *) malloc(0x10 * sizeof(VmFrame)),
+        .frame_capacity = 0x10
+    };
+}
+
+
+/**
+ * Free `vm` once it has finished with `result`, ending the calls a
+ * failure left in progress in the trace.
+ */
+static ValueResult vm_finish(Vm *vm, ValueResult result) {
+    if (result.failed && trace_calls) {
+        for (u32 i = 0; i < vm->frame_count; ++i) {
+            trace_record(TRACE_RETURN, 0, 0, 0);
+        }
+    }
+    free(vm->stack);
+    free(vm->frames);
+    return result;
+}
+
+
+// @see vm.h
+extern ValueResult vm_run(LispFunction *function) {
+    trace_begin(TRACE_VM);
+    Vm vm;
+    vm_init(&vm);
+    LispError *error = vm_enter(&vm, function, NULL, 0, 0);
+    ValueResult result = vm_finish(&vm, error != NULL ? vm_failure(error) : vm_execute(&vm));
+    trace_end(TRACE_VM);
+    return result;
+}
+
+
+// @see vm.h
+extern ValueResult vm_apply(LispValue function, LispValue *arguments, u32 argument_count) {
+    if (value_is_builtin(function)) {
+        return vm_call_builtin(function, arguments, argument_count);
+    }
+    if (!value_is_closure(function)) {
+        return vm_error("Expected a function.");
+    }
+
+    LispClosure *closure = value_closure(function);
+    Vm vm;
+    vm_init(&vm);
+    while (argument_count > vm.stack_capacity) {
+        vm.stack_capacity *= 2;
+    }
+    vm.stack = (LispValue *) realloc(vm.stack, vm.stack_capacity * sizeof(LispValue));
+    memcpy(vm.stack, arguments, argument_count * sizeof(LispValue));
+    vm.height = argument_count;
+
+    LispError *error = vm_enter(&vm, closure->function, closure, argument_count, 0);
+    return vm_finish(&vm, error != NULL ? vm_failure(error) : vm_execute(&vm));
+}
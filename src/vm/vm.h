@@ -0,0 +1,34 @@
+#ifndef VM_H
+#define VM_H
+#include <stdbool.h>
+
+#include "../util_types.h"
+#include "../runtime/value.h"
+#include "bytecode.h"
+
+
+/**
+ * Run the top-level code of a module, `function`, which takes no
+ * arguments and captures nothing.
+ *
+ * @return The value of its last form.
+ */
+extern ValueResult vm_run(LispFunction *function);
+
+/**
+ * Call the function value `function`, which is either a builtin or a
+ * closure.
+ */
+extern ValueResult vm_apply(LispValue function, LispValue *arguments, u32 argument_count);
+
+/**
+ * Look up the global named by the symbol `name`. Every builtin is a
+ * global named after it.
+ *
+ * @param value Set to the value of the global, if there is one.
+ * @return Whether the global is defined.
+ */
+extern bool vm_find_global(LispValue name, LispValue *value);
+
+
+#endif
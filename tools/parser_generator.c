@@ -0,0 +1,636 @@
+/**
+ * Generates the LL(1) parse table of the parser from the grammar in
+ * `docs/grammar.txt`, which documents its own format.
+ *
+ * usage: parser_generator grammar.txt parse_table.h
+ *
+ * The FIRST and FOLLOW sets of every nonterminal are computed to fill in
+ * the table, which maps a nonterminal and the type of the next token to
+ * the production to expand. A grammar that is not LL(1) is reported and
+ * nothing is written.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "../src/util_types.h"
+
+#define GENERATOR_MAX_TERMINALS 64
+#define GENERATOR_MAX_NONTERMINALS 0x100
+#define GENERATOR_MAX_PRODUCTIONS 0xFF
+#define GENERATOR_MAX_SYMBOLS 0x1000
+#define GENERATOR_MAX_WORDS 0x100
+
+// Symbols are terminal indices, or nonterminal indices with this bit set.
+#define GENERATOR_NONTERMINAL 0x4000
+// Set on a symbol marked with `^`. Must match `PARSER_CAPTURE`.
+#define GENERATOR_CAPTURE 0x8000
+
+
+typedef u64 TerminalSet;
+
+
+typedef struct {
+    char *name;
+    char *token_type;
+    char *description;
+} Terminal;
+
+
+typedef struct {
+    char *name;
+    char *description;
+    // The node type of the rule's action, or `NULL` if it has none.
+    char *node;
+    bool collapse;
+    bool defined;
+    u32 line;
+
+    bool nullable;
+    TerminalSet first;
+    TerminalSet follow;
+} Nonterminal;
+
+
+typedef struct {
+    u32 lhs;
+    u32 first;
+    u32 length;
+} Production;
+
+
+typedef struct {
+    const char *grammar_path;
+    Terminal terminals[GENERATOR_MAX_TERMINALS];
+    u32 terminal_count;
+    Nonterminal nonterminals[GENERATOR_MAX_NONTERMINALS];
+    u32 nonterminal_count;
+    // The nonterminal of the first rule.
+    u32 start;
+    // Production 0 is unused, so that 0 can mean "no production" in the table.
+    Production productions[GENERATOR_MAX_PRODUCTIONS + 1];
+    u32 production_count;
+    u16 symbols[GENERATOR_MAX_SYMBOLS];
+    u32 symbol_count;
+    u8 table[GENERATOR_MAX_NONTERMINALS][GENERATOR_MAX_TERMINALS];
+    bool failed;
+} Generator;
+
+
+static void generator_error(Generator *generator, u32 line, const char *format, const char *argument) {
+    fprintf(stderr, "%s:%u: error: ", generator->grammar_path, line);
+    fprintf(stderr, format, argument);
+    fputc('\n', stderr);
+    generator->failed = true;
+}
+
+
+static char *generator_read_file(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *contents = (char *) malloc((size_t) length + 1);
+    size_t read = fread(contents, 1, (size_t) length, file);
+    contents[read] = '\0';
+    fclose(file);
+    return contents;
+}
+
+
+/**
+ * Split `text` in place into words separated by whitespace. A word in
+ * double quotes may contain whitespace and is stored without its quotes.
+ *
+ * @return The number of words.
+ */
+static u32 generator_split(char *text, char *words[GENERATOR_MAX_WORDS]) {
+    u32 count = 0;
+    char *cursor = text;
+
+    while (count < GENERATOR_MAX_WORDS) {
+        while (isspace((unsigned char) *cursor)) {
+            cursor++;
+        }
+        if (*cursor == '\0') {
+            break;
+        }
+
+        if (*cursor == '"') {
+            words[count++] = ++cursor;
+            while (*cursor != '\0' && *cursor != '"') {
+                cursor++;
+            }
+        } else {
+            words[count++] = cursor;
+            while (*cursor != '\0' && !isspace((unsigned char) *cursor)) {
+                cursor++;
+            }
+        }
+
+        if (*cursor != '\0') {
+            *cursor++ = '\0';
+        }
+    }
+
+    return count;
+}
+
+
+static i32 generator_find_terminal(Generator *generator, const char *name) {
+    for (u32 i = 0; i < generator->terminal_count; ++i) {
+        if (strcmp(generator->terminals[i].name, name) == 0) {
+            return (i32) i;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * Get the index of the nonterminal `name`, adding it if it is new.
+ */
+static u32 generator_nonterminal(Generator *generator, const char *name, u32 line) {
+    for (u32 i = 0; i < generator->nonterminal_count; ++i) {
+        if (strcmp(generator->nonterminals[i].name, name) == 0) {
+            return i;
+        }
+    }
+
+    if (generator->nonterminal_count == GENERATOR_MAX_NONTERMINALS) {
+        generator_error(generator, line, "Too many nonterminals at '%s'.", name);
+        return 0;
+    }
+    Nonterminal *nonterminal = &generator->nonterminals[generator->nonterminal_count];
+    memset(nonterminal, 0, sizeof(Nonterminal));
+    nonterminal->name = strdup(name);
+    nonterminal->line = line;
+    return generator->nonterminal_count++;
+}
+
+
+static void generator_directive(Generator *generator, char *text, u32 line) {
+    char *words[GENERATOR_MAX_WORDS];
+    u32 count = generator_split(text, words);
+
+    if (strcmp(words[0], "%token") == 0 && count == 4) {
+        if (generator->terminal_count == GENERATOR_MAX_TERMINALS) {
+            generator_error(generator, line, "Too many terminals at %s.", words[1]);
+            return;
+        }
+        Terminal *terminal = &generator->terminals[generator->terminal_count++];
+        terminal->name = strdup(words[1]);
+        terminal->token_type = strdup(words[2]);
+        terminal->description = strdup(words[3]);
+    } else if (strcmp(words[0], "%describe") == 0 && count == 3) {
+        u32 index = generator_nonterminal(generator, words[1], line);
+        generator->nonterminals[index].description = strdup(words[2]);
+    } else {
+        generator_error(generator, line, "Malformed directive %s.", words[0]);
+    }
+}
+
+
+/**
+ * Add the productions of the rule in `text`, which may span several lines.
+ */
+static void generator_rule(Generator *generator, char *text, u32 line) {
+    char *words[GENERATOR_MAX_WORDS];
+    u32 count = generator_split(text, words);
+
+    if (count < 2 || strcmp(words[1], "::=") != 0) {
+        generator_error(generator, line, "Expected 'Name ::= ...', not '%s'.", words[0]);
+        return;
+    }
+
+    u32 lhs = generator_nonterminal(generator, words[0], line);
+    Nonterminal *nonterminal = &generator->nonterminals[lhs];
+    if (nonterminal->defined) {
+        generator_error(generator, line, "%s is defined twice.", words[0]);
+        return;
+    }
+    nonterminal->defined = true;
+    nonterminal->line = line;
+    if (generator->production_count == 0) {
+        generator->start = lhs;
+    }
+
+    // The action, if any, ends the rule.
+    if (count >= 2 && strcmp(words[count - 2], "=>") == 0) {
+        char *node = words[count - 1];
+        size_t length = strlen(node);
+        nonterminal->collapse = length > 0 && node[length - 1] == '?';
+        nonterminal->node = strndup(node, nonterminal->collapse ? length - 1 : length);
+        count -= 2;
+    }
+
+    u32 i = 2;
+    while (i <= count) {
+        if (generator->production_count == GENERATOR_MAX_PRODUCTIONS) {
+            generator_error(generator, line, "Too many productions at %s.", words[0]);
+            return;
+        }
+        Production *production = &generator->productions[++generator->production_count];
+        production->lhs = lhs;
+        production->first = generator->symbol_count;
+        production->length = 0;
+
+        for (; i < count && strcmp(words[i], "|") != 0; ++i) {
+            char *word = words[i];
+            if (strcmp(word, "ε") == 0) {
+                continue;
+            }
+
+            u16 capture = 0;
+            size_t length = strlen(word);
+            if (length > 1 && word[length - 1] == '^') {
+                word[length - 1] = '\0';
+                capture = GENERATOR_CAPTURE;
+            }
+
+            i32 terminal = generator_find_terminal(generator, word);
+            u16 symbol;
+            if (terminal >= 0) {
+                symbol = (u16) terminal;
+            } else if (!isalpha((unsigned char) word[0])) {
+                generator_error(generator, line, "Unknown terminal %s.", word);
+                continue;
+            } else {
+                symbol = (u16) (GENERATOR_NONTERMINAL | generator_nonterminal(generator, word, line));
+            }
+
+            if (generator->symbol_count == GENERATOR_MAX_SYMBOLS) {
+                generator_error(generator, line, "Too many symbols at %s.", word);
+                return;
+            }
+            generator->symbols[generator->symbol_count++] = symbol | capture;
+            production->length++;
+        }
+
+        // Skip the `|`, or step past the end of the rule.
+        i++;
+    }
+}
+
+
+/**
+ * Read the terminals, nonterminals and productions of the grammar.
+ */
+static void generator_parse(Generator *generator, char *grammar) {
+    char *rule = NULL;
+    size_t rule_length = 0;
+    u32 rule_line = 0;
+    u32 line_number = 0;
+
+    char *line = grammar;
+    while (line != NULL) {
+        char *next = strchr(line, '\n');
+        if (next != NULL) {
+            *next++ = '\0';
+        }
+        line_number++;
+
+        char *content = line;
+        while (isspace((unsigned char) *content)) {
+            content++;
+        }
+        bool continues = content != line && *content != '\0' && *content != '#';
+
+        // A rule ends at the first line that does not continue it.
+        if (rule != NULL && !continues) {
+            generator_rule(generator, rule, rule_line);
+            free(rule);
+            rule = NULL;
+        }
+
+        if (*content == '\0' || *content == '#') {
+            // Blank lines and comments.
+        } else if (*content == '%') {
+            generator_directive(generator, content, line_number);
+        } else if (continues) {
+            if (rule == NULL) {
+                generator_error(generator, line_number, "Unexpected indented line '%s'.", content);
+            } else {
+                size_t length = strlen(content);
+                rule = (char *) realloc(rule, rule_length + length + 2);
+                rule[rule_length++] = ' ';
+                memcpy(&rule[rule_length], content, length + 1);
+                rule_length += length;
+            }
+        } else {
+            rule = strdup(content);
+            rule_length = strlen(rule);
+            rule_line = line_number;
+        }
+
+        line = next;
+    }
+
+    if (rule != NULL) {
+        generator_rule(generator, rule, rule_line);
+        free(rule);
+    }
+
+    for (u32 i = 0; i < generator->nonterminal_count; ++i) {
+        if (!generator->nonterminals[i].defined) {
+            generator_error(generator, generator->nonterminals[i].line,
+                "%s is used but never defined.", generator->nonterminals[i].name);
+        }
+    }
+    if (generator->production_count == 0) {
+        generator_error(generator, line_number, "The grammar has no rules.%s", "");
+    }
+}
+
+
+/**
+ * Get the FIRST set of the symbols `symbols[0..length)`, and whether they
+ * can all derive the empty string.
+ */
+static TerminalSet generator_first_of(Generator *generator, const u16 *symbols, u32 length, bool *nullable) {
+    TerminalSet first = 0;
+    for (u32 i = 0; i < length; ++i) {
+        u16 symbol = symbols[i] & ~GENERATOR_CAPTURE;
+        if ((symbol & GENERATOR_NONTERMINAL) == 0) {
+            *nullable = false;
+            return first | ((TerminalSet) 1 << symbol);
+        }
+
+        Nonterminal *nonterminal = &generator->nonterminals[symbol & ~GENERATOR_NONTERMINAL];
+        first |= nonterminal->first;
+        if (!nonterminal->nullable) {
+            *nullable = false;
+            return first;
+        }
+    }
+    *nullable = true;
+    return first;
+}
+
+
+/**
+ * Compute which nonterminals are nullable, and their FIRST and FOLLOW
+ * sets, by iterating until nothing changes.
+ */
+static void generator_compute_sets(Generator *generator) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (u32 p = 1; p <= generator->production_count; ++p) {
+            Production *production = &generator->productions[p];
+            Nonterminal *lhs = &generator->nonterminals[production->lhs];
+
+            bool nullable;
+            TerminalSet first = generator_first_of(generator, &generator->symbols[production->first], production->length, &nullable);
+            if ((lhs->first | first) != lhs->first || (nullable && !lhs->nullable)) {
+                lhs->first |= first;
+                lhs->nullable |= nullable;
+                changed = true;
+            }
+        }
+    }
+
+    // Nothing may follow the start symbol; its rule ends with the end of
+    // the input.
+    changed = true;
+    while (changed) {
+        changed = false;
+        for (u32 p = 1; p <= generator->production_count; ++p) {
+            Production *production = &generator->productions[p];
+            const u16 *symbols = &generator->symbols[production->first];
+
+            for (u32 i = 0; i < production->length; ++i) {
+                u16 symbol = symbols[i] & ~GENERATOR_CAPTURE;
+                if ((symbol & GENERATOR_NONTERMINAL) == 0) {
+                    continue;
+                }
+                Nonterminal *nonterminal = &generator->nonterminals[symbol & ~GENERATOR_NONTERMINAL];
+
+                bool nullable;
+                TerminalSet follow = generator_first_of(generator, &symbols[i + 1], production->length - i - 1, &nullable);
+                if (nullable) {
+                    follow |= generator->nonterminals[production->lhs].follow;
+                }
+                if ((nonterminal->follow | follow) != nonterminal->follow) {
+                    nonterminal->follow |= follow;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+
+static void generator_fill_table(Generator *generator) {
+    for (u32 p = 1; p <= generator->production_count; ++p) {
+        Production *production = &generator->productions[p];
+        Nonterminal *lhs = &generator->nonterminals[production->lhs];
+
+        bool nullable;
+        TerminalSet lookahead = generator_first_of(generator, &generator->symbols[production->first], production->length, &nullable);
+        if (nullable) {
+            lookahead |= lhs->follow;
+        }
+
+        for (u32 t = 0; t < generator->terminal_count; ++t) {
+            if ((lookahead & ((TerminalSet) 1 << t)) == 0) {
+                continue;
+            }
+            if (generator->table[production->lhs][t] != 0) {
+                fprintf(stderr, "%s:%u: error: %s is not LL(1): two of its alternatives can start with %s.\n",
+                    generator->grammar_path, lhs->line, lhs->name, generator->terminals[t].name);
+                generator->failed = true;
+            }
+            generator->table[production->lhs][t] = (u8) p;
+        }
+    }
+}
+
+
+/**
+ * Write `text` as the contents of a C string literal.
+ */
+static void generator_write_string(FILE *output, const char *text) {
+    for (; *text != '\0'; ++text) {
+        if (*text == '"' || *text == '\\') {
+            fputc('\\', output);
+        }
+        fputc(*text, output);
+    }
+}
+
+
+/**
+ * Write the error for a missing `nonterminal`: its description if it has
+ * one, otherwise the terminals that could have come next.
+ */
+static void generator_write_expected(Generator *generator, FILE *output, Nonterminal *nonterminal) {
+    fputs("\"Expected ", output);
+
+    if (nonterminal->description != NULL) {
+        generator_write_string(output, nonterminal->description);
+    } else {
+        TerminalSet expected = nonterminal->first | (nonterminal->nullable ? nonterminal->follow : 0);
+        u32 remaining = (u32) __builtin_popcountll(expected);
+        for (u32 t = 0; t < generator->terminal_count; ++t) {
+            if ((expected & ((TerminalSet) 1 << t)) == 0) {
+                continue;
+            }
+            generator_write_string(output, generator->terminals[t].description);
+            remaining--;
+            fputs(remaining > 1 ? ", " : remaining == 1 ? " or " : "", output);
+        }
+    }
+
+    fputs(".\"", output);
+}
+
+
+/**
+ * Write `name` in upper snake case, so that `FunctionCall` becomes
+ * `FUNCTION_CALL`.
+ */
+static void generator_write_constant(FILE *output, const char *name) {
+    for (const char *c = name; *c != '\0'; ++c) {
+        if (c != name && isupper((unsigned char) *c)) {
+            fputc('_', output);
+        }
+        fputc(toupper((unsigned char) *c), output);
+    }
+}
+
+
+static void generator_write_symbol(Generator *generator, FILE *output, u16 symbol) {
+    u16 plain = symbol & ~GENERATOR_CAPTURE;
+    if ((plain & GENERATOR_NONTERMINAL) != 0) {
+        fprintf(output, "(PARSER_NONTERMINAL_BASE + %u)", plain & ~GENERATOR_NONTERMINAL);
+    } else {
+        fputs(generator->terminals[plain].token_type, output);
+    }
+    if ((symbol & GENERATOR_CAPTURE) != 0) {
+        fputs(" | PARSER_CAPTURE", output);
+    }
+}
+
+
+static void generator_write(Generator *generator, FILE *output) {
+    fprintf(output,
+        "// Generated from %s by tools/parser_generator.c. Do not edit.\n"
+        "#ifndef PARSE_TABLE_H\n"
+        "#define PARSE_TABLE_H\n\n"
+        "#define PARSER_NONTERMINAL_BASE (TOKEN_EOF + 1)\n"
+        "#define PARSER_NONTERMINAL_COUNT %u\n"
+        "#define PARSER_ACTION_BASE (PARSER_NONTERMINAL_BASE + PARSER_NONTERMINAL_COUNT)\n"
+        "#define PARSER_START_SYMBOL (PARSER_NONTERMINAL_BASE + %u)\n\n",
+        generator->grammar_path, generator->nonterminal_count, generator->start);
+
+    fputs("static const ParserNonterminal parser_nonterminals[PARSER_NONTERMINAL_COUNT] = {\n", output);
+    for (u32 i = 0; i < generator->nonterminal_count; ++i) {
+        Nonterminal *nonterminal = &generator->nonterminals[i];
+        fputs("    { ", output);
+        if (nonterminal->node != NULL) {
+            fputs("AST_", output);
+            generator_write_constant(output, nonterminal->node);
+        } else {
+            fputs("PARSER_NO_NODE", output);
+        }
+        fprintf(output, ", %s, ", nonterminal->collapse ? "true" : "false");
+        generator_write_expected(generator, output, nonterminal);
+        fprintf(output, " }, // %u %s\n", i, nonterminal->name);
+    }
+    fputs("};\n\n", output);
+
+    // The symbols of each production are stored last first, in the order
+    // they are pushed on the parser's stack.
+    fputs("static const u16 parser_symbols[] = {\n", output);
+    for (u32 p = 1; p <= generator->production_count; ++p) {
+        Production *production = &generator->productions[p];
+        fprintf(output, "    // %u: %s ::=", p, generator->nonterminals[production->lhs].name);
+        for (u32 i = 0; i < production->length; ++i) {
+            u16 symbol = generator->symbols[production->first + i] & ~GENERATOR_CAPTURE;
+            fprintf(output, " %s", (symbol & GENERATOR_NONTERMINAL) != 0
+                ? generator->nonterminals[symbol & ~GENERATOR_NONTERMINAL].name
+                : generator->terminals[symbol].name);
+        }
+        fputs(production->length == 0 ? " ε\n" : "\n", output);
+
+        for (u32 i = production->length; i > 0; --i) {
+            fputs("    ", output);
+            generator_write_symbol(generator, output, generator->symbols[production->first + i - 1]);
+            fputs(",\n", output);
+        }
+    }
+    fputs("    0\n};\n\n", output);
+
+    fputs("static const ParserProduction parser_productions[] = {\n    { 0, 0 },\n", output);
+    for (u32 p = 1; p <= generator->production_count; ++p) {
+        fprintf(output, "    { %u, %u },\n", generator->productions[p].first, generator->productions[p].length);
+    }
+    fputs("};\n\n", output);
+
+    fputs("static const u8 parser_table[PARSER_NONTERMINAL_COUNT][PARSER_NONTERMINAL_BASE] = {\n", output);
+    for (u32 i = 0; i < generator->nonterminal_count; ++i) {
+        fprintf(output, "    [%u] = {", i);
+        bool first = true;
+        for (u32 t = 0; t < generator->terminal_count; ++t) {
+            if (generator->table[i][t] != 0) {
+                fprintf(output, "%s[%s] = %u", first ? " " : ", ", generator->terminals[t].token_type, generator->table[i][t]);
+                first = false;
+            }
+        }
+        fprintf(output, " }, // %s\n", generator->nonterminals[i].name);
+    }
+    fputs("};\n\n", output);
+
+    fputs("static const char *const parser_terminal_errors[PARSER_NONTERMINAL_BASE] = {\n", output);
+    for (u32 t = 0; t < generator->terminal_count; ++t) {
+        fprintf(output, "    [%s] = \"Expected ", generator->terminals[t].token_type);
+        generator_write_string(output, generator->terminals[t].description);
+        fputs(".\",\n", output);
+    }
+    fputs("};\n\n#endif\n", output);
+}
+
+
+i32 main(i32 argc, char *argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s grammar.txt parse_table.h\n", argv[0]);
+        return 1;
+    }
+
+    static Generator generator;
+    generator.grammar_path = argv[1];
+
+    char *grammar = generator_read_file(argv[1]);
+    if (grammar == NULL) {
+        fprintf(stderr, "%s: error: Could not read the file.\n", argv[1]);
+        return 1;
+    }
+
+    generator_parse(&generator, grammar);
+    if (!generator.failed) {
+        generator_compute_sets(&generator);
+        generator_fill_table(&generator);
+    }
+    free(grammar);
+    if (generator.failed) {
+        return 1;
+    }
+
+    FILE *output = fopen(argv[2], "w");
+    if (output == NULL) {
+        fprintf(stderr, "%s: error: Could not write the file.\n", argv[2]);
+        return 1;
+    }
+    generator_write(&generator, output);
+    return fclose(output) == 0 ? 0 : 1;
+}
@@ -0,0 +1,267 @@
+/**
+ * Converts a trace written by the flight recorder, whose format is
+ * documented in `src/trace/trace.h`, to the JSON trace format read by
+ * Chrome's trace viewer and Perfetto.
+ *
+ * usage: trace_converter trace.bin > trace.json
+ *
+ * Phases and calls become duration events, and errors instant events.
+ * Timestamps are converted to microseconds since recording began by
+ * interpolating between the two anchors of the trace.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/util_types.h"
+#include "../src/trace/trace.h"
+
+
+typedef struct {
+    const u8 *bytes;
+    size_t length;
+    size_t position;
+    bool failed;
+} Reader;
+
+
+typedef struct {
+    u32 length;
+    const char *name;
+} ConverterSymbol;
+
+
+typedef struct {
+    u64 start_timestamp;
+    u64 start_nanoseconds;
+    // Nanoseconds per tick of the timestamps.
+    double scale;
+
+    ConverterSymbol *symbols;
+    u32 symbol_count;
+
+    // Whether an event has been written, so that the next needs a comma.
+    bool written;
+} Converter;
+
+
+static const char *const converter_phases[] = {
+    [TRACE_LEXER] = "lexer",
+    [TRACE_PARSER] = "parser",
+    [TRACE_COMPILER] = "compiler",
+    [TRACE_VM] = "vm"
+};
+
+
+// Indexed by `LispErrorType`.
+static const char *const converter_errors[] = {
+    "lexer", "parser", "internal", "runtime", "resource"
+};
+
+
+static char *converter_read_file(const char *path, size_t *length) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    size_t capacity = 0x10000;
+    char *contents = (char *) malloc(capacity);
+    *length = 0;
+    size_t read;
+    while ((read = fread(&contents[*length], 1, capacity - *length, file)) > 0) {
+        *length += read;
+        if (*length == capacity) {
+            capacity *= 2;
+            contents = (char *) realloc(contents, capacity);
+        }
+    }
+
+    fclose(file);
+    return contents;
+}
+
+
+/**
+ * Take the next `length` bytes, or `NULL` if the file ends first.
+ */
+static const u8 *reader_take(Reader *reader, size_t length) {
+    if (reader->failed || reader->length - reader->position < length) {
+        reader->failed = true;
+        return NULL;
+    }
+    const u8 *bytes = &reader->bytes[reader->position];
+    reader->position += length;
+    return bytes;
+}
+
+
+static u32 reader_u32(Reader *reader) {
+    u32 value = 0;
+    const u8 *bytes = reader_take(reader, sizeof(value));
+    if (bytes != NULL) {
+        memcpy(&value, bytes, sizeof(value));
+    }
+    return value;
+}
+
+
+static u64 reader_u64(Reader *reader) {
+    u64 value = 0;
+    const u8 *bytes = reader_take(reader, sizeof(value));
+    if (bytes != NULL) {
+        memcpy(&value, bytes, sizeof(value));
+    }
+    return value;
+}
+
+
+/**
+ * Write the `length` bytes at `string` as the contents of a JSON string.
+ */
+static void converter_write_string(const char *string, u32 length) {
+    for (u32 i = 0; i < length; ++i) {
+        u8 c = (u8) string[i];
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        } else if (c < 0x20) {
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
+        }
+    }
+}
+
+
+/**
+ * Write the fields every event has, leaving the object open.
+ */
+static void converter_begin_event(Converter *converter, const TraceEvent *event, u32 thread, char phase) {
+    double nanoseconds = ((double) event->timestamp - (double) converter->start_timestamp) * converter->scale;
+    printf("%s\n{\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"ph\":\"%c\"",
+        converter->written ? "," : "", thread, nanoseconds / 1000, phase);
+    converter->written = true;
+}
+
+
+static void converter_write_event(Converter *converter, const TraceEvent *event, u32 thread) {
+    switch ((TraceEventType) event->type) {
+        case TRACE_PHASE_BEGIN:
+        case TRACE_PHASE_END: {
+            const char *phase = event->argument < sizeof(converter_phases) / sizeof(converter_phases[0])
+                ? converter_phases[event->argument]
+                : "unknown";
+            converter_begin_event(converter, event, thread, event->type == TRACE_PHASE_BEGIN ? 'B' : 'E');
+            printf(",\"cat\":\"phase\",\"name\":\"%s\"}", phase);
+            break;
+        }
+        case TRACE_CALL: {
+            converter_begin_event(converter, event, thread, 'B');
+            fputs(",\"cat\":\"call\",\"name\":\"", stdout);
+            if (event->argument < converter->symbol_count) {
+                ConverterSymbol *symbol = &converter->symbols[event->argument];
+                converter_write_string(symbol->name, symbol->length);
+            } else {
+                fputs("(lambda)", stdout);
+            }
+            fputs("\"}", stdout);
+            break;
+        }
+        case TRACE_RETURN: {
+            converter_begin_event(converter, event, thread, 'E');
+            fputs(",\"cat\":\"call\"}", stdout);
+            break;
+        }
+        case TRACE_ERROR: {
+            const char *type = event->detail < sizeof(converter_errors) / sizeof(converter_errors[0])
+                ? converter_errors[event->detail]
+                : "unknown";
+            converter_begin_event(converter, event, thread, 'i');
+            printf(",\"cat\":\"error\",\"name\":\"%s error\",\"s\":\"t\","
+                "\"args\":{\"line\":%u,\"column\":%u}}", type, event->argument, event->column);
+            break;
+        }
+    }
+}
+
+
+static bool converter_convert(Converter *converter, Reader *reader) {
+    const u8 *magic = reader_take(reader, sizeof(TRACE_MAGIC));
+    if (magic == NULL || memcmp(magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0) {
+        fprintf(stderr, "error: Not a trace.\n");
+        return false;
+    }
+    u32 version = reader_u32(reader);
+    if (version != TRACE_VERSION) {
+        fprintf(stderr, "error: Unsupported trace version %u.\n", version);
+        return false;
+    }
+
+    converter->start_timestamp = reader_u64(reader);
+    converter->start_nanoseconds = reader_u64(reader);
+    u64 end_timestamp = reader_u64(reader);
+    u64 end_nanoseconds = reader_u64(reader);
+    converter->scale = end_timestamp > converter->start_timestamp
+        ? (double) (end_nanoseconds - converter->start_nanoseconds)
+            / (double) (end_timestamp - converter->start_timestamp)
+        : 1;
+
+    converter->symbol_count = reader_u32(reader);
+    if (reader->failed || converter->symbol_count > reader->length / sizeof(u32)) {
+        fprintf(stderr, "error: The trace is truncated.\n");
+        return false;
+    }
+    converter->symbols = (ConverterSymbol *) calloc(converter->symbol_count + 1, sizeof(ConverterSymbol));
+    for (u32 i = 0; i < converter->symbol_count; ++i) {
+        converter->symbols[i].length = reader_u32(reader);
+        converter->symbols[i].name = (const char *) reader_take(reader, converter->symbols[i].length);
+    }
+
+    u32 thread_count = reader_u32(reader);
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", stdout);
+    for (u32 i = 0; i < thread_count && !reader->failed; ++i) {
+        u32 thread = reader_u32(reader);
+        u32 event_count = reader_u32(reader);
+        for (u32 e = 0; e < event_count; ++e) {
+            const u8 *bytes = reader_take(reader, sizeof(TraceEvent));
+            if (bytes == NULL) {
+                break;
+            }
+            TraceEvent event;
+            memcpy(&event, bytes, sizeof(event));
+            converter_write_event(converter, &event, thread);
+        }
+    }
+    fputs("\n]}\n", stdout);
+
+    if (reader->failed) {
+        fprintf(stderr, "error: The trace is truncated.\n");
+        return false;
+    }
+    return true;
+}
+
+
+i32 main(i32 argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s trace.bin > trace.json\n", argv[0]);
+        return 1;
+    }
+
+    Reader reader = { 0 };
+    char *contents = converter_read_file(argv[1], &reader.length);
+    if (contents == NULL) {
+        fprintf(stderr, "%s: error: Could not read the file.\n", argv[1]);
+        return 1;
+    }
+    reader.bytes = (const u8 *) contents;
+
+    Converter converter = { 0 };
+    bool converted = converter_convert(&converter, &reader);
+    free(converter.symbols);
+    free(contents);
+    return converted ? 0 : 1;
+}
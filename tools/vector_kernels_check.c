@@ -0,0 +1,172 @@
+/**
+ * Checks that the vector kernels selected for this processor compute the
+ * same results as the scalar kernels, on every length whose elements after
+ * the last whole vector number from 0 to 7, and on inputs that are not
+ * aligned to a vector.
+ *
+ * usage: vector_kernels_check
+ *
+ * The values are small integers, so that floating point reductions are
+ * exact in any order. Exits with status 1 after listing every mismatch.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/util_types.h"
+#include "../src/runtime/vector_kernels.h"
+
+
+// Two whole vectors of the widest kernels, and a tail of up to 7.
+#define CHECK_MAX_LENGTH 15
+// How many elements the inputs are shifted by, to misalign them.
+#define CHECK_MAX_SHIFT 3
+
+
+typedef struct {
+    const VectorKernels *expected;
+    const VectorKernels *actual;
+    u32 failures;
+} Checker;
+
+
+static void checker_fail(Checker *checker, const char *kernel, size_t length, size_t shift) {
+    fprintf(stderr, "%s: %s differs from %s on %zu elements shifted by %zu\n",
+        kernel, checker->actual->name, checker->expected->name, length, shift);
+    checker->failures++;
+}
+
+
+static void checker_check_f64(Checker *checker, const double *a, const double *b, size_t length, size_t shift) {
+    double expected[CHECK_MAX_LENGTH], actual[CHECK_MAX_LENGTH];
+
+    for (u32 operation = NUMBER_ADD; operation <= NUMBER_DIVIDE; ++operation) {
+        for (u32 scalar = 0; scalar < 3; ++scalar) {
+            // Fill both with the same garbage, so that elements left
+            // unwritten show up as differences only if one kernel skips them.
+            memset(expected, 0x55, sizeof(expected));
+            memset(actual, 0x55, sizeof(actual));
+            checker->expected->f64_apply((NumberOperation) operation, expected, a, scalar == 1, b, scalar == 2, length);
+            checker->actual->f64_apply((NumberOperation) operation, actual, a, scalar == 1, b, scalar == 2, length);
+            if (memcmp(expected, actual, sizeof(expected)) != 0) {
+                checker_fail(checker, "f64_apply", length, shift);
+            }
+        }
+    }
+
+    if (checker->expected->f64_sum(a, length) != checker->actual->f64_sum(a, length)) {
+        checker_fail(checker, "f64_sum", length, shift);
+    }
+    if (checker->expected->f64_dot(a, b, length) != checker->actual->f64_dot(a, b, length)) {
+        checker_fail(checker, "f64_dot", length, shift);
+    }
+    if (length == 0) {
+        return;
+    }
+    if (checker->expected->f64_min(a, length) != checker->actual->f64_min(a, length)) {
+        checker_fail(checker, "f64_min", length, shift);
+    }
+    if (checker->expected->f64_max(b, length) != checker->actual->f64_max(b, length)) {
+        checker_fail(checker, "f64_max", length, shift);
+    }
+}
+
+
+static void checker_check_i64(Checker *checker, const i64 *a, const i64 *b, size_t length, size_t shift) {
+    i64 expected[CHECK_MAX_LENGTH], actual[CHECK_MAX_LENGTH];
+
+    for (u32 scalar = 0; scalar < 3; ++scalar) {
+        memset(expected, 0x55, sizeof(expected));
+        memset(actual, 0x55, sizeof(actual));
+        bool expected_exact = checker->expected->i64_add(expected, a, scalar == 1, b, scalar == 2, length);
+        bool actual_exact = checker->actual->i64_add(actual, a, scalar == 1, b, scalar == 2, length);
+        if (expected_exact != actual_exact || memcmp(expected, actual, sizeof(expected)) != 0) {
+            checker_fail(checker, "i64_add", length, shift);
+        }
+
+        memset(expected, 0x55, sizeof(expected));
+        memset(actual, 0x55, sizeof(actual));
+        expected_exact = checker->expected->i64_subtract(expected, a, scalar == 1, b, scalar == 2, length);
+        actual_exact = checker->actual->i64_subtract(actual, a, scalar == 1, b, scalar == 2, length);
+        if (expected_exact != actual_exact || memcmp(expected, actual, sizeof(expected)) != 0) {
+            checker_fail(checker, "i64_subtract", length, shift);
+        }
+    }
+
+    i64 expected_sum = 0, actual_sum = 0;
+    bool expected_exact = checker->expected->i64_sum(a, length, &expected_sum);
+    bool actual_exact = checker->actual->i64_sum(a, length, &actual_sum);
+    if (expected_exact != actual_exact || expected_sum != actual_sum) {
+        checker_fail(checker, "i64_sum", length, shift);
+    }
+    if (length == 0) {
+        return;
+    }
+    if (checker->expected->i64_min(b, length) != checker->actual->i64_min(b, length)) {
+        checker_fail(checker, "i64_min", length, shift);
+    }
+    if (checker->expected->i64_max(a, length) != checker->actual->i64_max(a, length)) {
+        checker_fail(checker, "i64_max", length, shift);
+    }
+}
+
+
+/**
+ * Check that an overflow in the last element is reported, which only the
+ * loop over the tail can see.
+ */
+static void checker_check_overflow(Checker *checker, i64 *a, i64 *b, size_t length, size_t shift) {
+    if (length == 0) {
+        return;
+    }
+    i64 result[CHECK_MAX_LENGTH];
+    i64 last_a = a[length - 1];
+    i64 last_b = b[length - 1];
+
+    a[length - 1] = INT64_MAX;
+    b[length - 1] = 1;
+    if (checker->actual->i64_add(result, a, false, b, false, length)) {
+        checker_fail(checker, "i64_add overflow", length, shift);
+    }
+    a[length - 1] = INT64_MIN;
+    if (checker->actual->i64_subtract(result, a, false, b, false, length)) {
+        checker_fail(checker, "i64_subtract overflow", length, shift);
+    }
+
+    a[length - 1] = last_a;
+    b[length - 1] = last_b;
+}
+
+
+int main(void) {
+    Checker checker = {
+        .expected = vector_kernels_scalar(),
+        .actual = vector_kernels(),
+        .failures = 0
+    };
+
+    double f64_a[CHECK_MAX_LENGTH + CHECK_MAX_SHIFT], f64_b[CHECK_MAX_LENGTH + CHECK_MAX_SHIFT];
+    i64 i64_a[CHECK_MAX_LENGTH + CHECK_MAX_SHIFT], i64_b[CHECK_MAX_LENGTH + CHECK_MAX_SHIFT];
+    for (size_t i = 0; i < CHECK_MAX_LENGTH + CHECK_MAX_SHIFT; ++i) {
+        // Neither sorted nor zero, so that the extremes and divisions
+        // depend on every element.
+        f64_a[i] = (double) ((i * 7) % 11 + 1);
+        f64_b[i] = (double) ((i * 5) % 13 + 1);
+        i64_a[i] = (i64) ((i * 7) % 11) * 3 - 10;
+        i64_b[i] = (i64) ((i * 5) % 13) - 6;
+    }
+
+    for (size_t shift = 0; shift <= CHECK_MAX_SHIFT; ++shift) {
+        for (size_t length = 0; length <= CHECK_MAX_LENGTH; ++length) {
+            checker_check_f64(&checker, &f64_a[shift], &f64_b[shift], length, shift);
+            checker_check_i64(&checker, &i64_a[shift], &i64_b[shift], length, shift);
+            checker_check_overflow(&checker, &i64_a[shift], &i64_b[shift], length, shift);
+        }
+    }
+
+    if (checker.failures > 0) {
+        return 1;
+    }
+    printf("The %s vector kernels agree with the %s kernels.\n", checker.actual->name, checker.expected->name);
+    return 0;
+}